@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# run the checks of this directory, and compare their tables. each
+# check is described at its section below. the executables are taken
+# from SFAC and SCRM, or from the PATH. as threads.sf is run in a
+# subdirectory, SFAC must be an absolute path. the session time stamps
+# of the tables are ignored.
+
+SFAC=${SFAC:-sfac}
+SCRM=${SCRM:-scrm}
+status=0
+
+same() {
+  grep -v TSess $1 > $1.tmp
+  grep -v TSess $2 > $2.tmp
+  if cmp -s $1.tmp $2.tmp; then
+    echo "$1 and $2 are the same"
+  else
+    echo "$1 and $2 differ"
+    status=1
+  fi
+  rm -f $1.tmp $2.tmp
+}
+
+# the lines of the table $2, and of the levels $1, with the level
+# indices replaced by the level names, sorted.
+named() {
+  awk 'NR == FNR {
+         if (NF >= 9 && $1 ~ /^[0-9]+$/ && $2 == -1) {
+           k = $7;
+           for (i = 8; i <= NF; i++) k = k "_" $i;
+           n[$1] = k;
+           print k, $3, $4, $6;
+         }
+         next;
+       }
+       NF == 8 && $1 ~ /^[0-9]+$/ {
+         $1 = n[$1];
+         $3 = n[$3];
+         print;
+       }' $1 $2 | sort
+}
+
+# the levels and transitions of $1 must all be found in $2.
+subset() {
+  named $1.lev $1.tr > $1.tmp
+  named $2.lev $2.tr > $2.tmp
+  if [ -s $1.tmp ] && [ -z "`comm -23 $1.tmp $2.tmp`" ]; then
+    echo "$1 is a subset of $2"
+  else
+    echo "$1 is not a subset of $2"
+    status=1
+  fi
+  rm -f $1.tmp $2.tmp
+}
+
+# the merged shards of the TR and CE tables of shards.sf against the
+# single files.
+rm -f ne*.b
+$SFAC shards.sf > shards.log || exit 1
+same ne.tr nem.tr
+same ne.ce nem.ce
+
+# the tables with limited radial caches of limit.sf against those with
+# unlimited ones of limit0.sf.
+rm -f nl*.b
+$SFAC limit0.sf > limit0.log || exit 1
+$SFAC limit.sf > limit.log || exit 1
+same nl0.lev nl.lev
+same nl0.tr nl.tr
+same nl0.ce nl.ce
+
+# the level populations from the sparse LU of sparse.sf against those
+# from DGESV of dense.sf, with the tables of rates.sf.
+rm -f fe.en fe.tr fe.ce
+$SFAC rates.sf > rates.log || exit 1
+$SCRM dense.sf > dense.log || exit 1
+$SCRM sparse.sf > sparse.log || exit 1
+grep CheckSparseSolve sparse.log
+same dense.spa sparse.spa
+
+# the levels and radiative rates of the lowest 3 levels of each 
+# symmetry, from DSYEVR of eigen2.sf and from the Davidson solver of
+# eigen3.sf, against those of the full spectrum from DSPEV of eigen0.sf.
+# the levels are matched by their names.
+rm -f eig*.b
+for m in 0 2 3; do
+  $SFAC eigen$m.sf > eigen$m.log || exit 1
+done
+subset eig2 eig0
+subset eig3 eig0
+
+# the tables of threads.sf computed with 1 thread against those with 3
+# and 4 threads, in the directories t1, t3 and t4. with 3 threads,
+# SolveStructure distributes the symmetries over the threads, with 4 the
+# threads share the work within each symmetry.
+for n in 1 3 4; do
+  rm -rf t$n
+  mkdir t$n
+  (cd t$n && OMP_NUM_THREADS=$n $SFAC ../threads.sf > threads.log) || exit 1
+done
+for n in 3 4; do
+  same t1/th.lev t$n/th.lev
+  same t1/th.tr t$n/th.tr
+  same t1/th.ce t$n/th.ce
+done
+
+exit $status
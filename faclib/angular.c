@@ -16,6 +16,7 @@
  *   along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include "angular.h"
 
 static char *rcsid="$Id$";
@@ -36,6 +37,8 @@ USE (rcsid);
 double ln_factorial[MAX_FACTORIAL];
 double ln_integer[MAX_FACTORIAL];
 
+static void InitAngularTables(void);
+
 #ifdef PERFORM_STATISTICS
 static ANGULAR_TIMING timing = {0, 0, 0};
 
@@ -79,6 +82,7 @@ int InitAngular(void) {
     ln_integer[n] = log((double) n);
     ln_factorial[n] = ln_factorial[n-1] + ln_integer[n]; 
   }
+  InitAngularTables();
   return 0;
 }
  
@@ -118,8 +122,9 @@ int Triangle(int j1, int j2, int j3) {
 */
 #define MAXTERM 512
 static double _sumk[MAXTERM];
+#pragma omp threadprivate(_sumk)
 /* 
-** FUNCTION:    W3j.
+** FUNCTION:    W3jCompute.
 ** PURPOSE:     calculate the Wigner 3j symbol.
 ** INPUT:       {int j1},
 **              angular momentum.
@@ -142,8 +147,9 @@ static double _sumk[MAXTERM];
 **              maximum angular momentum of about 500.
 **              if this limit is exceeded, the routine
 **              issues a warning.
+**              it is called through W3j, which caches the results.
 */
-double W3j(int j1, int j2, int j3, int m1, int m2, int m3) {
+static double W3jCompute(int j1, int j2, int j3, int m1, int m2, int m3) {
   int i, k, kmin, kmax, ik[14];
   double delta, qsum, a, b;
 
@@ -221,7 +227,7 @@ double W3j(int j1, int j2, int j3, int m1, int m2, int m3) {
 }
 
 /* 
-** FUNCTION:    W6j.
+** FUNCTION:    W6jCompute.
 ** PURPOSE:     calculate the 6j symbol.
 ** INPUT:       {int j1},
 **              angular momentum.
@@ -238,9 +244,10 @@ double W3j(int j1, int j2, int j3, int m1, int m2, int m3) {
 ** RETURN:      {double},
 **              6j symbol.
 ** SIDE EFFECT: 
-** NOTE:        
+** NOTE:        it is called through W6j, which caches the results.
 */
-double W6j(int j1, int j2, int j3, int i1, int i2, int i3) {
+static double W6jCompute(int j1, int j2, int j3, 
+			 int i1, int i2, int i3) {
   int n1, n2, n3, n4, n5, n6, n7, k, kmin, kmax, ic, ki;
   double r, a;
 
@@ -338,7 +345,7 @@ int W6jTriangle(int j1, int j2, int j3, int i1, int i2, int i3) {
 }
   
 /* 
-** FUNCTION:    W9j.
+** FUNCTION:    W9jCompute.
 ** PURPOSE:     calculate the 9j symbol.
 ** INPUT:       {int j1},
 **              angular momentum.
@@ -361,11 +368,11 @@ int W6jTriangle(int j1, int j2, int j3, int i1, int i2, int i3) {
 ** RETURN:      {double},
 **              9j symbol.
 ** SIDE EFFECT: 
-** NOTE:        
+** NOTE:        it is called through W9j, which caches the results.
 */     
-double W9j(int j1, int j2, int j3,
-	   int i1, int i2, int i3,
-	   int k1, int k2, int k3) {
+static double W9jCompute(int j1, int j2, int j3,
+			 int i1, int i2, int i3,
+			 int k1, int k2, int k3) {
   int j, jmin, jmax;
   double r;
 
@@ -444,6 +451,315 @@ int W9jTriangle(int j1, int j2, int j3,
 	  Triangle(j3, i3, k3));
 }
 
+/*
+** the symbol caches. the arguments are packed into one key as they
+** are given. the symmetries of the symbols are not used, since the
+** compute routines give results differing in the last bits for 
+** equivalent arguments, and a cached value must be the same as the
+** one computed. the results are kept in direct mapped tables 
+** without locks. a slot holds the value and the key xor the bits of
+** the value, a slot torn by concurrent writes fails the check and 
+** is a miss. symbols with all angular momenta not exceeding 
+** W3J_DMAX or W6J_DMAX are taken from dense tables filled by 
+** InitAngular.
+*/
+#if ULONG_MAX > 4294967295UL
+#define ANGULAR_CACHE 1
+#endif
+
+#define W3J_DMAX 7
+#define W6J_DMAX 7
+#define W3J_DN (W3J_DMAX+1)
+#define W6J_DN (W6J_DMAX+1)
+#define W3J_DM (2*W3J_DMAX+1)
+
+static double w3j_dense[W3J_DN*W3J_DN*W3J_DN*W3J_DM*W3J_DM];
+static double w6j_dense[W6J_DN*W6J_DN*W6J_DN*W6J_DN*W6J_DN*W6J_DN];
+static int dense_ready = 0;
+static long angular_stats[3][3];
+
+#ifdef ANGULAR_CACHE
+#define W3J_BITS 18
+#define W6J_BITS 18
+#define W9J_BITS 16
+
+typedef struct _ANGULAR_SLOT_ {
+  unsigned long check;
+  double value;
+} ANGULAR_SLOT;
+
+typedef union _ANGULAR_BITS_ {
+  double d;
+  unsigned long u;
+} ANGULAR_BITS;
+
+static ANGULAR_SLOT w3j_cache[1<<W3J_BITS];
+static ANGULAR_SLOT w6j_cache[1<<W6J_BITS];
+static ANGULAR_SLOT w9j_cache[1<<W9J_BITS];
+
+/* 
+** the tables are 2 way associative, a new key goes to the first slot
+** and the previous one is moved to the second.
+*/
+static int CacheGet(ANGULAR_SLOT *c, int bits, unsigned long key, 
+		    double *r) {
+  ANGULAR_SLOT *s;
+  ANGULAR_BITS b;
+  
+  s = c + (((key*0x9E3779B97F4A7C15UL) >> (64-bits)) & ~1UL);
+  b.d = s[0].value;
+  if ((s[0].check ^ b.u) == key) {
+    *r = b.d;
+    return 1;
+  }
+  b.d = s[1].value;
+  if ((s[1].check ^ b.u) == key) {
+    *r = b.d;
+    return 1;
+  }
+  return 0;
+}
+
+static void CachePut(ANGULAR_SLOT *c, int bits, unsigned long key, 
+		     double r) {
+  ANGULAR_SLOT *s;
+  ANGULAR_BITS b;
+  
+  s = c + (((key*0x9E3779B97F4A7C15UL) >> (64-bits)) & ~1UL);
+  s[1].value = s[0].value;
+  s[1].check = s[0].check;
+  b.d = r;
+  s[0].value = r;
+  s[0].check = key ^ b.u;
+}
+#endif
+
+/*
+** the counters are shared by all threads, and updated atomically.
+*/
+static void AngularCount(int i, int t) {
+#pragma omp atomic
+  angular_stats[i][t]++;
+}
+
+/* 
+** FUNCTION:    InitAngularTables.
+** PURPOSE:     fill the dense tables of the 3j and 6j symbols
+**              of small angular momenta.
+** INPUT:       
+** RETURN:      
+** SIDE EFFECT: 
+** NOTE:        
+*/
+static void InitAngularTables(void) {
+  int j1, j2, j3, m1, m2, i1, i2, i3, k;
+
+  if (dense_ready) return;
+  k = 0;
+  for (j1 = 0; j1 <= W3J_DMAX; j1++) {
+    for (j2 = 0; j2 <= W3J_DMAX; j2++) {
+      for (j3 = 0; j3 <= W3J_DMAX; j3++) {
+	for (m1 = -W3J_DMAX; m1 <= W3J_DMAX; m1++) {
+	  for (m2 = -W3J_DMAX; m2 <= W3J_DMAX; m2++) {
+	    if (!Triangle(j1, j2, j3) || abs(m1) > j1 || abs(m2) > j2 ||
+		abs(m1+m2) > j3) {
+	      w3j_dense[k++] = 0.0;
+	    } else {
+	      w3j_dense[k++] = W3jCompute(j1, j2, j3, m1, m2, -(m1+m2));
+	    }
+	  }
+	}
+      }
+    }
+  }
+  k = 0;
+  for (j1 = 0; j1 <= W6J_DMAX; j1++) {
+    for (j2 = 0; j2 <= W6J_DMAX; j2++) {
+      for (j3 = 0; j3 <= W6J_DMAX; j3++) {
+	for (i1 = 0; i1 <= W6J_DMAX; i1++) {
+	  for (i2 = 0; i2 <= W6J_DMAX; i2++) {
+	    for (i3 = 0; i3 <= W6J_DMAX; i3++) {
+	      if (!W6jTriangle(j1, j2, j3, i1, i2, i3)) {
+		w6j_dense[k++] = 0.0;
+	      } else {
+		w6j_dense[k++] = W6jCompute(j1, j2, j3, i1, i2, i3);
+	      }
+	    }
+	  }
+	}
+      }
+    }
+  }
+  dense_ready = 1;
+}
+
+/* 
+** FUNCTION:    W3j.
+** PURPOSE:     the Wigner 3j symbol, from the dense table or the 
+**              cache, computed by W3jCompute otherwise.
+** INPUT:       {int j1, j2, j3},
+**              angular momenta.
+**              {int m1, m2, m3},
+**              projections.
+** RETURN:      {double},
+**              3j coefficients.
+** SIDE EFFECT: 
+** NOTE:        
+*/
+double W3j(int j1, int j2, int j3, int m1, int m2, int m3) {
+#ifdef ANGULAR_CACHE
+  unsigned long key;
+  double r;
+#endif
+
+  if (m1 + m2 + m3) return 0.0;
+  if (abs(m1) > j1) return 0.0;
+  if (abs(m2) > j2) return 0.0;
+  if (abs(m3) > j3) return 0.0;
+  if (dense_ready && j1 <= W3J_DMAX && j2 <= W3J_DMAX && j3 <= W3J_DMAX) {
+    AngularCount(0, 0);
+    return w3j_dense[(((j1*W3J_DN + j2)*W3J_DN + j3)*W3J_DM + 
+		      m1 + W3J_DMAX)*W3J_DM + m2 + W3J_DMAX];
+  }
+  if (!Triangle(j1, j2, j3)) return 0.0;
+
+#ifdef ANGULAR_CACHE
+  if (j1 < 1024 && j2 < 1024 && j3 < 1024) {
+    key = (1UL<<63) | ((unsigned long) j1) | ((unsigned long) j2<<10) |
+      ((unsigned long) j3<<20) | ((unsigned long) (m1+j1)<<30) |
+      ((unsigned long) (m2+j2)<<41);
+    if (CacheGet(w3j_cache, W3J_BITS, key, &r)) {
+      AngularCount(0, 1);
+      return r;
+    }
+    AngularCount(0, 2);
+    r = W3jCompute(j1, j2, j3, m1, m2, m3);
+    CachePut(w3j_cache, W3J_BITS, key, r);
+    return r;
+  }
+#endif
+  return W3jCompute(j1, j2, j3, m1, m2, m3);
+}
+
+/* 
+** FUNCTION:    W6j.
+** PURPOSE:     the 6j symbol, from the dense table or the cache,
+**              computed by W6jCompute otherwise.
+** INPUT:       {int j1, j2, j3, i1, i2, i3},
+**              angular momenta.
+** RETURN:      {double},
+**              6j symbol.
+** SIDE EFFECT: 
+** NOTE:        
+*/
+double W6j(int j1, int j2, int j3, int i1, int i2, int i3) {
+#ifdef ANGULAR_CACHE
+  unsigned long key;
+  double r;
+#endif
+
+  if (dense_ready && j1 <= W6J_DMAX && j2 <= W6J_DMAX && j3 <= W6J_DMAX &&
+      i1 <= W6J_DMAX && i2 <= W6J_DMAX && i3 <= W6J_DMAX) {
+    AngularCount(1, 0);
+    return w6j_dense[((((j1*W6J_DN + j2)*W6J_DN + j3)*W6J_DN + 
+		       i1)*W6J_DN + i2)*W6J_DN + i3];
+  }
+  if (!W6jTriangle(j1, j2, j3, i1, i2, i3)) return 0.0;
+
+#ifdef ANGULAR_CACHE
+  if (j1 < 1024 && j2 < 1024 && j3 < 1024 && 
+      i1 < 1024 && i2 < 1024 && i3 < 1024) {
+    key = (1UL<<63) | ((unsigned long) j1) | ((unsigned long) j2<<10) |
+      ((unsigned long) j3<<20) | ((unsigned long) i1<<30) |
+      ((unsigned long) i2<<40) | ((unsigned long) i3<<50);
+    if (CacheGet(w6j_cache, W6J_BITS, key, &r)) {
+      AngularCount(1, 1);
+      return r;
+    }
+    AngularCount(1, 2);
+    r = W6jCompute(j1, j2, j3, i1, i2, i3);
+    CachePut(w6j_cache, W6J_BITS, key, r);
+    return r;
+  }
+#endif
+  return W6jCompute(j1, j2, j3, i1, i2, i3);
+}
+
+/* 
+** FUNCTION:    W9j.
+** PURPOSE:     the 9j symbol, from the cache, computed by W9jCompute
+**              otherwise.
+** INPUT:       {int j1, j2, j3, i1, i2, i3, k1, k2, k3},
+**              angular momenta.
+** RETURN:      {double},
+**              9j symbol.
+** SIDE EFFECT: 
+** NOTE:        
+*/     
+double W9j(int j1, int j2, int j3,
+	   int i1, int i2, int i3,
+	   int k1, int k2, int k3) {
+#ifdef ANGULAR_CACHE
+  int a[9], i;
+  unsigned long key;
+  double r;
+#endif
+
+  if (!W9jTriangle(j1, j2, j3, i1, i2, i3, k1, k2, k3)) return 0.0;
+#ifdef ANGULAR_CACHE
+  a[0] = j1;
+  a[1] = j2;
+  a[2] = j3;
+  a[3] = i1;
+  a[4] = i2;
+  a[5] = i3;
+  a[6] = k1;
+  a[7] = k2;
+  a[8] = k3;
+  key = 1UL<<63;
+  for (i = 0; i < 9; i++) {
+    if (a[i] >= 128) break;
+    key |= ((unsigned long) a[i]) << (7*i);
+  }
+  if (i == 9) {
+    if (CacheGet(w9j_cache, W9J_BITS, key, &r)) {
+      AngularCount(2, 1);
+      return r;
+    }
+    AngularCount(2, 2);
+    r = W9jCompute(j1, j2, j3, i1, i2, i3, k1, k2, k3);
+    CachePut(w9j_cache, W9J_BITS, key, r);
+    return r;
+  }
+#endif
+  return W9jCompute(j1, j2, j3, i1, i2, i3, k1, k2, k3);
+}
+
+/* 
+** FUNCTION:    PrintAngularStats.
+** PURPOSE:     print the number of the 3j, 6j and 9j symbols taken 
+**              from the dense tables and from the caches, and the
+**              number computed.
+** INPUT:       
+** RETURN:      
+** SIDE EFFECT: 
+** NOTE:        
+*/
+void PrintAngularStats(void) {
+  char *names[] = {"3j", "6j", "9j"};
+  long n, *st;
+  int i;
+
+  printf("%-6s %12s %12s %12s %8s\n", 
+	 "symbol", "tabulated", "hits", "computed", "rate");
+  for (i = 0; i < 3; i++) {
+    st = angular_stats[i];
+    n = st[0] + st[1] + st[2];
+    printf("%-6s %12ld %12ld %12ld %8.4f\n", names[i], 
+	   st[0], st[1], st[2], n > 0?(1.0 - st[2]/(double)n):0.0);
+  }
+}
+
 /* 
 ** FUNCTION:    WignerEckartFactor.
 ** PURPOSE:     calculate the geometric prefactor in 
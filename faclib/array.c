@@ -93,7 +93,9 @@ int ArrayInit(ARRAY *a, int esize, int block) {
   a->block = block;
   a->bsize = ((int)esize)*((int)block);
   a->dim = 0;
-  a->data = NULL;
+  a->nb = 0;
+  a->bptr = NULL;
+  a->retired = NULL;
   return 0;
 }
 
@@ -111,20 +113,48 @@ int ArrayInit(ARRAY *a, int esize, int block) {
 ** NOTE:        
 */
 void *ArrayGet(ARRAY *a, int i) {
-  DATA *p;
+  char *p;
+
   if (i < 0 || i >= a->dim) return NULL;
-  p = a->data;
-  while (i >= a->block) {
-    p = p->next;
-    i -= a->block;
-  }
-  if (p->dptr) {
-    return ((char *) p->dptr) + i*(a->esize);
+  p = (char *) a->bptr[i/a->block];
+  if (p) {
+    return p + (i%a->block)*(a->esize);
   } else {
     return NULL;
   }
 }
 
+/*
+** enlarge the block table to hold at least n blocks. inside a
+** parallel region the old table may still be in use by the
+** readers, so it is retired instead of freed.
+*/
+static void ArrayGrowTable(ARRAY *a, int n) {
+  void **t;
+  DATA *r;
+  int k, m;
+
+  m = 2*a->nb;
+  if (m < 4) m = 4;
+  if (m < n) m = n;
+  t = (void **) malloc(sizeof(void *)*m);
+  for (k = 0; k < a->nb; k++) t[k] = a->bptr[k];
+  for (; k < m; k++) t[k] = NULL;
+  if (a->bptr) {
+    if (InParallel()) {
+      r = (DATA *) malloc(sizeof(DATA));
+      r->dptr = a->bptr;
+      r->next = a->retired;
+      a->retired = r;
+    } else {
+      free(a->bptr);
+    }
+  }
+#pragma omp flush
+  a->bptr = t;
+  a->nb = m;
+}
+
 /* 
 ** FUNCTION:    ArraySet
 ** PURPOSE:     set the i-th element.
@@ -142,44 +172,29 @@ void *ArrayGet(ARRAY *a, int i) {
 ** SIDE EFFECT: 
 ** NOTE:        if d == NULL, this function simply retrieve the
 **              i-th element. if the element does not exist,
-**              an empty one is created.
+**              an empty one is created. the size of the array is
+**              updated only after the element is in place.
 */
 void *ArraySet(ARRAY *a, int i, void *d, 
 	       void (*InitData)(void *, int)) {
   void *pt;
-  char *ct;
-  DATA *p;
+  int k;
  
-  if (a->dim == 0) {
-    a->data = (DATA *) malloc(sizeof(DATA));
-    a->data->dptr = malloc(a->bsize);
-    if (InitData) InitData(a->data->dptr, a->block);
-    a->data->next = NULL;
-  }
-  p = a->data;
-  if (a->dim <= i) a->dim = i+1;
-  while (i >= a->block) {
-    if (!(p->next)) {
-      p->next = (DATA *) malloc(sizeof(DATA));
-      p->next->dptr = NULL;
-      p->next->next = NULL;
-    }
-    p = p->next;
-    i -= a->block;
-  }
-
-  if (!(p->dptr)) {
-    p->dptr = malloc(a->bsize);
-    if (InitData) InitData(p->dptr, a->block);
+  k = i/a->block;
+  if (k >= a->nb) ArrayGrowTable(a, k+1);
+  if (!(a->bptr[k])) {
+    pt = malloc(a->bsize);
+    if (InitData) InitData(pt, a->block);
+#pragma omp flush
+    a->bptr[k] = pt;
   }
   
-  ct = (char *) p->dptr;
-  for (; i > 0; i--) {
-    ct += a->esize;
-  }
-  pt = (void *) ct;
-
+  pt = ((char *) a->bptr[k]) + (i%a->block)*(a->esize);
   if (d) memcpy(pt, d, a->esize);
+  if (a->dim <= i) {
+#pragma omp flush
+    a->dim = i+1;
+  }
   return pt;
 }
 
@@ -193,29 +208,22 @@ void *ArraySet(ARRAY *a, int i, void *d,
 ** SIDE EFFECT: 
 */
 void *ArrayContiguous(ARRAY *a) {
-  void *r, *rp;
-  DATA *p;
-  int i, m;
+  char *r, *rp;
+  int i, k, m;
 
   if (a->dim == 0) return NULL;
-  m = a->esize*a->block;
-  r = malloc(a->esize*a->dim);
-  p = a->data;
+  m = a->bsize;
+  r = (char *) malloc(a->esize*a->dim);
   i = a->dim;
   rp = r;
-  while (1) {
-    if (i <= a->block) {
-      memcpy(rp, p->dptr, i*a->esize);
-      break;
-    } else {
-      memcpy(rp, p->dptr, m);
-      rp = ((char *)rp) + m;
-      i -= a->block;
-    }
-    p = p->next;
+  for (k = 0; i > 0; k++) {
+    if (i < a->block) m = i*a->esize;
+    if (a->bptr[k]) memcpy(rp, a->bptr[k], m);
+    rp += m;
+    i -= a->block;
   }
   
-  return r;
+  return (void *) r;
 }
   
 /* 
@@ -237,47 +245,27 @@ void *ArrayAppend(ARRAY *a, void *d,
   return ArraySet(a, i, d, InitData);
 }
 
-/* 
-** FUNCTION:    ArrayFreeData
-** PURPOSE:     free the data stored in the array.
-** INPUT:       {DATA *p},
-**              pointer to the data to be freed
-**              {int esize},
-**              size of the element in bytes.
-**              {int block},
-**              number of elements in one block.
-**              {void (*FreeElem)(void *)},
-**              a function called before freeing the data.
-** RETURN:      {int},
-**              always 0.
-** SIDE EFFECT: 
-** NOTE:        this function calls itself recursively.
+/*
+** free the blocks from k on, calling FreeElem for each of
+** their elements.
 */
-int ArrayFreeData(DATA *p, int esize, int block, 
-		  void (*FreeElem)(void *)) {
-  void *pt;
+static void ArrayFreeBlocks(ARRAY *a, int k, 
+			    void (*FreeElem)(void *)) {
+  char *pt;
   int i;
 
-  if (p == NULL) return 0;
-
-  if (p->next) {
-    ArrayFreeData(p->next, esize, block, FreeElem);
-  }
-    
-  if (FreeElem && p->dptr) {
-    pt = p->dptr;
-    for (i = 0; i < block; i++) {
-      FreeElem(pt);
-      pt = ((char *) pt) + esize;
+  for (; k < a->nb; k++) {
+    if (a->bptr[k] == NULL) continue;
+    if (FreeElem) {
+      pt = (char *) a->bptr[k];
+      for (i = 0; i < a->block; i++) {
+	FreeElem(pt);
+	pt += a->esize;
+      }
     }
+    free(a->bptr[k]);
+    a->bptr[k] = NULL;
   }
-  if (p->dptr) {
-    free(p->dptr);
-  }
-  free(p);
-  p = NULL;
-
-  return 0;
 }
 
 /* 
@@ -293,11 +281,21 @@ int ArrayFreeData(DATA *p, int esize, int block,
 ** NOTE:        
 */    
 int ArrayFree(ARRAY *a, void (*FreeElem)(void *)) {
+  DATA *r;
+
   if (!a) return 0;
   if (a->dim == 0) return 0;
-  ArrayFreeData(a->data, a->esize, a->block, FreeElem);
+  ArrayFreeBlocks(a, 0, FreeElem);
+  free(a->bptr);
+  while (a->retired) {
+    r = a->retired;
+    a->retired = r->next;
+    free(r->dptr);
+    free(r);
+  }
   a->dim = 0;
-  a->data = NULL;
+  a->nb = 0;
+  a->bptr = NULL;
   return 0;
 }
 
@@ -316,9 +314,8 @@ int ArrayFree(ARRAY *a, void (*FreeElem)(void *)) {
 ** NOTE:        if the length of array is <= n, nothing happens.
 */    
 int ArrayTrim(ARRAY *a, int n, void (*FreeElem)(void *)) {
-  DATA *p;
-  void *pt;
-  int i;
+  char *pt;
+  int i, k;
 
   if (!a) return 0;
   if (a->dim <= n) return 0;
@@ -328,26 +325,17 @@ int ArrayTrim(ARRAY *a, int n, void (*FreeElem)(void *)) {
     return 0;
   }
 
-  i = n;
-  p = a->data;
-  while (i >= a->block) {
-    p = p->next;
-    i -= a->block;
-  }
-
+  k = n/a->block;
+  i = n%a->block;
   if (i == 0) {
-    ArrayFreeData(p, a->esize, a->block, FreeElem);
-    p = NULL;
+    ArrayFreeBlocks(a, k, FreeElem);
   } else {
-    if (p->next) {
-      ArrayFreeData(p->next, a->esize, a->block, FreeElem);
-      p->next = NULL;
-    }
-    if (p->dptr && FreeElem) {
-      pt = ((char *) p->dptr) + i*(a->esize);
+    ArrayFreeBlocks(a, k+1, FreeElem);
+    if (a->bptr[k] && FreeElem) {
+      pt = ((char *) a->bptr[k]) + i*(a->esize);
       for (; i < a->block; i++) {
 	FreeElem(pt);
-	pt = ((char *) pt) + a->esize;
+	pt += a->esize;
       }
     }
   }
@@ -555,7 +543,7 @@ void InitMDataData(void *p, int n) {
   c -= a; c -= b; c ^= (b>>15); \
 }
 
-static int Hash2(int *id, ub4 length, ub4 initval, int n) {
+static ub4 HashKey(int *id, ub4 length, ub4 initval) {
   register ub4 a, b, c, len, *k;
   ub4 kd[32], i;
 
@@ -584,7 +572,11 @@ static int Hash2(int *id, ub4 length, ub4 initval, int n) {
   }
   Mix(a,b,c);
   /*-------------------------------------------- report the result */
-  return (int) (c & HashMask(n));
+  return c;
+}
+
+static int Hash2(int *id, ub4 length, ub4 initval, int n) {
+  return (int) (HashKey(id, length, initval) & HashMask(n));
 }
 
 int NMultiInit(MULTI *ma, int esize, int ndim, int *block) {
@@ -609,23 +601,15 @@ int NMultiInit(MULTI *ma, int esize, int ndim, int *block) {
 void *NMultiGet(MULTI *ma, int *k) {
   ARRAY *a;
   MDATA *pt;
-  DATA *p;
-  int i, j, m, h;
+  int j, h;
 
   h = Hash2(k, ma->ndim, 0, ma->ndim);
   a = &(ma->array[h]);
-  p = a->data;
-  i = a->dim;
-  j = 0;
-  while (p) {
-    pt = (MDATA *) p->dptr;
-    for (m = 0; m < a->block && j < i; j++, m++) {
-      if (memcmp(pt->index, k, ma->isize) == 0) {
-	return pt->data;
-      }
-      pt++;
+  for (j = 0; j < a->dim; j++) {
+    pt = (MDATA *) ArrayGet(a, j);
+    if (memcmp(pt->index, k, ma->isize) == 0) {
+      return pt->data;
     }
-    p = p->next;
   }
 
   return NULL;
@@ -634,10 +618,9 @@ void *NMultiGet(MULTI *ma, int *k) {
 void *NMultiSet(MULTI *ma, int *k, void *d, 
 		void (*InitData)(void *, int),
 		void (*FreeElem)(void *)) {
-  int i, j, m, h;
+  int j, h;
   MDATA *pt;
   ARRAY *a;
-  DATA *p, *p0;
 
   if (ma->maxelem > 0 && ma->numelem >= ma->maxelem) {
     NMultiFreeData(ma, FreeElem);
@@ -645,83 +628,40 @@ void *NMultiSet(MULTI *ma, int *k, void *d,
   }
   h = Hash2(k, ma->ndim, 0, ma->ndim);
   a = &(ma->array[h]);
-  if (a->dim == 0) {
-    a->data = (DATA *) malloc(sizeof(DATA));
-    a->data->dptr = malloc(a->bsize);
-    InitMDataData(a->data->dptr, a->block);
-    a->data->next = NULL;
-    pt = (MDATA *) a->data->dptr;
-  } else {
-    p = a->data;
-    i = a->dim;
-    j = 0;
-    while (p) {
-      pt = (MDATA *) p->dptr;
-      for (m = 0; m < a->block && j < i; j++, m++) {
-	if (memcmp(pt->index, k, ma->isize) == 0) {
-	  if (d) {
-	    memcpy(pt->data, d, ma->esize);
-	  }
-	  return pt->data;
-	}
-	pt++;
+  for (j = 0; j < a->dim; j++) {
+    pt = (MDATA *) ArrayGet(a, j);
+    if (memcmp(pt->index, k, ma->isize) == 0) {
+      if (d) {
+	memcpy(pt->data, d, ma->esize);
       }
-      p0 = p;
-      p = p->next;
-    }  
-    if (m == a->block) {
-      p0->next = (DATA *) malloc(sizeof(DATA));
-      p = p0->next;
-      p->dptr = malloc(a->bsize);
-      InitMDataData(p->dptr, a->block);
-      p->next = NULL;
-      pt = (MDATA *) p->dptr;
+      return pt->data;
     }
   }
 
   ma->numelem++;
+  pt = (MDATA *) ArraySet(a, a->dim, NULL, InitMDataData);
   pt->index = malloc(ma->isize);
   memcpy(pt->index, k, ma->isize);
   pt->data = malloc(ma->esize);
   if (InitData) InitData(pt->data, 1);
   if (d) memcpy(pt->data, d, ma->esize);
-  (a->dim)++;
 
   return pt->data;
 }
-
-static int NMultiArrayFreeData(DATA *p, int esize, int block, 
-			       void (*FreeElem)(void *)) { 
-  MDATA *pt;
-  int i;
-  
-  if (p->next) {
-    NMultiArrayFreeData(p->next, esize, block, FreeElem);
-  }
-
-  if (p->dptr) {
-    pt = p->dptr;
-    for (i = 0; i < block; i++) {
-      free(pt->index);
-      if (FreeElem && pt->data) FreeElem(pt->data);
-      free(pt->data);
-      pt++;
-    }
-    free(p->dptr);
-  }
-  if (p) {
-    free(p);
-  }
-  p = NULL;
-  return 0;
-}
     
 int NMultiFreeDataOnly(ARRAY *a, void (*FreeElem)(void *)) {
+  MDATA *pt;
+  int j;
+
   if (!a) return 0;
   if (a->dim == 0) return 0;
-  NMultiArrayFreeData(a->data, a->esize, a->block, FreeElem);
-  a->dim = 0;
-  a->data = NULL;
+  for (j = 0; j < a->dim; j++) {
+    pt = (MDATA *) ArrayGet(a, j);
+    free(pt->index);
+    if (FreeElem && pt->data) FreeElem(pt->data);
+    free(pt->data);
+  }
+  ArrayFree(a, NULL);
   return 0;
 }
 
@@ -748,3 +688,548 @@ int NMultiFree(MULTI *ma, void (*FreeElem)(void *)) {
   ma->ndim = 0;
   return 0;
 }
+
+/*
+** the following set of functions implement the MULTI array with
+** an open addressing hash table. the table is split into
+** MULTI_NSTRIPE stripes by the high bits of the hash, each stripe
+** has its own lock, slot table and slab arena. the slot table
+** uses linear probing and only holds the hash and the index of
+** the entry, the entries themselves, key followed by the element,
+** are allocated from the arena and never move.
+**
+** when maxelem > 0, each stripe holds at most its share of 
+** maxelem entries. beyond that, an entry is evicted with the CLOCK
+** algorithm: the top bit of the slot hash is a reference bit set 
+** on every access, the hand sweeps the slot table clearing the bit 
+** and evicts the first entry found with the bit already clear. 
+** the entry returned last by the stripe is never evicted, so that a
+** caller may hold on to one element while it looks up the next.
+** inside a parallel region, other threads may still be using an 
+** evicted element, its entry is then retired and only freed and 
+** reused by the first MultiSet called outside the region.
+*/
+#define MultiAlign(n)    ((((n)+7)/8)*8)
+#define StripeIndex(h)   (((h)>>26)&(MULTI_NSTRIPE-1))
+#define MEntry(s, ks, e) ((s)->chunk[(e)/MULTI_CHUNK] + \
+			  ((e)%MULTI_CHUNK)*(ks))
+#define MREF             0x80000000U
+#define MHASH(h)         ((h)&(~MREF))
+
+static void InitStripe(MSTRIPE *s) {
+  s->nslots = 0;
+  s->nused = 0;
+  s->slot = NULL;
+  s->nentries = 0;
+  s->nchunks = 0;
+  s->mchunks = 0;
+  s->chunk = NULL;
+  s->hand = 0;
+  s->last = 0;
+  s->free = -1;
+  s->nretired = 0;
+  s->mretired = 0;
+  s->retired = NULL;
+}
+
+/* 
+** FUNCTION:    OMultiInit
+** PURPOSE:     initialize an open addressing multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {int esize},
+**              size of each element in bytes.
+**              {int ndim},
+**              number of dimensions of the array.
+**              {int *block},
+**              kept for compatibility with the other implementations.
+** RETURN:      {int},
+**              always 0.
+** SIDE EFFECT: 
+** NOTE:        no memory for the elements is allocated until the
+**              first element of a stripe is set.
+*/    
+int OMultiInit(MULTI *ma, int esize, int ndim, int *block) {
+  int i;
+
+  ma->maxelem = -1;
+  ma->numelem = 0;
+  ma->ndim = ndim;
+  ma->isize = sizeof(int)*ndim;
+  ma->esize = esize;
+  ma->ksize = MultiAlign(ma->isize) + MultiAlign(esize);
+  ma->block = (unsigned short *) malloc(sizeof(unsigned short)*ndim);
+  for (i = 0; i < ndim; i++) ma->block[i] = block[i];
+  ma->array = NULL;
+  ma->stripe = (MSTRIPE *) malloc(sizeof(MSTRIPE)*MULTI_NSTRIPE);
+  for (i = 0; i < MULTI_NSTRIPE; i++) {
+    InitLock(&(ma->stripe[i].lock));
+    InitStripe(&(ma->stripe[i]));
+    ma->stripe[i].nhit = 0;
+    ma->stripe[i].nmiss = 0;
+    ma->stripe[i].nevict = 0;
+  }
+
+  return 0;
+}
+
+/* find the slot of key k. if not found, return -(i+1), where i is 
+   the empty slot the key should go to. */
+static int OMultiFind(MULTI *ma, MSTRIPE *s, int *k, unsigned int h) {
+  int i, m;
+  MSLOT *t;
+
+  m = s->nslots - 1;
+  i = h & m;
+  while (1) {
+    t = &(s->slot[i]);
+    if (t->entry == 0) return -(i+1);
+    if (MHASH(t->hash) == h && 
+	memcmp(MEntry(s, ma->ksize, t->entry-1), k, ma->isize) == 0) {
+      return i;
+    }
+    i = (i+1) & m;
+  }
+}
+
+/* double the size of the slot table, the entries are not touched. */
+static void OMultiGrow(MSTRIPE *s) {
+  int i, j, n, m;
+  MSLOT *t;
+
+  if (s->nslots == 0) n = MULTI_NSLOTS;
+  else n = 2*s->nslots;
+  t = (MSLOT *) malloc(sizeof(MSLOT)*n);
+  if (!t) {
+    printf("Not enough memory for MULTI slots\n");
+    exit(1);
+  }
+  for (i = 0; i < n; i++) t[i].entry = 0;
+  m = n - 1;
+  for (i = 0; i < s->nslots; i++) {
+    if (s->slot[i].entry == 0) continue;
+    j = MHASH(s->slot[i].hash) & m;
+    while (t[j].entry) j = (j+1) & m;
+    t[j] = s->slot[i];
+  }
+  if (s->slot) free(s->slot);
+  s->slot = t;
+  s->nslots = n;
+  s->hand = 0;
+}
+
+/* take a new entry from the free list or the arena of the stripe. */
+static int OMultiNewEntry(MULTI *ma, MSTRIPE *s) {
+  int e;
+
+  if (s->free >= 0) {
+    e = s->free;
+    memcpy(&(s->free), MEntry(s, ma->ksize, e), sizeof(int));
+    return e;
+  }
+  e = s->nentries;
+  if (e == s->nchunks*MULTI_CHUNK) {
+    if (s->nchunks == s->mchunks) {
+      if (s->mchunks == 0) s->mchunks = 8;
+      else s->mchunks *= 2;
+      s->chunk = (char **) realloc(s->chunk, sizeof(char *)*s->mchunks);
+    }
+    s->chunk[s->nchunks] = (char *) malloc(MULTI_CHUNK*ma->ksize);
+    if (!s->chunk || !s->chunk[s->nchunks]) {
+      printf("Not enough memory for MULTI arena\n");
+      exit(1);
+    }
+    s->nchunks++;
+  }
+  s->nentries++;
+  return e;
+}
+
+/* free the element of entry e and put the entry on the free list. */
+static void OMultiFreeEntry(MULTI *ma, MSTRIPE *s, int e,
+			    void (*FreeElem)(void *)) {
+  char *pt;
+
+  pt = MEntry(s, ma->ksize, e);
+  if (FreeElem) FreeElem(pt + MultiAlign(ma->isize));
+  memcpy(pt, &(s->free), sizeof(int));
+  s->free = e;
+}
+
+/* remove slot i, shifting back the following slots of the cluster
+   so that no tombstones are needed. */
+static void OMultiDelete(MSTRIPE *s, int i) {
+  int j, k, m;
+
+  m = s->nslots - 1;
+  j = i;
+  while (1) {
+    j = (j+1) & m;
+    if (s->slot[j].entry == 0) break;
+    k = MHASH(s->slot[j].hash) & m;
+    if ((j > i && (k <= i || k > j)) ||
+	(j < i && (k <= i && k > j))) {
+      s->slot[i] = s->slot[j];
+      i = j;
+    }
+  }
+  s->slot[i].entry = 0;
+  s->nused--;
+}
+
+/* evict one entry of the stripe with the CLOCK algorithm. 
+   return 0 if nothing can be evicted. */
+static int OMultiEvict(MULTI *ma, MSTRIPE *s, void (*FreeElem)(void *)) {
+  int i, n, e, m;
+  MSLOT *t;
+
+  m = s->nslots - 1;
+  for (n = 0; n <= 2*s->nslots; n++) {
+    i = s->hand;
+    t = &(s->slot[i]);
+    s->hand = (i+1) & m;
+    if (t->entry == 0 || t->entry == s->last) continue;
+    if (t->hash & MREF) {
+      t->hash &= ~MREF;
+      continue;
+    }
+    e = t->entry - 1;
+    OMultiDelete(s, i);
+    s->hand = i;
+    if (InParallel()) {
+      if (s->nretired == s->mretired) {
+	if (s->mretired == 0) s->mretired = MULTI_CHUNK;
+	else s->mretired *= 2;
+	s->retired = (int *) realloc(s->retired, sizeof(int)*s->mretired);
+	if (!s->retired) {
+	  printf("Not enough memory for MULTI eviction\n");
+	  exit(1);
+	}
+      }
+      s->retired[s->nretired++] = e;
+    } else {
+      OMultiFreeEntry(ma, s, e, FreeElem);
+    }
+    s->nevict++;
+#pragma omp atomic
+    ma->numelem--;
+    return 1;
+  }
+  return 0;
+}
+
+/* free the entries retired during a parallel region. */
+static void OMultiReclaim(MULTI *ma, void (*FreeElem)(void *)) {
+  MSTRIPE *s;
+  int i, j;
+
+  for (i = 0; i < MULTI_NSTRIPE; i++) {
+    s = &(ma->stripe[i]);
+    SetLock(&(s->lock));
+    for (j = 0; j < s->nretired; j++) {
+      OMultiFreeEntry(ma, s, s->retired[j], FreeElem);
+    }
+    s->nretired = 0;
+    ReleaseLock(&(s->lock));
+  }
+}
+
+/* 
+** FUNCTION:    OMultiGet
+** PURPOSE:     get an element in a multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {int *k},
+**              integer array of length ndim, 
+**              giving the indexes in each dimension.
+** RETURN:      {void *},
+**              pointer to the element, NULL if it does not exist.
+** SIDE EFFECT: 
+** NOTE:        
+*/    
+void *OMultiGet(MULTI *ma, int *k) {
+  MSTRIPE *s;
+  unsigned int h;
+  int i;
+  char *pt;
+
+  h = MHASH((unsigned int) HashKey(k, ma->ndim, 0));
+  s = &(ma->stripe[StripeIndex(h)]);
+  pt = NULL;
+  SetLock(&(s->lock));
+  if (s->nslots > 0) {
+    i = OMultiFind(ma, s, k, h);
+    if (i >= 0) {
+      s->slot[i].hash |= MREF;
+      s->last = s->slot[i].entry;
+      pt = MEntry(s, ma->ksize, s->slot[i].entry-1);
+      pt += MultiAlign(ma->isize);
+    }
+  }
+  if (pt) s->nhit++;
+  else s->nmiss++;
+  ReleaseLock(&(s->lock));
+
+  return (void *) pt;
+}
+
+/* 
+** FUNCTION:    OMultiSet
+** PURPOSE:     Set an element in a multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {int *k},
+**              integer array of length ndim, 
+**              giving the indexes in each dimension.
+**              {void *d},
+**              pointer to a piece of data to be copied to the array.
+**              {void (*InitData)(void *, int)},
+**              a function to initialize a newly created element.
+**              {void (*FreeElem)(void *)},
+**              a function called before freeing each element.
+** RETURN:      {void *},
+**              pointer to the element just set.
+** SIDE EFFECT: may evict an element not used recently when the
+**              array is limited.
+** NOTE:        if d == NULL, returns the existing element, or a new
+**              one initialized by InitData. the lock only protects
+**              the table, an element filled in by the caller after
+**              this returns may be seen half written by other 
+**              threads, such callers must publish it atomically.
+**              outside parallel regions, the pointer stays valid 
+**              until the second following MultiSet on the array.
+*/    
+void *OMultiSet(MULTI *ma, int *k, void *d, 
+		void (*InitData)(void *, int),
+		void (*FreeElem)(void *)) {
+  MSTRIPE *s;
+  unsigned int h;
+  int i, e, smax;
+  char *pt;
+
+  if (ma->maxelem > 0 && !InParallel()) {
+    for (i = 0; i < MULTI_NSTRIPE; i++) {
+      if (ma->stripe[i].nretired > 0) break;
+    }
+    if (i < MULTI_NSTRIPE) OMultiReclaim(ma, FreeElem);
+  }
+  h = MHASH((unsigned int) HashKey(k, ma->ndim, 0));
+  s = &(ma->stripe[StripeIndex(h)]);
+  SetLock(&(s->lock));
+  if (s->nslots == 0) OMultiGrow(s);
+  i = OMultiFind(ma, s, k, h);
+  if (i >= 0) {
+    s->slot[i].hash |= MREF;
+    s->last = s->slot[i].entry;
+    s->nhit++;
+    pt = MEntry(s, ma->ksize, s->slot[i].entry-1);
+    pt += MultiAlign(ma->isize);
+    if (d) memcpy(pt, d, ma->esize);
+    ReleaseLock(&(s->lock));
+    return (void *) pt;
+  }
+  s->nmiss++;
+  if (ma->maxelem > 0) {
+    smax = (ma->maxelem + MULTI_NSTRIPE - 1)/MULTI_NSTRIPE;
+    if (s->nused >= smax && OMultiEvict(ma, s, FreeElem)) {
+      i = OMultiFind(ma, s, k, h);
+    }
+  }
+  if (4*(s->nused+1) > 3*s->nslots) {
+    OMultiGrow(s);
+    i = OMultiFind(ma, s, k, h);
+  }
+  i = -(i+1);
+  e = OMultiNewEntry(ma, s);
+  pt = MEntry(s, ma->ksize, e);
+  memcpy(pt, k, ma->isize);
+  pt += MultiAlign(ma->isize);
+  if (InitData) InitData(pt, 1);
+  if (d) memcpy(pt, d, ma->esize);
+  s->slot[i].hash = h | MREF;
+  s->slot[i].entry = e+1;
+  s->nused++;
+  s->last = e+1;
+  ReleaseLock(&(s->lock));
+#pragma omp atomic
+  ma->numelem++;
+
+  return (void *) pt;
+}
+
+/* 
+** FUNCTION:    OMultiFreeData
+** PURPOSE:     Free the data of a multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {void (*FreeElem)(void *)},
+**              a function called before freeing each element.
+** RETURN:      {int},
+**              always 0.
+** SIDE EFFECT: 
+** NOTE:        must not be called while other threads use the array.
+**              the statistics are kept.
+*/    
+int OMultiFreeData(MULTI *ma, void (*FreeElem)(void *)) {
+  MSTRIPE *s;
+  int i, j;
+  char *pt;
+
+  if (ma->stripe == NULL) return 0;
+  for (i = 0; i < MULTI_NSTRIPE; i++) {
+    s = &(ma->stripe[i]);
+    if (FreeElem) {
+      for (j = 0; j < s->nslots; j++) {
+	if (s->slot[j].entry == 0) continue;
+	pt = MEntry(s, ma->ksize, s->slot[j].entry-1);
+	FreeElem(pt + MultiAlign(ma->isize));
+      }
+      for (j = 0; j < s->nretired; j++) {
+	pt = MEntry(s, ma->ksize, s->retired[j]);
+	FreeElem(pt + MultiAlign(ma->isize));
+      }
+    }
+    for (j = 0; j < s->nchunks; j++) {
+      free(s->chunk[j]);
+    }
+    if (s->chunk) free(s->chunk);
+    if (s->slot) free(s->slot);
+    if (s->retired) free(s->retired);
+    InitStripe(s);
+  }
+  ma->numelem = 0;
+
+  return 0;
+}
+
+/* 
+** FUNCTION:    OMultiFree
+** PURPOSE:     Free multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {void (*FreeElem)(void *)},
+**              a function called before freeing each element.
+** RETURN:      {int},
+**              always 0.
+** SIDE EFFECT: 
+** NOTE:        
+*/    
+int OMultiFree(MULTI *ma, void (*FreeElem)(void *)) {
+  int i;
+
+  if (!ma) return 0;
+  if (ma->ndim <= 0) return 0;
+  OMultiFreeData(ma, FreeElem);
+  for (i = 0; i < MULTI_NSTRIPE; i++) {
+    DestroyLock(&(ma->stripe[i].lock));
+  }
+  free(ma->stripe);
+  ma->stripe = NULL;
+  free(ma->block);
+  ma->block = NULL;
+  ma->ndim = 0;
+  return 0;
+}
+
+/* 
+** FUNCTION:    OMultiLimit
+** PURPOSE:     limit the memory used by a multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {double mb},
+**              memory budget in MB, <= 0 for no limit.
+** RETURN:      {int},
+**              the maximum number of elements.
+** SIDE EFFECT: 
+** NOTE:        only the memory of the table and the elements 
+**              themselves is counted, not the data they point to.
+*/    
+int OMultiLimit(MULTI *ma, double mb) {
+  double b;
+
+  if (mb <= 0) {
+    ma->maxelem = -1;
+  } else {
+    b = ma->ksize + (4.0/3.0)*sizeof(MSLOT);
+    b = mb*1e6/b;
+    if (b > 2e9) ma->maxelem = 2000000000;
+    else ma->maxelem = (int) b;
+    if (ma->maxelem < MULTI_NSTRIPE) ma->maxelem = MULTI_NSTRIPE;
+  }
+  return ma->maxelem;
+}
+
+/* 
+** FUNCTION:    OMultiStats
+** PURPOSE:     get the usage statistics of a multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {MULTI_STATS *st},
+**              the statistics on output.
+** RETURN:      {int},
+**              always 0.
+** SIDE EFFECT: 
+** NOTE:        
+*/    
+int OMultiStats(MULTI *ma, MULTI_STATS *st) {
+  MSTRIPE *s;
+  int i;
+
+  st->numelem = ma->numelem;
+  st->bytes = 0.0;
+  st->nhit = 0;
+  st->nmiss = 0;
+  st->nevict = 0;
+  if (ma->stripe == NULL) return 0;
+  for (i = 0; i < MULTI_NSTRIPE; i++) {
+    s = &(ma->stripe[i]);
+    SetLock(&(s->lock));
+    st->bytes += ((double) s->nchunks)*MULTI_CHUNK*ma->ksize;
+    st->bytes += ((double) s->nslots)*sizeof(MSLOT);
+    st->nhit += s->nhit;
+    st->nmiss += s->nmiss;
+    st->nevict += s->nevict;
+    ReleaseLock(&(s->lock));
+  }
+  return 0;
+}
+
+/* 
+** FUNCTION:    OMultiWalk
+** PURPOSE:     visit all elements of a multi-dimensional array.
+** INPUT:       {MULTI *ma},
+**              pointer to the multi-dimensional array.
+**              {int (*f)(int *, void *, void *)},
+**              called with the indexes, the element and arg of
+**              each element, the walk stops when it returns < 0.
+**              {void *arg},
+**              passed on to f.
+** RETURN:      {int},
+**              number of elements visited, or -1 if stopped.
+** SIDE EFFECT: 
+** NOTE:        the elements are visited in no particular order.
+**              f must not set or get elements of the same array.
+*/    
+int OMultiWalk(MULTI *ma, int (*f)(int *, void *, void *), void *arg) {
+  MSTRIPE *s;
+  int i, j, n;
+  char *pt;
+
+  n = 0;
+  if (ma->stripe == NULL) return 0;
+  for (i = 0; i < MULTI_NSTRIPE; i++) {
+    s = &(ma->stripe[i]);
+    SetLock(&(s->lock));
+    for (j = 0; j < s->nslots; j++) {
+      if (s->slot[j].entry == 0) continue;
+      pt = MEntry(s, ma->ksize, s->slot[j].entry-1);
+      if (f((int *) pt, pt + MultiAlign(ma->isize), arg) < 0) {
+	ReleaseLock(&(s->lock));
+	return -1;
+      }
+      n++;
+    }
+    ReleaseLock(&(s->lock));
+  }
+  return n;
+}
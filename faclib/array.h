@@ -73,10 +73,20 @@
 #include <string.h>
 #include <stddef.h>
 #include <time.h>
+#include "parallel.h"
 
-#define USE_NMULTI 1
+#define USE_OMULTI 1
 /* choose MULTI implementation */
-#ifdef USE_NMULTI
+#if defined(USE_OMULTI)
+#define MultiInit OMultiInit
+#define MultiGet OMultiGet
+#define MultiSet OMultiSet
+#define MultiFreeData OMultiFreeData
+#define MultiFree OMultiFree
+#define MultiLimit OMultiLimit
+#define MultiStats OMultiStats
+#define MultiWalk OMultiWalk
+#elif defined(USE_NMULTI)
 #define MultiInit NMultiInit
 #define MultiGet NMultiGet
 #define MultiSet NMultiSet
@@ -88,17 +98,19 @@
 #define MultiSet SMultiSet
 #define MultiFreeData SMultiFreeData
 #define MultiFree SMultiFree
-#endif /*USE_NMULTI*/
+#endif /*USE_OMULTI*/
 
 
 /*
 ** STRUCT:      DATA
-** PURPOSE:     data structure of the array elements
+** PURPOSE:     a block table of an array replaced by a larger one.
 ** FIELDS:      {void *dptr},
-**              pointer to a block of data.
+**              pointer to the old table.
 **              {DATA *next},
-**              pointer to the next block.
-** NOTE:        
+**              pointer to the next retired table.
+** NOTE:        a table replaced inside a parallel region may still
+**              be read by other threads, it is kept until the array
+**              is freed.
 */
 typedef struct _DATA_ {
   void *dptr;
@@ -112,18 +124,136 @@ typedef struct _DATA_ {
 **              the size of each element in bytes.
 **              {short block},
 **              number of elements in each block.
+**              {int bsize},
+**              the size of each block in bytes.
 **              {int dim},
 **              the size of the array.
-** NOTE:        
+**              {int nb},
+**              the size of the block table.
+**              {void **bptr},
+**              the block table, block k holds the elements
+**              k*block to (k+1)*block-1, NULL if not allocated.
+**              {DATA *retired},
+**              the block tables replaced in parallel regions.
+** NOTE:        the blocks never move, so the element pointers
+**              remain valid until the array is trimmed or freed.
+**              ArrayGet may be called concurrently with ArraySet
+**              appending elements, provided the writers are
+**              serialized by the caller.
 */
 typedef struct _ARRAY_ {
   unsigned short esize;
   unsigned short block;
   int bsize;
   int dim;
-  DATA  *data;
+  int nb;
+  void **bptr;
+  DATA *retired;
 } ARRAY;
 
+/*
+** STRUCT:      MSLOT
+** PURPOSE:     a slot in the open addressing table of OMULTI.
+** FIELDS:      {unsigned int hash},
+**              full hash value of the key stored.
+**              {int entry},
+**              1 + index of the entry in the arena, 0 if empty.
+** NOTE:        
+*/
+typedef struct _MSLOT_ {
+  unsigned int hash;
+  int entry;
+} MSLOT;
+
+/*
+** STRUCT:      MSTRIPE
+** PURPOSE:     one independently locked part of an OMULTI.
+** FIELDS:      {LOCK lock},
+**              lock protecting the stripe.
+**              {int nslots},
+**              size of the slot table, a power of 2.
+**              {int nused},
+**              number of occupied slots.
+**              {MSLOT *slot},
+**              the open addressing table.
+**              {int nentries},
+**              number of entries ever taken from the arena.
+**              {int nchunks},
+**              number of chunks allocated in the arena.
+**              {int mchunks},
+**              size of the chunk pointer table.
+**              {char **chunk},
+**              the slab arena, each chunk holds MULTI_CHUNK entries.
+**              {int hand},
+**              position of the CLOCK hand in the slot table.
+**              {int last},
+**              1 + the entry returned most recently, never evicted.
+**              {int free},
+**              head of the list of reusable entries, -1 if empty.
+**              {int nretired, mretired, *retired},
+**              entries evicted inside a parallel region, they are
+**              only reused once the region has ended.
+**              {long nhit, nmiss, nevict},
+**              number of hits, misses and evictions.
+** NOTE:        an entry is the key followed by the element, entries
+**              never move once created, so the element pointers 
+**              returned remain valid until the data are freed, or 
+**              the entry is evicted.
+*/
+typedef struct _MSTRIPE_ {
+  LOCK lock;
+  int nslots;
+  int nused;
+  MSLOT *slot;
+  int nentries;
+  int nchunks;
+  int mchunks;
+  char **chunk;
+  int hand;
+  int last;
+  int free;
+  int nretired;
+  int mretired;
+  int *retired;
+  long nhit;
+  long nmiss;
+  long nevict;
+} MSTRIPE;
+
+/*
+** STRUCT:      MULTI_STATS
+** PURPOSE:     usage statistics of a MULTI array.
+** FIELDS:      {int numelem},
+**              number of elements stored.
+**              {double bytes},
+**              memory held by the table and the arena.
+**              {long nhit, nmiss, nevict},
+**              number of hits, misses and evictions.
+** NOTE:        
+*/
+typedef struct _MULTI_STATS_ {
+  int numelem;
+  double bytes;
+  long nhit;
+  long nmiss;
+  long nevict;
+} MULTI_STATS;
+
+/*
+** VARIABLE:    MULTI_NSTRIPE, MULTI_CHUNK, MULTI_NSLOTS
+** TYPE:        macro constants.
+** PURPOSE:     number of stripes of an OMULTI, number of entries
+**              in one arena chunk, and the initial slot table size.
+** NOTE:        MULTI_NSTRIPE must be a power of 2.
+*/
+#ifdef _OPENMP
+#define MULTI_NSTRIPE  32
+#else
+#define MULTI_NSTRIPE  1
+#endif
+#define MULTI_CHUNK    256
+#define MULTI_NSLOTS   64
+
 /*
 ** STRUCT:      MULTI
 ** PURPOSE:     a multi-dimensional array.
@@ -136,7 +266,13 @@ typedef struct _ARRAY_ {
 **              {ARRAY *array},
 **              the multi-dimensional array is implemented as array 
 **              of arrays. 
-** NOTE:        
+**              {int ksize},
+**              size of an OMULTI arena entry in bytes.
+**              {MSTRIPE *stripe},
+**              the stripes of an OMULTI.
+** NOTE:        when maxelem > 0, NMULTI and SMULTI wipe all data once
+**              maxelem elements are stored, while OMULTI evicts the 
+**              elements not used recently with the CLOCK algorithm.
 */
 typedef struct _MULTI_ {
   int numelem, maxelem;
@@ -145,6 +281,8 @@ typedef struct _MULTI_ {
   unsigned short esize;
   unsigned short *block;
   ARRAY *array;
+  int ksize;
+  MSTRIPE *stripe;
 } MULTI;
 
 int   ArrayInit(ARRAY *a, int esize, int block);
@@ -157,8 +295,6 @@ void *ArrayAppend(ARRAY *a, void *d,
 int   ArrayTrim(ARRAY *a, int n, 
 		void(*FreeElem)(void *));
 int   ArrayFree(ARRAY *a, void (*FreeElem)(void *));
-int   ArrayFreeData(DATA *p, int esize, int block, 
-		    void (*FreeElem)(void *));
 
 int   SMultiInit(MULTI *ma, int esize, int ndim, int *block);
 void *SMultiGet(MULTI *ma, int *k);
@@ -183,6 +319,24 @@ int   NMultiFree(MULTI *ma,
 int   NMultiFreeDataOnly(ARRAY *a, void (*FreeElem)(void *));
 int   NMultiFreeData(MULTI *ma, void (*FreeElem)(void *));
 
+/*
+** the open addressing implementation of MULTI. keys and elements
+** are stored inline in slab arenas, and the table is split into
+** MULTI_NSTRIPE stripes, each with its own lock, so that one
+** array may be shared by the threads of a parallel region.
+*/
+int   OMultiInit(MULTI *ma, int esize, int ndim, int *block);
+void *OMultiGet(MULTI *ma, int *k);
+void *OMultiSet(MULTI *ma, int *k, void *d, 
+		void (*InitData)(void *, int),
+		void (*FreeElem)(void *));
+int   OMultiFree(MULTI *ma, 
+		 void (*FreeElem)(void *));
+int   OMultiFreeData(MULTI *ma, void (*FreeElem)(void *));
+int   OMultiLimit(MULTI *ma, double mb);
+int   OMultiStats(MULTI *ma, MULTI_STATS *st);
+int   OMultiWalk(MULTI *ma, int (*f)(int *, void *, void *), void *arg);
+
 void  InitIntData(void *p, int n);
 void  InitDoubleData(void *p, int n);
 void  InitPointerData(void *p, int n);
@@ -179,6 +179,14 @@
 		  INT, DOUBLEV, INT, DOUBLE, DOUBLEV, INT,\
 		  A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11)
 
+     PROTOCCALLSFSUB13(DGEMM, dgemm, STRING, STRING, INT, INT, INT,\
+		       DOUBLE, DOUBLEV, INT, DOUBLEV, INT, DOUBLE,\
+		       DOUBLEV, INT)
+#define DGEMM(A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,A13)\
+     CCALLSFSUB13(DGEMM, dgemm, STRING, STRING, INT, INT, INT,\
+		  DOUBLE, DOUBLEV, INT, DOUBLEV, INT, DOUBLE,\
+		  DOUBLEV, INT, A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,A13)
+
      PROTOCCALLSFSUB12(DSPEVD, dspevd, STRING, STRING, INT, DOUBLEV,\
 		       DOUBLEV, DOUBLEV, INT, DOUBLEV, INT, INTV, INT,\
 		       INTV)
@@ -194,6 +202,26 @@
 		 DOUBLEV, DOUBLEV, INT, DOUBLEV, INTV,\
 		 A1,A2,A3,A4,A5,A6,A7,A8,A9)
 
+     /* full storage solvers, only in the system LAPACK */
+     PROTOCCALLSFSUB11(DSYEVD, dsyevd, STRING, STRING, INT, DOUBLEV,\
+		       INT, DOUBLEV, DOUBLEV, INT, INTV, INT, INTV)
+#define DSYEVD(A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11)\
+     CCALLSFSUB11(DSYEVD, dsyevd, STRING, STRING, INT, DOUBLEV,\
+		  INT, DOUBLEV, DOUBLEV, INT, INTV, INT, INTV,\
+		  A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11)
+
+     PROTOCCALLSFSUB21(DSYEVR, dsyevr, STRING, STRING, STRING, INT,\
+		       DOUBLEV, INT, DOUBLE, DOUBLE, INT, INT, DOUBLE,\
+		       INTV, DOUBLEV, DOUBLEV, INT, INTV, DOUBLEV, INT,\
+		       INTV, INT, INTV)
+#define DSYEVR(A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,\
+               B1,B2,B3,B4,B5,B6,B7,B8,B9,B10)\
+     CCALLSFSUB21(DSYEVR, dsyevr, STRING, STRING, STRING, INT,\
+		  DOUBLEV, INT, DOUBLE, DOUBLE, INT, INT, DOUBLE,\
+		  INTV, DOUBLEV, DOUBLEV, INT, INTV, DOUBLEV, INT,\
+		  INTV, INT, INTV, A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,\
+		  B1,B2,B3,B4,B5,B6,B7,B8,B9,B10)
+
      PROTOCCALLSFSUB14(DGEEV, dgeev, STRING, STRING, INT, DOUBLEV, INT,	\
 		       DOUBLEV, DOUBLEV, DOUBLEV, INT, DOUBLEV, INT, DOUBLEV, \
 		       INT, INTV)
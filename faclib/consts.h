@@ -220,6 +220,9 @@
 #define MAXDN              3
 #define MBCLOSE            8        
 #define MAXLEVEB           1000000
+#define DAVIDSON_TOL       1E-8
+#define DAVIDSON_NITER     500
+#define DAVIDSON_MINDIM    4
 
 /* transition */
 #define G_COULOMB          1
@@ -29,7 +29,15 @@ USE (rcsid);
 static IONIZED ion0;
 static ARRAY *ions;
 static ARRAY *blocks;
+static ARRAY *rate_index;
 static double *bmatrix = NULL;
+/* the block rate matrix in compressed columns, the rhs, and the
+ * normalization row of each column, when sparse_solver is set. */
+static SP_MATRIX smatrix = {0, 0, 0, NULL, NULL, NULL};
+static double *svector = NULL;
+static int *snorm = NULL;
+static int sparse_solver = 0;
+static double sparse_pivot = 0.1;
 
 static int n_single_blocks = 64;
 
@@ -99,6 +107,12 @@ int SetCascade(int c, double a) {
   return 0;
 }
 
+int SetSparseSolver(int m, double tol) {
+  sparse_solver = m;
+  if (tol > 0.0 && tol <= 1.0) sparse_pivot = tol;
+  return 0;
+}
+
 int InitCRM(void) {
   int i;
 
@@ -111,6 +125,8 @@ int InitCRM(void) {
   ArrayInit(ions, sizeof(ION), ION_BLOCK);
   blocks = (ARRAY *) malloc(sizeof(ARRAY));
   ArrayInit(blocks, sizeof(LBLOCK), LBLOCK_BLOCK);
+  rate_index = (ARRAY *) malloc(sizeof(ARRAY));
+  ArrayInit(rate_index, sizeof(RATE_INDEX), ION_BLOCK*8);
   bmatrix = NULL;
   
   InitDBase();
@@ -120,6 +136,29 @@ int InitCRM(void) {
   return 0;
 }
 
+static void FreeSparseMatrix(SP_MATRIX *a) {
+  if (a->p) free(a->p);
+  if (a->i) free(a->i);
+  if (a->x) free(a->x);
+  a->p = NULL;
+  a->i = NULL;
+  a->x = NULL;
+  a->n = 0;
+  a->nnz = 0;
+  a->nmax = 0;
+}
+
+/* the matrices are allocated by BlockMatrix, for the current blocks */
+static void FreeBlockMatrix(void) {
+  if (bmatrix) free(bmatrix);
+  bmatrix = NULL;
+  FreeSparseMatrix(&smatrix);
+  if (svector) free(svector);
+  svector = NULL;
+  if (snorm) free(snorm);
+  snorm = NULL;
+}
+
 static void InitBlkRateData(void *p, int n) {
   BLK_RATE *r;
   int k;
@@ -139,6 +178,27 @@ static void FreeBlkRateData(void *p) {
   r->rates = NULL;
 }
 
+static void InitRateIndexData(void *p, int n) {
+  RATE_INDEX *x;
+  int k;
+
+  x = (RATE_INDEX *) p;
+  for (k = 0; k < n; k++, x++) {
+    x->bslot = NULL;
+    x->rslot = NULL;
+  }
+}
+
+static void FreeRateIndexData(void *p) {
+  RATE_INDEX *x;
+
+  x = (RATE_INDEX *) p;
+  if (x->bslot) free(x->bslot);
+  if (x->rslot) free(x->rslot);
+  x->bslot = NULL;
+  x->rslot = NULL;
+}
+
 static void InitIonData(void *p, int n) {
   ION *ion;
   int i, k;
@@ -257,6 +317,8 @@ int ReinitCRM(int m) {
 
   ReinitDBase(0);
   if (m == 3) return 0;
+
+  ArrayFree(rate_index, FreeRateIndexData);
   
   if (m == 1) {
     for (k = 0; k < ions->dim; k++) {
@@ -294,10 +356,7 @@ int ReinitCRM(int m) {
   ion0.atom = 0;
   ArrayFree(ions, FreeIonData);
   ArrayFree(blocks, FreeBlockData);
-  if (bmatrix) {
-    free(bmatrix);
-  }
-  bmatrix = NULL;
+  FreeBlockMatrix();
   
   return 0;
 }
@@ -1184,12 +1243,7 @@ int SetBlocks(double ni, char *ifn) {
     }
   }
   
-  k = blocks->dim;
-  if (bmatrix) free(bmatrix);
-  if (k > 0) {
-    k = 2*k*(k+1)+k;
-    bmatrix = (double *) malloc(sizeof(double)*k);
-  }
+  FreeBlockMatrix();
   
   return 0;
 }
@@ -2565,30 +2619,31 @@ int RateTable(char *fn, int nc, char *sc[], int md) {
   return 0;
 }
 
-void FixNorm(int m) {
+/*
+** the normalization equations replace the balance equations of
+** some blocks. nr[k] is the row of the equation in which block k
+** appears, or -1. a block k with nr[k] == k owns such a row.
+*/
+static void NormRows(int n, int *nr, double *x) {
   LBLOCK *blk1;
   ION *ion;
-  int k0, k1, iion, k, p, i, n;
-  double den, *x;
+  int k0, k1, iion, k, i;
+  double den;
 
-  n = blocks->dim;
-  x = bmatrix + n*n;
-  for (i = 0; i < n; i++) x[i] = 0.0;
+  for (i = 0; i < n; i++) {
+    x[i] = 0.0;
+    nr[i] = -1;
+  }
 
   if (norm_mode == 3) {
     x[0] = 1.0;
-    p = 0;
-    for (k = 0; k < n; k++) {
-      bmatrix[p] = 1.0;
-      p += n;
-    }
+    for (k = 0; k < n; k++) nr[k] = 0;
     for (k = 0; k < ions->dim; k++) {
       ion = (ION *) ArrayGet(ions, k);
       den = ion->n0;
       if (den+1 != 1) {
 	blk1 = ion->iblock[0];
-	p = blk1->ib;
-	x[p] = den;
+	x[blk1->ib] = den;
       }
     }
   } else if (norm_mode == 2) {
@@ -2601,16 +2656,12 @@ void FixNorm(int m) {
       }
     }
     x[0] = den;
-    p = 0;
-    for (k = 0; k < n; k++) {
-      bmatrix[p] = 1.0;
-      p += n;
-    }
-  } else {  
+    for (k = 0; k < n; k++) nr[k] = 0;
+  } else {
     iion = -2;
     k0 = 0;
     k1 = 0;
-    for (i = 0; i < n; i++) {    
+    for (i = 0; i < n; i++) {
       blk1 = (LBLOCK *) ArrayGet(blocks, i);
       if (blk1->iion != iion) {
 	if (iion != -2) {
@@ -2621,43 +2672,172 @@ void FixNorm(int m) {
 	  else den = ion->n0;
 	  if (den > 0.0) {
 	    x[k0] = den;
-	    p = k0;
-	    for (k = 0; k < n; k++) {
-	      if (norm_mode == 1) {
-		if (k < k1 && k >= k0) bmatrix[p] = 1.0;
-		else bmatrix[p] = 0.0;
-	      } else {
-		if (k == k0) bmatrix[p] = 1.0;
-		else bmatrix[p] = 0.0;
-	      }
-	      p += n;
+	    if (norm_mode == 1) {
+	      for (k = k0; k < k1; k++) nr[k] = k0;
+	    } else {
+	      nr[k0] = k0;
 	    }
-	  } 
+	  }
 	}
 	iion = blk1->iion;
 	k0 = k1;
       }
       k1++;
     }
-    
+
     k = iion;
     ion = (ION *) ArrayGet(ions, k);
     den = ion->n0;
     if (den > 0.0) {
       x[k0] = den;
-      p = k0;
-      for (k = 0; k < n; k++) {
-	if (norm_mode == 1) {
-	  if (k < k1 && k >= k0) bmatrix[p] = 1.0;
-	  else bmatrix[p] = 0.0;
-	} else {       
-	  if (k == k0) bmatrix[p] = 1.0;
-	  else bmatrix[p] = 0.0;
-	}
-	p += n;
+      if (norm_mode == 1) {
+	for (k = k0; k < k1; k++) nr[k] = k0;
+      } else {
+	nr[k0] = k0;
       }
-    } 
+    }
+  }
+}
+
+void FixNorm(int m) {
+  SP_MATRIX a;
+  int k, p, q, i, n, *nr;
+  double *x;
+
+  n = blocks->dim;
+  if (sparse_solver) {
+    NormRows(n, snorm, svector);
+    /* drop the normalized rows, and add the coefficients of
+       the normalization equations */
+    nr = snorm;
+    a.n = n;
+    a.nmax = smatrix.nnz + n;
+    a.p = (int *) malloc(sizeof(int)*(n+1));
+    a.i = (int *) malloc(sizeof(int)*a.nmax);
+    a.x = (double *) malloc(sizeof(double)*a.nmax);
+    q = 0;
+    for (k = 0; k < n; k++) {
+      a.p[k] = q;
+      if (nr[k] >= 0) {
+	a.i[q] = nr[k];
+	a.x[q] = 1.0;
+	q++;
+      }
+      for (p = smatrix.p[k]; p < smatrix.p[k+1]; p++) {
+	i = smatrix.i[p];
+	if (nr[i] == i) continue;
+	a.i[q] = i;
+	a.x[q] = smatrix.x[p];
+	q++;
+      }
+    }
+    a.p[n] = q;
+    a.nnz = q;
+    FreeSparseMatrix(&smatrix);
+    smatrix = a;
+    return;
+  }
+
+  x = bmatrix + n*n;
+  nr = (int *) malloc(sizeof(int)*n);
+  NormRows(n, nr, x);
+  for (i = 0; i < n; i++) {
+    if (nr[i] != i) continue;
+    p = i;
+    for (k = 0; k < n; k++) {
+      if (nr[k] == i) bmatrix[p] = 1.0;
+      else bmatrix[p] = 0.0;
+      p += n;
+    }
   }
+  free(nr);
+}
+
+/* add the rate a from block i to block j */
+static void AddBlockRate(int i, int j, double a) {
+  int n;
+
+  if (a == 0) return;
+  if (!sparse_solver) {
+    n = blocks->dim;
+    bmatrix[i*n + j] += a;
+    return;
+  }
+  if (smatrix.nnz == smatrix.nmax) {
+    smatrix.nmax *= 2;
+    smatrix.p = (int *) realloc(smatrix.p, sizeof(int)*smatrix.nmax);
+    smatrix.i = (int *) realloc(smatrix.i, sizeof(int)*smatrix.nmax);
+    smatrix.x = (double *) realloc(smatrix.x, sizeof(double)*smatrix.nmax);
+  }
+  smatrix.p[smatrix.nnz] = i;
+  smatrix.i[smatrix.nnz] = j;
+  smatrix.x[smatrix.nnz] = a;
+  smatrix.nnz++;
+}
+
+/*
+** convert the rates collected by AddBlockRate to compressed columns,
+** with the duplicates summed, and the diagonal, which is the total
+** rate out of the block, stored first in each column.
+*/
+static void CompressBlockMatrix(int n) {
+  SP_MATRIX a;
+  int i, j, k, p, q, *w;
+  double d;
+
+  a.n = n;
+  a.nmax = smatrix.nnz + n;
+  a.p = (int *) malloc(sizeof(int)*(n+1));
+  a.i = (int *) malloc(sizeof(int)*a.nmax);
+  a.x = (double *) malloc(sizeof(double)*a.nmax);
+  w = (int *) malloc(sizeof(int)*n);
+  for (k = 0; k < n; k++) w[k] = 1;
+  for (k = 0; k < smatrix.nnz; k++) w[smatrix.p[k]]++;
+  a.p[0] = 0;
+  for (k = 0; k < n; k++) {
+    a.p[k+1] = a.p[k] + w[k];
+    w[k] = a.p[k];
+    a.i[w[k]] = k;
+    a.x[w[k]] = 0.0;
+    w[k]++;
+  }
+  for (k = 0; k < smatrix.nnz; k++) {
+    p = w[smatrix.p[k]]++;
+    a.i[p] = smatrix.i[k];
+    a.x[p] = smatrix.x[k];
+  }
+
+  for (k = 0; k < n; k++) w[k] = -1;
+  q = 0;
+  for (j = 0; j < n; j++) {
+    k = q;
+    for (p = a.p[j]; p < a.p[j+1]; p++) {
+      i = a.i[p];
+      if (w[i] >= k) {
+	a.x[w[i]] += a.x[p];
+      } else {
+	w[i] = q;
+	a.i[q] = i;
+	a.x[q] = a.x[p];
+	q++;
+      }
+    }
+    a.p[j] = k;
+  }
+  a.p[n] = q;
+  a.nnz = q;
+  free(w);
+
+  for (j = 0; j < n; j++) {
+    d = 0.0;
+    for (p = a.p[j]+1; p < a.p[j+1]; p++) {
+      d += a.x[p];
+    }
+    a.x[a.p[j]] = -d;
+  }
+
+  FreeSparseMatrix(&smatrix);
+  smatrix = a;
 }
 
 int BlockMatrix(void) {
@@ -2666,11 +2846,28 @@ int BlockMatrix(void) {
   LBLOCK *blk1, *blk2;
   BLK_RATE *brts;
   int n, k, m, i, j, t, p, q;
-  double a, den;
-  
+  double a, b, c, den;
+
   n = blocks->dim;
-  for (i = 0; i < 2*n*(n+1); i++) {
-    bmatrix[i] = 0.0;
+  if (sparse_solver) {
+    if (svector == NULL) {
+      svector = (double *) malloc(sizeof(double)*2*n);
+      snorm = (int *) malloc(sizeof(int)*n);
+    }
+    FreeSparseMatrix(&smatrix);
+    smatrix.nmax = 4*n + RATES_BLOCK;
+    smatrix.p = (int *) malloc(sizeof(int)*smatrix.nmax);
+    smatrix.i = (int *) malloc(sizeof(int)*smatrix.nmax);
+    smatrix.x = (double *) malloc(sizeof(double)*smatrix.nmax);
+  } else {
+    FreeSparseMatrix(&smatrix);
+    if (bmatrix == NULL) {
+      k = 2*n*(n+1)+n;
+      bmatrix = (double *) malloc(sizeof(double)*k);
+    }
+    for (i = 0; i < 2*n*(n+1); i++) {
+      bmatrix[i] = 0.0;
+    }
   }
 
   for (k = 0; k < ions->dim; k++) {
@@ -2682,23 +2879,23 @@ int BlockMatrix(void) {
 	blk2 = brts->fblock;
 	if (blk1 == blk2) continue;
 	if (rec_cascade && (blk1->rec || blk2->rec)) continue;
+	a = 0.0;
+	b = 0.0;
 	for (m = 0; m < brts->rates->dim; m++) {
 	  r = (RATE *) ArrayGet(brts->rates, m);
-	  i = ion->iblock[r->i]->ib;
-	  j = ion->iblock[r->f]->ib;
 	  den = blk1->r[ion->ilev[r->i]];
 	  if (den) {
-	    p = i*n + j;
-	    bmatrix[p] += den * electron_density * r->dir;
+	    a += den * electron_density * r->dir;
 	  }
 	  if (r->inv > 0.0) {
 	    den = blk2->r[ion->ilev[r->f]];
 	    if (den) {
-	      p = i + j*n;
-	      bmatrix[p] += den * electron_density * r->inv;
+	      b += den * electron_density * r->inv;
 	    }
 	  }
 	}
+	AddBlockRate(blk1->ib, blk2->ib, a);
+	AddBlockRate(blk2->ib, blk1->ib, b);
       }
     }
     for (t = 0; t < ion->tr_rates->dim; t++) {
@@ -2707,27 +2904,27 @@ int BlockMatrix(void) {
       blk2 = brts->fblock;
       if (blk1 == blk2) continue;
       if (rec_cascade && (blk1->rec || blk2->rec)) continue;
+      a = 0.0;
+      b = 0.0;
       for (m = 0; m < brts->rates->dim; m++) {
 	r = (RATE *) ArrayGet(brts->rates, m);
-	i = ion->iblock[r->i]->ib;
-	j = ion->iblock[r->f]->ib;
 	den = blk1->r[ion->ilev[r->i]];
 	if (den) {
-	  p = i*n + j;
-	  bmatrix[p] += den * r->dir;
+	  a += den * r->dir;
 	}
 	if (r->inv > 0.0 && photon_density > 0.0) {
 	  if (den) {
-	    a = photon_density * r->inv;
-	    bmatrix[p] += den*a*(ion->j[r->f]+1.0)/(ion->j[r->i]+1.0);
-	  }	  
+	    c = photon_density * r->inv;
+	    a += den*c*(ion->j[r->f]+1.0)/(ion->j[r->i]+1.0);
+	  }
 	  den = blk2->r[ion->ilev[r->f]];
 	  if (den) {
-	    p = i + j*n;
-	    bmatrix[p] += den * photon_density * r->inv;
+	    b += den * photon_density * r->inv;
 	  }
 	}
       }
+      AddBlockRate(blk1->ib, blk2->ib, a);
+      AddBlockRate(blk2->ib, blk1->ib, b);
     }
     for (t = 0; t < ion->tr2_rates->dim; t++) {
       brts = (BLK_RATE *) ArrayGet(ion->tr2_rates, t);
@@ -2735,16 +2932,15 @@ int BlockMatrix(void) {
       blk2 = brts->fblock;
       if (blk1 == blk2) continue;
       if (rec_cascade && (blk1->rec || blk2->rec)) continue;
+      a = 0.0;
       for (m = 0; m < brts->rates->dim; m++) {
 	r = (RATE *) ArrayGet(brts->rates, m);
-	i = ion->iblock[r->i]->ib;
-	j = ion->iblock[r->f]->ib;
 	den = blk1->r[ion->ilev[r->i]];
 	if (den) {
-	  p = i*n + j;
-	  bmatrix[p] += den * r->dir;
+	  a += den * r->dir;
 	}
       }
+      AddBlockRate(blk1->ib, blk2->ib, a);
     }
     for (t = 0; t < ion->rr_rates->dim; t++) {
       brts = (BLK_RATE *) ArrayGet(ion->rr_rates, t);
@@ -2752,25 +2948,25 @@ int BlockMatrix(void) {
       blk2 = brts->fblock;
       if (blk1 == blk2) continue;
       if (rec_cascade && (blk1->rec || blk2->rec)) continue;
+      a = 0.0;
+      b = 0.0;
       for (m = 0; m < brts->rates->dim; m++) {
-	r = (RATE *) ArrayGet(brts->rates, m); 
-	i = ion->iblock[r->i]->ib;
-	j = ion->iblock[r->f]->ib;
+	r = (RATE *) ArrayGet(brts->rates, m);
 	den = blk1->r[ion->ilev[r->i]];
 	if (den) {
 	  if (electron_density > 0.0) {
-	    p = i*n + j;
-	    bmatrix[p] += den * electron_density * r->dir;
+	    a += den * electron_density * r->dir;
 	  }
 	}
 	if (r->inv > 0.0 && photon_density > 0.0) {
 	  den = blk2->r[ion->ilev[r->f]];
 	  if (den) {
-	    p = i + j*n;
-	    bmatrix[p] += den * photon_density * r->inv;
+	    b += den * photon_density * r->inv;
 	  }
 	}
       }
+      AddBlockRate(blk1->ib, blk2->ib, a);
+      AddBlockRate(blk2->ib, blk1->ib, b);
     }
     for (t = 0; t < ion->ai_rates->dim; t++) {
       brts = (BLK_RATE *) ArrayGet(ion->ai_rates, t);
@@ -2778,23 +2974,23 @@ int BlockMatrix(void) {
       blk2 = brts->fblock;
       if (blk1 == blk2) continue;
       if (rec_cascade && (blk1->rec || blk2->rec)) continue;
+      a = 0.0;
+      b = 0.0;
       for (m = 0; m < brts->rates->dim; m++) {
-	r = (RATE *) ArrayGet(brts->rates, m); 
-	i = ion->iblock[r->i]->ib;
-	j = ion->iblock[r->f]->ib;
+	r = (RATE *) ArrayGet(brts->rates, m);
 	den = blk1->r[ion->ilev[r->i]];
 	if (den) {
-	  p = i*n + j;
-	  bmatrix[p] += den * r->dir;
+	  a += den * r->dir;
 	}
 	if (r->inv > 0.0 && electron_density > 0.0) {
 	  den = blk2->r[ion->ilev[r->f]];
 	  if (den) {
-	    p = i + j*n;
-	    bmatrix[p] += den * electron_density * r->inv;
+	    b += den * electron_density * r->inv;
 	  }
 	}
-      }  
+      }
+      AddBlockRate(blk1->ib, blk2->ib, a);
+      AddBlockRate(blk2->ib, blk1->ib, b);
     }
     if (electron_density > 0.0) {
       for (t = 0; t < ion->ci_rates->dim; t++) {
@@ -2803,28 +2999,33 @@ int BlockMatrix(void) {
 	blk2 = brts->fblock;
 	if (blk1 == blk2) continue;
 	if (rec_cascade && (blk1->rec || blk2->rec)) continue;
+	a = 0.0;
+	b = 0.0;
 	for (m = 0; m < brts->rates->dim; m++) {
-	  r = (RATE *) ArrayGet(brts->rates, m); 
-	  i = ion->iblock[r->i]->ib;
-	  j = ion->iblock[r->f]->ib;
+	  r = (RATE *) ArrayGet(brts->rates, m);
 	  den = blk1->r[ion->ilev[r->i]];
 	  if (den) {
-	    p = i*n + j;
-	    bmatrix[p] += den * electron_density * r->dir;
+	    a += den * electron_density * r->dir;
 	  }
 	  if (r->inv > 0.0) {
 	    den = blk2->r[ion->ilev[r->f]];
 	    if (den) {
-	      p = i + j*n;
 	      den *= electron_density;
-	      bmatrix[p] += den * electron_density * r->inv;
+	      b += den * electron_density * r->inv;
 	    }
 	  }
-	}  
+	}
+	AddBlockRate(blk1->ib, blk2->ib, a);
+	AddBlockRate(blk2->ib, blk1->ib, b);
       }
     }
   }
 
+  if (sparse_solver) {
+    CompressBlockMatrix(n);
+    return 0;
+  }
+
   for (i = 0; i < n; i++) {
     p = i*n;
     q = i + p;
@@ -2838,6 +3039,319 @@ int BlockMatrix(void) {
   return 0;
 }
 
+/*
+** the rows of L reached from the nonzeros of column k of a, in
+** topological order in xi[top..n-1]. the depth first search is
+** not recursive, xi[n..2n-1] holds the position in each column.
+*/
+static int SparseReach(SP_MATRIX *l, SP_MATRIX *a, int k,
+		       int *xi, int *mark, int *pinv) {
+  int n, top, head, done, p, p2, q, i, j, jnew, *pstack;
+
+  n = a->n;
+  pstack = xi + n;
+  top = n;
+  for (q = a->p[k]; q < a->p[k+1]; q++) {
+    if (mark[a->i[q]]) continue;
+    head = 0;
+    xi[0] = a->i[q];
+    while (head >= 0) {
+      j = xi[head];
+      jnew = pinv[j];
+      if (!mark[j]) {
+	mark[j] = 1;
+	pstack[head] = (jnew < 0)? 0 : l->p[jnew]+1;
+      }
+      done = 1;
+      p2 = (jnew < 0)? 0 : l->p[jnew+1];
+      for (p = pstack[head]; p < p2; p++) {
+	i = l->i[p];
+	if (mark[i]) continue;
+	pstack[head] = p;
+	xi[++head] = i;
+	done = 0;
+	break;
+      }
+      if (done) {
+	head--;
+	xi[--top] = j;
+      }
+    }
+  }
+  for (p = top; p < n; p++) mark[xi[p]] = 0;
+
+  return top;
+}
+
+static void GrowSparseMatrix(SP_MATRIX *a, int m) {
+  if (a->nnz + m <= a->nmax) return;
+  a->nmax = 2*a->nmax + m;
+  a->i = (int *) realloc(a->i, sizeof(int)*a->nmax);
+  a->x = (double *) realloc(a->x, sizeof(double)*a->nmax);
+}
+
+/*
+** left looking LU factorization, P A Q = L U, with threshold
+** partial pivoting. the columns are taken in the order q. the
+** diagonal is the pivot if it is within the factor sparse_pivot
+** of the largest candidate. the rows marked in skip are the
+** pivots only if no other row is left. L has a unit diagonal
+** stored first in each column, U has the diagonal stored last.
+*/
+static int SparseLU(SP_MATRIX *a, int *q, int *skip,
+		    SP_MATRIX *l, SP_MATRIX *u, int *pinv) {
+  int n, k, col, top, p, i, j, jnew, ipiv, ib, *xi, *mark;
+  double *x, amax, bmax, pivot, t;
+
+  n = a->n;
+  l->n = n;
+  l->nnz = 0;
+  l->nmax = 4*a->nnz + n;
+  l->p = (int *) malloc(sizeof(int)*(n+1));
+  l->i = (int *) malloc(sizeof(int)*l->nmax);
+  l->x = (double *) malloc(sizeof(double)*l->nmax);
+  u->n = n;
+  u->nnz = 0;
+  u->nmax = 4*a->nnz + n;
+  u->p = (int *) malloc(sizeof(int)*(n+1));
+  u->i = (int *) malloc(sizeof(int)*u->nmax);
+  u->x = (double *) malloc(sizeof(double)*u->nmax);
+  xi = (int *) malloc(sizeof(int)*2*n);
+  mark = (int *) malloc(sizeof(int)*n);
+  x = (double *) malloc(sizeof(double)*n);
+  for (i = 0; i < n; i++) {
+    pinv[i] = -1;
+    mark[i] = 0;
+    x[i] = 0.0;
+  }
+
+  for (k = 0; k < n; k++) {
+    l->p[k] = l->nnz;
+    u->p[k] = u->nnz;
+    GrowSparseMatrix(l, n-k);
+    GrowSparseMatrix(u, k+1);
+    col = q[k];
+    top = SparseReach(l, a, col, xi, mark, pinv);
+    for (p = a->p[col]; p < a->p[col+1]; p++) {
+      x[a->i[p]] = a->x[p];
+    }
+    for (p = top; p < n; p++) {
+      j = xi[p];
+      jnew = pinv[j];
+      if (jnew < 0) continue;
+      t = x[j];
+      if (t == 0) continue;
+      for (i = l->p[jnew]+1; i < l->p[jnew+1]; i++) {
+	x[l->i[i]] -= l->x[i]*t;
+      }
+    }
+
+    ipiv = -1;
+    ib = -1;
+    amax = 0.0;
+    bmax = 0.0;
+    for (p = top; p < n; p++) {
+      i = xi[p];
+      if (pinv[i] < 0) {
+	t = fabs(x[i]);
+	if (skip[i]) {
+	  if (t > bmax) {
+	    bmax = t;
+	    ib = i;
+	  }
+	} else if (t > amax) {
+	  amax = t;
+	  ipiv = i;
+	}
+      } else if (x[i]) {
+	u->i[u->nnz] = pinv[i];
+	u->x[u->nnz] = x[i];
+	u->nnz++;
+      }
+    }
+    if (ipiv < 0) {
+      ipiv = ib;
+      amax = bmax;
+    }
+    if (ipiv < 0) break;
+    if (pinv[col] < 0 && fabs(x[col]) >= sparse_pivot*amax) ipiv = col;
+    pivot = x[ipiv];
+    u->i[u->nnz] = k;
+    u->x[u->nnz] = pivot;
+    u->nnz++;
+    pinv[ipiv] = k;
+    l->i[l->nnz] = ipiv;
+    l->x[l->nnz] = 1.0;
+    l->nnz++;
+    for (p = top; p < n; p++) {
+      i = xi[p];
+      if (pinv[i] < 0 && x[i]) {
+	l->i[l->nnz] = i;
+	l->x[l->nnz] = x[i]/pivot;
+	l->nnz++;
+      }
+      x[i] = 0.0;
+    }
+  }
+
+  free(xi);
+  free(mark);
+  free(x);
+  if (k < n) return -1;
+
+  l->p[n] = l->nnz;
+  u->p[n] = u->nnz;
+  for (p = 0; p < l->nnz; p++) {
+    l->i[p] = pinv[l->i[p]];
+  }
+
+  return 0;
+}
+
+/* solve A x = b with the factors of SparseLU, b is overwritten */
+static void SparseLUSolve(SP_MATRIX *l, SP_MATRIX *u, int *pinv, int *q,
+			  double *b, double *w) {
+  int n, i, j, p;
+
+  n = l->n;
+  for (i = 0; i < n; i++) w[pinv[i]] = b[i];
+  for (j = 0; j < n; j++) {
+    for (p = l->p[j]+1; p < l->p[j+1]; p++) {
+      w[l->i[p]] -= l->x[p]*w[j];
+    }
+  }
+  for (j = n-1; j >= 0; j--) {
+    w[j] /= u->x[u->p[j+1]-1];
+    for (p = u->p[j]; p < u->p[j+1]-1; p++) {
+      w[u->i[p]] -= u->x[p]*w[j];
+    }
+  }
+  for (i = 0; i < n; i++) b[q[i]] = w[i];
+}
+
+/*
+** with sparse_solver > 1, the reduced equations are also solved with
+** DGESV on a dense copy, and the largest relative difference of the
+** populations is reported. this is only meant to check the sparse LU
+** on small models.
+*/
+static void CheckSparseSolve(SP_MATRIX *a, double *rhs, double *b) {
+  double *d, *y, dmax, t;
+  int *ipiv;
+  int m, i, j, p, info, imax;
+
+  m = a->n;
+  if (m == 0) return;
+  d = (double *) malloc(sizeof(double)*m*m);
+  y = (double *) malloc(sizeof(double)*m);
+  ipiv = (int *) malloc(sizeof(int)*m);
+  for (i = 0; i < m*m; i++) d[i] = 0.0;
+  for (j = 0; j < m; j++) {
+    for (p = a->p[j]; p < a->p[j+1]; p++) {
+      d[j*m + a->i[p]] = a->x[p];
+    }
+    y[j] = rhs[j];
+  }
+  DGESV(m, 1, d, m, ipiv, y, m, &info);
+  if (info != 0) {
+    printf("CheckSparseSolve: DGESV failed: %d\n", info);
+  } else {
+    dmax = 0.0;
+    imax = 0;
+    for (i = 0; i < m; i++) {
+      t = fabs(b[i] - y[i]);
+      if (y[i]) t /= fabs(y[i]);
+      if (t > dmax) {
+	dmax = t;
+	imax = i;
+      }
+    }
+    printf("CheckSparseSolve: %d blocks, max rel. diff. %10.3E at %d\n",
+	   m, dmax, imax);
+  }
+  free(d);
+  free(y);
+  free(ipiv);
+}
+
+/*
+** the sparse counterpart of the DGESV solution in BlockPopulation.
+** blocks with a zero diagonal are removed, with x[i] set to 2E50.
+** the populations of the others are returned in b. the balance
+** equations are taken first, then the normalization equations.
+*/
+static int SparseBlockSolve(int n, double *x, double *b) {
+  SP_MATRIX a, l, u;
+  int i, j, k, m, p, *map, *q, *skip, *pinv;
+  double *w, *rhs;
+
+  rhs = NULL;
+  map = (int *) malloc(sizeof(int)*n);
+  m = 0;
+  for (i = 0; i < n; i++) {
+    map[i] = -1;
+    for (p = smatrix.p[i]; p < smatrix.p[i+1]; p++) {
+      if (smatrix.i[p] == i) {
+	if (smatrix.x[p]) map[i] = m++;
+	break;
+      }
+    }
+    if (map[i] < 0) x[i] = 2E50;
+  }
+
+  a.n = m;
+  a.nnz = 0;
+  a.nmax = smatrix.nnz;
+  a.p = (int *) malloc(sizeof(int)*(m+1));
+  a.i = (int *) malloc(sizeof(int)*(a.nmax+1));
+  a.x = (double *) malloc(sizeof(double)*(a.nmax+1));
+  q = (int *) malloc(sizeof(int)*m);
+  skip = (int *) malloc(sizeof(int)*m);
+  pinv = (int *) malloc(sizeof(int)*m);
+  w = (double *) malloc(sizeof(double)*m);
+  k = 0;
+  for (i = 0; i < n; i++) {
+    if (map[i] < 0) continue;
+    a.p[map[i]] = a.nnz;
+    for (p = smatrix.p[i]; p < smatrix.p[i+1]; p++) {
+      j = map[smatrix.i[p]];
+      if (j < 0) continue;
+      a.i[a.nnz] = j;
+      a.x[a.nnz] = smatrix.x[p];
+      a.nnz++;
+    }
+    b[map[i]] = x[i];
+    skip[map[i]] = (snorm[i] == i);
+    if (!skip[map[i]]) q[k++] = map[i];
+  }
+  a.p[m] = a.nnz;
+  for (i = 0; i < m; i++) {
+    if (skip[i]) q[k++] = i;
+  }
+
+  if (sparse_solver > 1) {
+    rhs = (double *) malloc(sizeof(double)*m);
+    memcpy(rhs, b, sizeof(double)*m);
+  }
+  i = SparseLU(&a, q, skip, &l, &u, pinv);
+  if (i == 0) {
+    SparseLUSolve(&l, &u, pinv, q, b, w);
+    if (sparse_solver > 1) CheckSparseSolve(&a, rhs, b);
+  }
+  if (sparse_solver > 1) free(rhs);
+
+  FreeSparseMatrix(&a);
+  FreeSparseMatrix(&l);
+  FreeSparseMatrix(&u);
+  free(map);
+  free(q);
+  free(skip);
+  free(pinv);
+  free(w);
+
+  return i;
+}
+
 int BlockPopulation(int miter) {
   LBLOCK *blk;
   ION *ion;
@@ -2852,85 +3366,98 @@ int BlockPopulation(int miter) {
   double ta, tb, td;
 
   n = blocks->dim;
-  a = bmatrix + n*n;
-  x = a;
-  a = a + n;
-  b = a + n*n;
-  ipiv = (int *) (b+n);
+  /* a and ipiv are only used by the dense solver */
+  a = NULL;
+  ipiv = NULL;
+  m = 0;
+  if (sparse_solver) {
+    x = svector;
+    b = x + n;
+  } else {
+    a = bmatrix + n*n;
+    x = a;
+    a = a + n;
+    b = a + n*n;
+    ipiv = (int *) (b+n);
+  }
 
   /*if (norm_mode == 0) miter = 1; use iteration to enforec normalization*/  
   miter = 1; /*disable iteration, use FixNorm to enforce normalization*/
   for (niter = 0; niter < miter; niter++) {
     FixNorm(niter);
-    ta = 0.0;
-    /*
-    for (i = 0; i < n; i++) {
-      ta += x[i];
-    }
-    for (i = 0; i < n; i++) {
-      if (x[i] > 0) {
-	for (j = 0; j < n; j++) {
-	  p = j*n + i;      
-	  if (bmatrix[p]) {
-	    bmatrix[p] *= ta/x[i];
+    if (sparse_solver) {
+      info = SparseBlockSolve(n, x, b);
+    } else {
+      ta = 0.0;
+      /*
+      for (i = 0; i < n; i++) {
+	ta += x[i];
+      }
+      for (i = 0; i < n; i++) {
+	if (x[i] > 0) {
+	  for (j = 0; j < n; j++) {
+	    p = j*n + i;      
+	    if (bmatrix[p]) {
+	      bmatrix[p] *= ta/x[i];
+	    }
 	  }
+	  x[i] = ta;
 	}
-	x[i] = ta;
       }
-    }
-    */
-    p = 0;
-    q = 0;
-    m = 0;
-    for (i = 0; i < n; i++) {
-      if (bmatrix[i+i*n] == 0) {
-	x[i] = 2E50;
-	p += n;
-	continue;
+      */
+      p = 0;
+      q = 0;
+      m = 0;
+      for (i = 0; i < n; i++) {
+	if (bmatrix[i+i*n] == 0) {
+	  x[i] = 2E50;
+	  p += n;
+	  continue;
+	}
+	for (j = 0; j < n; j++) {
+	  a[q] = bmatrix[p];
+	  p++;
+	  q++;
+	}
+	b[i] = x[i];
+	m++;
       }
-      for (j = 0; j < n; j++) {
-	a[q] = bmatrix[p];
-	p++;
-	q++;
+    
+      p = 0;
+      for (i = 0; i < m; i++) {
+	q = p;
+	for (j = 0; j < n; j++) {
+	  if (x[j] > 1E50) {
+	    continue;
+	  }
+	  a[q] = a[p+j];
+	  q++;
+	}
+	p += n;
       }
-      b[i] = x[i];
-      m++;
-    }
     
-    p = 0;
-    for (i = 0; i < m; i++) {
-      q = p;
+      q = 0;
       for (j = 0; j < n; j++) {
 	if (x[j] > 1E50) {
 	  continue;
 	}
-	a[q] = a[p+j];
+	b[q] = b[j];
 	q++;
-      }
-      p += n;
-    }
-    
-    q = 0;
-    for (j = 0; j < n; j++) {
-      if (x[j] > 1E50) {
-	continue;
-      }
-      b[q] = b[j];
-      q++;
-    }  
+      }  
     
-    nrhs = 1;
-    lda = n;
-    ldb = n;
+      nrhs = 1;
+      lda = n;
+      ldb = n;
     
-    /*
-      for (i = 0; i < m; i++) {
-      for (j = 0; j < m; j++) {
-      printf("%3d %3d %12.5E %12.5E\n", i, j, a[j*n+i], b[j]);
-      }
-      }
-    */
-    DGESV(m, nrhs, a, lda, ipiv, b, ldb, &info);
+      /*
+	for (i = 0; i < m; i++) {
+	for (j = 0; j < m; j++) {
+	printf("%3d %3d %12.5E %12.5E\n", i, j, a[j*n+i], b[j]);
+	}
+	}
+      */
+      DGESV(m, nrhs, a, lda, ipiv, b, ldb, &info);
+    }
 
     /*
     ta = 0.0;
@@ -3948,36 +4475,157 @@ int PlotSpec(char *ifn, char *ofn, int nele, int type,
   return 0;
 }
 
+static unsigned int PairHash(int i, int j) {
+  unsigned int h;
+
+  h = ((unsigned int) i)*0x9E3779B1U ^ ((unsigned int) j)*0x85EBCA6BU;
+  return h ^ (h >> 15);
+}
+
+/* the slot of the block pair, empty if it is not in rts yet */
+static int BlkPairSlot(RATE_INDEX *x, LBLOCK *ib, LBLOCK *fb) {
+  BLK_RATE *brt;
+  int h, mask;
+
+  mask = x->nbslots - 1;
+  h = PairHash(ib->ib, fb->ib) & mask;
+  while (x->bslot[h]) {
+    brt = (BLK_RATE *) ArrayGet(x->rts, x->bslot[h]-1);
+    if (brt->iblock == ib && brt->fblock == fb) break;
+    h = (h+1) & mask;
+  }
+  return h;
+}
+
+/* the slot of the transition i->f, empty if it is not in rts yet */
+static int RatePairSlot(RATE_INDEX *x, int i, int f) {
+  BLK_RATE *brt;
+  RATE *r0;
+  int h, mask;
+
+  mask = x->nrslots - 1;
+  h = PairHash(i, f) & mask;
+  while (x->rslot[2*h]) {
+    brt = (BLK_RATE *) ArrayGet(x->rts, x->rslot[2*h]-1);
+    r0 = (RATE *) ArrayGet(brt->rates, x->rslot[2*h+1]);
+    if (r0->i == i && r0->f == f) break;
+    h = (h+1) & mask;
+  }
+  return h;
+}
+
+static void BuildBlkPairIndex(RATE_INDEX *x) {
+  BLK_RATE *brt;
+  int k, h;
+
+  if (x->bslot) free(x->bslot);
+  x->nbslots = 64;
+  while (x->nbslots < 2*(x->nb+1)) x->nbslots *= 2;
+  x->bslot = (int *) malloc(sizeof(int)*x->nbslots);
+  for (h = 0; h < x->nbslots; h++) x->bslot[h] = 0;
+  for (k = 0; k < x->nb; k++) {
+    brt = (BLK_RATE *) ArrayGet(x->rts, k);
+    h = BlkPairSlot(x, brt->iblock, brt->fblock);
+    x->bslot[h] = k+1;
+  }
+}
+
+/* 
+** the rates of a transition repeated with m = 0 are all kept,
+** the index points to the first one, as the linear search did.
+*/
+static void BuildRatePairIndex(RATE_INDEX *x) {
+  BLK_RATE *brt;
+  RATE *r0;
+  int k, j, h;
+
+  x->nr = 0;
+  for (k = 0; k < x->nb; k++) {
+    brt = (BLK_RATE *) ArrayGet(x->rts, k);
+    x->nr += brt->rates->dim;
+  }
+  if (x->rslot) free(x->rslot);
+  x->nrslots = 64;
+  while (x->nrslots < 2*(x->nr+1)) x->nrslots *= 2;
+  x->rslot = (int *) malloc(sizeof(int)*2*x->nrslots);
+  for (h = 0; h < 2*x->nrslots; h++) x->rslot[h] = 0;
+  for (k = 0; k < x->nb; k++) {
+    brt = (BLK_RATE *) ArrayGet(x->rts, k);
+    for (j = 0; j < brt->rates->dim; j++) {
+      r0 = (RATE *) ArrayGet(brt->rates, j);
+      h = RatePairSlot(x, r0->i, r0->f);
+      if (x->rslot[2*h] == 0) {
+	x->rslot[2*h] = k+1;
+	x->rslot[2*h+1] = j;
+      }
+    }
+  }
+}
+
+/*
+** the index of rts. the rate arrays are only extended through
+** AddRate, so an index whose count differs from rts->dim belongs
+** to an array that has been freed since, and is rebuilt.
+*/
+static RATE_INDEX *GetRateIndex(ARRAY *rts) {
+  static int last = 0;
+  RATE_INDEX *x, x0;
+  int k;
+
+  x = (RATE_INDEX *) ArrayGet(rate_index, last);
+  if (x == NULL || x->rts != rts) {
+    for (k = 0; k < rate_index->dim; k++) {
+      x = (RATE_INDEX *) ArrayGet(rate_index, k);
+      if (x->rts == rts) break;
+    }
+    if (k == rate_index->dim) {
+      x0.rts = rts;
+      x0.nb = -1;
+      x0.bslot = NULL;
+      x0.nr = 0;
+      x0.rslot = NULL;
+      x = (RATE_INDEX *) ArrayAppend(rate_index, &x0, InitRateIndexData);
+    }
+    last = k;
+  }
+  if (x->nb != rts->dim) {
+    x->nb = rts->dim;
+    BuildBlkPairIndex(x);
+    if (x->rslot) BuildRatePairIndex(x);
+  }
+  return x;
+}
+
 int AddRate(ION *ion, ARRAY *rts, RATE *r, int m) {
   LBLOCK *ib, *fb;
   BLK_RATE *brt, brt0;
+  RATE_INDEX *x;
   RATE *r0;
-  int i;
+  int h, k, b;
   
   ib = ion->iblock[r->i];
   fb = ion->iblock[r->f];
-  for (i = 0; i < rts->dim; i++) {
-    brt = (BLK_RATE *) ArrayGet(rts, i);
-    if (brt->iblock == ib && brt->fblock == fb) {
-      break;
-    }
-  }
-  if (i == rts->dim) {
+  x = GetRateIndex(rts);
+  if (m && x->rslot == NULL) BuildRatePairIndex(x);
+  h = BlkPairSlot(x, ib, fb);
+  if (x->bslot[h] == 0) {
     brt0.iblock = ib;
     brt0.fblock = fb;
     brt0.rates = (ARRAY *) malloc(sizeof(ARRAY));
     ArrayInit(brt0.rates, sizeof(RATE), RATES_BLOCK);
     ArrayAppend(brt0.rates, r, NULL);
-    ArrayAppend(rts, &brt0, InitBlkRateData);
+    brt = (BLK_RATE *) ArrayAppend(rts, &brt0, InitBlkRateData);
+    x->nb = rts->dim;
+    x->bslot[h] = x->nb;
+    b = x->nb;
+    if (2*x->nb >= x->nbslots) BuildBlkPairIndex(x);
   } else {
+    b = x->bslot[h];
+    brt = (BLK_RATE *) ArrayGet(rts, b-1);
     if (m) {
-      for (i = 0; i < brt->rates->dim; i++) {
-	r0 = (RATE *) ArrayGet(brt->rates, i);
-	if (r0->i == r->i && r0->f == r->f) break;
-      }
-      if (i == brt->rates->dim) {
-	ArrayAppend(brt->rates, r, NULL);
-      } else {
+      k = RatePairSlot(x, r->i, r->f);
+      if (x->rslot[2*k]) {
+	r0 = (RATE *) ArrayGet(brt->rates, x->rslot[2*k+1]);
 	if (m == 1) {
 	  r0->dir += r->dir;
 	  r0->inv += r->inv;
@@ -3987,28 +4635,54 @@ int AddRate(ION *ion, ARRAY *rts, RATE *r, int m) {
 	}
 	return 1;
       }
+    }
+    ArrayAppend(brt->rates, r, NULL);
+  }
+  if (x->rslot) {
+    x->nr++;
+    if (2*x->nr >= x->nrslots) {
+      BuildRatePairIndex(x);
     } else {
-      ArrayAppend(brt->rates, r, NULL);
+      k = RatePairSlot(x, r->i, r->f);
+      if (x->rslot[2*k] == 0) {
+	x->rslot[2*k] = b;
+	x->rslot[2*k+1] = brt->rates->dim-1;
+      }
     }
   }
   return 0;
 }
   
+/* add the rates of the nt transitions computed in a batch */
+static void AddRates(ION *ion, ARRAY *rts, int nt, int *ri, int *rf,
+		     double *dir, double *inv) {
+  RATE rt;
+  int t;
+
+  for (t = 0; t < nt; t++) {
+    rt.i = ri[t];
+    rt.f = rf[t];
+    rt.dir = dir[t];
+    rt.inv = inv[t];
+    AddRate(ion, rts, &rt, 0);
+  }
+}
+
 int SetCERates(int inv) {
-  int nb, i, j;
-  int n, m, m1, k;
-  int j1, j2;
+  int nb, i, j, t, nt;
+  int n, m, m1, k, nd;
+  int *j1, *j2, *ri, *rf;
   int p, q;
   ION *ion;
-  RATE rt;
   F_HEADER fh;
   CE_HEADER h;
-  CE_RECORD r;
+  CE_RECORD *r;
+  DB_BLOCK blk;
   FILE *f;
-  double e, bte, bms;
+  double *e, bte, bms;
   float *cs;
   double data[2+(1+MAXNUSR)*2];
-  double *y, *x;
+  double *y, *x, *dp, *buf, *dir, *rinv;
   double *eusr;
   int swp;
   
@@ -4018,7 +4692,17 @@ int SetCERates(int inv) {
     printf("ERROR: Blocks not set, exitting\n");
     exit(1);
   }
+  /* the rates are computed in batches of RATES_BLOCK transitions */
+  buf = (double *) malloc(sizeof(double)*RATES_BLOCK*(5+(1+MAXNUSR)*2));
+  e = buf + RATES_BLOCK*(2+(1+MAXNUSR)*2);
+  dir = e + RATES_BLOCK;
+  rinv = dir + RATES_BLOCK;
+  j1 = (int *) malloc(sizeof(int)*RATES_BLOCK*4);
+  j2 = j1 + RATES_BLOCK;
+  ri = j2 + RATES_BLOCK;
+  rf = ri + RATES_BLOCK;
   y = data + 2;
+  InitDBBlock(&blk);
   for (k = 0; k < ions->dim; k++) {
     ion = (ION *) ArrayGet(ions, k);
     ArrayFree(ion->ce_rates, FreeBlkRateData);
@@ -4039,30 +4723,34 @@ int SetCERates(int inv) {
       }
       m = h.n_usr;
       m1 = m + 1;
+      nd = 2 + 2*m1;
       x = y + m1;
       data[0] = (h.te0*HARTREE_EV + bte)/bms;
       for (j = 0; j < m; j++) {
 	x[j] = log((data[0] + eusr[j]*HARTREE_EV)/data[0]);
       }
       x[m] = eusr[m-1]/(data[0]/HARTREE_EV+eusr[m-1]);
-      for (i = 0; i < h.ntransitions; i++) {
-	n = ReadCERecord(f, &r, swp, &h);
-	rt.i = r.lower;
-	rt.f = r.upper;
-	j1 = ion->j[r.lower];
-	j2 = ion->j[r.upper];
-	e = ion->energy[r.upper] - ion->energy[r.lower];
-	data[1] = r.bethe;
-	cs = r.strength;
-	y[m] = r.born[0];
-	for (j = 0; j < m; j++) {
-	  y[j] = cs[j];
+      n = ReadCEBlock(f, &h, swp, &blk);
+      r = (CE_RECORD *) blk.r;
+      for (i = 0; i < n; i += nt) {
+	nt = Min(n - i, RATES_BLOCK);
+	for (t = 0; t < nt; t++, r++) {
+	  ri[t] = r->lower;
+	  rf[t] = r->upper;
+	  j1[t] = ion->j[r->lower];
+	  j2[t] = ion->j[r->upper];
+	  e[t] = ion->energy[r->upper] - ion->energy[r->lower];
+	  data[1] = r->bethe;
+	  cs = r->strength;
+	  y[m] = r->born[0];
+	  for (j = 0; j < m; j++) {
+	    y[j] = cs[j];
+	  }
+	  dp = buf + t*nd;
+	  memcpy(dp, data, sizeof(double)*nd);
 	}
-	CERate(&(rt.dir), &(rt.inv), inv, j1, j2, e, m,
-	       data, rt.i, rt.f);
-	AddRate(ion, ion->ce_rates, &rt, 0);
-	if (h.qk_mode == QK_FIT) free(r.params);
-	free(r.strength);
+	CERates(nt, dir, rinv, inv, j1, j2, e, m, buf, nd, ri, rf);
+	AddRates(ion, ion->ce_rates, nt, ri, rf, dir, rinv);
       }
       free(h.tegrid);
       free(h.egrid);
@@ -4086,43 +4774,43 @@ int SetCERates(int inv) {
 	}
 	m = h.n_usr;
 	m1 = m + 1;
+	nd = 2 + 2*m1;
 	x = y + m1;
 	data[0] = (h.te0*HARTREE_EV + bte)/bms;
         for (j = 0; j < m; j++) {
 	  x[j] = log((data[0] + eusr[j]*HARTREE_EV)/data[0]);
         }
 	x[m] = eusr[m-1]/(data[0]/HARTREE_EV+eusr[m-1]);
-	for (i = 0; i < h.ntransitions; i++) {
-	  n = ReadCERecord(f, &r, swp, &h);
-	  p = IonizedIndex(r.lower, 0);
-	  if (p < 0) {
-	    if (h.qk_mode == QK_FIT) free(r.params);
-	    free(r.strength);
-	    continue;
-	  }
-	  q = IonizedIndex(r.upper, 0);
-	  if (q < 0) {
-	    if (h.qk_mode == QK_FIT) free(r.params);
-	    free(r.strength);
-	    continue;
-	  }
-	  rt.i = ion0.ionized_map[1][p];
-	  rt.f = ion0.ionized_map[1][q];
-	  j1 = ion->j[rt.i];
-	  j2 = ion->j[rt.f];
-	  e = ion0.energy[q] - ion0.energy[p];
-	  data[1] = r.bethe;	
-	  cs = r.strength;
-	  y[m] = r.born[0];
+	nt = 0;
+	n = ReadCEBlock(f, &h, swp, &blk);
+	r = (CE_RECORD *) blk.r;
+	for (i = 0; i < n; i++, r++) {
+	  p = IonizedIndex(r->lower, 0);
+	  if (p < 0) continue;
+	  q = IonizedIndex(r->upper, 0);
+	  if (q < 0) continue;
+	  ri[nt] = ion0.ionized_map[1][p];
+	  rf[nt] = ion0.ionized_map[1][q];
+	  j1[nt] = ion->j[ri[nt]];
+	  j2[nt] = ion->j[rf[nt]];
+	  e[nt] = ion0.energy[q] - ion0.energy[p];
+	  data[1] = r->bethe;	
+	  cs = r->strength;
+	  y[m] = r->born[0];
 	  for (j = 0; j < m; j++) {
 	    y[j] = cs[j];
 	  }
-	  CERate(&(rt.dir), &(rt.inv), inv, j1, j2, e, m,
-		 data, rt.i, rt.f);
-	  AddRate(ion, ion->ce_rates, &rt, 0);
-	  if (h.qk_mode == QK_FIT) free(r.params);
-	  free(r.strength);
+	  dp = buf + nt*nd;
+	  memcpy(dp, data, sizeof(double)*nd);
+	  nt++;
+	  if (nt == RATES_BLOCK) {
+	    CERates(nt, dir, rinv, inv, j1, j2, e, m, buf, nd, ri, rf);
+	    AddRates(ion, ion->ce_rates, nt, ri, rf, dir, rinv);
+	    nt = 0;
+	  }
 	}
+	CERates(nt, dir, rinv, inv, j1, j2, e, m, buf, nd, ri, rf);
+	AddRates(ion, ion->ce_rates, nt, ri, rf, dir, rinv);
 	free(h.tegrid);
 	free(h.egrid);
 	free(h.usr_egrid);
@@ -4130,6 +4818,9 @@ int SetCERates(int inv) {
       fclose(f);
     }
   }
+  FreeDBBlock(&blk);
+  free(buf);
+  free(j1);
 
   return 0;
 }
@@ -4141,68 +4832,66 @@ int SetTRRates(int inv) {
   int p, q, m;
   ION *ion;
   RATE rt;
-  F_HEADER fh;
-  TR_HEADER h;
-  TR_RECORD r;
-  TR_EXTRA rx;
+  DB_VIEW *v;
+  TR_HEADER *h;
+  TR_RECORD *r;
+  TR_EXTRA *rx;
+  DB_BLOCK blk;
   LBLOCK *ib;
   double e, gf;
-  FILE *f;  
-  int swp, iuta, im;
+  int iuta, im;
 
   if (ion0.atom <= 0) {
     printf("ERROR: Blocks not set, exitting\n");
     exit(1);
   }
+  InitDBBlock(&blk);
   for (k = 0; k < ions->dim; k++) {
     ion = (ION *) ArrayGet(ions, k);
     ArrayFree(ion->tr_rates, FreeBlkRateData);
-    f = fopen(ion->dbfiles[DB_TR-1], "r");
-    if (f == NULL) {
+    v = OpenDBView(ion->dbfiles[DB_TR-1]);
+    if (v == NULL) {
       printf("File %s does not exist, skipping.\n", ion->dbfiles[DB_TR-1]);
       continue;
     }
-    n = ReadFHeader(f, &fh, &swp);
-    for (nb = 0; nb < fh.nblocks; nb++) {
-      n = ReadTRHeader(f, &h, swp);
-      iuta = IsUTA();
-      if (h.nele == ion->nele-1) {
-	if (k > 0 || ion0.nionized > 0) {
-	  fseek(f, h.length, SEEK_CUR);
-	  continue;
-	}
+    for (nb = 0; nb < v->nblocks; nb++) {
+      h = &(v->h[nb].tr);
+      if (h->nele == ion->nele-1) {
+	if (k > 0 || ion0.nionized > 0) continue;
       }
-      if (abs(h.multipole) <= 1) m = 0;
+      if (abs(h->multipole) <= 1) m = 0;
       else m = 1;
-      for (i = 0; i < h.ntransitions; i++) {
-	n = ReadTRRecord(f, &r, &rx, swp);
-	rt.i = r.upper;
+      n = DBViewBlock(v, nb, &blk);
+      iuta = IsUTA();
+      for (i = 0; i < n; i++) {
+	r = (TR_RECORD *) blk.r + i;
+	rx = (TR_EXTRA *) blk.rx + i;
+	rt.i = r->upper;
 	if (ion0.n < 0) {
-	  ib = ion->iblock[r.upper];
+	  ib = ion->iblock[r->upper];
 	  if (ib->rec &&
 	      ib->rec->nrec[ib->irec] > 10) {
 	    continue;
 	  }
 	}
-	rt.f = r.lower;
-	j1 = ion->j[r.upper];
-	j2 = ion->j[r.lower];
-	e = ion->energy[r.upper] - ion->energy[r.lower];
-	if (iuta) e = rx.energy;
+	rt.f = r->lower;
+	j1 = ion->j[r->upper];
+	j2 = ion->j[r->lower];
+	e = ion->energy[r->upper] - ion->energy[r->lower];
+	if (iuta) e = rx->energy;
 	if (e > 0) {
-	  gf = OscillatorStrength(h.multipole, e, (double)(r.strength), NULL);
-	  if (iuta) gf *= rx.sci;
+	  gf = OscillatorStrength(h->multipole, e, (double)(r->strength), NULL);
+	  if (iuta) gf *= rx->sci;
 	  TRRate(&(rt.dir), &(rt.inv), inv, j1, j2, e, (float)gf);
 	  im = AddRate(ion, ion->tr_rates, &rt, m);
 	  if (iuta && im == 0) {
-	    rt.dir = rx.energy;
-	    rt.inv = rx.sdev;
+	    rt.dir = rx->energy;
+	    rt.inv = rx->sdev;
 	    AddRate(ion, ion->tr_sdev, &rt, 0);
 	  }
 	}
       }
     }
-    fclose(f);
     if (ion->nele == 1) {
       ArrayFree(ion->tr2_rates, FreeBlkRateData);
       rt.f = FindLevelByName(ion->dbfiles[DB_EN-1], 1, 
@@ -4240,28 +4929,26 @@ int SetTRRates(int inv) {
     if (ion0.n < 0) continue;
     ExtrapolateTR(ion, inv);
     if (k == 0 && ion0.nionized > 0) {
-      f = fopen(ion0.dbfiles[DB_TR-1], "r");
-      if (f == NULL) {
+      v = OpenDBView(ion0.dbfiles[DB_TR-1]);
+      if (v == NULL) {
 	printf("File %s does not exist, skipping.\n", ion0.dbfiles[DB_TR-1]);
 	continue;
       }
-      n = ReadFHeader(f, &fh, &swp);
-      for (nb = 0; nb < fh.nblocks; nb++) {
-	n = ReadTRHeader(f, &h, swp);
-	iuta = IsUTA();
-	if (h.nele != ion0.nele) {
-	  fseek(f, h.length, SEEK_CUR);
-	  continue;
-	}  
-	if (abs(h.multipole) == 1) m = 0;
+      for (nb = 0; nb < v->nblocks; nb++) {
+	h = &(v->h[nb].tr);
+	if (h->nele != ion0.nele) continue;
+	if (abs(h->multipole) == 1) m = 0;
 	else m = 1;
-	for (i = 0; i < h.ntransitions; i++) {
-	  n = ReadTRRecord(f, &r, &rx, swp);
-	  p = IonizedIndex(r.lower, 0);
+	n = DBViewBlock(v, nb, &blk);
+	iuta = IsUTA();
+	for (i = 0; i < n; i++) {
+	  r = (TR_RECORD *) blk.r + i;
+	  rx = (TR_EXTRA *) blk.rx + i;
+	  p = IonizedIndex(r->lower, 0);
 	  if (p < 0) {
 	    continue;
 	  }
-	  q = IonizedIndex(r.upper, 0);
+	  q = IonizedIndex(r->upper, 0);
 	  if (q < 0) {
 	    continue;
 	  }
@@ -4270,36 +4957,37 @@ int SetTRRates(int inv) {
 	  j1 = ion->j[rt.i];
 	  j2 = ion->j[rt.f];
 	  e = ion0.energy[q] - ion0.energy[p];
-	  if (iuta) e = rx.energy;	    
+	  if (iuta) e = rx->energy;	    
 	  if (e > 0) {
-	    gf = OscillatorStrength(h.multipole, e, (double)(r.strength), NULL);
-	    if (iuta) gf *= rx.sci;
+	    gf = OscillatorStrength(h->multipole, e, (double)(r->strength), NULL);
+	    if (iuta) gf *= rx->sci;
 	    TRRate(&(rt.dir), &(rt.inv), inv, j1, j2, e, (float)gf);
 	    im = AddRate(ion, ion->tr_rates, &rt, m);
 	    if (iuta && im == 0) {
-	      rt.dir = rx.energy;
-	      rt.inv = rx.sdev;
+	      rt.dir = rx->energy;
+	      rt.inv = rx->sdev;
 	      AddRate(ion, ion->tr_sdev, &rt, 0);
 	    }
 	  }
 	}
       }
-      fclose(f);
     }
   }
+  FreeDBBlock(&blk);
   return 0;
 }
 
 int SetCIRates(int inv) { 
-  int nb, i, t;
-  int n, m, k;
-  int j1, j2;
+  int nb, i, t, nt;
+  int n, m, k, j;
+  int *j1, *j2, *ri, *rf;
   ION *ion;
-  RATE rt;
   F_HEADER fh;
   CI_HEADER h;
-  CI_RECORD r;
-  double e;
+  CI_RECORD *r;
+  DB_BLOCK blk;
+  double *e, *dir, *rinv;
+  float *buf;
   FILE *f;  
   int swp;
 
@@ -4309,6 +4997,15 @@ int SetCIRates(int inv) {
     printf("ERROR: Blocks not set, exitting\n");
     exit(1);
   }
+  buf = NULL;
+  e = (double *) malloc(sizeof(double)*RATES_BLOCK*3);
+  dir = e + RATES_BLOCK;
+  rinv = dir + RATES_BLOCK;
+  j1 = (int *) malloc(sizeof(int)*RATES_BLOCK*4);
+  j2 = j1 + RATES_BLOCK;
+  ri = j2 + RATES_BLOCK;
+  rf = ri + RATES_BLOCK;
+  InitDBBlock(&blk);
   for (k = 0; k < ions->dim; k++) {
     ion = (ION *) ArrayGet(ions, k);
     ArrayFree(ion->ci_rates, FreeBlkRateData);
@@ -4328,18 +5025,23 @@ int SetCIRates(int inv) {
 	free(h.usr_egrid);
 	continue;
       }
-      for (i = 0; i < h.ntransitions; i++) {
-	n = ReadCIRecord(f, &r, swp, &h);
-	rt.i = r.b;
-	rt.f = r.f;
-	j1 = ion->j[r.b];
-	j2 = ion->j[r.f];
-	e = ion->energy[r.f] - ion->energy[r.b];
-	CIRate(&(rt.dir), &(rt.inv), inv, j1, j2, e, m, r.params,
-	       rt.i, rt.f);
-	AddRate(ion, ion->ci_rates, &rt, 0);
-	free(r.params);
-	free(r.strength);
+      buf = (float *) realloc(buf, sizeof(float)*RATES_BLOCK*m);
+      n = ReadCIBlock(f, &h, swp, &blk);
+      r = (CI_RECORD *) blk.r;
+      for (i = 0; i < n; i += nt) {
+	nt = Min(n - i, RATES_BLOCK);
+	for (t = 0; t < nt; t++, r++) {
+	  ri[t] = r->b;
+	  rf[t] = r->f;
+	  j1[t] = ion->j[r->b];
+	  j2[t] = ion->j[r->f];
+	  e[t] = ion->energy[r->f] - ion->energy[r->b];
+	  for (j = 0; j < m; j++) {
+	    buf[t*m+j] = r->params[j];
+	  }
+	}
+	CIRates(nt, dir, rinv, inv, j1, j2, e, m, buf, m, ri, rf);
+	AddRates(ion, ion->ci_rates, nt, ri, rf, dir, rinv);
       }
       free(h.tegrid);
       free(h.egrid);
@@ -4347,23 +5049,27 @@ int SetCIRates(int inv) {
     }
     fclose(f);
   }
+  FreeDBBlock(&blk);
+  if (buf) free(buf);
+  free(e);
+  free(j1);
   return 0;
 }
 
 int SetRRRates(int inv) { 
-  int nb, i, j;
-  int n, m, k;
-  int j1, j2;
+  int nb, i, j, t, nt;
+  int n, m, k, nd;
+  int *j1, *j2, *ri, *rf;
   ION *ion;
-  RATE rt;
   F_HEADER fh;
   RR_HEADER h;
-  RR_RECORD r;
-  double e;
+  RR_RECORD *r;
+  DB_BLOCK blk;
+  double *e, *dir, *rinv, *buf;
   FILE *f;  
   int swp;
   float *cs;
-  double data[1+MAXNUSR*4];
+  double *data;
   double *eusr;
   double *x, *logx, *y, *p;
 
@@ -4372,7 +5078,15 @@ int SetRRRates(int inv) {
     printf("ERROR: Blocks not set, exitting\n");
     exit(1);
   }
-  y = data + 1;
+  buf = (double *) malloc(sizeof(double)*RATES_BLOCK*(4+MAXNUSR*4));
+  e = buf + RATES_BLOCK*(1+MAXNUSR*4);
+  dir = e + RATES_BLOCK;
+  rinv = dir + RATES_BLOCK;
+  j1 = (int *) malloc(sizeof(int)*RATES_BLOCK*4);
+  j2 = j1 + RATES_BLOCK;
+  ri = j2 + RATES_BLOCK;
+  rf = ri + RATES_BLOCK;
+  InitDBBlock(&blk);
   for (k = 0; k < ions->dim; k++) {
     ion = (ION *) ArrayGet(ions, k);
     ArrayFree(ion->rr_rates, FreeBlkRateData);
@@ -4398,37 +5112,41 @@ int SetRRRates(int inv) {
       }
       eusr = h.usr_egrid;
       m = h.n_usr;
-      x = y + m;
-      logx = x + m;
-      p = logx + m;
-      for (i = 0; i < h.ntransitions; i++) {
-	n = ReadRRRecord(f, &r, swp, &h);
-	rt.i = r.f;
-	rt.f = r.b;
-	j1 = ion->j[r.f];
-	j2 = ion->j[r.b];
-	e = ion->energy[r.f] - ion->energy[r.b];
-	data[0] = 3.5 + r.kl;
-	if (e < 0.0) {
-	  printf("%d %d %10.3E %10.3E\n", 
-		 r.f, r.b, ion->energy[r.f],ion->energy[r.b]);
-	  exit(1);
-	}
-	cs = r.strength;
-	for (j = 0; j < m; j++) {
-	  x[j] = (e+eusr[j])/e;
-	  logx[j] = log(x[j]);
-	  y[j] = log(cs[j]);
-	}
-	for (j = 0; j < h.nparams; j++) {
-	  p[j] = r.params[j];
+      nd = 1 + 3*m + h.nparams;
+      n = ReadRRBlock(f, &h, swp, &blk);
+      r = (RR_RECORD *) blk.r;
+      for (i = 0; i < n; i += nt) {
+	nt = Min(n - i, RATES_BLOCK);
+	for (t = 0; t < nt; t++, r++) {
+	  ri[t] = r->f;
+	  rf[t] = r->b;
+	  j1[t] = ion->j[r->f];
+	  j2[t] = ion->j[r->b];
+	  e[t] = ion->energy[r->f] - ion->energy[r->b];
+	  data = buf + t*nd;
+	  y = data + 1;
+	  x = y + m;
+	  logx = x + m;
+	  p = logx + m;
+	  data[0] = 3.5 + r->kl;
+	  if (e[t] < 0.0) {
+	    printf("%d %d %10.3E %10.3E\n", 
+		   r->f, r->b, ion->energy[r->f],ion->energy[r->b]);
+	    exit(1);
+	  }
+	  cs = r->strength;
+	  for (j = 0; j < m; j++) {
+	    x[j] = (e[t]+eusr[j])/e[t];
+	    logx[j] = log(x[j]);
+	    y[j] = log(cs[j]);
+	  }
+	  for (j = 0; j < h.nparams; j++) {
+	    p[j] = r->params[j];
+	  }
+	  p[h.nparams-1] *= HARTREE_EV;
 	}
-	p[h.nparams-1] *= HARTREE_EV;
-	RRRate(&(rt.dir), &(rt.inv), inv, j1, j2, e, m, data,
-	       rt.i, rt.f);
-	AddRate(ion, ion->rr_rates, &rt, 0);
-	free(r.params);
-	free(r.strength);
+	RRRates(nt, dir, rinv, inv, j1, j2, e, m, buf, nd, ri, rf);
+	AddRates(ion, ion->rr_rates, nt, ri, rf, dir, rinv);
       }
       free(h.tegrid);
       free(h.egrid);
@@ -4437,6 +5155,9 @@ int SetRRRates(int inv) {
     fclose(f);
     ExtrapolateRR(ion, inv);
   }
+  FreeDBBlock(&blk);
+  free(buf);
+  free(j1);
   return 0;
 }
 
@@ -4445,7 +5166,8 @@ int SetAIRatesInner(char *fn) {
   ION *ion;
   F_HEADER fh;
   AI_HEADER h;
-  AI_RECORD r;
+  AI_RECORD *r;
+  DB_BLOCK blk;
   FILE *f;  
   int swp;
   int ibase;
@@ -4466,13 +5188,15 @@ int SetAIRatesInner(char *fn) {
     return 0;
   }
 
+  InitDBBlock(&blk);
   n = ReadFHeader(f, &fh, &swp);
   b0 = -1;
   for (nb = 0; nb < fh.nblocks; nb++) {
     n = ReadAIHeader(f, &h, swp);
-    for (i = 0; i < h.ntransitions; i++) {
-      n = ReadAIRecord(f, &r, swp);
-      if (b0 < 0 || r.b < b0) b0 = r.b;
+    n = ReadAIBlock(f, &h, swp, &blk);
+    r = (AI_RECORD *) blk.r;
+    for (i = 0; i < n; i++, r++) {
+      if (b0 < 0 || r->b < b0) b0 = r->b;
     }
     free(h.egrid);
   }
@@ -4487,12 +5211,13 @@ int SetAIRatesInner(char *fn) {
     }
     nm = ion->KLN_bmax - ion->KLN_bmin;    
     if (k < ions->dim) {
-      for (i = 0; i < h.ntransitions; i++) {
-	n = ReadAIRecord(f, &r, swp);
-	r.rate *= RATE_AU;
-	ibase = r.b - b0;
+      n = ReadAIBlock(f, &h, swp, &blk);
+      r = (AI_RECORD *) blk.r;
+      for (i = 0; i < n; i++, r++) {
+	r->rate *= RATE_AU;
+	ibase = r->b - b0;
 	if (ibase >= 0 && ibase <= nm) {
-	  ion->KLN_ai[ibase] += r.rate;
+	  ion->KLN_ai[ibase] += r->rate;
 	}
       }    
     } else {
@@ -4502,6 +5227,7 @@ int SetAIRatesInner(char *fn) {
   }
 
   fclose(f);
+  FreeDBBlock(&blk);
 
   return 0;
 }
@@ -4514,7 +5240,8 @@ int SetAIRates(int inv) {
   RATE rt;
   F_HEADER fh;
   AI_HEADER h;
-  AI_RECORD r;
+  AI_RECORD *r;
+  DB_BLOCK blk;
   double e;
   FILE *f;  
   int swp;
@@ -4526,6 +5253,7 @@ int SetAIRates(int inv) {
     printf("ERROR: Blocks not set, exitting\n");
     exit(1);
   }
+  InitDBBlock(&blk);
   for (k = 0; k < ions->dim; k++) {
     if (k == 0) ion = (ION *) ArrayGet(ions, k);
     else ion = ion1;
@@ -4545,43 +5273,44 @@ int SetAIRates(int inv) {
 	free(h.egrid);
 	continue;
       }
-      for (i = 0; i < h.ntransitions; i++) {
-	n = ReadAIRecord(f, &r, swp);
+      n = ReadAIBlock(f, &h, swp, &blk);
+      r = (AI_RECORD *) blk.r;
+      for (i = 0; i < n; i++, r++) {
 	if (inner_auger == 1) {
-	  if (r.b <= ion->KLN_max && 
-	      r.b >= ion->KLN_min &&
-	      r.f <= ion->KLN_amax &&
-	      r.f >= ion->KLN_amin) {
-	    ibase = ion->ibase[r.b] - ion->KLN_bmin;
+	  if (r->b <= ion->KLN_max && 
+	      r->b >= ion->KLN_min &&
+	      r->f <= ion->KLN_amax &&
+	      r->f >= ion->KLN_amin) {
+	    ibase = ion->ibase[r->b] - ion->KLN_bmin;
 	    if (ibase >= 0) {
-	      ion->KLN_ai[ibase] += r.rate*RATE_AU;
+	      ion->KLN_ai[ibase] += r->rate*RATE_AU;
 	    }
 	  }
 	} else if (inner_auger == 3) {
 	  if (h.nele == ion->nele-1 &&
-	      r.b <= ion->KLN_bmax && 
-	      r.b >= ion->KLN_bmin) {
-	    ibase = r.b - ion->KLN_bmin;	   
-	    ion->KLN_ai[ibase] += r.rate*RATE_AU;
+	      r->b <= ion->KLN_bmax && 
+	      r->b >= ion->KLN_bmin) {
+	    ibase = r->b - ion->KLN_bmin;	   
+	    ion->KLN_ai[ibase] += r->rate*RATE_AU;
 	    continue;
 	  }
 	} else if (inner_auger == 4) {
-	  if (ion->iblock[r.b]->ionized) {
-	    ib = IonIndex(ion1, ion->iblock[r.b]->ib, ion->ilev[r.b]);
+	  if (ion->iblock[r->b]->ionized) {
+	    ib = IonIndex(ion1, ion->iblock[r->b]->ib, ion->ilev[r->b]);
 	    if (ib <= ion1->KLN_bmax && ib >= ion1->KLN_bmin) {
 	      ibase = ib - ion1->KLN_bmin;
-	      ion1->KLN_ai[ibase] += r.rate*RATE_AU;
+	      ion1->KLN_ai[ibase] += r->rate*RATE_AU;
 	    }
 	  }
 	}
-	rt.i = r.b;
-	rt.f = r.f;
-	j1 = ion->j[r.b];
-	j2 = ion->j[r.f];
-	e = ion->energy[r.b] - ion->energy[r.f];
-	if (e < 0 && ion->ibase[r.b] != r.f) e -= ai_emin;
+	rt.i = r->b;
+	rt.f = r->f;
+	j1 = ion->j[r->b];
+	j2 = ion->j[r->f];
+	e = ion->energy[r->b] - ion->energy[r->f];
+	if (e < 0 && ion->ibase[r->b] != r->f) e -= ai_emin;
 	if (e > EPS16) {
-	  AIRate(&(rt.dir), &(rt.inv), inv, j1, j2, e, r.rate);
+	  AIRate(&(rt.dir), &(rt.inv), inv, j1, j2, e, r->rate);
 	  AddRate(ion, ion->ai_rates, &rt, 0);
 	}
       }
@@ -4607,14 +5336,15 @@ int SetAIRates(int inv) {
       n = ReadFHeader(f, &fh, &swp);
       for (nb = 0; nb < fh.nblocks; nb++) {
 	n = ReadAIHeader(f, &h, swp);
-	for (i = 0; i < h.ntransitions; i++) {
-	  n = ReadAIRecord(f, &r, swp);
-	  ib = IonizedIndex(r.b, 0);
+	n = ReadAIBlock(f, &h, swp, &blk);
+	r = (AI_RECORD *) blk.r;
+	for (i = 0; i < n; i++, r++) {
+	  ib = IonizedIndex(r->b, 0);
 	  if (ib >= 0) {
 	    ib = ion0.ionized_map[1][ib];
 	    if (ib <= ion->KLN_bmax && ib >= ion->KLN_bmin) {
 	      ibase = ib - ion->KLN_bmin;
-	      ion->KLN_ai[ibase] += r.rate*RATE_AU;
+	      ion->KLN_ai[ibase] += r->rate*RATE_AU;
 	    }
 	  }
 	}
@@ -4622,6 +5352,7 @@ int SetAIRates(int inv) {
       fclose(f);
     }
   }
+  FreeDBBlock(&blk);
   return 0;
 }
 
@@ -4937,11 +5668,27 @@ int DumpRates(char *fn, int k, int m, int imax, int a) {
   BLK_RATE *brts;
   
   if (k == 0) {
+    if (bmatrix == NULL && smatrix.n == 0) {
+      printf("the block matrix has not been constructed\n");
+      return -1;
+    }
     f = fopen(fn, "w");
     if (f == NULL) {
       printf("cannot open file %s\n", fn);
       return -1;
     }
+    if (smatrix.n > 0) {
+      /* only the nonzero elements, column by column */
+      for (q = 0; q < smatrix.n; q++) {
+	for (t = smatrix.p[q]; t < smatrix.p[q+1]; t++) {
+	  p = smatrix.i[t];
+	  fprintf(f, "%5d %5d %12.5E %12.5E\n", 
+		  p, q, smatrix.x[t], svector[p]);
+	}
+      }
+      fclose(f);
+      return 0;
+    }
     for (p = 0; p < blocks->dim; p++) {
       for (q = 0; q < blocks->dim; q++) {
 	t = q*blocks->dim + p;
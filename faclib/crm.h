@@ -70,6 +70,24 @@ typedef struct _BLK_RATE_ {
   ARRAY *rates;
 } BLK_RATE;
 
+/* hash index of the BLK_RATE entries of a rate array, by block pair,
+ * and of their rates by (i, f) once AddRate is asked to merge. */
+typedef struct _RATE_INDEX_ {
+  ARRAY *rts;
+  int nb, nbslots;
+  int *bslot;
+  int nr, nrslots;
+  int *rslot;
+} RATE_INDEX;
+
+typedef struct _SP_MATRIX_ {
+  int n;
+  int nnz, nmax;
+  int *p;
+  int *i;
+  double *x;
+} SP_MATRIX;
+
 typedef struct _ION_ {
   int iground; /* ionized ground state of this ion */
   int nlevels;
@@ -121,6 +139,7 @@ int SetEleDensity(double ele);
 int SetPhoDensity(double pho);
 int SetCascade(int c, double a);
 int SetIteration(double acc, double s, int max);
+int SetSparseSolver(int m, double tol);
 int InitCRM(void);
 int ReinitCRM(int m);
 int AddIon(int nele, double n, char *pref);
@@ -17,6 +17,11 @@
  */
 
 #include "dbase.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef _POSIX_MAPPED_FILES
+#include <sys/mman.h>
+#endif
 
 static char *rcsid="$Id$";
 #if __GNUC__ == 2
@@ -42,6 +47,44 @@ static SP_HEADER sp_header;
 static RT_HEADER rt_header;
 static DR_HEADER dr_header;
 
+/*
+** the files of each type written in this session, other than the
+** current one in db_fn, with their file headers. a file set aside
+** for another of its type is appended to when it is opened again.
+*/
+static struct {
+  int n;
+  char **fn;
+  F_HEADER *fh;
+} db_files = {0, NULL, NULL};
+static char *db_fn[NDB];
+
+/*
+** the output files are written through a large stdio buffer, so that
+** the records reach the file system in a few large writes. the headers
+** of the blocks finished by DeinitFile are patched by CloseFile, and
+** the file is not sought back and forth at the end of each block.
+** db_tail[t] is the file of type t+1 known to be positioned at its end.
+*/
+#define DBBUFSIZE 4194304
+typedef struct _DB_PATCH_ {
+  FILE *f;
+  long int position;
+  long int length;
+  int nele;
+  int n;
+} DB_PATCH;
+static struct {
+  int n, m;
+  DB_PATCH *p;
+} db_patch = {0, 0, NULL};
+static FILE *db_tail[NDB];
+static char *db_buf[NDB];
+
+#define NDBVIEW 8
+static DB_VIEW *db_views[NDBVIEW];
+static long db_view_clock = 0;
+
 static EN_SRECORD *mem_en_table = NULL;
 static int mem_en_table_size = 0;
 static EN_SRECORD *mem_enf_table = NULL;
@@ -573,8 +616,68 @@ void CEMF2CEFRecord(CEMF_RECORD *mr, CEF_RECORD *r, CEMF_HEADER *mh,
   r->strength = &(mr->strength[k*mh->n_egrid]);
 }
 
+/* forget the files of type t written in this session, all if t = 0. */
+static void ForgetDBFiles(int t) {
+  int i, k;
+
+  k = 0;
+  for (i = 0; i < db_files.n; i++) {
+    if (t == 0 || db_files.fh[i].type == t) {
+      free(db_files.fn[i]);
+      continue;
+    }
+    db_files.fn[k] = db_files.fn[i];
+    db_files.fh[k] = db_files.fh[i];
+    k++;
+  }
+  db_files.n = k;
+  for (i = 0; i < NDB; i++) {
+    if (db_fn[i] && (t == 0 || t == i+1)) {
+      free(db_fn[i]);
+      db_fn[i] = NULL;
+    }
+  }
+}
+
+/*
+** set the current file of the type ihdr+1 aside, and make fn the
+** current one, with the header it had if it has been written in this
+** session, or as a new file otherwise.
+*/
+static void SwitchDBFile(int ihdr, char *fn) {
+  int i;
+
+  for (i = 0; i < db_files.n; i++) {
+    if (db_files.fh[i].type == ihdr+1 && 
+	strcmp(db_files.fn[i], db_fn[ihdr]) == 0) break;
+  }
+  if (i == db_files.n) {
+    db_files.fn = (char **) realloc(db_files.fn, sizeof(char *)*(i+1));
+    db_files.fh = (F_HEADER *) realloc(db_files.fh, sizeof(F_HEADER)*(i+1));
+    db_files.fn[i] = db_fn[ihdr];
+    db_files.n++;
+  } else {
+    free(db_fn[ihdr]);
+  }
+  db_files.fh[i] = fheader[ihdr];
+  db_fn[ihdr] = (char *) malloc(strlen(fn)+1);
+  strcpy(db_fn[ihdr], fn);
+
+  for (i = 0; i < db_files.n; i++) {
+    if (db_files.fh[i].type == ihdr+1 && 
+	strcmp(db_files.fn[i], fn) == 0) break;
+  }
+  if (i < db_files.n) {
+    fheader[ihdr] = db_files.fh[i];
+  } else {
+    fheader[ihdr].nblocks = 0;
+  }
+}
+
 int InitDBase(void) {
   int i;
+
+  ForgetDBFiles(0);
   for (i = 0; i < NDB; i++) {
     fheader[i].tsession = (long int) time(0);
     fheader[i].version = VERSION;
@@ -617,6 +720,7 @@ int ReinitDBase(int m) {
     iground = 0;
     itrf = 0;
     if (m > NDB) return -1;
+    ForgetDBFiles(m);
     i = m-1;
     fheader[i].tsession = (long int) time(0);
     fheader[i].version = VERSION;
@@ -1195,6 +1299,15 @@ int WriteFHeader(FILE *f, F_HEADER *fh) {
   return m;
 }
 
+/* the version and format flags of the file being read. */
+static void SetFHeaderRead(F_HEADER *fh) {
+  SetVersionRead(fh->type, fh->version*100+fh->sversion*10+fh->ssversion);
+  if (fh->type == DB_TR && itrf >= 0) {
+    if (VersionLE(fh, 1, 0, 6)) itrf = 1;
+    else itrf = 0;
+  }
+}
+
 int ReadFHeader(FILE *f, F_HEADER *fh, int *swp) {
   int n, m = 0;
 
@@ -1214,11 +1327,7 @@ int ReadFHeader(FILE *f, F_HEADER *fh, int *swp) {
     SwapEndianFHeader(fh);
   }
 
-  SetVersionRead(fh->type, fh->version*100+fh->sversion*10+fh->ssversion);
-  if (fh->type == DB_TR && itrf >= 0) {
-    if (VersionLE(fh, 1, 0, 6)) itrf = 1;
-    else itrf = 0;
-  }
+  SetFHeaderRead(fh);
 
   return m;
 }
@@ -2659,6 +2768,896 @@ int ReadDRRecord(FILE *f, DR_RECORD *r, int swp) {
   
   return m;
 } 
+
+/*
+** the block readers below decode all records of a block with one
+** read of its length bytes. the records are stored in the arrays
+** of a DB_BLOCK, which are grown as needed and reused for the next
+** block, so that a table is loaded without an allocation per
+** record. the params and strength arrays of the records point into
+** b->fbuf, and are valid until the next read into b.
+*/
+#define _BSF0(sv, p, e) {				\
+    if ((p) + sizeof(sv) > (e)) return -1;		\
+    memcpy(&(sv), p, sizeof(sv));			\
+    (p) += sizeof(sv);					\
+  }while(0)
+#define _BSF1(sv, s, k, p, e) {				\
+    if ((p) + (s)*(k) > (e)) return -1;			\
+    memcpy(sv, p, (s)*(k));				\
+    (p) += (s)*(k);					\
+  }while(0)
+#define BSF0(sv) _BSF0(sv, p, e)
+#define BSF1(sv, s, k) _BSF1(sv, s, k, p, e)
+
+void InitDBBlock(DB_BLOCK *b) {
+  b->buf = NULL;
+  b->nbuf = 0;
+  b->r = NULL;
+  b->rx = NULL;
+  b->nr = 0;
+  b->mr = 0;
+  b->fbuf = NULL;
+  b->nf = 0;
+}
+
+void FreeDBBlock(DB_BLOCK *b) {
+  if (b->buf) free(b->buf);
+  if (b->r) free(b->r);
+  if (b->rx) free(b->rx);
+  if (b->fbuf) free(b->fbuf);
+  InitDBBlock(b);
+}
+
+/* 
+** make room for nr records of size rsize and extra size xsize, and
+** nf floats, and read the len bytes of the block if len > 0.
+*/
+static int GrowDBBlock(FILE *f, DB_BLOCK *b, int nr, int rsize, 
+		       int xsize, long nf, long len) {
+  if (nr > b->mr) {
+    b->r = realloc(b->r, (size_t) rsize*nr);
+    if (xsize > 0) b->rx = realloc(b->rx, (size_t) xsize*nr);
+    b->mr = nr;
+  } else if (xsize > 0 && b->rx == NULL) {
+    b->rx = malloc((size_t) xsize*b->mr);
+  }
+  if (nf > b->nf) {
+    b->fbuf = (float *) realloc(b->fbuf, sizeof(float)*nf);
+    b->nf = nf;
+  }
+  if (len > b->nbuf) {
+    b->buf = (char *) realloc(b->buf, len);
+    b->nbuf = len;
+  }
+  b->nr = 0;
+  if (len > 0) {
+    if (fread(b->buf, 1, len, f) != (size_t) len) return -1;
+  }
+  return 0;
+}
+
+/* reverse the bytes of n 4-byte words. */
+static void SwapEndian4(void *p, long n) {
+  unsigned char *c;
+  unsigned char t;
+  long i;
+
+  c = (unsigned char *) p;
+  for (i = 0; i < n; i++, c += 4) {
+    t = c[0];
+    c[0] = c[3];
+    c[3] = t;
+    t = c[1];
+    c[1] = c[2];
+    c[2] = t;
+  }
+}
+
+/*
+** read the records of a CE block with header h into b. returns the 
+** number of records, or -1 on a short block. the bytes of the block
+** are taken from src if it is not NULL, and read from f otherwise.
+*/
+static int DecodeCEBlock(FILE *f, char *src, CE_HEADER *h, int swp,
+			  DB_BLOCK *b) {
+  CE_RECORD *r, tr;
+  char *p, *e;
+  int i, m0, m1;
+  long nf;
+
+  /* the floats of the records are part of the block bytes, so the
+     length of the block bounds their number. */
+  nf = h->length/sizeof(float) + 1;
+  if (version_read[DB_CE-1] < 109) {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(CE_RECORD), 
+		    0, nf, 0) < 0) return -1;
+    r = (CE_RECORD *) b->r;
+    nf = 0;
+    for (i = 0; i < h->ntransitions; i++) {
+      if (ReadCERecord(f, &tr, swp, h) == 0) return -1;
+      if (h->msub) {
+	m0 = tr.nsub;
+      } else if (h->qk_mode == QK_FIT) {
+	m0 = h->nparams * tr.nsub;
+      } else m0 = 0;
+      m1 = h->n_usr*tr.nsub;
+      r[i] = tr;
+      r[i].params = NULL;
+      if (m0) {
+	r[i].params = b->fbuf + nf;
+	memcpy(r[i].params, tr.params, sizeof(float)*m0);
+	free(tr.params);
+	nf += m0;
+      }
+      r[i].strength = b->fbuf + nf;
+      memcpy(r[i].strength, tr.strength, sizeof(float)*m1);
+      free(tr.strength);
+      nf += m1;
+    }
+  } else {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(CE_RECORD), 
+		    0, nf, src?0:h->length) < 0) return -1;
+    r = (CE_RECORD *) b->r;
+    p = src?src:b->buf;
+    e = p + h->length;
+    nf = 0;
+    for (i = 0; i < h->ntransitions; i++) {
+      BSF0(r[i].lower);
+      BSF0(r[i].upper);
+      BSF0(r[i].nsub);
+      BSF0(r[i].bethe);
+      BSF1(r[i].born, sizeof(float), 2);
+      if (swp) SwapEndianCERecord(r+i);
+      if (h->msub) {
+	m0 = r[i].nsub;
+      } else if (h->qk_mode == QK_FIT) {
+	m0 = h->nparams * r[i].nsub;
+      } else m0 = 0;
+      r[i].params = NULL;
+      if (m0) {
+	r[i].params = b->fbuf + nf;
+	BSF1(r[i].params, sizeof(float), m0);
+	nf += m0;
+      }
+      m1 = h->n_usr * r[i].nsub;
+      r[i].strength = b->fbuf + nf;
+      BSF1(r[i].strength, sizeof(float), m1);
+      nf += m1;
+    }
+    if (swp) SwapEndian4(b->fbuf, nf);
+  }
+  b->nr = h->ntransitions;
+
+  return b->nr;
+}
+
+int ReadCEBlock(FILE *f, CE_HEADER *h, int swp, DB_BLOCK *b) {
+  return DecodeCEBlock(f, NULL, h, swp, b);
+}
+
+/*
+** read the records of a TR block into b. the TR_EXTRA of the UTA
+** records are in b->rx.
+*/
+static int DecodeTRBlock(FILE *f, char *src, TR_HEADER *h, int swp,
+			  DB_BLOCK *b) {
+  TR_RECORD *r;
+  TR_EXTRA *rx;
+  char *p, *e;
+  int i;
+
+  if (version_read[DB_TR-1] < 109) {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(TR_RECORD),
+		    sizeof(TR_EXTRA), 0, 0) < 0) return -1;
+    r = (TR_RECORD *) b->r;
+    rx = (TR_EXTRA *) b->rx;
+    for (i = 0; i < h->ntransitions; i++) {
+      if (ReadTRRecord(f, r+i, rx+i, swp) == 0) return -1;
+    }
+  } else {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(TR_RECORD),
+		    sizeof(TR_EXTRA), 0, src?0:h->length) < 0) return -1;
+    r = (TR_RECORD *) b->r;
+    rx = (TR_EXTRA *) b->rx;
+    p = src?src:b->buf;
+    e = p + h->length;
+    for (i = 0; i < h->ntransitions; i++) {
+      BSF0(r[i].lower);
+      BSF0(r[i].upper);
+      BSF0(r[i].strength);
+      if (iuta) {
+	BSF0(rx[i].energy);
+	BSF0(rx[i].sdev);
+	BSF0(rx[i].sci);
+      }
+      if (swp) SwapEndianTRRecord(r+i, rx+i);
+      if (utaci == 0) rx[i].sci = 1.0;
+    }
+  }
+  b->nr = h->ntransitions;
+
+  return b->nr;
+}
+
+int ReadTRBlock(FILE *f, TR_HEADER *h, int swp, DB_BLOCK *b) {
+  return DecodeTRBlock(f, NULL, h, swp, b);
+}
+
+/* read the records of an RR block into b. */
+static int DecodeRRBlock(FILE *f, char *src, RR_HEADER *h, int swp,
+			  DB_BLOCK *b) {
+  RR_RECORD *r, tr;
+  char *p, *e;
+  int i, m0, m1;
+  long nf;
+
+  nf = h->length/sizeof(float) + 1;
+  m0 = (h->qk_mode == QK_FIT)?h->nparams:0;
+  m1 = h->n_usr;
+  if (version_read[DB_RR-1] < 109) {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(RR_RECORD), 
+		    0, nf, 0) < 0) return -1;
+    r = (RR_RECORD *) b->r;
+    nf = 0;
+    for (i = 0; i < h->ntransitions; i++) {
+      if (ReadRRRecord(f, &tr, swp, h) == 0) return -1;
+      r[i] = tr;
+      r[i].params = NULL;
+      if (m0) {
+	r[i].params = b->fbuf + nf;
+	memcpy(r[i].params, tr.params, sizeof(float)*m0);
+	free(tr.params);
+	nf += m0;
+      }
+      r[i].strength = b->fbuf + nf;
+      memcpy(r[i].strength, tr.strength, sizeof(float)*m1);
+      free(tr.strength);
+      nf += m1;
+    }
+  } else {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(RR_RECORD), 
+		    0, nf, src?0:h->length) < 0) return -1;
+    r = (RR_RECORD *) b->r;
+    p = src?src:b->buf;
+    e = p + h->length;
+    nf = 0;
+    for (i = 0; i < h->ntransitions; i++) {
+      BSF0(r[i].b);
+      BSF0(r[i].f);
+      BSF0(r[i].kl);
+      if (swp) SwapEndianRRRecord(r+i);
+      r[i].params = NULL;
+      if (m0) {
+	r[i].params = b->fbuf + nf;
+	BSF1(r[i].params, sizeof(float), m0);
+	nf += m0;
+      }
+      r[i].strength = b->fbuf + nf;
+      BSF1(r[i].strength, sizeof(float), m1);
+      nf += m1;
+    }
+    if (swp) SwapEndian4(b->fbuf, nf);
+  }
+  b->nr = h->ntransitions;
+
+  return b->nr;
+}
+
+int ReadRRBlock(FILE *f, RR_HEADER *h, int swp, DB_BLOCK *b) {
+  return DecodeRRBlock(f, NULL, h, swp, b);
+}
+
+/* read the records of a CI block into b. */
+static int DecodeCIBlock(FILE *f, char *src, CI_HEADER *h, int swp,
+			  DB_BLOCK *b) {
+  CI_RECORD *r, tr;
+  char *p, *e;
+  int i, m0, m1;
+  long nf;
+
+  nf = h->length/sizeof(float) + 1;
+  m0 = h->nparams;
+  m1 = h->n_usr;
+  if (version_read[DB_CI-1] < 109) {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(CI_RECORD), 
+		    0, nf, 0) < 0) return -1;
+    r = (CI_RECORD *) b->r;
+    nf = 0;
+    for (i = 0; i < h->ntransitions; i++) {
+      if (ReadCIRecord(f, &tr, swp, h) == 0) return -1;
+      r[i] = tr;
+      r[i].params = b->fbuf + nf;
+      memcpy(r[i].params, tr.params, sizeof(float)*m0);
+      free(tr.params);
+      nf += m0;
+      r[i].strength = b->fbuf + nf;
+      memcpy(r[i].strength, tr.strength, sizeof(float)*m1);
+      free(tr.strength);
+      nf += m1;
+    }
+  } else {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(CI_RECORD), 
+		    0, nf, src?0:h->length) < 0) return -1;
+    r = (CI_RECORD *) b->r;
+    p = src?src:b->buf;
+    e = p + h->length;
+    nf = 0;
+    for (i = 0; i < h->ntransitions; i++) {
+      BSF0(r[i].b);
+      BSF0(r[i].f);
+      BSF0(r[i].kl);
+      if (swp) SwapEndianCIRecord(r+i);
+      r[i].params = b->fbuf + nf;
+      BSF1(r[i].params, sizeof(float), m0);
+      nf += m0;
+      r[i].strength = b->fbuf + nf;
+      BSF1(r[i].strength, sizeof(float), m1);
+      nf += m1;
+    }
+    if (swp) SwapEndian4(b->fbuf, nf);
+  }
+  b->nr = h->ntransitions;
+
+  return b->nr;
+}
+
+int ReadCIBlock(FILE *f, CI_HEADER *h, int swp, DB_BLOCK *b) {
+  return DecodeCIBlock(f, NULL, h, swp, b);
+}
+
+/* read the records of an AI block into b. */
+static int DecodeAIBlock(FILE *f, char *src, AI_HEADER *h, int swp,
+			  DB_BLOCK *b) {
+  AI_RECORD *r;
+  char *p, *e;
+  int i;
+
+  if (version_read[DB_AI-1] < 109) {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(AI_RECORD),
+		    0, 0, 0) < 0) return -1;
+    r = (AI_RECORD *) b->r;
+    for (i = 0; i < h->ntransitions; i++) {
+      if (ReadAIRecord(f, r+i, swp) == 0) return -1;
+    }
+  } else {
+    if (GrowDBBlock(f, b, h->ntransitions, sizeof(AI_RECORD),
+		    0, 0, src?0:h->length) < 0) return -1;
+    r = (AI_RECORD *) b->r;
+    p = src?src:b->buf;
+    e = p + h->length;
+    for (i = 0; i < h->ntransitions; i++) {
+      BSF0(r[i].b);
+      BSF0(r[i].f);
+      BSF0(r[i].rate);
+      if (swp) SwapEndianAIRecord(r+i);
+    }
+  }
+  b->nr = h->ntransitions;
+
+  return b->nr;
+}
+
+int ReadAIBlock(FILE *f, AI_HEADER *h, int swp, DB_BLOCK *b) {
+  return DecodeAIBlock(f, NULL, h, swp, b);
+}
+
+/* the version and UTA flag of the block ib of a TR view. */
+static void SetViewRead(DB_VIEW *v, int ib) {
+  TR_HEADER *h;
+  int rs;
+
+  SetFHeaderRead(&(v->fh));
+  if (v->fh.type != DB_TR || ib < 0) return;
+  h = &(v->h[ib].tr);
+  if (v->version < 109) rs = sizeof(TR_RECORD);
+  else rs = SIZE_TR_RECORD;
+  if (h->ntransitions > 0 && h->length/h->ntransitions > rs) iuta = 1;
+  else iuta = 0;
+}
+
+static int ReadViewHeader(FILE *f, int t, int swp, DB_VHEADER *h) {
+  switch (t) {
+  case DB_EN:
+    return ReadENHeader(f, &(h->en), swp);
+  case DB_ENF:
+    return ReadENFHeader(f, &(h->enf), swp);
+  case DB_TR:
+    return ReadTRHeader(f, &(h->tr), swp);
+  case DB_CE:
+    return ReadCEHeader(f, &(h->ce), swp);
+  case DB_RR:
+    return ReadRRHeader(f, &(h->rr), swp);
+  case DB_AI:
+    return ReadAIHeader(f, &(h->ai), swp);
+  case DB_CI:
+    return ReadCIHeader(f, &(h->ci), swp);
+  default:
+    return 0;
+  }
+}
+
+static void FreeViewHeader(int t, DB_VHEADER *h) {
+  switch (t) {
+  case DB_CE:
+    free(h->ce.tegrid);
+    free(h->ce.egrid);
+    free(h->ce.usr_egrid);
+    break;
+  case DB_RR:
+    free(h->rr.tegrid);
+    free(h->rr.egrid);
+    free(h->rr.usr_egrid);
+    break;
+  case DB_AI:
+    free(h->ai.egrid);
+    break;
+  case DB_CI:
+    free(h->ci.tegrid);
+    free(h->ci.egrid);
+    free(h->ci.usr_egrid);
+    break;
+  default:
+    break;
+  }
+}
+
+static void FreeDBView(DB_VIEW *v) {
+  int i;
+
+  for (i = 0; i < v->nblocks; i++) {
+    FreeViewHeader(v->fh.type, v->h+i);
+  }
+  if (v->map) {
+#ifdef _POSIX_MAPPED_FILES
+    if (v->mmapped) munmap(v->map, v->msize);
+    else free(v->map);
+#else
+    free(v->map);
+#endif
+  }
+  if (v->f) fclose(v->f);
+  if (v->index) {
+    free(v->index);
+    free(v->nsum);
+  }
+  free(v->h);
+  free(v->records);
+  free(v->fn);
+  free(v);
+}
+
+/* the nanoseconds of the modification time, where stat has them. */
+static long StatMTimeNS(struct stat *st) {
+#ifdef st_mtime
+  return (long) st->st_mtim.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+/* the identity of the file the view v was made of. */
+static void SetViewStat(DB_VIEW *v, struct stat *st) {
+  v->dev = (unsigned long) st->st_dev;
+  v->ino = (unsigned long) st->st_ino;
+  v->msize = (long) st->st_size;
+  v->mtime = (long) st->st_mtime;
+  v->mtime_ns = StatMTimeNS(st);
+}
+
+/* whether st is the file the view v was made of, unchanged. */
+static int SameViewStat(DB_VIEW *v, struct stat *st) {
+  return (v->dev == (unsigned long) st->st_dev &&
+	  v->ino == (unsigned long) st->st_ino &&
+	  v->msize == (long) st->st_size &&
+	  v->mtime == (long) st->st_mtime &&
+	  v->mtime_ns == StatMTimeNS(st));
+}
+
+/*
+** the pages of a shared mapping beyond the end of a file truncated
+** since it was mapped raise SIGBUS when touched. check the open file
+** before the records of a view are scanned. returns -1 if it has
+** changed, and the view must not be used.
+*/
+static int CheckViewFile(DB_VIEW *v) {
+  struct stat st;
+
+  if (!v->mmapped) return 0;
+  if (fstat(fileno(v->f), &st) != 0 || !SameViewStat(v, &st)) {
+    printf("file %s changed while it is viewed\n", v->fn);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+** a new view of the file fn, outside of the cache of OpenDBView.
+** it is released by FreeDBView.
+*/
+static DB_VIEW *NewDBView(char *fn) {
+  struct stat st;
+  F_HEADER fh;
+  DB_VIEW *v;
+  FILE *f;
+  int i, n, swp;
+  long p;
+
+  f = fopen(fn, "rb");
+  if (f == NULL) return NULL;
+  if (fstat(fileno(f), &st) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  n = ReadFHeader(f, &fh, &swp);
+  if (n == 0) {
+    fclose(f);
+    return NULL;
+  }
+  if (fh.type != DB_EN && fh.type != DB_ENF && fh.type != DB_TR &&
+      fh.type != DB_CE && fh.type != DB_RR && fh.type != DB_AI &&
+      fh.type != DB_CI) {
+    printf("File type %d has no view\n", fh.type);
+    fclose(f);
+    return NULL;
+  }
+  
+  v = (DB_VIEW *) malloc(sizeof(DB_VIEW));
+  v->fn = (char *) malloc(strlen(fn)+1);
+  strcpy(v->fn, fn);
+  v->f = f;
+  v->fh = fh;
+  v->swp = swp;
+  v->version = fh.version*100 + fh.sversion*10 + fh.ssversion;
+  v->map = NULL;
+  v->mmapped = 0;
+  SetViewStat(v, &st);
+  v->used = ++db_view_clock;
+  v->nblocks = 0;
+  v->nindex = 0;
+  v->index = NULL;
+  v->nsum = NULL;
+  n = fh.nblocks > 0 ? fh.nblocks : 1;
+  v->h = (DB_VHEADER *) malloc(sizeof(DB_VHEADER)*n);
+  v->records = (long *) malloc(sizeof(long)*n);
+  for (i = 0; i < fh.nblocks; i++) {
+    n = ReadViewHeader(f, fh.type, swp, v->h+i);
+    if (n == 0) break;
+    p = ftell(f);
+    if (p + v->h[i].en.length > v->msize) {
+      FreeViewHeader(fh.type, v->h+i);
+      break;
+    }
+    v->records[i] = p;
+    v->nblocks++;
+    if (fseek(f, v->h[i].en.length, SEEK_CUR) != 0) break;
+  }
+
+#ifdef _POSIX_MAPPED_FILES
+  if (v->msize > 0) {
+    v->map = mmap(NULL, v->msize, PROT_READ, MAP_SHARED, fileno(f), 0);
+    if (v->map == MAP_FAILED) {
+      v->map = NULL;
+    } else {
+      v->mmapped = 1;
+    }
+  }
+#endif
+  if (v->map == NULL) {
+    v->map = (char *) malloc(v->msize+1);
+    fseek(f, 0, SEEK_SET);
+    if ((long) fread(v->map, 1, v->msize, f) != v->msize) {
+      printf("error reading file %s\n", fn);
+      FreeDBView(v);
+      return NULL;
+    }
+  }
+
+  SetViewRead(v, -1);
+
+  return v;
+}
+
+/*
+** the view of the file fn. a view already open is reused if the file
+** has not changed since. otherwise the file header is validated, the
+** block headers indexed, and the file mapped into memory. the views
+** are owned by the cache, and released by CloseDBView. returns NULL
+** if the file cannot be read or its type has no view.
+*/
+DB_VIEW *OpenDBView(char *fn) {
+  struct stat st;
+  DB_VIEW *v;
+  int i, k;
+
+  if (stat(fn, &st) != 0) return NULL;
+  k = -1;
+  for (i = 0; i < NDBVIEW; i++) {
+    v = db_views[i];
+    if (v && strcmp(v->fn, fn) == 0) {
+      if (SameViewStat(v, &st)) {
+	v->used = ++db_view_clock;
+	SetViewRead(v, -1);
+	return v;
+      }
+      FreeDBView(v);
+      db_views[i] = NULL;
+    }
+    if (k >= 0 && db_views[k] == NULL) continue;
+    if (db_views[i] == NULL || k < 0 || 
+	db_views[i]->used < db_views[k]->used) k = i;
+  }
+
+  v = NewDBView(fn);
+  if (v == NULL) return NULL;
+  if (db_views[k]) FreeDBView(db_views[k]);
+  db_views[k] = v;
+
+  return v;
+}
+
+/* release the view of the file fn, or all views if fn is NULL. */
+void CloseDBView(char *fn) {
+  int i;
+
+  for (i = 0; i < NDBVIEW; i++) {
+    if (db_views[i] == NULL) continue;
+    if (fn == NULL || strcmp(db_views[i]->fn, fn) == 0) {
+      FreeDBView(db_views[i]);
+      db_views[i] = NULL;
+    }
+  }
+}
+
+/*
+** decode the record k of the block ib of an EN view. returns the 
+** size of the record, or -1 if it is not in the file.
+*/
+int DBViewENRecord(DB_VIEW *v, int ib, int k, EN_RECORD *r) {
+  char *p, *e;
+  long rs;
+
+  if (ib < 0 || ib >= v->nblocks) return -1;
+  if (k < 0 || k >= v->h[ib].en.nlevels) return -1;
+  if (v->version < 109) rs = sizeof(EN_RECORD);
+  else rs = SIZE_EN_RECORD;
+  p = v->map + v->records[ib] + rs*k;
+  e = v->map + v->records[ib] + v->h[ib].en.length;
+  if (v->version < 109) {
+    BSF1(r, sizeof(EN_RECORD), 1);
+  } else {
+    BSF0(r->p);
+    BSF0(r->j);
+    BSF0(r->ilev);
+    BSF0(r->ibase);
+    BSF0(r->energy);
+    BSF1(r->ncomplex, sizeof(char), LNCOMPLEX);
+    BSF1(r->sname, sizeof(char), LSNAME);
+    BSF1(r->name, sizeof(char), LNAME);
+  }
+  if (v->swp) SwapEndianENRecord(r);
+  
+  return rs;
+}
+
+/* 
+** decode the record k of the block ib of a TR view. rx is set for
+** the UTA records. returns the size of the record, or -1.
+*/
+int DBViewTRRecord(DB_VIEW *v, int ib, int k, TR_RECORD *r, TR_EXTRA *rx) {
+  TR_HEADER *h;
+  char *p, *e;
+  long rs;
+
+  if (ib < 0 || ib >= v->nblocks) return -1;
+  h = &(v->h[ib].tr);
+  if (k < 0 || k >= h->ntransitions) return -1;
+  SetViewRead(v, ib);
+  rs = h->length/h->ntransitions;
+  p = v->map + v->records[ib] + rs*k;
+  e = p + rs;
+  if (v->version < 109) {
+    BSF1(r, sizeof(TR_RECORD), 1);
+    if (rs > sizeof(TR_RECORD)) {
+      BSF1(rx, sizeof(TR_EXTRA), 1);
+    }
+    if (v->swp) SwapEndianTRRecord(r, rx);
+  } else {
+    BSF0(r->lower);
+    BSF0(r->upper);
+    BSF0(r->strength);
+    if (rs > SIZE_TR_RECORD) {
+      BSF0(rx->energy);
+      BSF0(rx->sdev);
+      BSF0(rx->sci);
+    }
+    if (v->swp) SwapEndianTRRecord(r, rx);
+    if (utaci == 0) rx->sci = 1.0;
+  }
+
+  return rs;
+}
+
+/* 
+** decode the records of the block ib of a TR, CE, RR or CI view into
+** b, as Read*Block does. the version and UTA flags of the file are
+** set as they are for its reading. returns the number of records.
+*/
+int DBViewBlock(DB_VIEW *v, int ib, DB_BLOCK *b) {
+  char *src;
+
+  if (ib < 0 || ib >= v->nblocks) return -1;
+  if (CheckViewFile(v) < 0) return -1;
+  SetViewRead(v, ib);
+  if (v->version < 109) {
+    src = NULL;
+    fseek(v->f, v->records[ib], SEEK_SET);
+  } else {
+    src = v->map + v->records[ib];
+  }
+  switch (v->fh.type) {
+  case DB_TR:
+    return DecodeTRBlock(v->f, src, &(v->h[ib].tr), v->swp, b);
+  case DB_CE:
+    return DecodeCEBlock(v->f, src, &(v->h[ib].ce), v->swp, b);
+  case DB_RR:
+    return DecodeRRBlock(v->f, src, &(v->h[ib].rr), v->swp, b);
+  case DB_CI:
+    return DecodeCIBlock(v->f, src, &(v->h[ib].ci), v->swp, b);
+  case DB_AI:
+    return DecodeAIBlock(v->f, src, &(v->h[ib].ai), v->swp, b);
+  default:
+    return -1;
+  }
+}
+
+/* 
+** decode the record k of the block ib of an AI view. returns the
+** size of the record, or -1.
+*/
+int DBViewAIRecord(DB_VIEW *v, int ib, int k, AI_RECORD *r) {
+  AI_HEADER *h;
+  char *p, *e;
+  long rs;
+
+  if (ib < 0 || ib >= v->nblocks) return -1;
+  h = &(v->h[ib].ai);
+  if (k < 0 || k >= h->ntransitions) return -1;
+  rs = h->length/h->ntransitions;
+  p = v->map + v->records[ib] + rs*k;
+  e = p + rs;
+  if (v->version < 109) {
+    BSF1(r, sizeof(AI_RECORD), 1);
+  } else {
+    BSF0(r->b);
+    BSF0(r->f);
+    BSF0(r->rate);
+  }
+  if (v->swp) SwapEndianAIRecord(r);
+
+  return rs;
+}
+
+/* 
+** FNV hash of at most n chars of s, with the leading and trailing
+** blanks removed as in StrTrimCmp, continued from h.
+*/
+static unsigned int HashTrim(unsigned int h, char *s, int n) {
+  int i, j;
+
+  i = 0;
+  while (i < n && (s[i] == ' ' || s[i] == '\t')) i++;
+  j = i;
+  while (j < n && s[j]) j++;
+  while (j > i && (s[j-1] == ' ' || s[j-1] == '\t')) j--;
+  for (; i < j; i++) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619U;
+  }
+  h *= 16777619U;
+  
+  return h;
+}
+
+/* the index key of the level name of FindLevelByName. */
+static unsigned int LevelNameKey(char *nc, int n1, char *cnr, int n2,
+				 char *cr, int n3) {
+  unsigned int h;
+
+  h = HashTrim(2166136261U, nc, n1);
+  h = HashTrim(h, cnr, n2);
+  h = HashTrim(h, cr, n3);
+  return h;
+}
+
+static int CompareVIndex(const void *p1, const void *p2) {
+  DB_VINDEX *i1, *i2;
+
+  i1 = (DB_VINDEX *) p1;
+  i2 = (DB_VINDEX *) p2;
+  if (i1->key < i2->key) return -1;
+  if (i1->key > i2->key) return 1;
+  if (i1->ib != i2->ib) return i1->ib - i2->ib;
+  return i1->k - i2->k;
+}
+
+/*
+** build the index of the records of an EN, TR or AI view, on the 
+** first call. the records of EN are keyed by the hash of the level
+** name, those of TR and AI by the upper level, and the entries of one
+** key are in the file order. v->nsum[ib] is the number of records
+** before the block ib. returns the number of entries.
+*/
+int DBViewIndex(DB_VIEW *v) {
+  EN_RECORD r;
+  TR_RECORD tr;
+  TR_EXTRA rx;
+  AI_RECORD ar;
+  int i, k, n, m;
+
+  if (v->index) return v->nindex;
+  if (v->fh.type != DB_EN && v->fh.type != DB_TR && 
+      v->fh.type != DB_AI) return -1;
+  if (CheckViewFile(v) < 0) return -1;
+  n = 0;
+  for (i = 0; i < v->nblocks; i++) n += v->h[i].en.nlevels;
+  v->index = (DB_VINDEX *) malloc(sizeof(DB_VINDEX)*(n+1));
+  v->nsum = (int *) malloc(sizeof(int)*(v->nblocks+1));
+  n = 0;
+  m = 0;
+  for (i = 0; i < v->nblocks; i++) {
+    v->nsum[i] = m;
+    m += v->h[i].en.nlevels;
+    for (k = 0; k < v->h[i].en.nlevels; k++) {
+      switch (v->fh.type) {
+      case DB_EN:
+	if (DBViewENRecord(v, i, k, &r) < 0) continue;
+	v->index[n].key = LevelNameKey(r.ncomplex, LNCOMPLEX, 
+				       r.sname, LSNAME, r.name, LNAME);
+	break;
+      case DB_TR:
+	if (DBViewTRRecord(v, i, k, &tr, &rx) < 0) continue;
+	v->index[n].key = tr.upper;
+	break;
+      default:
+	if (DBViewAIRecord(v, i, k, &ar) < 0) continue;
+	v->index[n].key = ar.b;
+	break;
+      }
+      v->index[n].ib = i;
+      v->index[n].k = k;
+      n++;
+    }
+  }
+  v->nsum[i] = m;
+  qsort(v->index, n, sizeof(DB_VINDEX), CompareVIndex);
+  v->nindex = n;
+
+  return n;
+}
+
+/*
+** the entries of the index with the key. *i0 is set to the first of
+** them. returns their number.
+*/
+int DBViewFind(DB_VIEW *v, unsigned int key, int *i0) {
+  int i, j, k;
+
+  if (DBViewIndex(v) <= 0) return 0;
+  i = 0;
+  j = v->nindex;
+  while (i < j) {
+    k = (i+j)/2;
+    if (v->index[k].key < key) i = k+1;
+    else j = k;
+  }
+  *i0 = i;
+  for (j = i; j < v->nindex; j++) {
+    if (v->index[j].key != key) break;
+  }
+  
+  return j-i;
+}
   
 FILE *OpenFile(char *fn, F_HEADER *fhdr) {
   int ihdr;
@@ -2666,10 +3665,17 @@ FILE *OpenFile(char *fn, F_HEADER *fhdr) {
 
   ihdr = fhdr->type - 1;
 
+  CloseDBView(fn);
+  if (db_fn[ihdr] == NULL) {
+    db_fn[ihdr] = (char *) malloc(strlen(fn)+1);
+    strcpy(db_fn[ihdr], fn);
+  } else if (strcmp(db_fn[ihdr], fn) != 0) {
+    SwitchDBFile(ihdr, fn);
+  }
   f = fopen(fn, "r+b");
   if (f == NULL) {
     if (fheader[ihdr].nblocks > 0) {
-      printf("A single file for one DB type must be used in one session.\n");
+      printf("cannot reopen file %s written in this session\n", fn);
       exit(1);
     }
     f = fopen(fn, "wb");
@@ -2688,6 +3694,11 @@ FILE *OpenFile(char *fn, F_HEADER *fhdr) {
     printf("cannot open file %s\n", fn);
     exit(1);
   }
+  if (db_buf[ihdr] == NULL) {
+    db_buf[ihdr] = (char *) malloc(DBBUFSIZE);
+    setvbuf(f, db_buf[ihdr], _IOFBF, DBBUFSIZE);
+  }
+  db_tail[ihdr] = NULL;
 
   fheader[ihdr].type = fhdr->type;
   strncpy(fheader[ihdr].symbol, fhdr->symbol, 2);
@@ -2697,15 +3708,60 @@ FILE *OpenFile(char *fn, F_HEADER *fhdr) {
   return f;
 }
 
+/* defer the patch of the header of a block to CloseFile. */
+static void DeferHeader(FILE *f, long int position, long int length,
+			int nele, int n) {
+  DB_PATCH *p;
+
+  if (db_patch.n == db_patch.m) {
+    db_patch.m = 2*db_patch.m + 64;
+    db_patch.p = (DB_PATCH *) realloc(db_patch.p, 
+				      sizeof(DB_PATCH)*db_patch.m);
+  }
+  p = db_patch.p + db_patch.n;
+  p->f = f;
+  p->position = position;
+  p->length = length;
+  p->nele = nele;
+  p->n = n;
+  db_patch.n++;
+}
+
+/* write the length, nele and number of records of the deferred headers. */
+static void PatchHeaders(FILE *f) {
+  DB_PATCH *p;
+  int i, k;
+
+  k = 0;
+  for (i = 0; i < db_patch.n; i++) {
+    p = db_patch.p + i;
+    if (p->f != f) {
+      db_patch.p[k++] = *p;
+      continue;
+    }
+    fseek(f, p->position + sizeof(long int), SEEK_SET);
+    fwrite(&(p->length), sizeof(long int), 1, f);
+    fwrite(&(p->nele), sizeof(int), 1, f);
+    fwrite(&(p->n), sizeof(int), 1, f);
+  }
+  db_patch.n = k;
+}
+
 int CloseFile(FILE *f, F_HEADER *fhdr) {
   int ihdr;
  
   ihdr = fhdr->type-1;
+  PatchHeaders(f);
   fseek(f, 0, SEEK_SET);
   fheader[ihdr].type = fhdr->type;
   WriteFHeader(f, &(fheader[ihdr]));
   
   fclose(f);
+  db_tail[ihdr] = NULL;
+  if (db_buf[ihdr]) {
+    free(db_buf[ihdr]);
+    db_buf[ihdr] = NULL;
+  }
   return 0;
 }
 
@@ -2731,7 +3787,7 @@ int InitFile(FILE *f, F_HEADER *fhdr, void *rhdr) {
   if (f == NULL) return 0;
   
   ihdr = fhdr->type - 1;
-  fseek(f, 0, SEEK_END);
+  if (f != db_tail[ihdr]) fseek(f, 0, SEEK_END);
   p = ftell(f);
 
   switch (fhdr->type) {
@@ -2849,100 +3905,116 @@ int InitFile(FILE *f, F_HEADER *fhdr, void *rhdr) {
 }
 
 int DeinitFile(FILE *f, F_HEADER *fhdr) {
-  int n;
+  int n, ihdr;
 
   if (f == NULL || fhdr->type <= 0) return 0;
 
+  ihdr = fhdr->type - 1;
   switch (fhdr->type) {
   case DB_EN:
-    fseek(f, en_header.position, SEEK_SET);
     if (en_header.length > 0) {
-      n = WriteENHeader(f, &en_header);
+      DeferHeader(f, en_header.position, en_header.length, 
+		  en_header.nele, en_header.nlevels);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_TR:
-    fseek(f, tr_header.position, SEEK_SET);
     if (tr_header.length > 0) {
-      n = WriteTRHeader(f, &tr_header);
+      DeferHeader(f, tr_header.position, tr_header.length, 
+		  tr_header.nele, tr_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_CE:
-    fseek(f, ce_header.position, SEEK_SET);
     if (ce_header.length > 0) {
-      n = WriteCEHeader(f, &ce_header);
+      DeferHeader(f, ce_header.position, ce_header.length, 
+		  ce_header.nele, ce_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_RR:
-    fseek(f, rr_header.position, SEEK_SET);
     if (rr_header.length > 0) {
-      n = WriteRRHeader(f, &rr_header);
+      DeferHeader(f, rr_header.position, rr_header.length, 
+		  rr_header.nele, rr_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_AI:
-    fseek(f, ai_header.position, SEEK_SET);
     if (ai_header.length > 0) {
-      n = WriteAIHeader(f, &ai_header);
+      DeferHeader(f, ai_header.position, ai_header.length, 
+		  ai_header.nele, ai_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_CI:
-    fseek(f, ci_header.position, SEEK_SET);
     if (ci_header.length > 0) {
-      n = WriteCIHeader(f, &ci_header);
+      DeferHeader(f, ci_header.position, ci_header.length, 
+		  ci_header.nele, ci_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_SP:
-    fseek(f, sp_header.position, SEEK_SET);
     if (sp_header.length > 0) {
-      n = WriteSPHeader(f, &sp_header);
+      DeferHeader(f, sp_header.position, sp_header.length, 
+		  sp_header.nele, sp_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_RT:
     fseek(f, rt_header.position, SEEK_SET);
     if (rt_header.length > 0) {
       n = WriteRTHeader(f, &rt_header);
     }
+    db_tail[ihdr] = NULL;
     break;
   case DB_DR:
     fseek(f, dr_header.position, SEEK_SET);
     if (dr_header.length > 0) {
       n = WriteDRHeader(f, &dr_header);
     }
+    db_tail[ihdr] = NULL;
     break;
   case DB_AIM:
-    fseek(f, aim_header.position, SEEK_SET);
     if (aim_header.length > 0) {
-      n = WriteAIMHeader(f, &aim_header);
+      DeferHeader(f, aim_header.position, aim_header.length, 
+		  aim_header.nele, aim_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_CIM:
-    fseek(f, cim_header.position, SEEK_SET);
     if (cim_header.length > 0) {
-      n = WriteCIMHeader(f, &cim_header);
+      DeferHeader(f, cim_header.position, cim_header.length, 
+		  cim_header.nele, cim_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_ENF:
-    fseek(f, enf_header.position, SEEK_SET);
     if (enf_header.length > 0) {
-      n = WriteENFHeader(f, &enf_header);
+      DeferHeader(f, enf_header.position, enf_header.length, 
+		  enf_header.nele, enf_header.nlevels);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_TRF:
-    fseek(f, trf_header.position, SEEK_SET);
     if (trf_header.length > 0) {
-      n = WriteTRFHeader(f, &trf_header);
+      DeferHeader(f, trf_header.position, trf_header.length, 
+		  trf_header.nele, trf_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_CEF:
-    fseek(f, cef_header.position, SEEK_SET);
     if (cef_header.length > 0) {
-      n = WriteCEFHeader(f, &cef_header);
+      DeferHeader(f, cef_header.position, cef_header.length, 
+		  cef_header.nele, cef_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   case DB_CEMF:
-    fseek(f, cemf_header.position, SEEK_SET);
     if (cemf_header.length > 0) {
-      n = WriteCEMFHeader(f, &cemf_header);
+      DeferHeader(f, cemf_header.position, cemf_header.length, 
+		  cemf_header.nele, cemf_header.ntransitions);
     }
+    db_tail[ihdr] = f;
     break;
   default:
     break;
@@ -3095,141 +4167,89 @@ static int StrTrimCmp(char *s1, char *s2) {
 }
    
 int FindLevelByName(char *fn, int nele, char *nc, char *cnr, char *cr) {
-  F_HEADER fh;  
-  EN_HEADER h;
+  DB_VIEW *v;
   EN_RECORD r;
-  FILE *f;
-  int n, k;
-  int swp;
+  unsigned int key;
+  int i, i0, n, ib;
   
-  f = fopen(fn, "r");
-  if (f == NULL) {
+  v = OpenDBView(fn);
+  if (v == NULL) {
     printf("cannot open file %s\n", fn);
     return -1;
   }
-  n = ReadFHeader(f, &fh, &swp);
-  if (n == 0) {
-    fclose(f);
-    return 0;
-  }
-
-  if (fh.type != DB_EN) {
+  if (v->fh.type != DB_EN) {
     printf("File type is not DB_EN\n");
-    fclose(f);
     return -1;
   }
 
-  while (1) {
-    n = ReadENHeader(f, &h, swp);
-    if (n == 0) break;
-    if (h.nele != nele) {
-      fseek(f, h.length, SEEK_CUR);
-      continue;
-    }
-    for (k = 0; k < h.nlevels; k++) {
-      n = ReadENRecord(f, &r, swp);
-      if (StrTrimCmp(r.ncomplex, nc) == 0 &&
-	  StrTrimCmp(r.sname, cnr) == 0 &&
-	  StrTrimCmp(r.name, cr) == 0) {
-	fclose(f);
-	return r.ilev;
-      }
+  key = LevelNameKey(nc, strlen(nc), cnr, strlen(cnr), cr, strlen(cr));
+  n = DBViewFind(v, key, &i0);
+  for (i = i0; i < i0+n; i++) {
+    ib = v->index[i].ib;
+    if (v->h[ib].en.nele != nele) continue;
+    if (DBViewENRecord(v, ib, v->index[i].k, &r) < 0) continue;
+    if (StrTrimCmp(r.ncomplex, nc) == 0 &&
+	StrTrimCmp(r.sname, cnr) == 0 &&
+	StrTrimCmp(r.name, cr) == 0) {
+      return r.ilev;
     }
   }
   
-  fclose(f);
   return -1;
 }
       
 int LevelInfor(char *fn, int ilev, EN_RECORD *r0) {
-  F_HEADER fh;  
-  EN_HEADER h;
-  EN_RECORD r;
-  FILE *f;
-  int n, i, k, nlevels;
-  int swp, sr;
+  DB_VIEW *v;
+  int i, j, k, nlevels;
   
-  f = fopen(fn, "r");
-  if (f == NULL) {
+  v = OpenDBView(fn);
+  if (v == NULL) {
     printf("cannot open file %s\n", fn);
     return -1;
   }
-  n = ReadFHeader(f, &fh, &swp);
-  if (n == 0) {
-    fclose(f);
-    return 0;
-  }
-  if (fh.type != DB_EN) {
+  if (v->fh.type != DB_EN) {
     printf("File type is not DB_EN\n");
-    fclose(f);
     return -1;
   }
-  if (version_read[DB_EN-1] < 109) sr = sizeof(EN_RECORD);
-  else sr = SIZE_EN_RECORD;
 
   if (ilev >= 0) {
-    k = ilev;
-    nlevels = 0;
-    for (i = 0; i < fh.nblocks; i++) {
-      n = ReadENHeader(f, &h, swp);
-      if (n == 0) break;
-      nlevels += h.nlevels;
-      if (k < h.nlevels) {
-	if (k > 0) fseek(f, sr*k, SEEK_CUR);
-	n = ReadENRecord(f, &r, swp);
-	if (n == 0) break;
-	if (r.ilev != ilev) {
-	  fclose(f);
-	  return -1;
-	}
-	memcpy(r0, &r, sizeof(EN_RECORD));
-	break;
-      } else {
-	k -= h.nlevels;
-	fseek(f, h.length, SEEK_CUR);
-      }
-    }
-    fclose(f);
-    if (i == fh.nblocks) return -1;
+    if (DBViewIndex(v) < 0) return -1;
+    i = 0;
+    j = v->nblocks;
+    while (j-i > 1) {
+      k = (i+j)/2;
+      if (v->nsum[k] <= ilev) i = k;
+      else j = k;
+    }
+    if (i >= v->nblocks || ilev >= v->nsum[i+1]) return -1;
+    if (DBViewENRecord(v, i, ilev-v->nsum[i], r0) < 0) return -1;
+    if (r0->ilev != ilev) return -1;
     return 0;
   } else {
     k = -ilev;
     if (k == 1000) k = 0;
+    nlevels = 0;
     if (k < 1000) {
-      nlevels = 0;
-      for (i = 0; i < fh.nblocks; i++) {
-	n = ReadENHeader(f, &h, swp);
-	if (n == 0) break;
-	if (h.nele == k) break;
-	nlevels += h.nlevels;
-	fseek(f, h.length, SEEK_CUR);
+      for (i = 0; i < v->nblocks; i++) {
+	if (v->h[i].en.nele == k) return nlevels;
+	nlevels += v->h[i].en.nlevels;
       }
-      fclose(f);
-      if (i == fh.nblocks) return -1;
-      return nlevels;
+      return -1;
     } else {
-      nlevels = 0;
       k -= 1000;
       if (k == 1) {
-	for (i = 0; i < fh.nblocks; i++) {
-	  n = ReadENHeader(f, &h, swp);
-	  if (n == 0) break;
-	  nlevels += h.nlevels;
-	  fseek(f, h.length, SEEK_CUR);
+	for (i = 0; i < v->nblocks; i++) {
+	  nlevels += v->h[i].en.nlevels;
 	}
       } else if (k == 2) {
-	nlevels = fh.nblocks;
+	nlevels = v->nblocks;
       } else if (k >= 1000) {
 	k -= 1000;
-	for (i = 0; i < fh.nblocks; i++) {
+	for (i = 0; i < v->nblocks; i++) {
 	  if (i >= k) break;
-	  n = ReadENHeader(f, &h, swp);
-	  if (n == 0) break;
-	  nlevels += h.nlevels;
-	  fseek(f, h.length, SEEK_CUR);
+	  nlevels += v->h[i].en.nlevels;
 	}
       }
-      fclose(f);
       return nlevels;
     }
   }  
@@ -3256,42 +4276,28 @@ int IBaseFromENRecord(EN_RECORD *r) {
 }
 
 int MemENTable(char *fn) {
-  F_HEADER fh;  
-  EN_HEADER h;
+  DB_VIEW *v;
   EN_RECORD r;
-  FILE *f;
   char *s;
-  int n, i, nlevels;
+  int i, k, nlevels;
   float e0;
-  int swp, sr;
 
-  f = fopen(fn, "r");
-  if (f == NULL) return -1;
-
-  n = ReadFHeader(f, &fh, &swp);  
-  if (n == 0) return 0;
-  if (fh.type == DB_ENF) {
-    fclose(f);
+  v = OpenDBView(fn);
+  if (v == NULL) return -1;
+  if (v->fh.type == DB_ENF) {
     return MemENFTable(fn);
   }
-  if (fh.type != DB_EN) {
+  if (v->fh.type != DB_EN) {
     printf("File type is not DB_EN\n");
-    fclose(f);
     return -1;
   }
-  if (version_read[DB_EN-1] < 109) sr = sizeof(EN_RECORD);
-  else sr = SIZE_EN_RECORD;
 
   if (mem_en_table) free(mem_en_table);
 
+  /* the last record of a block has its largest ilev. */
   nlevels = 0;
-  for (i = 0; i < fh.nblocks; i++) {
-    n = ReadENHeader(f, &h, swp);
-    if (n == 0) break;
-    if (h.length > sr) {
-      fseek(f, h.length-sr, SEEK_CUR);
-    }
-    n = ReadENRecord(f, &r, swp);
+  for (i = 0; i < v->nblocks; i++) {
+    if (DBViewENRecord(v, i, v->h[i].en.nlevels-1, &r) < 0) continue;
     if (r.ilev >= nlevels) nlevels = r.ilev+1;
   }
 
@@ -3299,17 +4305,9 @@ int MemENTable(char *fn) {
   mem_en_table_size = nlevels;
 
   e0 = 0.0;
-  if (version_read[DB_EN-1] < 109) {
-    fseek(f, sizeof(F_HEADER), SEEK_SET);
-  } else {
-    fseek(f, SIZE_F_HEADER, SEEK_SET);
-  }
-  while (1) {
-    n = ReadENHeader(f, &h, swp);
-    if (n == 0) break;
-    for (i = 0; i < h.nlevels; i++) {
-      n = ReadENRecord(f, &r, swp);
-      if (n == 0) break;
+  for (i = 0; i < v->nblocks; i++) {
+    for (k = 0; k < v->h[i].en.nlevels; k++) {
+      if (DBViewENRecord(v, i, k, &r) < 0) break;
       if (r.energy < e0) {
 	e0 = r.energy;
 	iground = r.ilev;
@@ -3333,7 +4331,6 @@ int MemENTable(char *fn) {
     }
   }
 
-  fclose(f);
   return 0;
 }    
 
@@ -3603,54 +4600,43 @@ int PrintTRFTable(FILE *f1, FILE *f2, int v, int swp) {
 
 int TRBranch(char *fn, int upper, int lower, 
 	     double *te, double *pa, double *ta) {
-  F_HEADER fh;
-  TR_HEADER h;
+  DB_VIEW *v;
+  TR_HEADER *h;
   TR_RECORD r;
   TR_EXTRA rx;
-  FILE *f;
-  int n, i, k;
+  int i, i0, n, ib;
   double a, b, c, e;
-  int swp;
  
   if (mem_en_table == NULL) {
     printf("Energy table has not been built in memory.\n");
     return -1;
   }
 
-  f = fopen(fn, "r");
-  if (f == NULL) {
+  v = OpenDBView(fn);
+  if (v == NULL) {
     printf("cannot open file %s\n", fn);
     return -1;
   }
-  n = ReadFHeader(f, &fh, &swp);
-  if (n == 0) {
-    fclose(f);
-    return 0;
-  }
-  if (fh.type != DB_TR) {
+  if (v->fh.type != DB_TR) {
     printf("File type is not DB_TR\n");
-    fclose(f);
     return -1;
   }
   
   a = 0.0;
   c = 0.0;
-  for (i = 0; i < fh.nblocks; i++) {
-    n = ReadTRHeader(f, &h, swp);
-    if (n == 0) break;
-    for (k = 0; k < h.ntransitions; k++) {
-      n = ReadTRRecord(f, &r, &rx, swp);
-      if (n == 0) break;
-      if (r.upper == upper) {
-	e = mem_en_table[r.upper].energy - mem_en_table[r.lower].energy;
-	OscillatorStrength(h.multipole, e, r.strength, &b);
-	b /= (mem_en_table[r.upper].j + 1.0);
-	b *= RATE_AU;
-	a += b;
-	if (r.lower == lower) {
-	  c += b;
-	}
-      }
+  n = DBViewFind(v, upper, &i0);
+  for (i = i0; i < i0+n; i++) {
+    ib = v->index[i].ib;
+    h = &(v->h[ib].tr);
+    if (DBViewTRRecord(v, ib, v->index[i].k, &r, &rx) < 0) continue;
+    if (r.upper != upper) continue;
+    e = mem_en_table[r.upper].energy - mem_en_table[r.lower].energy;
+    OscillatorStrength(h->multipole, e, r.strength, &b);
+    b /= (mem_en_table[r.upper].j + 1.0);
+    b *= RATE_AU;
+    a += b;
+    if (r.lower == lower) {
+      c += b;
     }
   }
   
@@ -3663,14 +4649,13 @@ int TRBranch(char *fn, int upper, int lower,
     *te = 0.0;
   }
 
-  fclose(f);
-
   return 0;
 }
   
 int PrintCETable(FILE *f1, FILE *f2, int v, int swp) {
   CE_HEADER h;
   CE_RECORD r;
+  DB_BLOCK blk;
   int n, i, t;
   int nb;
   int m, k, p1, p2;
@@ -3678,6 +4663,7 @@ int PrintCETable(FILE *f1, FILE *f2, int v, int swp) {
   double bte, bms, be;
 
   nb = 0;
+  InitDBBlock(&blk);
   BornFormFactorTE(&bte);
   bms = BornMass();  
   while (1) {
@@ -3720,9 +4706,9 @@ int PrintCETable(FILE *f1, FILE *f2, int v, int swp) {
       }
     }
     
-    for (i = 0; i < h.ntransitions; i++) {
-      n = ReadCERecord(f1, &r, swp, &h);
-      if (n == 0) break;
+    n = ReadCEBlock(f1, &h, swp, &blk);
+    for (i = 0; i < n; i++) {
+      r = ((CE_RECORD *) blk.r)[i];
       if (v) {
 	e = mem_en_table[r.upper].energy - mem_en_table[r.lower].energy;
 	fprintf(f2, "%6d %2d %6d %2d %11.4E %d\n",
@@ -3772,14 +4758,13 @@ int PrintCETable(FILE *f1, FILE *f2, int v, int swp) {
 	}
       }      
       fflush(f2);
-      if (h.msub || h.qk_mode == QK_FIT) free(r.params);
-      free(r.strength);
     }
     free(h.tegrid);
     free(h.egrid);
     free(h.usr_egrid);
     nb += 1;
   }
+  FreeDBBlock(&blk);
 
   return nb;
 }
@@ -4136,53 +5121,37 @@ int PrintAITable(FILE *f1, FILE *f2, int v, int swp) {
 
 int AIBranch(char *fn, int ib, int ia,
 	     double *te, double *pa, double *ta) {
-  F_HEADER fh;
-  AI_HEADER h;
+  DB_VIEW *v;
   AI_RECORD r;
-  FILE *f;
-  int n, i, k;
-  double a, b, c, e;
-  int swp;
+  int i, i0, n;
+  double a, b, c;
     
   if (mem_en_table == NULL) {
     printf("Energy table has not been built in memory.\n");
     return -1;
   }
 
-  f = fopen(fn, "r");
-  if (f == NULL) {
+  v = OpenDBView(fn);
+  if (v == NULL) {
     printf("cannot open file %s\n", fn);
     return -1;
   }
-  n = ReadFHeader(f, &fh, &swp);
-  if (n == 0) {
-    fclose(f);
-    return 0;
-  }
-  if (fh.type != DB_AI) {
+  if (v->fh.type != DB_AI) {
     printf("File type is not DB_AI\n");
-    fclose(f);
     return -1;
   }
    
   a = 0.0;
   c = 0.0;
-  for (i = 0; i < fh.nblocks; i++) {
-    n = ReadAIHeader(f, &h, swp);
-    if (n == 0) break;
-    for (k = 0; k < h.ntransitions; k++) {
-      n = ReadAIRecord(f, &r, swp);
-      if (n == 0) break;
-      if (r.b == ib) {
-	e = mem_en_table[r.b].energy - mem_en_table[r.f].energy;
-	b = RATE_AU*r.rate;
-	a += b;
-	if (r.f == ia) {
-	  c += b;
-	}
-      }
-    }    
-    free(h.egrid);
+  n = DBViewFind(v, ib, &i0);
+  for (i = i0; i < i0+n; i++) {
+    if (DBViewAIRecord(v, v->index[i].ib, v->index[i].k, &r) < 0) continue;
+    if (r.b != ib) continue;
+    b = RATE_AU*r.rate;
+    a += b;
+    if (r.f == ia) {
+      c += b;
+    }
   }
   
   *pa = c;
@@ -4193,8 +5162,6 @@ int AIBranch(char *fn, int ib, int ia,
   } else {
     *te = 0.0;
   }
-
-  fclose(f);
   
   return 0;
 }
@@ -4760,6 +5727,156 @@ int JoinTable(char *fn1, char *fn2, char *fn) {
 #undef NBUF
 }
 
+/* a block of one of the files merged by MergeTable. */
+typedef struct _MERGE_BLOCK_ {
+  int ifn;
+  int rank;
+  int seq;
+  long start;
+  long hsize;
+  long length;
+} MERGE_BLOCK;
+
+static int CompareMergeBlock(const void *p1, const void *p2) {
+  MERGE_BLOCK *b1, *b2;
+
+  b1 = (MERGE_BLOCK *) p1;
+  b2 = (MERGE_BLOCK *) p2;
+  if (b1->rank != b2->rank) return b1->rank - b2->rank;
+  return b1->seq - b2->seq;
+}
+
+/*
+** merge the n files ifn, written separately, e.g., by the workers of
+** a parallel run, into a single file ofn. the files must have the
+** same type, version, element and byte order. the blocks are copied
+** without decoding their records, grouped by nele in the order of
+** their first appearance, and their positions and the number of
+** blocks in the file header are fixed.
+*/
+int MergeTable(char *ofn, int n, char **ifn) {
+  F_HEADER fh;
+  DB_VIEW *v;
+  MERGE_BLOCK *b;
+  FILE *f, *f1;
+  char *buf;
+  int *ne, nne, nb, mb, i, j, k, m;
+  long p, q;
+#define NBUF 65536
+
+  if (n <= 0) return -1;
+  nb = 0;
+  mb = 0;
+  nne = 0;
+  b = NULL;
+  ne = NULL;
+  for (i = 0; i < n; i++) {
+    v = NewDBView(ifn[i]);
+    if (v == NULL) {
+      printf("cannot open file %s\n", ifn[i]);
+      nb = -1;
+      break;
+    }
+    if (v->swp) {
+      printf("File %s is in different byte-order\n", ifn[i]);
+      FreeDBView(v);
+      nb = -1;
+      break;
+    }
+    if (i == 0) {
+      fh = v->fh;
+      fh.nblocks = 0;
+    } else if (v->fh.type != fh.type || v->fh.atom != fh.atom ||
+	       v->fh.version != fh.version || v->fh.sversion != fh.sversion ||
+	       v->fh.ssversion != fh.ssversion) {
+      printf("Files %s and %s are not of the same type, version, ", 
+	     ifn[0], ifn[i]);
+      printf("or element\n");
+      FreeDBView(v);
+      nb = -1;
+      break;
+    }
+    if (nb + v->nblocks > mb) {
+      mb = 2*mb + v->nblocks;
+      b = (MERGE_BLOCK *) realloc(b, sizeof(MERGE_BLOCK)*mb);
+      ne = (int *) realloc(ne, sizeof(int)*mb);
+    }
+    if (v->version < 109) p = sizeof(F_HEADER);
+    else p = SIZE_F_HEADER;
+    for (j = 0; j < v->nblocks; j++) {
+      for (k = 0; k < nne; k++) {
+	if (ne[k] == v->h[j].en.nele) break;
+      }
+      if (k == nne) ne[nne++] = v->h[j].en.nele;
+      b[nb].ifn = i;
+      b[nb].rank = k;
+      b[nb].seq = nb;
+      b[nb].start = p;
+      b[nb].hsize = v->records[j] - p;
+      b[nb].length = v->h[j].en.length;
+      p = v->records[j] + v->h[j].en.length;
+      nb++;
+    }
+    FreeDBView(v);
+  }
+  if (nb < 0) {
+    if (b) free(b);
+    if (ne) free(ne);
+    return -1;
+  }
+
+  CloseDBView(ofn);
+  f = fopen(ofn, "wb");
+  if (f == NULL) {
+    printf("cannot open file %s\n", ofn);
+    free(b);
+    free(ne);
+    return -1;
+  }
+  qsort(b, nb, sizeof(MERGE_BLOCK), CompareMergeBlock);
+  fh.nblocks = nb;
+  WriteFHeader(f, &fh);
+  buf = (char *) malloc(NBUF);
+  f1 = NULL;
+  m = -1;
+  for (i = 0; i < nb; i++) {
+    if (b[i].ifn != m) {
+      if (f1) fclose(f1);
+      m = b[i].ifn;
+      f1 = fopen(ifn[m], "rb");
+      if (f1 == NULL) break;
+    }
+    /* the block header starts with its position in the file. */
+    p = ftell(f);
+    q = b[i].hsize + b[i].length;
+    if (fseek(f1, b[i].start, SEEK_SET) != 0) break;
+    k = 0;
+    while (q > 0) {
+      j = (q < NBUF)? q : NBUF;
+      if (fread(buf, 1, j, f1) != (size_t) j) break;
+      if (k == 0) {
+	memcpy(buf, &p, sizeof(long int));
+	k = 1;
+      }
+      if (fwrite(buf, 1, j, f) != (size_t) j) break;
+      q -= j;
+    }
+    if (q > 0) break;
+  }
+  if (f1) fclose(f1);
+  fclose(f);
+  free(buf);
+  free(b);
+  free(ne);
+  if (i < nb) {
+    printf("error merging file %s into %s\n", ifn[m], ofn);
+    return -1;
+  }
+
+  return nb;
+#undef NBUF
+}
+
 int ISearch(int i, int n, int *ia) {
   int k;
 
@@ -412,6 +412,76 @@ typedef struct _DR_RECORD_ {
   float total_rate;
 } DR_RECORD;  
 
+/* the records of a block, read by one of the Read*Block functions.
+ * the arrays are owned by the block, grown as needed, and reused for
+ * the next block read into it. they are released by FreeDBBlock.
+ */
+typedef struct _DB_BLOCK_ {
+  char *buf;
+  long nbuf;
+  void *r;
+  void *rx;
+  int nr;
+  int mr;
+  float *fbuf;
+  long nf;
+} DB_BLOCK;
+
+/* the block header of a file with a view. the position, length, nele
+ * and the number of records lead all of them, and can be read through
+ * any member, e.g., h->en.nele and h->en.nlevels.
+ */
+typedef union _DB_VHEADER_ {
+  EN_HEADER en;
+  ENF_HEADER enf;
+  TR_HEADER tr;
+  CE_HEADER ce;
+  RR_HEADER rr;
+  AI_HEADER ai;
+  CI_HEADER ci;
+} DB_VHEADER;
+
+/* an entry of the index of a view, the record k of the block ib. */
+typedef struct _DB_VINDEX_ {
+  unsigned int key;
+  int ib;
+  int k;
+} DB_VINDEX;
+
+/* a read-only view of a database file. the file header is validated
+ * and the block headers are read once, when the view is opened. the
+ * records are then decoded in place from the file mapped into memory.
+ * the views are kept open and shared by the callers of OpenDBView,
+ * so that lookups and repeated scans of a file do not reparse it.
+ * the index of the records, built on demand by DBViewIndex, maps
+ * the level names of EN, and the upper levels of TR and AI, to them.
+ * a view is reused only while the device, inode, size and modification
+ * time of the file are unchanged. a file truncated by another process
+ * while it is mapped is detected by DBViewBlock and DBViewIndex, the
+ * record accessors rely on the check made by OpenDBView.
+ */
+typedef struct _DB_VIEW_ {
+  char *fn;
+  FILE *f;
+  F_HEADER fh;
+  int swp;
+  int version;
+  char *map;
+  long msize;
+  int mmapped;
+  unsigned long dev;
+  unsigned long ino;
+  long mtime;
+  long mtime_ns;
+  long used;
+  int nblocks;
+  DB_VHEADER *h;
+  long *records;
+  int nindex;
+  DB_VINDEX *index;
+  int *nsum;
+} DB_VIEW;
+
 /* these read functions interface with the binary data files.
  * they can be used in custom c/c++ codes to read the binary 
  * files directly. to do so, copy consts.h, dbase.h, and dbase.c
@@ -449,6 +519,21 @@ int ReadRTHeader(FILE *f, RT_HEADER *h, int swp);
 int ReadRTRecord(FILE *f, RT_RECORD *r, int swp);
 int ReadDRHeader(FILE *f, DR_HEADER *h, int swp);
 int ReadDRRecord(FILE *f, DR_RECORD *r, int swp);
+void InitDBBlock(DB_BLOCK *b);
+void FreeDBBlock(DB_BLOCK *b);
+int ReadTRBlock(FILE *f, TR_HEADER *h, int swp, DB_BLOCK *b);
+int ReadCEBlock(FILE *f, CE_HEADER *h, int swp, DB_BLOCK *b);
+int ReadRRBlock(FILE *f, RR_HEADER *h, int swp, DB_BLOCK *b);
+int ReadCIBlock(FILE *f, CI_HEADER *h, int swp, DB_BLOCK *b);
+int ReadAIBlock(FILE *f, AI_HEADER *h, int swp, DB_BLOCK *b);
+DB_VIEW *OpenDBView(char *fn);
+void CloseDBView(char *fn);
+int DBViewENRecord(DB_VIEW *v, int ib, int k, EN_RECORD *r);
+int DBViewTRRecord(DB_VIEW *v, int ib, int k, TR_RECORD *r, TR_EXTRA *rx);
+int DBViewBlock(DB_VIEW *v, int ib, DB_BLOCK *b);
+int DBViewAIRecord(DB_VIEW *v, int ib, int k, AI_RECORD *r);
+int DBViewIndex(DB_VIEW *v);
+int DBViewFind(DB_VIEW *v, unsigned int key, int *i0);
 
 void CEMF2CEFHeader(CEMF_HEADER *mh, CEF_HEADER *h);
 void CEMF2CEFRecord(CEMF_RECORD *mr, CEF_RECORD *r, CEMF_HEADER *mh, 
@@ -564,6 +649,7 @@ int IsUTA(void);
 void SetTRF(int m);
 int AppendTable(char *fn);
 int JoinTable(char *fn1, char *fn2, char *fn);
+int MergeTable(char *ofn, int n, char **ifn);
 int TRBranch(char *fn, int i, int j, double *te, double *pa, double *ta);
 int AIBranch(char *fn, int i, int j, double *te, double *pa, double *ta);
 int LevelInfor(char *fn, int ilev, EN_RECORD *r0);
@@ -27,6 +27,7 @@ USE (rcsid);
 
 #define MAXMSUB  32
 #define NPARAMS  4
+#define CE_BLOCK 256
 
 static int qk_mode;
 static double qk_fit_tolerance;
@@ -40,6 +41,7 @@ static double usr_egrid[MAXNUSR];
 static double log_usr[MAXNUSR];
 static double xusr[MAXNUSR];
 static double log_xusr[MAXNUSR];
+#pragma omp threadprivate(xusr, log_xusr)
 
 static int n_egrid = 0;
 static int n_egrid1 = 0;
@@ -67,6 +69,7 @@ static double gos1[NKINT];
 static double gos2[NKINT];
 static double gost[NKINT];
 static double gosint[NKINT];
+#pragma omp threadprivate(kint, log_kint, gos1, gos2, gost, gosint)
 static double xborn = XBORN;
 static double xborn0 = XBORN0;
 static double xborn1 = XBORN1;
@@ -107,6 +110,41 @@ void FreeExcitationPkData(void *p) {
   dp->nkl = -1;
 }
 
+/* store the pk computed in t into the cache element d, with nkl set
+   last, unless another thread has done so meanwhile. */
+static void PublishCEPK(CEPK *d, CEPK *t) {
+#pragma omp critical(excitation_cache)
+  {
+    if (d->nkl < 0) {
+      d->nkappa = t->nkappa;
+      d->kappa0 = t->kappa0;
+      d->kappa1 = t->kappa1;
+      d->pkd = t->pkd;
+      d->pke = t->pke;
+#pragma omp flush
+      d->nkl = t->nkl;
+    } else {
+      free(t->kappa0);
+      free(t->kappa1);
+      free(t->pkd);
+      free(t->pke);
+    }
+  }
+}
+
+/* same for the qk tables. */
+static void PublishCEQk(double **p, double *y) {
+#pragma omp critical(excitation_cache)
+  {
+    if (*p == NULL) {
+#pragma omp flush
+      *p = y;
+    } else {
+      free(y);
+    }
+  }
+}
+
 void FreeExcitationQkData(void *p) {
   double *dp;
 
@@ -304,6 +342,25 @@ int SetCEPWGrid(int ns, int *n, int *step) {
   return 0;
 }
 
+/*
+** the direct slater integrals of the energies i0 and above of
+** CERadialPk, for the partial wave km of ks[1]. they share the yk
+** potential of the bound orbitals ks[0] and ks[2], and are done
+** in one batch, which leaves them in the slater cache.
+*/
+static void CESlaterBatch(int *ks, int km, double e1, int i0, 
+			  int k, int mode) {
+  int i, n, kb[MAXNTE], kd[MAXNTE];
+
+  n = 0;
+  for (i = i0; i < n_tegrid; i++) {
+    kb[n] = OrbitalIndex(0, km, e1 + tegrid[i]);
+    kd[n] = ks[3];
+    n++;
+  }
+  if (n > 0) SlaterBatch(NULL, ks[0], ks[2], k/2, n, kb, kd, mode);
+}
+
 int CERadialPk(CEPK **pk, int ie, int k0, int k1, int k) {
   int type, ko2, i, m, t, q;
   int kf0, kf1, kpp0, kpp1, km0, km1;
@@ -314,9 +371,10 @@ int CERadialPk(CEPK **pk, int ie, int k0, int k1, int k) {
   double te, e0, e1, sd, se;
   double a, tdi[MAXNTE], tex[MAXNTE];
   int js1, js3, js[4], ks[4];
-  int nkappa, noex[MAXNTE];
+  int nkappa, noex[MAXNTE], kc0, kc1, sb, mode;
   short *kappa0, *kappa1;
   double *pkd, *pke;
+  CEPK tpk;
 
 #ifdef PERFORM_STATISTICS
   clock_t start, stop;
@@ -344,6 +402,12 @@ int CERadialPk(CEPK **pk, int ie, int k0, int k1, int k) {
     return type;
   }
 
+  /* whether the direct integrals of the energies after the first
+     one may be done in batches, i.e., they are not separable. */
+  GetSlaterCut(&kc0, &kc1);
+  sb = (type >= 0 && n_tegrid > 1 && orb0->n > 0 && orb1->n > 0 &&
+	(kl0 <= kc1 || kl1 <= kc1));
+
   nkappa = (MAXNKL)*(GetMaxRank()+1)*4;
   kappa0 = (short *) malloc(sizeof(short)*nkappa);
   kappa1 = (short *) malloc(sizeof(short)*nkappa);
@@ -429,6 +493,8 @@ int CERadialPk(CEPK **pk, int ie, int k0, int k1, int k) {
 	    kf1 = OrbitalIndex(0, km1, e0);
 	    ks[1] = kf1;
 	  }
+	  if (kl1 >= pw_scratch.qr && kl0 >= pw_scratch.qr) mode = -1;
+	  else mode = 1;
 	  for (i = 0; i < n_tegrid; i++) {
 	    te = tegrid[i];
 	    e0 = e1 + te;
@@ -439,14 +505,13 @@ int CERadialPk(CEPK **pk, int ie, int k0, int k1, int k) {
 	      kf0 = OrbitalIndex(0, km1, e0);
 	      ks[1] = kf0;	      
 	    }
+	    if (i == 1 && sb && IsEven(kl0 + kl1 + ko2) &&
+		(kl0 <= kc1 || kl1 <= kc1)) {
+	      CESlaterBatch(ks, (pw_type == 0)?km0:km1, e1, i, k, mode);
+	    }
 	    
 	    if (noex[i] == 0) {
-	      if (kl1 >= pw_scratch.qr &&
-		  kl0 >= pw_scratch.qr) {
-		SlaterTotal(&sd, &se, js, ks, k, -1);
-	      } else {
-		SlaterTotal(&sd, &se, js, ks, k, 1);
-	      }
+	      SlaterTotal(&sd, &se, js, ks, k, mode);
 	      if (i == 0) {
 		if (1.0+sd == 1.0 && 1.0+se == 1.0) {
 		  break;
@@ -456,12 +521,7 @@ int CERadialPk(CEPK **pk, int ie, int k0, int k1, int k) {
 	      tex[i] += (sd+se)*(sd+se);
 	    } else {
 	      se = 0.0;
-	      if (kl1 >= pw_scratch.qr &&
-		  kl0 >= pw_scratch.qr) {
-		SlaterTotal(&sd, NULL, js, ks, k, -1);
-	      } else {
-		SlaterTotal(&sd, NULL, js, ks, k, 1);
-	      }
+	      SlaterTotal(&sd, NULL, js, ks, k, mode);
 	      if (i == 0) {
 		if (1.0+sd == 1.0) {
 		  break;
@@ -482,17 +542,18 @@ int CERadialPk(CEPK **pk, int ie, int k0, int k1, int k) {
     }
   }
 
-  (*pk)->nkl = t;
-  (*pk)->nkappa = m;
+  tpk.nkl = t;
+  tpk.nkappa = m;
   if (pw_type == 0) {
-    (*pk)->kappa0 = ReallocNew(kappa0, sizeof(short)*m);
-    (*pk)->kappa1 = ReallocNew(kappa1, sizeof(short)*m);
+    tpk.kappa0 = ReallocNew(kappa0, sizeof(short)*m);
+    tpk.kappa1 = ReallocNew(kappa1, sizeof(short)*m);
   } else {
-    (*pk)->kappa0 = ReallocNew(kappa1, sizeof(short)*m);
-    (*pk)->kappa1 = ReallocNew(kappa0, sizeof(short)*m);
+    tpk.kappa0 = ReallocNew(kappa1, sizeof(short)*m);
+    tpk.kappa1 = ReallocNew(kappa0, sizeof(short)*m);
   }
-  (*pk)->pkd = ReallocNew(pkd, sizeof(double)*q);
-  (*pk)->pke = ReallocNew(pke, sizeof(double)*q);  
+  tpk.pkd = ReallocNew(pkd, sizeof(double)*q);
+  tpk.pke = ReallocNew(pke, sizeof(double)*q);  
+  PublishCEPK(*pk, &tpk);
     
 #ifdef PERFORM_STATISTICS
   stop = clock();
@@ -1057,8 +1118,7 @@ double *CERadialQkTable(int k0, int k1, int k2, int k3, int k) {
     mk = GetMaxKMBPT();
     if (k/2 <= mk) t = nqk*2 + 1;
   }
-  *p = (double *) malloc(sizeof(double)*t);
-  rqc = *p;
+  rqc = (double *) malloc(sizeof(double)*t);
 
   ptr = rqc;
   for (ite = 0; ite < n_tegrid; ite++) {
@@ -1078,6 +1138,7 @@ double *CERadialQkTable(int k0, int k1, int k2, int k3, int k) {
       ptr += n_egrid1;
     }
   }
+  PublishCEQk(p, rqc);
 
 #ifdef PERFORM_STATISTICS
   stop = clock();
@@ -1130,8 +1191,7 @@ double *CERadialQkMSubTable(int k0, int k1, int k2, int k3, int k, int kp) {
     q[iq] = q[iq-1] + 2;
   }  
   nqk = nq*n_tegrid*n_egrid1;
-  *p = (double *) malloc(sizeof(double)*(nqk+1));
-  rqc = *p;
+  rqc = (double *) malloc(sizeof(double)*(nqk+1));
   if (xborn == 0) {
     for (ie = 0; ie < n_egrid1; ie++) {
       e1 = egrid[ie];
@@ -1387,13 +1447,14 @@ double *CERadialQkMSubTable(int k0, int k1, int k2, int k3, int k, int kp) {
   }    
   rqc[nqk] = type1;
   if (type2 != 1) rqc[nqk] = type2;
+  PublishCEQk(p, rqc);
 
 #ifdef PERFORM_STATISTICS
   stop = clock();
   timing.rad_qk += stop-start;
 #endif
   
-  return rqc;
+  return *p;
 } 	
   
 int CERadialQk(double *rqc, double te, int k0, int k1, int k2, int k3, int k) {
@@ -2424,6 +2485,61 @@ int CollisionStrength(double *qkt, double *params, double *e, double *bethe,
   }
 }
 
+/*
+** compute the collision strength of the transition ilow -> iup into
+** the record r. returns 1 if the record is to be written, 0 if the 
+** transition is forbidden or its collision strengths vanish.
+*/
+static int CollisionStrengthRecord(CE_RECORD *r, CE_HEADER *h, 
+				   int ilow, int iup, int msub, int iuta) {
+  double qkc[MAXMSUB*MAXNUSR];
+  double params[MAXMSUB*NPARAMS];
+  double e, bethe[3];
+  int k, m, ip, iempty;
+
+  if (iuta) {
+    k = CollisionStrengthUTA(qkc, params, &e, bethe, ilow, iup);
+  } else {
+    k = CollisionStrength(qkc, params, &e, bethe, ilow, iup, msub); 
+  }
+  if (k <= 0) return 0;
+  m = h->n_usr * k;
+  iempty = 1;
+  for (ip = 0; ip < m; ip++) {
+    if ((float) qkc[ip]) {
+      iempty = 0;
+      break;
+    }
+  }
+  if (iempty) return 0;
+
+  r->bethe = bethe[0];
+  r->born[0] = bethe[1];
+  r->born[1] = bethe[2];
+  r->lower = ilow;
+  r->upper = iup;
+  r->nsub = k;
+  r->strength = (float *) malloc(sizeof(float)*m);
+  for (ip = 0; ip < m; ip++) {
+    r->strength[ip] = (float) qkc[ip];
+  }
+  if (msub) {
+    m = k;
+  } else if (qk_mode == QK_FIT) {
+    m = h->nparams * k;
+  } else {
+    m = 0;
+  }
+  r->params = NULL;
+  if (m > 0) {
+    r->params = (float *) malloc(sizeof(float)*m);
+    for (ip = 0; ip < m; ip++) {
+      r->params[ip] = (float) params[ip];
+    }
+  }
+  return 1;
+}
+
 int SaveExcitation(int nlow, int *low, int nup, int *up, int msub, char *fn) {
 #ifdef PERFORM_STATISTICS
   STRUCT_TIMING structt;
@@ -2434,23 +2550,23 @@ int SaveExcitation(int nlow, int *low, int nup, int *up, int msub, char *fn) {
   SYMMETRY *sym;
   STATE *st;
   CONFIG *cfg;
-  int i, j, k, n, m, ie, ip;
+  int i, j, k, n, m, ie;
   FILE *f;
-  double qkc[MAXMSUB*MAXNUSR];
-  double params[MAXMSUB*NPARAMS];
   int *alev;
-  int nsub;
   LEVEL *lev1, *lev2;
-  CE_RECORD r;
+  CE_RECORD *r, *rb;
   CE_HEADER ce_hdr;
   F_HEADER fhdr;
   ARRAY subte;
   int isub, n_tegrid0, n_egrid0, n_usr0;
-  int te_set, e_set, usr_set, iempty, iuta;
+  int te_set, e_set, usr_set, iuta;
   double emin, emax, e, c;
   double e0, e1, te0, ei;
-  double rmin, rmax, bethe[3];
+  double rmin, rmax;
   int nc, ilow, iup;
+  int ntr, nb, t, t0, t1, next, *rs;
+  double dnu, pqa[MAXMSUB];
+  int ierr, ipqa[MAXMSUB];
 
   iuta = IsUTA();
   if (iuta && msub) {
@@ -2574,6 +2690,16 @@ int SaveExcitation(int nlow, int *low, int nup, int *up, int msub, char *fn) {
   }
   te0 = emax;
 
+  if (msub && MaxThreads() > 1) {
+    /* DXLEGF initializes its extended range constants on the first
+       call, make it before the threads start. */
+    dnu = 0.0;
+    DXLEGF(dnu, 0, 0, 0, 1.0, 3, pqa, ipqa, &ierr);
+  }
+  nb = CE_BLOCK*MaxThreads();
+  rb = (CE_RECORD *) malloc(sizeof(CE_RECORD)*nb);
+  rs = (int *) malloc(sizeof(int)*nb);
+
   e0 = emin*0.999;
   fhdr.type = DB_CE;
   strcpy(fhdr.symbol, GetAtomicSymbol());
@@ -2694,19 +2820,22 @@ int SaveExcitation(int nlow, int *low, int nup, int *up, int msub, char *fn) {
     ce_hdr.usr_egrid = usr_egrid;
 
     InitFile(f, &fhdr, &ce_hdr);  
-    nsub = 1;
-    if (msub) {
-      r.params = (float *) malloc(sizeof(float)*nsub);
-    } else if (qk_mode == QK_FIT) {
-      m = ce_hdr.nparams * nsub;
-      r.params = (float *) malloc(sizeof(float)*m);
-    }
-    m = ce_hdr.n_usr * nsub;
-    r.strength = (float *) malloc(sizeof(float)*m);
-    
-    for (i = 0; i < nlow; i++) {
-      lev1 = GetLevel(low[i]);
-      for (j = 0; j < nup; j++) {
+    /* the transitions are computed by the threads in blocks of nb.
+       a finished record waits in the reorder buffer rs until all the
+       preceding ones have been written, so that the file is the same 
+       as in a serial run. */
+    ntr = nlow*nup;
+    for (t0 = 0; t0 < ntr; t0 += nb) {
+      t1 = Min(t0+nb, ntr);
+      for (t = t0; t < t1; t++) {
+	rs[t-t0] = -1;
+      }
+      next = t0;
+#pragma omp parallel for private(t, i, j, k, e, ilow, iup, lev1, lev2) schedule(dynamic) if(fpw == NULL)
+      for (t = t0; t < t1; t++) {
+	i = t/nup;
+	j = t%nup;
+	lev1 = GetLevel(low[i]);
 	lev2 = GetLevel(up[j]);
 	e = lev2->energy - lev1->energy;	
 	ilow = low[i];
@@ -2718,56 +2847,27 @@ int SaveExcitation(int nlow, int *low, int nup, int *up, int msub, char *fn) {
 	    e = -e;
 	  }
 	}	    
-	if (e < e0 || e >= e1) continue;
-	if (iuta) {
-	  k = CollisionStrengthUTA(qkc, params, &e, bethe, ilow, iup);
+	if (e < e0 || e >= e1) {
+	  k = 0;
 	} else {
-	  k = CollisionStrength(qkc, params, &e, bethe, ilow, iup, msub); 
-	}
-	if (k < 0) continue;
-	r.bethe = bethe[0];
-	r.born[0] = bethe[1];
-	r.born[1] = bethe[2];
-	r.lower = ilow;
-	r.upper = iup;
-	r.nsub = k;
-	if (r.nsub > nsub) {
-	  r.params = (float *) realloc(r.params, sizeof(float)*r.nsub);
-	  m = ce_hdr.n_usr * r.nsub;
-	  r.strength = (float *) realloc(r.strength, sizeof(float)*m);
-	  nsub = r.nsub;
+	  k = CollisionStrengthRecord(rb+t-t0, &ce_hdr, ilow, iup, 
+				      msub, iuta);
 	}
-
-	if (msub) {
-	  for (m = 0; m < r.nsub; m++) {
-	    r.params[m] = (float) params[m];
-	  }
-	} else if (qk_mode == QK_FIT) {
-	  ip = 0;
-	  for (m = 0; m < r.nsub; m++) {
-	    for (ie = 0; ie < ce_hdr.nparams; ie++) {
-	      r.params[ip] = (float) params[ip];
-	      ip++;
+#pragma omp critical(excitation_records)
+	{
+	  rs[t-t0] = k;
+	  while (next < t1 && rs[next-t0] >= 0) {
+	    if (rs[next-t0] > 0) {
+	      r = rb + next-t0;
+	      WriteCERecord(f, r);
+	      if (r->params) free(r->params);
+	      free(r->strength);
 	    }
+	    next++;
 	  }
 	}
-      
-	ip = 0;
-	iempty = 1;
-	for (m = 0; m < r.nsub; m++) {
-	  for (ie = 0; ie < ce_hdr.n_usr; ie++) {
-	    r.strength[ip] = (float) qkc[ip];
-	    if (r.strength[ip]) iempty = 0;
-	    ip++;
-	  }
-	}
-	if (iempty == 0) {
-	  WriteCERecord(f, &r);
-	}
       }
     }
-    if (msub || qk_mode == QK_FIT) free(r.params);
-    free(r.strength);
     DeinitFile(f, &fhdr);
     e0 = e1;
     FreeExcitationQk();
@@ -2776,6 +2876,8 @@ int SaveExcitation(int nlow, int *low, int nup, int *up, int msub, char *fn) {
 
   ReinitExcitation(1);
 
+  free(rb);
+  free(rs);
   ArrayFree(&subte, NULL);
   if (alev) free(alev);
   CloseFile(f, &fhdr);
@@ -42,6 +42,8 @@
 #include <mpi.h>
 #endif
 
+#include "parallel.h"
+
 /* define constants */
 #include "consts.h"
 
@@ -91,6 +91,7 @@ static struct {
   void (*function)(int, double *, int , double *, double *, 
 		   double *, double *, int, void *);
 } minpack_params;
+#pragma omp threadprivate(minpack_params)
 
 
 void spline_work(double *x, double *y, int n, 
@@ -1079,7 +1080,8 @@ int CECross(char *ifn, char *ofn, int i0, int i1,
   FILE *f1, *f2;
   int n, swp;
   CE_HEADER h;
-  CE_RECORD r;
+  CE_RECORD *r;
+  DB_BLOCK blk;
   int i, t, m, k;
   double data[2+(1+MAXNUSR)*3], e, cs, a, ratio;
   double eth, a1, cs1, k2, rp, e1, e0, b0, b1;
@@ -1093,6 +1095,7 @@ int CECross(char *ifn, char *ofn, int i0, int i1,
     return -1;
   }
   
+  InitDBBlock(&blk);
   f2 = NULL;
   n = ReadFHeader(f1, &fh, &swp);
   if (n == 0) {
@@ -1126,19 +1129,20 @@ int CECross(char *ifn, char *ofn, int i0, int i1,
   while (1) {
     n = ReadCEHeader(f1, &h, swp);
     if (n == 0) break;
-    for (i = 0; i < h.ntransitions; i++) {
-      n = ReadCERecord(f1, &r, swp, &h);
-      if ((r.lower == i0 || i0 < 0) && (r.upper == i1 || i1 < 0)) {
-	eth = mem_en_table[r.upper].energy - mem_en_table[r.lower].energy;
+    n = ReadCEBlock(f1, &h, swp, &blk);
+    r = (CE_RECORD *) blk.r;
+    for (i = 0; i < n; i++, r++) {
+      if ((r->lower == i0 || i0 < 0) && (r->upper == i1 || i1 < 0)) {
+	eth = mem_en_table[r->upper].energy - mem_en_table[r->lower].energy;
 	e = eth*HARTREE_EV;
 	fprintf(f2, "# %5d\t%2d\t%5d\t%2d\t%11.4E\t%5d\t%d\n",
-		r.lower, mem_en_table[r.lower].j,
-		r.upper, mem_en_table[r.upper].j,
-		e, negy, r.nsub);
+		r->lower, mem_en_table[r->lower].j,
+		r->upper, mem_en_table[r->upper].j,
+		e, negy, r->nsub);
 	be = (e + bte*HARTREE_EV)/bms;	
 	PrepCECrossHeader(&h, data);
-	for (k = 0; k < r.nsub; k++) {
-	  PrepCECrossRecord(k, &r, &h, data);
+	for (k = 0; k < r->nsub; k++) {
+	  PrepCECrossRecord(k, r, &h, data);
 	  for (t = 0; t < negy; t++) {
 	    if (mp == 0) {
 	      e0 = egy[t];
@@ -1148,22 +1152,22 @@ int CECross(char *ifn, char *ofn, int i0, int i1,
 	      e0 = e1 + be;
 	    }
 	    if (e1 > 0) {
-	      cs = InterpolateCECross(e1, &r, &h, data, &ratio);
+	      cs = InterpolateCECross(e1, r, &h, data, &ratio);
 	      a = e0/HARTREE_EV;
 	      b0 = 1.0 + FINE_STRUCTURE_CONST2*a;
 	      b1 = 1.0 + FINE_STRUCTURE_CONST2*(a-eth);
 	      a = a*(1.0+0.5*FINE_STRUCTURE_CONST2*a);
 	      a = PI*AREA_AU20/(2.0*a);
-	      if (!h.msub) a /= (mem_en_table[r.lower].j+1.0);
+	      if (!h.msub) a /= (mem_en_table[r->lower].j+1.0);
 	      a *= cs;
 	      if (data[1] > 0.0) {	      
-		cs1 = data[1]*log(e0/e) + r.born[0];
+		cs1 = data[1]*log(e0/e) + r->born[0];
 		k2 = e0/HARTREE_EV;
 		k2 = 2.0*k2*(1.0+0.5*FINE_STRUCTURE_CONST2*k2);
 		a1 = FINE_STRUCTURE_CONST2*k2;
 		a1 = a1/(1.0+a1);
 		a1 = data[1]*(log(0.5*k2/eth) - a1);
-		a1 += r.born[0];
+		a1 += r->born[0];
 		a1 *= b0*b1;
 		k2 = cs1/a1;
 		a1 = e0/HARTREE_EV;
@@ -1192,16 +1196,12 @@ int CECross(char *ifn, char *ofn, int i0, int i1,
 	  fprintf(f2, "\n\n");
 	}
 	if (i0 >= 0 && i1 >= 0) {
-	  if (h.msub || h.qk_mode == QK_FIT) free(r.params);
-	  free(r.strength);
 	  free(h.tegrid);
 	  free(h.egrid);
 	  free(h.usr_egrid);
 	  goto DONE;
 	}
       }
-      if (h.msub || h.qk_mode == QK_FIT) free(r.params);
-      free(r.strength);
     }
     free(h.tegrid);
     free(h.egrid);
@@ -1210,6 +1210,7 @@ int CECross(char *ifn, char *ofn, int i0, int i1,
 
  DONE:
   fclose(f1);
+  FreeDBBlock(&blk);
 
   if (f2) {
     if (f2 != stdout) {
@@ -1439,7 +1440,8 @@ int CEMaxwell(char *ifn, char *ofn, int i0, int i1,
   FILE *f1, *f2;
   int n, swp;
   CE_HEADER h;
-  CE_RECORD r;
+  CE_RECORD *r;
+  DB_BLOCK blk;
   int i, t, m, k, p;
   double data[2+(1+MAXNUSR)*4], e, cs, a, c, ratio;
   double *xg = gauss_xw[0];  
@@ -1453,6 +1455,7 @@ int CEMaxwell(char *ifn, char *ofn, int i0, int i1,
     return -1;
   }
    
+  InitDBBlock(&blk);
   f2 = NULL;
   n = ReadFHeader(f1, &fh, &swp);
   if (n == 0) {
@@ -1485,44 +1488,41 @@ int CEMaxwell(char *ifn, char *ofn, int i0, int i1,
   while (1) {
     n = ReadCEHeader(f1, &h, swp);
     if (n == 0) break;
-    for (i = 0; i < h.ntransitions; i++) {
-      n = ReadCERecord(f1, &r, swp, &h);
-      if ((r.lower == i0 || i0 < 0) && (r.upper == i1 || i1 < 0)) {
-	e = mem_en_table[r.upper].energy - mem_en_table[r.lower].energy;
+    n = ReadCEBlock(f1, &h, swp, &blk);
+    r = (CE_RECORD *) blk.r;
+    for (i = 0; i < n; i++, r++) {
+      if ((r->lower == i0 || i0 < 0) && (r->upper == i1 || i1 < 0)) {
+	e = mem_en_table[r->upper].energy - mem_en_table[r->lower].energy;
 	e *= HARTREE_EV;
 	fprintf(f2, "# %5d\t%2d\t%5d\t%2d\t%11.4E\t%5d\t%d\n",
-		r.lower, mem_en_table[r.lower].j,
-		r.upper, mem_en_table[r.upper].j,
-		e, nt, r.nsub);
+		r->lower, mem_en_table[r->lower].j,
+		r->upper, mem_en_table[r->upper].j,
+		e, nt, r->nsub);
 	PrepCECrossHeader(&h, data);
-	for (k = 0; k < r.nsub; k++) {
-	  PrepCECrossRecord(k, &r, &h, data);
+	for (k = 0; k < r->nsub; k++) {
+	  PrepCECrossRecord(k, r, &h, data);
 	  for (t = 0; t < nt; t++) {
 	    cs = 0.0;
 	    for (p = 0; p < 15; p++) {
 	      a = temp[t]*xg[p];
-	      c = InterpolateCECross(a, &r, &h, data, &ratio);
+	      c = InterpolateCECross(a, r, &h, data, &ratio);
 	      cs += wg[p]*c;
 	    }
 	    a = 217.16*sqrt(HARTREE_EV/(2.0*temp[t]));
 	    a *= cs*exp(-e/temp[t]);
-	    if (!h.msub) a /= (mem_en_table[r.lower].j+1.0);
+	    if (!h.msub) a /= (mem_en_table[r->lower].j+1.0);
 	    fprintf(f2, "%11.4E\t%11.4E\t%11.4E\n", 
 		    temp[t], cs, a);
 	  }
 	  fprintf(f2, "\n\n");
 	}
 	if (i0 >= 0 && i1 >= 0) {
-	  if (h.msub || h.qk_mode == QK_FIT) free(r.params);
-	  free(r.strength);
 	  free(h.tegrid);
 	  free(h.egrid);
 	  free(h.usr_egrid);
 	  goto DONE;
 	}
       }
-      if (h.msub || h.qk_mode == QK_FIT) free(r.params);
-      free(r.strength);
     }
     free(h.tegrid);
     free(h.egrid);
@@ -1531,6 +1531,7 @@ int CEMaxwell(char *ifn, char *ofn, int i0, int i1,
 
  DONE:
   fclose(f1);
+  FreeDBBlock(&blk);
 
   if (f2) {
     if (f2 != stdout) {
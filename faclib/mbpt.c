@@ -3400,6 +3400,7 @@ int StructureMBPT1(char *fn, char *fn1, int nkg, int *kg, int nk, int *nkm,
 	printf("%3d %3d %3d %3d %3d %3d ... %12.5E %12.5E\n", 
 	       k0, k1, nc, mst, n0, n1, dt, dtt);
 	fflush(stdout);
+	TickRadialCheckpoint();
 	
 	free(bra);
 	free(ket);
@@ -3611,6 +3612,7 @@ int StructureMBPT1(char *fn, char *fn1, int nkg, int *kg, int nk, int *nkm,
 	printf("%3d %3d %3d %3d %3d %3d ... %12.5E %12.5E\n", 
 	       k0, k1, nc, mst, n0, n1, dt, dtt);
 	fflush(stdout);
+	TickRadialCheckpoint();
 	
 	free(bra);
 	free(ket);
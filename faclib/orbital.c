@@ -31,6 +31,13 @@ static double ABAND[4*MAXRP];
 static double _dwork[MAXRP];
 static double _dwork1[MAXRP];
 static double _dwork2[MAXRP];
+/* the relativistic correction of the potential for the orbital being 
+   solved, set by SetPotentialW. */
+static double _w[MAXRP];
+static double _dw[MAXRP];
+static double _dw2[MAXRP];
+#pragma omp threadprivate(_veff, ABAND, _dwork, _dwork1, _dwork2)
+#pragma omp threadprivate(_w, _dw, _dw2)
  
 static int max_iteration = 512;
 static int nmax = 0;
@@ -1249,6 +1256,8 @@ int RadialRydberg(ORBITAL *orb, POTENTIAL *pot) {
       zp = FINE_STRUCTURE_CONST2*e;
       x0 = pot->rad[i2];
       ierr = 1;
+      /* DCOUL passes intermediates through common blocks */
+#pragma omp critical(coul_dcoul)
       DCOUL(z, e, orb->kappa, x0, &pp, &qq, &ppi, &qqi, &ierr);
       p1 = (qq/pp)*2.0*x0/FINE_STRUCTURE_CONST - orb->kappa;
       qi = DpDr(orb->kappa, i2, e, pot, p1);
@@ -1277,6 +1286,8 @@ int RadialRydberg(ORBITAL *orb, POTENTIAL *pot) {
     zp = FINE_STRUCTURE_CONST2*e;
     x0 = pot->rad[i2];
     ierr = 1;
+    /* DCOUL passes intermediates through common blocks */
+#pragma omp critical(coul_dcoul)
     DCOUL(z, e, orb->kappa, x0, &pp, &qq, &ppi, &qqi, &ierr);
     norm2 = pp;
     fact = norm2/p[i2];
@@ -1628,41 +1639,46 @@ double Amplitude(double *p, double e, int ka, POTENTIAL *pot, int i0) {
   iopt = 0;
   mf = 10;
 
-  i--;
-  for (; i >= 0; i--) {
-    r = _dwork[i];
-    y[2] = r0;
-    y[3] = _dwork1[i+1]*r0;
-    y[4] = (_dwork1[i]*r - y[3])/(r - r0);
-    y[5] = e;
-    while (r0 != r) {
-      LSODE(C_FUNCTION(DERIVODE, derivode), neq, y, &r0, r, itol, rtol, atol, 
-	    itask, &istate, iopt, rwork, lrw, iwork, liw, NULL, mf);
-      if (istate == -1) istate = 2;
-      else if (istate < 0) {
-	printf("LSODE Error %d\n", istate);
-	exit(1);
+  /* LSODE keeps its state in the common block ls0001, so the 
+     integration is serialized among the threads. */
+#pragma omp critical(ode_lsode)
+  {
+    i--;
+    for (; i >= 0; i--) {
+      r = _dwork[i];
+      y[2] = r0;
+      y[3] = _dwork1[i+1]*r0;
+      y[4] = (_dwork1[i]*r - y[3])/(r - r0);
+      y[5] = e;
+      while (r0 != r) {
+	LSODE(C_FUNCTION(DERIVODE, derivode), neq, y, &r0, r, itol, rtol, atol, 
+	      itask, &istate, iopt, rwork, lrw, iwork, liw, NULL, mf);
+	if (istate == -1) istate = 2;
+	else if (istate < 0) {
+	  printf("LSODE Error %d\n", istate);
+	  exit(1);
+	}
       }
     }
-  }
 
-  p[n] = y[0];
-  for (i = n-1; i >= i0; i--) {
-    r = pot->rad[i];
-    y[2] = r0;
-    y[3] = _veff[i+1]*r0;
-    y[4] = (_veff[i]*r - y[3])/(r - r0);
-    y[5] = e;
-    while (r0 != r) {
-      LSODE(C_FUNCTION(DERIVODE, derivode), neq, y, &r0, r, itol, rtol, atol,
-	    itask, &istate, iopt, rwork, lrw, iwork, liw, NULL, mf);
-      if (istate == -1) istate = 2;
-      else if (istate < 0) {
-	printf("LSODE Error %d\n", istate);
-	exit(1);
+    p[n] = y[0];
+    for (i = n-1; i >= i0; i--) {
+      r = pot->rad[i];
+      y[2] = r0;
+      y[3] = _veff[i+1]*r0;
+      y[4] = (_veff[i]*r - y[3])/(r - r0);
+      y[5] = e;
+      while (r0 != r) {
+	LSODE(C_FUNCTION(DERIVODE, derivode), neq, y, &r0, r, itol, rtol, atol,
+	      itask, &istate, iopt, rwork, lrw, iwork, liw, NULL, mf);
+	if (istate == -1) istate = 2;
+	else if (istate < 0) {
+	  printf("LSODE Error %d\n", istate);
+	  exit(1);
+	}
       }
+      p[i] = y[0];
     }
-    p[i] = y[0];
   }
 
   return y[1];
@@ -1699,7 +1715,7 @@ int SetVEffective(int kl, POTENTIAL *pot) {
     r = pot->rad[i];
     r *= r;
     _veff[i] = pot->Vc[i] + pot->U[i] + kl1/r;
-    _veff[i] += pot->W[i];
+    _veff[i] += _w[i];
   }
 
   return 0;
@@ -2073,6 +2089,11 @@ int SetPotentialU(POTENTIAL *pot, int n, double *u) {
   return 0;
 }
 
+/* 
+** the correction depends on the energy and kappa of the orbital, it is
+** kept in the thread private _w, _dw and _dw2 rather than in pot, so 
+** that several threads may solve orbitals in the same potential.
+*/
 int SetPotentialW (POTENTIAL *pot, double e, int kappa) {
   int i;
   double xi, r, x, y, z;
@@ -2085,21 +2106,21 @@ int SetPotentialW (POTENTIAL *pot, double e, int kappa) {
     y = - 2.0*kappa*x/pot->rad[i];
     x = x*x*0.75*FINE_STRUCTURE_CONST2/r;
     z = (pot->dU2[i] + pot->dVc2[i]);
-    pot->W[i] = x + y + z;
-    pot->W[i] /= 4.0*r;
+    _w[i] = x + y + z;
+    _w[i] /= 4.0*r;
     x = xi*xi;
-    pot->W[i] = x - pot->W[i];
-    pot->W[i] *= 0.5*FINE_STRUCTURE_CONST2;
-    pot->W[i] = -pot->W[i];
+    _w[i] = x - _w[i];
+    _w[i] *= 0.5*FINE_STRUCTURE_CONST2;
+    _w[i] = -_w[i];
   }
 
-  Differential(pot->W, pot->dW, 0, pot->maxrp-1);
+  Differential(_w, _dw, 0, pot->maxrp-1);
   for (i = 0; i < pot->maxrp; i++) {
-    pot->dW[i] = pot->dr_drho[i];
+    _dw[i] = pot->dr_drho[i];
   }
-  Differential(pot->dW, pot->dW2, 0, pot->maxrp-1);
+  Differential(_dw, _dw2, 0, pot->maxrp-1);
   for (i = 0; i < pot->maxrp; i++) {
-    pot->dW2[i] = pot->dr_drho[i];
+    _dw2[i] = pot->dr_drho[i];
   }
   return 0;
 }
@@ -0,0 +1,95 @@
+/*
+ *   FAC - Flexible Atomic Code
+ *   Copyright (C) 2001-2015 Ming Feng Gu
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_ 1
+
+/*************************************************************
+  Header of module "parallel"
+
+  Thin wrappers around the OpenMP runtime. When the library
+  is not compiled with OpenMP, the locks are no-ops and
+  there is only one thread.
+
+**************************************************************/
+
+#ifdef _OPENMP
+#include <omp.h>
+
+/*
+** STRUCT:      LOCK
+** PURPOSE:     a mutual exclusion lock.
+** FIELDS:
+** NOTE:        an omp_lock_t with OpenMP, a dummy int otherwise.
+*/
+typedef omp_lock_t LOCK;
+
+/*
+** MACRO:       InitLock, DestroyLock, SetLock, ReleaseLock
+** PURPOSE:     initialize, destroy, acquire and release a LOCK.
+** INPUT:       {LOCK *x},
+**              pointer to the lock.
+** RETURN:
+** SIDE EFFECT:
+** NOTE:
+*/
+#define InitLock(x)    omp_init_lock(x)
+#define DestroyLock(x) omp_destroy_lock(x)
+#define SetLock(x)     omp_set_lock(x)
+#define ReleaseLock(x) omp_unset_lock(x)
+
+/*
+** MACRO:       MyThread, MaxThreads, InParallel
+** PURPOSE:     id of the calling thread, number of threads
+**              available to a parallel region, and whether
+**              the caller is inside an active parallel region.
+** INPUT:
+** RETURN:      {int}
+** SIDE EFFECT:
+** NOTE:
+*/
+#define MyThread()     omp_get_thread_num()
+#define MaxThreads()   omp_get_max_threads()
+#define InParallel()   omp_in_parallel()
+
+/*
+** MACRO:       SetMaxThreads
+** PURPOSE:     set the number of threads used by parallel regions.
+** INPUT:       {int n},
+**              number of threads.
+** RETURN:
+** SIDE EFFECT:
+** NOTE:        without OpenMP, it does nothing.
+*/
+#define SetMaxThreads(n) omp_set_num_threads(n)
+
+#else
+
+typedef int LOCK;
+#define InitLock(x)    ((void)(x))
+#define DestroyLock(x) ((void)(x))
+#define SetLock(x)     ((void)(x))
+#define ReleaseLock(x) ((void)(x))
+#define MyThread()     0
+#define MaxThreads()   1
+#define InParallel()   0
+#define SetMaxThreads(n) ((void)(n))
+
+#endif /* _OPENMP */
+
+#endif
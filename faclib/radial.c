@@ -51,6 +51,12 @@ static double _dphasep[MAXRP];
 static double _yk[MAXRP];
 static double _zk[MAXRP];
 static double _xk[MAXRP];
+/* every thread works in its own copy of the scratch arrays, so that
+   Slater, GetYk and Integrate may be called from parallel regions. */
+#pragma omp threadprivate(_dwork, _dwork1, _dwork2, _dwork3, _dwork4)
+#pragma omp threadprivate(_dwork5, _dwork6, _dwork7, _dwork8, _dwork9)
+#pragma omp threadprivate(_dwork10, _dwork11, _phase, _dphase, _dphasep)
+#pragma omp threadprivate(_yk, _zk, _xk)
 
 static struct {
   double stabilizer;
@@ -93,7 +99,35 @@ static MULTI *yk_array;
 static int n_awgrid = 0;
 static double awgrid[MAXNTE];
 
+/*
+** the checkpoint of the slater, breit, vinti and qed1e integrals
+** between bound orbitals. the integrals are moved to the arrays of
+** the checkpoint whenever the radial arrays are cleared, and looked
+** up there before they are computed again.
+*/
+static struct {
+  int active;
+  unsigned int fp[2];
+  double dt;
+  time_t last;
+  char fn[1024];
+  MULTI *array[4];
+} checkpoint;
+
+/* the integral of index in the checkpoint array m, 0 if not there. */
+static double CheckpointValue(int m, int *index) {
+  double *q;
+
+  if (!checkpoint.active) return 0.0;
+  q = (double *) MultiGet(checkpoint.array[m], index);
+  if (q) return *q;
+  return 0.0;
+}
+
+static void CloseRadialCheckpoint(void);
+
 static double PhaseRDependent(double x, double eta, double b);
+static int OrbitalIndexSerial(int n, int kappa, double energy);
 
 #ifdef PERFORM_STATISTICS
 static RAD_TIMING rad_timing = {0, 0, 0, 0};
@@ -123,6 +157,21 @@ static void InitYkData(void *p, int n) {
   for (i = 0; i < n; i++) {
     d[i].npts = -1;
     d[i].yk = NULL;
+    d[i].yk0 = NULL;
+  }
+}
+
+/* store the array y computed for a cache element p, unless another
+   thread has done so meanwhile, in which case y is discarded. */
+static void PublishRadialCache(double **p, double *y) {
+#pragma omp critical(radial_cache)
+  {
+    if (*p == NULL) {
+#pragma omp flush
+      *p = y;
+    } else {
+      free(y);
+    }
   }
 }
 
@@ -150,7 +199,10 @@ static void FreeYkData(void *p) {
   SLATER_YK *dp;
   
   dp = (SLATER_YK *) p;
-  if (dp->npts > 0) free(dp->yk);
+  if (dp->npts > 0) {
+    if (dp->yk) free(dp->yk);
+    if (dp->yk0) free(dp->yk0);
+  }
 }
 
 int FreeMultipoleArray(void) {
@@ -198,6 +250,11 @@ void SetSlaterCut(int k0, int k1) {
   }
 }
 
+void GetSlaterCut(int *k0, int *k1) {
+  *k0 = slater_cut.kl0/2;
+  *k1 = slater_cut.kl1/2;
+}
+
 void SetPotentialMode(int m, double h) {
   potential->mode = m;
   if (h > 1e10) {
@@ -950,7 +1007,8 @@ int SolveDirac(ORBITAL *orb) {
 #endif
 
   err = 0;  
-  potential->flag = -1;
+  /* the potential is shared by all threads, only touch it if needed */
+  if (potential->flag != -1) potential->flag = -1;
   err = RadialSolver(orb, potential);
   if (err) { 
     printf("Error ocuured in RadialSolver, %d\n", err);
@@ -1104,7 +1162,18 @@ int GetNumContinua(void) {
 }
 
 int OrbitalIndex(int n, int kappa, double energy) {
-  int i, j;
+  int i;
+
+  /* the orbital table may grow here, serialize the lookup and the
+     insert. the orbital is solved outside, in GetOrbitalSolved. */
+#pragma omp critical(radial_orbitals)
+  i = OrbitalIndexSerial(n, kappa, energy);
+  GetOrbitalSolved(i);
+  return i;
+}
+
+static int OrbitalIndexSerial(int n, int kappa, double energy) {
+  int i;
   ORBITAL *orb;
   int resolve_dirac;
 
@@ -1144,11 +1213,6 @@ int OrbitalIndex(int n, int kappa, double energy) {
   orb->n = n;
   orb->kappa = kappa;
   orb->energy = energy;
-  j = SolveDirac(orb);
-  if (j < 0) {
-    printf("Error occured in solving Dirac eq. err = %d\n", j);
-    exit(1);
-  }
   
   if (n == 0 && !resolve_dirac) {
     n_continua++;
@@ -1194,16 +1258,35 @@ ORBITAL *GetOrbital(int k) {
 }
 
 ORBITAL *GetOrbitalSolved(int k) {
-  ORBITAL *orb;
+  ORBITAL *orb, tmp;
+  double *wfun;
   int i;
   
   orb = (ORBITAL *) ArrayGet(orbitals, k);
   if (orb->wfun == NULL) {
-    i = SolveDirac(orb);
+    /* solve into a copy outside the lock, and publish the wave function
+       only when complete, other threads test orb->wfun without locking.
+       if another thread has published it meanwhile, the copy is 
+       discarded. */
+#pragma omp critical(radial_orbitals)
+    tmp = *orb;
+    i = SolveDirac(&tmp);
     if (i < 0) {
       printf("Error occured in solving Dirac eq. err = %d\n", i);
       exit(1);
     }
+#pragma omp critical(radial_orbitals)
+    {
+      if (orb->wfun == NULL) {
+	wfun = tmp.wfun;
+	tmp.wfun = NULL;
+	*orb = tmp;
+#pragma omp flush
+	orb->wfun = wfun;
+      } else {
+	free(tmp.wfun);
+      }
+    }
   }
   return orb;
 }
@@ -1237,6 +1320,7 @@ int ClearOrbitalTable(int m) {
   int i;
 
   if (m == 0) {
+    CloseRadialCheckpoint();
     n_orbitals = 0;
     n_continua = 0;
     ArrayFree(orbitals, FreeOrbitalData);
@@ -2231,6 +2315,8 @@ int ResidualPotential(double *s, int k0, int k1) {
   if (k0 > k1) {
     index[0] = k1;
     index[1] = k0;
+    orb1 = orb2;
+    orb2 = GetOrbital(k0);
   } else {
     index[0] = k0;
     index[1] = k1;
@@ -2306,11 +2392,79 @@ double MeanPotential(int k0, int k1) {
   return z;
 }
 
+/*
+** the tables of r^k on the radial grid, for 0 <= k < RKTABLE_MAX.
+** they are built on first use, and rebuilt when the grid changes,
+** which is detected by the number of points, the end points and
+** the mapping parameters of the grid.
+*/
+#define RKTABLE_MAX 64
+static struct {
+  int maxrp;
+  double r0, r1, ar, br;
+  double *p[RKTABLE_MAX];
+} rk_table;
+
+/*
+** r^k on the radial grid. it is the cached table if k is in range,
+** otherwise it is computed into w. the result must not be modified.
+*/
+static double *RadialPower(int k, double *w) {
+  int i, n, c;
+  double *p;
+
+  n = potential->maxrp;
+  c = (k >= 0 && k < RKTABLE_MAX);
+  if (rk_table.maxrp != n ||
+      rk_table.r0 != potential->rad[0] ||
+      rk_table.r1 != potential->rad[n-1] ||
+      rk_table.ar != potential->ar ||
+      rk_table.br != potential->br) {
+    if (InParallel()) c = 0;
+    else {
+      for (i = 0; i < RKTABLE_MAX; i++) {
+	if (rk_table.p[i]) {
+	  free(rk_table.p[i]);
+	  rk_table.p[i] = NULL;
+	}
+      }
+      rk_table.maxrp = n;
+      rk_table.r0 = potential->rad[0];
+      rk_table.r1 = potential->rad[n-1];
+      rk_table.ar = potential->ar;
+      rk_table.br = potential->br;
+    }
+  }
+  if (!c) {
+    for (i = 0; i < n; i++) {
+      w[i] = pow(potential->rad[i], k);
+    }
+    return w;
+  }
+  if (rk_table.p[k]) return rk_table.p[k];
+
+  p = (double *) malloc(sizeof(double)*n);
+  for (i = 0; i < n; i++) {
+    p[i] = pow(potential->rad[i], k);
+  }
+#pragma omp critical(radial_rktable)
+  {
+    if (rk_table.p[k] == NULL) {
+#pragma omp flush
+      rk_table.p[k] = p;
+      p = NULL;
+    }
+  }
+  if (p) free(p);
+
+  return rk_table.p[k];
+}
+
 double RadialMoments(int m, int k1, int k2) {
   int index[3];
   int npts, i0, i;
   ORBITAL *orb1, *orb2;
-  double *q, r, z, *p1, *p2, *q1, *q2;
+  double *q, r, z, *p1, *p2, *q1, *q2, *rk;
   int n1, n2;
   int kl1, kl2;
   int nh, klh;
@@ -2386,11 +2540,12 @@ double RadialMoments(int m, int k1, int k2) {
     q1 = Small(orb1);
     p2 = Large(orb2);
     q2 = Small(orb2);
+    rk = RadialPower(m, _dwork2);
     for (i = i0; i <= npts; i++) {
       r = p1[i]*p2[i] + q1[i]*q2[i];
       r *= potential->dr_drho[i];
       _yk[i] = r;
-      if (m != 0) _yk[i] *= pow(potential->rad[i], m);
+      if (m != 0) _yk[i] *= rk[i];
     }
     r = Simpson(_yk, i0, npts);
     *q = r;
@@ -2398,17 +2553,9 @@ double RadialMoments(int m, int k1, int k2) {
     npts = potential->maxrp-1;
     if (n1 != 0) npts = Min(npts, orb1->ilast);
     if (n2 != 0) npts = Min(npts, orb2->ilast);
-    if (m == 0) {
-      for (i = 0; i <= npts; i++) {
-	_yk[i] = 1.0;
-      }
-    } else {
-      for (i = 0; i <= npts; i++) {
-	_yk[i] = pow(potential->rad[i], m);
-      }
-    }
+    rk = RadialPower(m, _yk);
     r = 0.0;
-    Integrate(_yk, orb1, orb2, 1, &r, m);
+    Integrate(rk, orb1, orb2, 1, &r, m);
     *q = r;
   }
   return r;
@@ -2475,7 +2622,7 @@ int MultipoleRadialFRGrid(double **p0, int m, int k1, int k2, int gauge) {
   int am, t;
   int index[4], s;
   ORBITAL *orb1, *orb2, *orb;
-  double x, a, r, rp, ef, **p1;
+  double x, a, r, rp, ef, **p1, *y;
   int jy, n, i, j, npts;
   double rcl;
 
@@ -2518,7 +2665,7 @@ int MultipoleRadialFRGrid(double **p0, int m, int k1, int k2, int gauge) {
     ef = 0.0;
   }
 
-  *p1 = (double *) malloc(sizeof(double)*n_awgrid);
+  y = (double *) malloc(sizeof(double)*n_awgrid);
   
   npts = potential->maxrp-1;
   if (orb1->n > 0) npts = Min(npts, orb1->ilast);
@@ -2529,7 +2676,7 @@ int MultipoleRadialFRGrid(double **p0, int m, int k1, int k2, int gauge) {
   for (i = 0; i < n_awgrid; i++) {
     r = 0.0;
     a = awgrid[i];
-    (*p1)[i] = 0.0;
+    y[i] = 0.0;
     if (ef > 0.0) a += ef;
     if (m > 0) {
       t = kappa1 + kappa2;
@@ -2543,7 +2690,7 @@ int MultipoleRadialFRGrid(double **p0, int m, int k1, int k2, int gauge) {
 	r *= t;
 	r *= (2*m + 1.0)/sqrt(m*(m+1.0));
 	r /= pow(a, m);
-	(*p1)[i] = r*rcl;
+	y[i] = r*rcl;
       }
     } else {
       if (gauge == G_COULOMB) {
@@ -2570,7 +2717,7 @@ int MultipoleRadialFRGrid(double **p0, int m, int k1, int k2, int gauge) {
 	}
 	r += rp;
 	if (am > 1) r /= pow(a, am-1);
-	(*p1)[i] = r*rcl;
+	y[i] = r*rcl;
       } else if (gauge == G_BABUSHKIN) {
 	t = kappa1 - kappa2;
 	for (j = 0; j < npts; j++) {
@@ -2595,12 +2742,14 @@ int MultipoleRadialFRGrid(double **p0, int m, int k1, int k2, int gauge) {
 	q /= pow(a, am);
 	r *= q;
 	rp *= q;
-	(*p1)[i] = (r+rp)*rcl;
+	y[i] = (r+rp)*rcl;
       }
     }
   }
 
 
+  PublishRadialCache(p1, y);
+
 #ifdef PERFORM_STATISTICS 
   stop = clock();
   rad_timing.radial_1e += stop - start;
@@ -2652,7 +2801,7 @@ double MultipoleRadialFR0(double aw, int m, int k1, int k2, int gauge) {
   int am, t;
   int index[4];
   ORBITAL *orb1, *orb2, *orb;
-  double x, a, r, rp, **p1, ef;
+  double x, a, r, rp, **p1, ef, *y;
   int jy, n, i, j, npts;
   double rcl;
 
@@ -2707,7 +2856,7 @@ double MultipoleRadialFR0(double aw, int m, int k1, int k2, int gauge) {
     r *= rcl;
     return r;
   }  
-  *p1 = (double *) malloc(sizeof(double)*n_awgrid);
+  y = (double *) malloc(sizeof(double)*n_awgrid);
   
   npts = potential->maxrp-1;
   if (orb1->n > 0) npts = Min(npts, orb1->ilast);
@@ -2718,7 +2867,7 @@ double MultipoleRadialFR0(double aw, int m, int k1, int k2, int gauge) {
   for (i = 0; i < n_awgrid; i++) {
     r = 0.0;
     a = awgrid[i];
-    (*p1)[i] = 0.0;
+    y[i] = 0.0;
     if (ef > 0.0) a += ef;
     if (m > 0) {
       t = kappa1 + kappa2;
@@ -2732,7 +2881,7 @@ double MultipoleRadialFR0(double aw, int m, int k1, int k2, int gauge) {
 	r *= t;
 	r *= (2*m + 1.0)/sqrt(m*(m+1.0));
 	r /= pow(a, m);
-	(*p1)[i] = r;
+	y[i] = r;
       }
     } else {
       if (gauge == G_COULOMB) {
@@ -2759,7 +2908,7 @@ double MultipoleRadialFR0(double aw, int m, int k1, int k2, int gauge) {
 	}
 	r += rp;
 	if (am > 1) r /= pow(a, am-1);
-	(*p1)[i] = r;
+	y[i] = r;
       } else if (gauge == G_BABUSHKIN) {
 	t = kappa1 - kappa2;
 	for (j = 0; j < npts; j++) {
@@ -2784,11 +2933,12 @@ double MultipoleRadialFR0(double aw, int m, int k1, int k2, int gauge) {
 	q /= pow(a, am);
 	r *= q;
 	rp *= q;
-	(*p1)[i] = r+rp;
+	y[i] = r+rp;
       }
     }
   }
 
+  PublishRadialCache(p1, y);
   r = InterpolateMultipole(aw, n_awgrid, awgrid, *p1);
   if (gauge == G_COULOMB && m < 0) r /= aw;
   r *= rcl;
@@ -2806,7 +2956,7 @@ double *GeneralizedMoments(int k1, int k2, int m) {
   double x, r, r0;
   double *p1, *p2, *q1, *q2;
   int index[3], t;
-  double **p, k, *kg;
+  double **p, k, *kg, *y;
   double amin, amax, kmin, kmax;
   
   index[0] = m;
@@ -2829,14 +2979,15 @@ double *GeneralizedMoments(int k1, int k2, int m) {
   }
 
   nk = NGOSK;
-  *p = (double *) malloc(sizeof(double)*nk*2);
-  kg = *p + nk;
+  y = (double *) malloc(sizeof(double)*nk*2);
+  kg = y + nk;
 
   if (orb1->wfun == NULL || orb2->wfun == NULL || 
       (orb1->n <= 0 && orb2->n <= 0)) {
     for (t = 0; t < nk*2; t++) {
-      (*p)[t] = 0.0;
+      y[t] = 0.0;
     }
+    PublishRadialCache(p, y);
     return *p;
   }
   
@@ -2892,7 +3043,7 @@ double *GeneralizedMoments(int k1, int k2, int m) {
       }
       r = Simpson(_dphase, 0, n1);
       
-      (*p)[t] = (r - r0)/k;
+      y[t] = (r - r0)/k;
     }
   } else {
     if (orb1->n > 0) n1 = orb1->ilast;
@@ -2904,9 +3055,10 @@ double *GeneralizedMoments(int k1, int k2, int m) {
 	_yk[i] = BESLJN(jy, m, x);
       }
       Integrate(_yk, orb1, orb2, 1, &r, 0);
-      (*p)[t] = r/k;
+      y[t] = r/k;
     }
   }
+  PublishRadialCache(p, y);
   return *p;
 }
 
@@ -3180,6 +3332,8 @@ double QED1E(int k0, int k1) {
   if (k0 > k1) {
     index[0] = k1;
     index[1] = k0;
+    orb1 = orb2;
+    orb2 = GetOrbital(k0);
   } else {
     index[0] = k0;
     index[1] = k1;
@@ -3189,6 +3343,11 @@ double QED1E(int k0, int k1) {
   if (p && *p) {
     return *p;
   }
+  r = CheckpointValue(3, index);
+  if (r) {
+    *p = r;
+    return r;
+  }
 
   r = 0.0;
   
@@ -3256,6 +3415,11 @@ double Vinti(int k0, int k1) {
   if (p && *p) {
     return *p;
   }
+  r = CheckpointValue(2, index);
+  if (r) {
+    *p = r;
+    return r;
+  }
 
   ka0 = orb1->kappa;
   ka1 = orb2->kappa;
@@ -3371,7 +3535,7 @@ double BreitC(int n, int m, int k, int k0, int k1, int k2, int k3) {
 double BreitS(int k0, int k1, int k2, int k3, int k) {
   ORBITAL *orb0, *orb1, *orb2, *orb3;
   int index[5], i;
-  double *p, r;
+  double *p, r, *rk;
   
   index[0] = k0;
   index[1] = k1;
@@ -3382,6 +3546,8 @@ double BreitS(int k0, int k1, int k2, int k3, int k) {
   p = (double *) MultiSet(breit_array, index, NULL, InitDoubleData, NULL);
   if (p && *p) {
     r = *p;
+  } else if ((r = CheckpointValue(1, index)) != 0) {
+    *p = r;
   } else {
     orb0 = GetOrbitalSolved(k0);
     orb1 = GetOrbitalSolved(k1);
@@ -3389,14 +3555,11 @@ double BreitS(int k0, int k1, int k2, int k3, int k) {
     orb3 = GetOrbitalSolved(k3);
     if (!orb0 || !orb1 || !orb2 || !orb3) return 0.0;
     
-    for (i = 0; i < potential->maxrp; i++) {
-      _dwork1[i] = pow(potential->rad[i], k);
-    }
-    
-    Integrate(_dwork1, orb0, orb1, -6, _zk, 0);
+    rk = RadialPower(k, _dwork1);
+    Integrate(rk, orb0, orb1, -6, _zk, 0);
     
     for (i = 0; i < potential->maxrp; i++) {
-      _zk[i] /= _dwork1[i]*potential->rad[i];
+      _zk[i] /= rk[i]*potential->rad[i];
     }
 
     Integrate(_zk, orb2, orb3, 6, &r, 0);
@@ -3483,11 +3646,19 @@ int Slater(double *s, int k0, int k1, int k2, int k3, int k, int mode) {
   if (abs(mode) < 2) {
     SortSlaterKey(index);
     p = (double *) MultiSet(slater_array, index, NULL, InitDoubleData, NULL);
+    /* evaluate in the sorted order, so that the cached value does not
+       depend on which permutation was asked for first. */
+    k0 = index[0];
+    k1 = index[1];
+    k2 = index[2];
+    k3 = index[3];
   } else {
     p = NULL;
   }
   if (p && *p) {
     *s = *p;
+  } else if (p && (*s = CheckpointValue(0, index)) != 0) {
+    *p = *s;
   } else {
     orb0 = GetOrbitalSolved(k0);
     orb1 = GetOrbitalSolved(k1);
@@ -3560,32 +3731,143 @@ int Slater(double *s, int k0, int k1, int k2, int k3, int k, int mode) {
 }
 
 
+/*
+** the slater integrals R^k(k0 k1[i], k2 k3[i]) for i < n, which all
+** share the yk potential of the pair k0, k2. the potential is built
+** once, and each integral is one integration against it. the
+** results are stored in slater_array, and in s[i] if s is not NULL.
+** the pairs whose sorted key does not have k0, k2 as its yk pair,
+** and the separable modes, are evaluated by Slater.
+*/
+int SlaterBatch(double *s, int k0, int k2, int k, int n,
+		int *k1, int *k3, int mode) {
+  int index[5], i, m, *miss;
+  double *p, r, norm;
+  ORBITAL *orb0, *orb1, *orb2, *orb3;
+
+  if (abs(mode) >= 2) {
+    for (i = 0; i < n; i++) {
+      Slater(&r, k0, k1[i], k2, k3[i], k, mode);
+      if (s) s[i] = r;
+    }
+    return 0;
+  }
+
+  orb0 = GetOrbitalSolved(k0);
+  orb2 = GetOrbitalSolved(k2);
+  miss = (int *) malloc(sizeof(int)*n);
+  m = 0;
+  for (i = 0; i < n; i++) {
+    index[0] = k0;
+    index[1] = k1[i];
+    index[2] = k2;
+    index[3] = k3[i];
+    index[4] = k;
+    SortSlaterKey(index);
+    p = (double *) MultiSet(slater_array, index, NULL, InitDoubleData, NULL);
+    if (*p) {
+      r = *p;
+    } else if ((r = CheckpointValue(0, index)) != 0) {
+      *p = r;
+    } else if (orb0 && orb2 &&
+	       ((index[0] == k0 && index[2] == k2) ||
+		(index[0] == k2 && index[2] == k0))) {
+      orb1 = GetOrbitalSolved(index[1]);
+      orb3 = GetOrbitalSolved(index[3]);
+      r = 0.0;
+      if (orb1 && orb3) {
+	miss[m++] = i;
+	continue;
+      }
+    } else {
+      Slater(&r, k0, k1[i], k2, k3[i], k, mode);
+    }
+    if (s) s[i] = r;
+  }
+
+  if (m > 0) {
+    GetYk(k, _yk, orb0, orb2, k0, k2, (mode < 0)?-2:-1);
+    for (i = 0; i < potential->maxrp; i++) {
+      _yk[i] /= potential->rad[i];
+    }
+  }
+  for (i = 0; i < m; i++) {
+    index[0] = k0;
+    index[1] = k1[miss[i]];
+    index[2] = k2;
+    index[3] = k3[miss[i]];
+    index[4] = k;
+    SortSlaterKey(index);
+    orb1 = GetOrbital(index[1]);
+    orb3 = GetOrbital(index[3]);
+    if (mode < 0) {
+      Integrate(_yk, orb1, orb3, 2, &r, 0);
+      norm  = GetOrbital(index[0])->qr_norm;
+      norm *= orb1->qr_norm;
+      norm *= GetOrbital(index[2])->qr_norm;
+      norm *= orb3->qr_norm;
+      r *= norm;
+    } else {
+      Integrate(_yk, orb1, orb3, 1, &r, 0);
+    }
+    p = (double *) MultiSet(slater_array, index, NULL, InitDoubleData, NULL);
+    *p = r;
+    if (s) s[miss[i]] = r;
+  }
+  free(miss);
+
+  return 0;
+}
+
+
+/* the order of the orbitals i and j in the slater integral keys.
+   bound orbitals are ordered by index, and come before the free ones.
+   the indices of the free orbitals depend on the order in which the 
+   threads ask for them, so they are ordered by energy and kappa. */
+static int CompareSlaterOrbital(int i, int j) {
+  ORBITAL *orb1, *orb2;
+
+  if (i == j) return 0;
+  orb1 = GetOrbital(i);
+  orb2 = GetOrbital(j);
+  if (orb1->n != 0 || orb2->n != 0) {
+    if (orb1->n == 0) return 1;
+    if (orb2->n == 0) return -1;
+  } else if (orb1->energy != orb2->energy) {
+    return (orb1->energy > orb2->energy)?1:-1;
+  } else if (orb1->kappa != orb2->kappa) {
+    return (orb1->kappa > orb2->kappa)?1:-1;
+  }
+  return (i > j)?1:-1;
+}
+
 /* reorder the orbital index appears in the slater integral, so that it is
    in a form: a <= b <= d, a <= c, and if (a == b), c <= d. */ 
 void SortSlaterKey(int *kd) {
   int i;
 
-  if (kd[0] > kd[2]) {
+  if (CompareSlaterOrbital(kd[0], kd[2]) > 0) {
     i = kd[0];
     kd[0] = kd[2];
     kd[2] = i;
   }
 
-  if (kd[1] > kd[3]) {
+  if (CompareSlaterOrbital(kd[1], kd[3]) > 0) {
     i = kd[1];
     kd[1] = kd[3];
     kd[3] = i;
   }
   
-  if (kd[0] > kd[1]) {
+  i = CompareSlaterOrbital(kd[0], kd[1]);
+  if (i > 0) {
     i = kd[0];
     kd[0] = kd[1];
     kd[1] = i;
     i = kd[2];
     kd[2] = kd[3];
     kd[3] = i;
-  } else if (kd[0] == kd[1]) {
-    if (kd[2] > kd[3]) {
+  } else if (i == 0) {
+    if (CompareSlaterOrbital(kd[2], kd[3]) > 0) {
       i = kd[2];
       kd[2] = kd[3];
       kd[3] = i;
@@ -3595,13 +3877,16 @@ void SortSlaterKey(int *kd) {
 
 void PrepSlater(int ib0, int iu0, int ib1, int iu1,
 		int ib2, int iu2, int ib3, int iu3) {
-  int k, kmax, kk, i, j, p, q, m, ilast;
+  int k, kmax, kk, i, j, p, q, n;
   int j0, j1, j2, j3, k0, k1, k2, k3;
-  int index[6];
-  double *dp;
+  int *kb, *kd;
   ORBITAL *orb0, *orb1, *orb2, *orb3;
   int c = 0;
 
+  n = (iu1-ib1+1)*(iu3-ib3+1);
+  if (n <= 0) return;
+  kb = (int *) malloc(sizeof(int)*n);
+  kd = (int *) malloc(sizeof(int)*n);
   kmax = GetMaxRank();
   for (kk = 0; kk <= kmax; kk += 2) {
     k = kk/2;
@@ -3613,11 +3898,7 @@ void PrepSlater(int ib0, int iu0, int ib1, int iu1,
 	orb2 = GetOrbital(p);
 	GetJLFromKappa(orb2->kappa, &j2, &k2);
 	if (k0 > slater_cut.kl0 || k2 > slater_cut.kl0) continue;
-	GetYk(k, _yk, orb0, orb2, i, p, -1);
-	ilast = potential->maxrp-1;
-	for (m = 0; m <= ilast; m++) {
-	  _yk[m] /= potential->rad[m];
-	}
+	n = 0;
 	for (j = ib1; j <= iu1; j++) {
 	  if (j < i) continue;
 	  orb1 = GetOrbital(j);
@@ -3631,22 +3912,18 @@ void PrepSlater(int ib0, int iu0, int ib1, int iu1,
 		IsOdd((k1+k3)/2+k) ||
 		!Triangle(j0, j2, kk) ||
 		!Triangle(j1, j3, kk)) continue;	     
-	    index[0] = i;
-	    index[1] = j;
-	    index[2] = p;
-	    index[3] = q;
-	    index[4] = k;
-	    index[5] = 0;
-	    dp = MultiSet(slater_array, index, NULL, InitDoubleData, NULL);
-	    c++;
-	    if (*dp == 0) {
-	      Integrate(_yk, orb1, orb3, 1, dp, 0);
-	    }
+	    kb[n] = j;
+	    kd[n] = q;
+	    n++;
 	  }
 	}
+	if (n > 0) SlaterBatch(NULL, i, p, k, n, kb, kd, 1);
+	c += n;
       }
     }
   }
+  free(kb);
+  free(kd);
   printf("PrepSlater: %d\n", c);
 }
       
@@ -3694,6 +3971,8 @@ int GetYk0(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2, int type) {
 /*
 ** this is a better version of Yk than GetYk0.
 ** note that on exit, _zk consists r^k, which is used in GetYk
+** the powers are taken of r/r0, since r^k itself underflows near
+** the origin for large k. 
 */      
 int GetYk1(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2, int type) {
   int i, ilast;
@@ -3725,9 +4004,10 @@ int GetYk1(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2, int type) {
 int GetYk(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2, 
 	  int k1, int k2, int type) {
   int i, i0, i1, n;
-  double a, b, a2, b2, max, max1;
+  double a, b, a2, b2, max, max1, *rk;
   int index[3];
-  SLATER_YK *syk;
+  SLATER_YK *syk, tyk;
+  ORBITAL *orb0;
 
   if (k1 <= k2) {
     index[0] = k1;
@@ -3739,7 +4019,47 @@ int GetYk(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2,
   index[2] = k;
 
   syk = (SLATER_YK *) MultiSet(yk_array, index, NULL, InitYkData, FreeYkData);
+
+  /* a pair with a free orbital keeps the exact yk in yk0, since the 
+     tail fit of the compressed entry is only accurate for bound pairs.
+     it is computed with the orbitals in the order of the slater keys. */
+  if (orb1->n == 0 || orb2->n == 0) {
+    if (syk->npts < 0) {
+      if (CompareSlaterOrbital(k1, k2) > 0) {
+	orb0 = orb1;
+	orb1 = orb2;
+	orb2 = orb0;
+      }
+      GetYk1(k, yk, orb1, orb2, type);
+      rk = malloc(sizeof(double)*potential->maxrp);
+      memcpy(rk, yk, sizeof(double)*potential->maxrp);
+#pragma omp critical(radial_cache)
+      {
+	if (syk->npts < 0) {
+	  syk->yk0 = rk;
+#pragma omp flush
+	  syk->npts = potential->maxrp;
+	} else {
+	  free(rk);
+	}
+      }
+    }
+    memcpy(yk, syk->yk0, sizeof(double)*potential->maxrp);
+    return 0;
+  }
+
   if (syk->npts < 0) {
+    /* the entry is built with the orbitals in the key order, and every
+       caller, the first one included, gets the yk rebuilt from it. so 
+       the yk does not depend on which caller, or which thread, comes
+       first. */
+    if (k1 > k2) {
+      orb0 = orb1;
+      orb1 = orb2;
+      orb2 = orb0;
+    }
+    /* build the entry in tyk, and publish it with npts set last, 
+       since other threads may be reading syk concurrently. */
     GetYk1(k, yk, orb1, orb2, type);
     max = 0;
     for (i = 0; i < potential->maxrp; i++) {
@@ -3769,11 +4089,11 @@ int GetYk(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2,
       b = fabs(a - _zk[i0]);
       _zk[i0] = log(b);
     }
-    syk->coeff[0] = a;    
-    syk->npts = i0+1;
-    syk->yk = malloc(sizeof(float)*(syk->npts));
-    for (i = 0; i < syk->npts ; i++) {
-      syk->yk[i] = yk[i];
+    tyk.coeff[0] = a;    
+    tyk.npts = i0+1;
+    tyk.yk = malloc(sizeof(float)*(tyk.npts));
+    for (i = 0; i < tyk.npts ; i++) {
+      tyk.yk[i] = yk[i];
     }
     n = i1 - i0 + 1;
     a = 0.0;
@@ -3787,8 +4107,8 @@ int GetYk(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2,
       a2 += max*max;
       b2 += _zk[i]*max;
     }
-    syk->coeff[1] = (a*b - n*b2)/(a*a - n*a2);       
-    if (syk->coeff[1] >= 0) {
+    tyk.coeff[1] = (a*b - n*b2)/(a*a - n*a2);       
+    if (tyk.coeff[1] >= 0) {
       i1 = i0 + (i1-i0)*0.3;
       if (i1 == i0) i1 = i0 + 1;
       for (i = i0; i <= i1; i++) {      
@@ -3798,32 +4118,41 @@ int GetYk(int k, double *yk, ORBITAL *orb1, ORBITAL *orb2,
 	a2 += max*max;
 	b2 += _zk[i]*max;
       }
-      syk->coeff[1] = (a*b - n*b2)/(a*a - n*a2);  
-    }
-    if (syk->coeff[1] >= 0) {
-      syk->coeff[1] = -10.0/(potential->rad[i1]-potential->rad[i0]);
-    } 
-  } else {
-    for (i = syk->npts-1; i < potential->maxrp; i++) {
-      _dwork1[i] = pow(potential->rad[i], k);
-    }
-    for (i = 0; i < syk->npts; i++) {
-      yk[i] = syk->yk[i];
-    }
-    i0 = syk->npts-1;
-    a = syk->yk[i0]*_dwork1[i0];
-    for (i = syk->npts; i < potential->maxrp; i++) {
-      b = potential->rad[i] - potential->rad[i0];
-      b = syk->coeff[1]*b;
-      if (b < -20) {
-	yk[i] = syk->coeff[0];
+      tyk.coeff[1] = (a*b - n*b2)/(a*a - n*a2);  
+    }
+    if (tyk.coeff[1] >= 0) {
+      tyk.coeff[1] = -10.0/(potential->rad[i1]-potential->rad[i0]);
+    }
+#pragma omp critical(radial_cache)
+    {
+      if (syk->npts < 0) {
+	syk->yk = tyk.yk;
+	syk->coeff[0] = tyk.coeff[0];
+	syk->coeff[1] = tyk.coeff[1];
+#pragma omp flush
+	syk->npts = tyk.npts;
       } else {
-	yk[i] = (a - syk->coeff[0])*exp(b);
-	yk[i] += syk->coeff[0];
+	free(tyk.yk);
       }
-      yk[i] /= _dwork1[i];
-    }    
+    }
   }
+  rk = RadialPower(k, _dwork1);
+  for (i = 0; i < syk->npts; i++) {
+    yk[i] = syk->yk[i];
+  }
+  i0 = syk->npts-1;
+  a = syk->yk[i0]*rk[i0];
+  for (i = syk->npts; i < potential->maxrp; i++) {
+    b = potential->rad[i] - potential->rad[i0];
+    b = syk->coeff[1]*b;
+    if (b < -20) {
+      yk[i] = syk->coeff[0];
+    } else {
+      yk[i] = (a - syk->coeff[0])*exp(b);
+      yk[i] += syk->coeff[0];
+    }
+    yk[i] /= rk[i];
+  }    
       
   return 0;
 }  
@@ -3942,12 +4271,15 @@ int IntegrateSubRegion(int i0, int i1,
   int i, j, ip, i2, type;
   ORBITAL *tmp;
   double *large1, *large2, *small1, *small2;
-  double *x, *y, *r1, *x1, *x2, *y1, *y2;
+  double *x, *y, *r1, *x1, *x2, *y1, *y2, *dr;
   double a, b, e1, e2, a2, r0;
 
   if (i1 <= i0) return 0;
   type = abs(t);
 
+  /* a local pointer, so that the loops over the grid need not
+     reload it after each store, and may be vectorized. */
+  dr = potential->dr_drho;
   x = _dwork3;
   y = _dwork4;
   x1 = _dwork5;
@@ -3969,7 +4301,7 @@ int IntegrateSubRegion(int i0, int i1,
       for (i = i0; i <= i1; i++) {
 	x[i] = large1[i] * large2[i];
 	x[i] += small1[i] * small2[i];
-	x[i] *= f[i]*potential->dr_drho[i];
+	x[i] *= f[i]*dr[i];
       }
       if (i1 == orb1->ilast && orb1->n == 0 && i < potential->maxrp) {
 	if (i <= orb2->ilast) {
@@ -3978,7 +4310,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  b = cos(large1[ip]);
 	  x[i] = large1[i]*a*large2[i];
 	  x[i] += (small1[i]*b + small1[ip]*a)*small2[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb2->n == 0) {
 	  ip = i+1;
@@ -3988,7 +4320,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e2 = cos(large2[ip]);
 	  x[i] = large1[i]*a*large2[i]*e1;
 	  x[i] += (small1[i]*b+small1[ip]*a)*(small2[i]*e2+small2[ip]*e1);
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       } else if (i1 == orb2->ilast && orb2->n == 0 && i < potential->maxrp) {
@@ -3998,7 +4330,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  b = cos(large2[ip]);
 	  x[i] = large2[i]*a*large1[i];
 	  x[i] += (small2[i]*b + small2[ip]*a)*small1[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb1->n == 0) {
 	  ip = i+1;
@@ -4008,7 +4340,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e2 = cos(large1[ip]);
 	  x[i] = large2[i]*a*large1[i]*e1;
 	  x[i] += (small2[i]*b+small2[ip]*a)*(small1[i]*e2+small1[ip]*e1);
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       }
@@ -4016,7 +4348,7 @@ int IntegrateSubRegion(int i0, int i1,
     case 2: /* type = 2 */
       for (i = i0; i <= i1; i++) {
 	x[i] = large1[i] * large2[i];
-	x[i] *= f[i]*potential->dr_drho[i];
+	x[i] *= f[i]*dr[i];
       }
       if (i1 == orb1->ilast && orb1->n == 0 && i < potential->maxrp) {
 	if (i <= orb2->ilast) {
@@ -4024,7 +4356,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  a = sin(large1[ip]);
 	  b = cos(large1[ip]);
 	  x[i] = large1[i]*a*large2[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb2->n == 0) {
 	  ip = i+1;
@@ -4033,7 +4365,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e1 = sin(large2[ip]);
 	  e2 = cos(large2[ip]);
 	  x[i] = large1[i]*a*large2[i]*e1;
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       } else if (i1 == orb2->ilast && orb2->n == 0 && i < potential->maxrp) {
@@ -4042,7 +4374,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  a = sin(large2[ip]);
 	  b = cos(large2[ip]);
 	  x[i] = large2[i]*a*large1[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb1->n == 0) {
 	  ip = i+1;
@@ -4051,7 +4383,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e1 = sin(large1[ip]);
 	  e2 = cos(large1[ip]);
 	  x[i] = large2[i]*a*large1[i]*e1;
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       }
@@ -4059,7 +4391,7 @@ int IntegrateSubRegion(int i0, int i1,
     case 3: /*type = 3 */
       for (i = i0; i <= i1; i++) {
 	x[i] = small1[i] * small2[i];
-	x[i] *= f[i]*potential->dr_drho[i];
+	x[i] *= f[i]*dr[i];
       }
       if (i1 == orb1->ilast && orb1->n == 0 && i < potential->maxrp) {
 	if (i <= orb2->ilast) {
@@ -4067,7 +4399,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  a = sin(large1[ip]);
 	  b = cos(large1[ip]);
 	  x[i] = (small1[i]*b + small1[ip]*a)*small2[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb2->n == 0) {
 	  ip = i+1;
@@ -4076,7 +4408,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e1 = sin(large2[ip]);
 	  e2 = cos(large2[ip]);
 	  x[i] = (small1[i]*b+small1[ip]*a)*(small2[i]*e2+small2[ip]*e1);
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       } else if (i1 == orb2->ilast && orb2->n == 0 && i < potential->maxrp) {
@@ -4085,7 +4417,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  a = sin(large2[ip]);
 	  b = cos(large2[ip]);
 	  x[i] = (small2[i]*b + small2[ip]*a)*small1[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb1->n == 0) {
 	  ip = i+1;
@@ -4094,7 +4426,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e1 = sin(large1[ip]);
 	  e2 = cos(large1[ip]);
 	  x[i] = (small2[i]*b+small2[ip]*a)*(small1[i]*e2+small1[ip]*e1);
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       }
@@ -4103,7 +4435,7 @@ int IntegrateSubRegion(int i0, int i1,
       for (i = i0; i <= i1; i++) {
 	x[i] = large1[i] * small2[i];
 	x[i] += small1[i] * large2[i];
-	x[i] *= f[i]*potential->dr_drho[i];
+	x[i] *= f[i]*dr[i];
       }
       if (i1 == orb1->ilast && orb1->n == 0 && i < potential->maxrp) {
 	if (i <= orb2->ilast) {
@@ -4112,7 +4444,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  b = cos(large1[ip]);
 	  x[i] = large1[i]*a*small2[i];
 	  x[i] += (small1[i]*b + small1[ip]*a)*large2[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb2->n == 0) {
 	  ip = i+1;
@@ -4122,7 +4454,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e2 = cos(large2[ip]);
 	  x[i] = large1[i]*a*(small2[i]*e2+small2[ip]*e1);
 	  x[i] += (small1[i]*b+small1[ip]*a)*large2[i]*e1;
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       } else if (i1 == orb2->ilast && orb2->n == 0 && i < potential->maxrp) {
@@ -4132,7 +4464,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  b = cos(large2[ip]);
 	  x[i] = (small2[i]*b + small2[ip]*a)*large1[i];
 	  x[i] += large2[i]*a*small1[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb1->n == 0) {
 	  ip = i+1;
@@ -4142,7 +4474,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e2 = cos(large1[ip]);
 	  x[i] = (small2[i]*b+small2[ip]*a)*large1[i]*e1;
 	  x[i] += large2[i]*a*(small1[i]*e2+small1[ip]*e1);
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       }
@@ -4151,7 +4483,7 @@ int IntegrateSubRegion(int i0, int i1,
       for (i = i0; i <= i1; i++) {
 	x[i] = large1[i] * small2[i];
 	x[i] -= small1[i] * large2[i];
-	x[i] *= f[i]*potential->dr_drho[i];
+	x[i] *= f[i]*dr[i];
       } 
       if (i1 == orb1->ilast && orb1->n == 0 && i < potential->maxrp) {
 	if (i <= orb2->ilast) {
@@ -4160,7 +4492,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  b = cos(large1[ip]);
 	  x[i] = large1[i]*a*small2[i];
 	  x[i] -= (small1[i]*b + small1[ip]*a)*large2[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb2->n == 0) {
 	  ip = i+1;
@@ -4170,7 +4502,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e2 = cos(large2[ip]);
 	  x[i] = large1[i]*a*(small2[i]*e2+small2[ip]*e1);
 	  x[i] -= (small1[i]*b+small1[ip]*a)*large2[i]*e1;
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       } else if (i1 == orb2->ilast && orb2->n == 0 && i < potential->maxrp) {
@@ -4180,7 +4512,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  b = cos(large2[ip]);
 	  x[i] = (small2[i]*b + small2[ip]*a)*large1[i];
 	  x[i] -= large2[i]*a*small1[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb1->n == 0) {
 	  ip = i+1;
@@ -4190,7 +4522,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e2 = cos(large1[ip]);
 	  x[i] = (small2[i]*b+small2[ip]*a)*large1[i]*e1;
 	  x[i] -= large2[i]*a*(small1[i]*e2+small1[ip]*e1);
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       }
@@ -4198,7 +4530,7 @@ int IntegrateSubRegion(int i0, int i1,
     case 6: /* type = 6 */
       for (i = i0; i <= i1; i++) {
 	x[i] = large1[i] * small2[i];
-	x[i] *= f[i]*potential->dr_drho[i];
+	x[i] *= f[i]*dr[i];
       }
       if (i1 == orb1->ilast && orb1->n == 0 && i < potential->maxrp) {
 	if (i <= orb2->ilast) {
@@ -4206,7 +4538,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  a = sin(large1[ip]);
 	  b = cos(large1[ip]);
 	  x[i] = large1[i]*a*small2[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb2->n == 0) {
 	  ip = i+1;
@@ -4215,7 +4547,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e1 = sin(large2[ip]);
 	  e2 = cos(large2[ip]);
 	  x[i] = large1[i]*a*(small2[i]*e2+small2[ip]*e1);
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       } else if (i1 == orb2->ilast && orb2->n == 0 && i < potential->maxrp) {
@@ -4224,7 +4556,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  a = sin(large2[ip]);
 	  b = cos(large2[ip]);
 	  x[i] = (small2[i]*b + small2[ip]*a)*large1[i];
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	} else if (orb1->n == 0) {
 	  ip = i+1;
@@ -4233,7 +4565,7 @@ int IntegrateSubRegion(int i0, int i1,
 	  e1 = sin(large1[ip]);
 	  e2 = cos(large1[ip]);
 	  x[i] = (small2[i]*b+small2[ip]*a)*large1[i]*e1;
-	  x[i] *= f[i]*potential->dr_drho[i];
+	  x[i] *= f[i]*dr[i];
 	  i2 = i;
 	}
       }
@@ -4907,36 +5239,456 @@ int IntegrateSinCos(int j, double *x, double *y,
   return 0;
 }
 
-void LimitArrayRadial(int m, double n) {
-  int k;
-
-  k = (int)(n*1000000);
+static MULTI *RadialArray(int m) {
   switch (m) {
   case 0:
-    yk_array->maxelem = k;
-    break;
+    return yk_array;
   case 1:
-    slater_array->maxelem = k;
-    break;
+    return slater_array;
   case 2:
-    breit_array->maxelem = k;
-    break;
+    return breit_array;
   case 3:
-    gos_array->maxelem = k;
-    break;
+    return gos_array;
   case 4:
-    moments_array->maxelem = k;
-    break;
+    return moments_array;
   case 5:
-    multipole_array->maxelem = k;
-    break;
+    return multipole_array;
   case 6:
-    residual_array->maxelem = k;
-    break;
+    return residual_array;
+  case 7:
+    return vinti_array;
+  case 8:
+    return qed1e_array;
   default:
-    printf("m > 6, nothing is done\n");
-    break;
+    return NULL;
+  }
+}
+
+void LimitArrayRadial(int m, double n) {
+  MULTI *ma;
+
+  ma = RadialArray(m);
+  if (ma == NULL) {
+    printf("m > 8, nothing is done\n");
+    return;
+  }
+  ma->maxelem = (int)(n*1000000);
+}
+
+void LimitArrayRadialMemory(int m, double mb) {
+  MULTI *ma;
+
+  ma = RadialArray(m);
+  if (ma == NULL) {
+    printf("m > 8, nothing is done\n");
+    return;
+  }
+  MultiLimit(ma, mb);
+}
+
+void PrintArrayRadialStats(void) {
+  char *names[] = {"yk", "slater", "breit", "gos", "moments", 
+		   "multipole", "residual", "vinti", "qed1e"};
+  MULTI_STATS st;
+  MULTI *ma;
+  int m;
+
+  printf("%2s %-9s %10s %10s %10s %12s %12s %12s\n", "m", "array", 
+	 "limit", "elements", "MB", "hits", "misses", "evictions");
+  for (m = 0; m < 9; m++) {
+    ma = RadialArray(m);
+    MultiStats(ma, &st);
+    printf("%2d %-9s %10d %10d %10.3f %12ld %12ld %12ld\n", 
+	   m, names[m], ma->maxelem, st.numelem, st.bytes/1e6,
+	   st.nhit, st.nmiss, st.nevict);
+  }
+}
+
+/*
+** the checkpoint file starts with 8 ints {magic, version, maxrp,
+** norb, 0, 0, 0, 0}, and the 2 ints of the fingerprint of the
+** potential. then the orbital table follows, each orbital with 4
+** ints {n, kappa, ilast, nw}, the energy, the qr_norm, and the nw
+** doubles of the wave function. last are the slater, breit, vinti
+** and qed1e arrays, each with 2 ints {ndim, n}, and n elements of
+** ndim indexes followed by the value.
+*/
+#define CHECKPOINT_MAGIC   0x50434b52
+#define CHECKPOINT_VERSION 1
+
+static int checkpoint_arrays[4] = {1, 2, 7, 8};
+
+typedef struct _CHECKPOINT_WALK_ {
+  FILE *f;
+  MULTI *ma;
+  int ndim;
+  int n;
+} CHECKPOINT_WALK;
+
+/* FNV-1a hash of n bytes at p, continued from h. */
+static unsigned int HashBytes(unsigned int h, void *p, int n) {
+  unsigned char *c;
+  int i;
+
+  c = (unsigned char *) p;
+  for (i = 0; i < n; i++) {
+    h ^= c[i];
+    h *= 16777619U;
   }
+  return h;
+}
+
+/*
+** the fingerprint of the potential, and of the qed options the
+** integrals depend on. the two words are hashes with different
+** offsets, the second one over the data in reverse order.
+*/
+static void PotentialFingerprint(unsigned int *fp) {
+  POTENTIAL *pot;
+  int i, m, n, iv[6];
+  double dv[10], *a[4];
+
+  pot = potential;
+  iv[0] = pot->mode;
+  iv[1] = pot->flag;
+  iv[2] = pot->maxrp;
+  iv[3] = pot->ib;
+  iv[4] = pot->nb;
+  iv[5] = pot->ib1;
+  dv[0] = pot->hxs;
+  dv[1] = pot->ratio;
+  dv[2] = pot->asymp;
+  dv[3] = pot->rmin;
+  dv[4] = pot->N;
+  dv[5] = pot->lambda;
+  dv[6] = pot->a;
+  dv[7] = pot->ar;
+  dv[8] = pot->br;
+  dv[9] = pot->bqp;
+  a[0] = pot->Z;
+  a[1] = pot->rad;
+  a[2] = pot->Vc;
+  a[3] = pot->U;
+  n = pot->maxrp;
+  fp[0] = 2166136261U;
+  fp[0] = HashBytes(fp[0], iv, sizeof(iv));
+  fp[0] = HashBytes(fp[0], dv, sizeof(dv));
+  fp[0] = HashBytes(fp[0], &qed, sizeof(qed));
+  for (m = 0; m < 4; m++) {
+    fp[0] = HashBytes(fp[0], a[m], sizeof(double)*n);
+  }
+  fp[1] = 3735928559U;
+  for (m = 3; m >= 0; m--) {
+    for (i = n-1; i >= 0; i--) {
+      fp[1] = HashBytes(fp[1], a[m]+i, sizeof(double));
+    }
+  }
+  fp[1] = HashBytes(fp[1], &qed, sizeof(qed));
+  fp[1] = HashBytes(fp[1], dv, sizeof(dv));
+  fp[1] = HashBytes(fp[1], iv, sizeof(iv));
+}
+
+/* whether the orbitals of the integral k are all bound ones. */
+static int CheckpointKey(int *k, int ndim) {
+  int i;
+
+  for (i = 0; i < ndim && i < 4; i++) {
+    if (k[i] < 0 || k[i] >= n_orbitals) return 0;
+    if (GetOrbital(k[i])->n <= 0) return 0;
+  }
+  return 1;
+}
+
+static int WriteCheckpointElem(int *k, void *d, void *arg) {
+  CHECKPOINT_WALK *w;
+
+  w = (CHECKPOINT_WALK *) arg;
+  if (*((double *) d) == 0 || !CheckpointKey(k, w->ndim)) return 0;
+  fwrite(k, sizeof(int), w->ndim, w->f);
+  fwrite(d, sizeof(double), 1, w->f);
+  w->n++;
+  return 0;
+}
+
+static int FlushCheckpointElem(int *k, void *d, void *arg) {
+  CHECKPOINT_WALK *w;
+
+  w = (CHECKPOINT_WALK *) arg;
+  if (*((double *) d) == 0 || !CheckpointKey(k, w->ndim)) return 0;
+  MultiSet(w->ma, k, d, InitDoubleData, NULL);
+  return 0;
+}
+
+/* move the integrals of the radial arrays to the checkpoint. */
+static void FlushRadialCheckpoint(void) {
+  CHECKPOINT_WALK w;
+  int m;
+
+  for (m = 0; m < 4; m++) {
+    w.ma = checkpoint.array[m];
+    w.ndim = w.ma->ndim;
+    MultiWalk(RadialArray(checkpoint_arrays[m]), FlushCheckpointElem, &w);
+  }
+}
+
+/*
+** write the orbitals, and the integrals of the arrays ma to fn,
+** with the fingerprint fp. it is written to fn.tmp first and then
+** renamed, so that an interrupted save leaves the previous file.
+*/
+static int WriteRadialCheckpoint(char *fn, unsigned int *fp, MULTI **ma) {
+  FILE *f;
+  char *tfn;
+  int hdr[8], i, m, iv[4];
+  long p;
+  double e[2];
+  ORBITAL *orb;
+  CHECKPOINT_WALK w;
+
+  tfn = (char *) malloc(strlen(fn)+5);
+  sprintf(tfn, "%s.tmp", fn);
+  f = fopen(tfn, "w");
+  if (f == NULL) {
+    printf("cannot open file %s\n", tfn);
+    free(tfn);
+    return -1;
+  }
+  for (i = 0; i < 8; i++) hdr[i] = 0;
+  hdr[0] = CHECKPOINT_MAGIC;
+  hdr[1] = CHECKPOINT_VERSION;
+  hdr[2] = potential->maxrp;
+  hdr[3] = n_orbitals;
+  fwrite(hdr, sizeof(int), 8, f);
+  fwrite(fp, sizeof(unsigned int), 2, f);
+  for (i = 0; i < n_orbitals; i++) {
+    orb = GetOrbital(i);
+    iv[0] = orb->n;
+    iv[1] = orb->kappa;
+    iv[2] = orb->ilast;
+    iv[3] = (orb->n > 0 && orb->wfun)? 2*potential->maxrp : 0;
+    e[0] = orb->energy;
+    e[1] = orb->qr_norm;
+    fwrite(iv, sizeof(int), 4, f);
+    fwrite(e, sizeof(double), 2, f);
+    if (iv[3] > 0) fwrite(orb->wfun, sizeof(double), iv[3], f);
+  }
+
+  w.f = f;
+  for (m = 0; m < 4; m++) {
+    w.ndim = ma[m]->ndim;
+    w.n = 0;
+    p = ftell(f);
+    iv[0] = w.ndim;
+    iv[1] = 0;
+    fwrite(iv, sizeof(int), 2, f);
+    MultiWalk(ma[m], WriteCheckpointElem, &w);
+    fseek(f, p + sizeof(int), SEEK_SET);
+    fwrite(&(w.n), sizeof(int), 1, f);
+    fseek(f, 0, SEEK_END);
+  }
+  fclose(f);
+
+  i = 0;
+  if (rename(tfn, fn) != 0) {
+    printf("cannot rename %s to %s\n", tfn, fn);
+    i = -1;
+  }
+  free(tfn);
+  return i;
+}
+
+/*
+** read the checkpoint fn into the arrays ma, if its fingerprint is
+** fp. the bound orbitals not in the table are added with their wave
+** functions, and the indexes of the integrals are translated to the
+** table. returns the number of integrals read, or -1 on error.
+*/
+static int ReadRadialCheckpoint(char *fn, unsigned int *fp, MULTI **ma) {
+  FILE *f;
+  int hdr[8], i, j, k, m, n, nr, iv[4], *map, key[5];
+  unsigned int fp0[2];
+  double e[2], r, *wfun;
+  ORBITAL *orb, tmp;
+
+  f = fopen(fn, "r");
+  if (f == NULL) return -1;
+  if (fread(hdr, sizeof(int), 8, f) != 8 ||
+      fread(fp0, sizeof(unsigned int), 2, f) != 2 ||
+      hdr[0] != CHECKPOINT_MAGIC || hdr[1] != CHECKPOINT_VERSION) {
+    printf("invalid checkpoint file %s\n", fn);
+    fclose(f);
+    return -1;
+  }
+  if (hdr[2] != potential->maxrp || fp[0] != fp0[0] || fp[1] != fp0[1]) {
+    printf("checkpoint %s is for a different potential\n", fn);
+    fclose(f);
+    return -1;
+  }
+
+  map = (int *) malloc(sizeof(int)*(hdr[3]+1));
+  for (i = 0; i < hdr[3]; i++) {
+    if (fread(iv, sizeof(int), 4, f) != 4 ||
+	fread(e, sizeof(double), 2, f) != 2) break;
+    map[i] = -1;
+    if (iv[3] <= 0) continue;
+    wfun = (double *) malloc(sizeof(double)*iv[3]);
+    if ((int) fread(wfun, sizeof(double), iv[3], f) != iv[3]) {
+      free(wfun);
+      break;
+    }
+    k = OrbitalExists(iv[0], iv[1], e[0]);
+    if (k < 0) {
+      tmp.n = iv[0];
+      tmp.kappa = iv[1];
+      tmp.energy = e[0];
+      tmp.qr_norm = e[1];
+      tmp.ilast = iv[2];
+      tmp.phase = NULL;
+      tmp.wfun = wfun;
+      k = AddOrbital(&tmp);
+    } else {
+      orb = GetOrbital(k);
+      if (orb->wfun == NULL) {
+	orb->energy = e[0];
+	orb->qr_norm = e[1];
+	orb->ilast = iv[2];
+	orb->wfun = wfun;
+      } else {
+	free(wfun);
+      }
+    }
+    map[i] = k;
+  }
+  if (i < hdr[3]) {
+    printf("checkpoint %s truncated at orbital %d\n", fn, i);
+    free(map);
+    fclose(f);
+    return -1;
+  }
+
+  nr = 0;
+  for (m = 0; m < 4; m++) {
+    if (fread(iv, sizeof(int), 2, f) != 2 || iv[0] != ma[m]->ndim) break;
+    n = iv[1];
+    for (i = 0; i < n; i++) {
+      if ((int) fread(key, sizeof(int), iv[0], f) != iv[0] ||
+	  fread(&r, sizeof(double), 1, f) != 1) break;
+      for (j = 0; j < iv[0] && j < 4; j++) {
+	if (key[j] < 0 || key[j] >= hdr[3] || map[key[j]] < 0) break;
+	key[j] = map[key[j]];
+      }
+      if (j < iv[0] && j < 4) continue;
+      if (checkpoint_arrays[m] == 1) {
+	SortSlaterKey(key);
+      } else if (checkpoint_arrays[m] == 8 && key[0] > key[1]) {
+	k = key[0];
+	key[0] = key[1];
+	key[1] = k;
+      }
+      MultiSet(ma[m], key, &r, InitDoubleData, NULL);
+      nr++;
+    }
+    if (i < n) break;
+  }
+  free(map);
+  fclose(f);
+  if (m < 4) {
+    printf("checkpoint %s truncated, %d integrals read\n", fn, nr);
+  }
+
+  return nr;
+}
+
+static void ReleaseRadialCheckpoint(void) {
+  int m;
+
+  checkpoint.active = 0;
+  for (m = 0; m < 4; m++) {
+    MultiFreeData(checkpoint.array[m], NULL);
+  }
+}
+
+/*
+** save the checkpoint if the potential has not changed since it
+** was opened, and release its integrals.
+*/
+static void CloseRadialCheckpoint(void) {
+  if (!checkpoint.active) return;
+  TickRadialCheckpoint();
+  if (!checkpoint.active) return;
+  WriteRadialCheckpoint(checkpoint.fn, checkpoint.fp, checkpoint.array);
+  ReleaseRadialCheckpoint();
+}
+
+/*
+** a point where the integrals may be checkpointed, i.e., outside
+** parallel regions. the integrals computed so far are moved to the
+** checkpoint, which is saved if its interval has passed. if the
+** potential has changed, the checkpoint is closed.
+*/
+void TickRadialCheckpoint(void) {
+  unsigned int fp[2];
+
+  if (!checkpoint.active || InParallel()) return;
+  PotentialFingerprint(fp);
+  if (fp[0] != checkpoint.fp[0] || fp[1] != checkpoint.fp[1]) {
+    printf("potential changed, checkpoint %s closed\n", checkpoint.fn);
+    ReleaseRadialCheckpoint();
+    return;
+  }
+  FlushRadialCheckpoint();
+  if (checkpoint.dt > 0 &&
+      difftime(time(NULL), checkpoint.last) >= checkpoint.dt) {
+    WriteRadialCheckpoint(checkpoint.fn, checkpoint.fp, checkpoint.array);
+    checkpoint.last = time(NULL);
+  }
+}
+
+/*
+** save the orbitals and the slater, breit, vinti and qed1e integrals
+** computed so far to fn. these are the ones of the checkpoint if it
+** is open, otherwise, those of the radial arrays.
+*/
+int SaveRadialCheckpoint(char *fn) {
+  unsigned int fp[2];
+  MULTI *ma[4];
+  int m;
+
+  TickRadialCheckpoint();
+  if (checkpoint.active) {
+    m = WriteRadialCheckpoint(fn, checkpoint.fp, checkpoint.array);
+    if (strcmp(fn, checkpoint.fn) == 0) checkpoint.last = time(NULL);
+    return m;
+  }
+  PotentialFingerprint(fp);
+  for (m = 0; m < 4; m++) {
+    ma[m] = RadialArray(checkpoint_arrays[m]);
+  }
+  return WriteRadialCheckpoint(fn, fp, ma);
+}
+
+/*
+** open the checkpoint fn for the current potential. the integrals
+** of fn are restored if it was saved for the same potential. from
+** then on, the integrals between bound orbitals are kept, and saved
+** to fn every dt seconds if dt > 0, and when the orbital table is
+** cleared. returns the number of integrals restored.
+*/
+int SetRadialCheckpoint(char *fn, double dt) {
+  int nr;
+
+  CloseRadialCheckpoint();
+  strncpy(checkpoint.fn, fn, 1023);
+  checkpoint.fn[1023] = '\0';
+  checkpoint.dt = dt;
+  PotentialFingerprint(checkpoint.fp);
+  nr = ReadRadialCheckpoint(fn, checkpoint.fp, checkpoint.array);
+  if (nr < 0) nr = 0;
+  checkpoint.active = 1;
+  checkpoint.last = time(NULL);
+  FlushRadialCheckpoint();
+
+  return nr;
 }
 
 int InitRadial(void) {
@@ -4994,6 +5746,19 @@ int InitRadial(void) {
   yk_array = (MULTI *) malloc(sizeof(MULTI));
   MultiInit(yk_array, sizeof(SLATER_YK), ndim, blocks);
 
+  ndim = 5;
+  for (i = 0; i < ndim; i++) blocks[i] = MULTI_BLOCK5;
+  for (i = 0; i < 4; i++) {
+    if (i == 2) {
+      ndim = 2;
+      blocks[0] = MULTI_BLOCK2;
+      blocks[1] = MULTI_BLOCK2;
+    }
+    checkpoint.array[i] = (MULTI *) malloc(sizeof(MULTI));
+    MultiInit(checkpoint.array[i], sizeof(double), ndim, blocks);
+  }
+  checkpoint.active = 0;
+
   n_awgrid = 1;
   awgrid[0]= EPS3;
   
@@ -5004,6 +5769,7 @@ int InitRadial(void) {
 
 int ReinitRadial(int m) {
   if (m < 0) return 0;
+  TickRadialCheckpoint();
   SetSlaterCut(-1, -1);
   ClearOrbitalTable(m);
   FreeSimpleArray(slater_array);
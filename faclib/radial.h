@@ -35,6 +35,7 @@
 typedef struct _SLATER_YK_ {
   short npts;
   float *yk;
+  double *yk0;
   float coeff[2];
 } SLATER_YK;
 
@@ -55,6 +56,7 @@ int GetBoundary(double *rb, double *b, int *nmax, double *dr);
 int SetBoundary(int nmax, double p, double bqp);
 int RadialOverlaps(char *fn, int kappa);
 void SetSlaterCut(int k0, int k1);
+void GetSlaterCut(int *k0, int *k1);
 void SetPotentialMode(int m, double h);
 void SetSE(int n);
 void SetVP(int n);
@@ -126,6 +128,8 @@ double Vinti(int k0, int k1);
 double QED1E(int k0, int k1);
 double SelfEnergyRatio(ORBITAL *orb);
 int Slater(double *s, int k0, int k1, int k2, int k3, int k, int mode);
+int SlaterBatch(double *s, int k0, int k2, int k, int n,
+		int *k1, int *k3, int mode);
 double BreitC(int n, int m, int k, int k0, int k1, int k2, int k3);
 double BreitS(int k0, int k1, int k2, int k3, int k);
 double BreitI(int n, int k0, int k1, int k2, int k3, int m);
@@ -160,6 +164,11 @@ int FreeAllContinua(void);
 int FreeContinua(double e);
 int ClearOrbitalTable(int m);
 void LimitArrayRadial(int m, double n);
+void LimitArrayRadialMemory(int m, double mb);
+void PrintArrayRadialStats(void);
+int SaveRadialCheckpoint(char *fn);
+int SetRadialCheckpoint(char *fn, double dt);
+void TickRadialCheckpoint(void);
 int InitRadial(void);
 int ReinitRadial(int m);
 int TestIntegrate(void);
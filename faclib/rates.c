@@ -35,6 +35,19 @@ static DISTRIBUTION pho_dist[MAX_DIST];
 static int _iwork[QUAD_LIMIT];
 static double _dwork[4*QUAD_LIMIT];
 
+/* 
+** the optional quadrature of IntegrateRates. the interval is divided
+** into RATE_PANELS panels whose widths double from the threshold on,
+** each with rate_quad Gauss-Legendre points. rate_quad = 0, the 
+** default, uses DQAGS in IntegrateRate.
+*/
+#define RATE_PANELS 16
+#define RATE_YMAX 50.0
+#define MAX_RATE_QUAD 16
+static int rate_quad = 0;
+static double quad_x[RATE_PANELS*MAX_RATE_QUAD];
+static double quad_w[RATE_PANELS*MAX_RATE_QUAD];
+
 #define N3BRI 2000
 static double gamma3b = 1.0;
 
@@ -137,6 +150,57 @@ int SetRateAccuracy(double epsrel, double epsabs) {
   return 0.0;
 }    
 
+/*
+** nodes and weights of the n-point Gauss-Legendre rule on [0, 1].
+*/
+static void GaussLegendre(int n, double *x, double *w) {
+  int i, j, k;
+  double z, z1, p1, p2, p3, pp;
+
+  for (i = 0; i < (n+1)/2; i++) {
+    z = cos(PI*(i + 0.75)/(n + 0.5));
+    for (k = 0; k < 100; k++) {
+      p1 = 1.0;
+      p2 = 0.0;
+      for (j = 1; j <= n; j++) {
+	p3 = p2;
+	p2 = p1;
+	p1 = ((2.0*j - 1.0)*z*p2 - (j - 1.0)*p3)/j;
+      }
+      pp = n*(z*p1 - p2)/(z*z - 1.0);
+      z1 = z;
+      z = z1 - p1/pp;
+      if (fabs(z - z1) <= 1E-15) break;
+    }
+    x[i] = 0.5*(1.0 - z);
+    x[n-1-i] = 0.5*(1.0 + z);
+    w[i] = 1.0/((1.0 - z*z)*pp*pp);
+    w[n-1-i] = w[i];
+  }
+}
+
+int SetRateQuadrature(int n) {
+  double x[MAX_RATE_QUAD], w[MAX_RATE_QUAD], a, b;
+  int i, k;
+
+  if (n > MAX_RATE_QUAD) n = MAX_RATE_QUAD;
+  if (n < 0) n = 0;
+  rate_quad = n;
+  if (n == 0) return 0;
+  GaussLegendre(n, x, w);
+  /* the nodes for a unit interval, the first panel is [0, 2^(1-P)] */
+  b = 0.0;
+  for (i = 0; i < RATE_PANELS; i++) {
+    a = b;
+    b = pow(2.0, i+1-RATE_PANELS);
+    for (k = 0; k < n; k++) {
+      quad_x[i*n+k] = a + (b-a)*x[k];
+      quad_w[i*n+k] = (b-a)*w[k];
+    }
+  }
+  return 0;
+}
+
 void SetGamma3B(double g) {
   gamma3b = g;
 }
@@ -351,6 +415,62 @@ double IntegrateRate(int idist, double eth, double bound,
   }
 }
 
+/*
+** the rates of n transitions sharing the same Rate1E. the
+** parameters of transition t start at params + t*size bytes.
+** for the Maxwellian electrons, if SetRateQuadrature has selected it,
+** the fixed composite Gauss-Legendre rule is used, and the transitions
+** are shared by the threads. the rule is in the energy variable, and
+** does not follow the xlog of the distribution. otherwise each is
+** integrated by IntegrateRate.
+*/
+int IntegrateRates(int idist, int n, double *eth, double *bound,
+		   int np, void *params, int size, int *i0, int *f0,
+		   int type, double (*Rate1E)(double, double, int, void *),
+		   double *r) {
+  const double maxwell_const = 1.12837967;
+  DISTRIBUTION *d;
+  double te, emin, emax, a, x, y, ymax, s;
+  char *p;
+  int t, k, nq;
+
+  p = (char *) params;
+  if (rate_quad == 0 || idist != 0 || iedist != 0) {
+    for (t = 0; t < n; t++) {
+      r[t] = IntegrateRate(idist, eth[t], bound[t], np, p + t*size,
+			   i0[t], f0[t], type, Rate1E);
+    }
+    return 0;
+  }
+
+  d = ele_dist + iedist;
+  te = d->params[0];
+  emin = d->params[1];
+  emax = d->params[2];
+  nq = RATE_PANELS*rate_quad;
+  /* with x = a + te*y, the maxwellian is sqrt(x/te)*exp(-a/te-y)/te */
+#pragma omp parallel for private(t, k, a, x, y, ymax, s) schedule(dynamic, 16)
+  for (t = 0; t < n; t++) {
+    a = bound[t];
+    if (a < emin) a = emin;
+    s = 0.0;
+    if (a < emax) {
+      ymax = (emax - a)/te;
+      if (ymax > RATE_YMAX) ymax = RATE_YMAX;
+      for (k = 0; k < nq; k++) {
+	y = ymax*quad_x[k];
+	x = a + te*y;
+	s += quad_w[k]*sqrt(x/te)*exp(-y)*Rate1E(x, eth[t], np, p + t*size);
+      }
+      s *= ymax*maxwell_const*exp(-a/te);
+    }
+    if (s < 0.0) s = 0.0;
+    r[t] = s;
+  }
+  
+  return 0;
+}
+
 double IntegrateRate2(int idist, double e, int np, 
 		      void *params, int i0, int f0, int type,
 		      double (*Rate1E)(double, double, double, int, void *)) { 
@@ -538,30 +658,49 @@ double DERate1E(double e1, double eth0, int np, void *p) {
   return a;
 }
   
-int CERate(double *dir, double *inv, int iinv, 
-	   int j1, int j2, double e,
-	   int m, double *params, int i0, int f0) {
-  double a, e0;
-
-  e0 = e*HARTREE_EV;	     
-  a = IntegrateRate(0, e0, e0/BornMass(), m, params, 
-		    i0, f0, RT_CE, CERate1E);
-  *dir = a/(j1 + 1.0);
-  if (iinv) {
-    if (iedist == 0) {
-      a *= exp(e0/ele_dist[0].params[0]);
-      *inv = a/(j2 + 1.0);
+int CERates(int n, double *dir, double *inv, int iinv, 
+	    int *j1, int *j2, double *e, int m, double *params, int size,
+	    int *i0, int *f0) {
+  double a, *e0, *b;
+  int t;
+
+  e0 = (double *) malloc(sizeof(double)*2*n);
+  b = e0 + n;
+  for (t = 0; t < n; t++) {
+    e0[t] = e[t]*HARTREE_EV;
+    b[t] = e0[t]/BornMass();
+  }
+  IntegrateRates(0, n, e0, b, m, params, sizeof(double)*size, 
+		 i0, f0, RT_CE, CERate1E, dir);
+  if (iinv && iedist != 0) {
+    for (t = 0; t < n; t++) b[t] = 0.0;
+    IntegrateRates(0, n, e0, b, m, params, sizeof(double)*size, 
+		   i0, f0, -RT_CE, DERate1E, inv);
+  }
+  for (t = 0; t < n; t++) {
+    a = dir[t];
+    dir[t] = a/(j1[t] + 1.0);
+    if (iinv) {
+      if (iedist == 0) {
+	a *= exp(e0[t]/ele_dist[0].params[0]);
+	inv[t] = a/(j2[t] + 1.0);
+      } else {
+	inv[t] /= (j2[t] + 1.0);
+      }
     } else {
-      *inv = IntegrateRate(0, e0, 0.0, m, params, 
-			   i0, f0, -RT_CE, DERate1E);
-      *inv /= (j2 + 1.0);
+      inv[t] = 0.0;
     }
-  } else {
-    *inv = 0.0;
   }
+  free(e0);
   return 0;
 }
 
+int CERate(double *dir, double *inv, int iinv, 
+	   int j1, int j2, double e,
+	   int m, double *params, int i0, int f0) {
+  return CERates(1, dir, inv, iinv, &j1, &j2, &e, m, params, 0, &i0, &f0);
+}
+
 int TRRate(double *dir, double *inv, int iinv,
 	   int j1, int j2, double e, float strength) {
   double a, b, e0;
@@ -613,32 +752,48 @@ double CIRate1E(double e, double eth, int np, void *p) {
   return c;
 }
 
-int CIRate(double *dir, double *inv, int iinv, 
-	   int j1, int j2, double e,
-	   int m, float *params, int i0, int f0) {
+int CIRates(int n, double *dir, double *inv, int iinv, 
+	    int *j1, int *j2, double *e, int m, float *params, int size,
+	    int *i0, int *f0) {
   const double p = 1.65156E-12; /* 0.5*(h^2/(2pi*m*eV))^{3/2} */
-  double e0, a;
-  
-  e0 = e*HARTREE_EV;
-  a = IntegrateRate(0, e0, e0, m, params, 
-		    i0, f0, RT_CI, CIRate1E);
-  *dir = a/(j1 + 1.0);
-  if (iinv) {
-    if (iedist == 0) {
-      a *= exp(e0/ele_dist[0].params[0]);
-      *inv = p*pow(ele_dist[0].params[0], -1.5)*a;
-      *inv /= (j2 + 1.0); 
+  double a, *e0;
+  int t;
+
+  e0 = (double *) malloc(sizeof(double)*n);
+  for (t = 0; t < n; t++) {
+    e0[t] = e[t]*HARTREE_EV;
+  }
+  IntegrateRates(0, n, e0, e0, m, params, sizeof(float)*size, 
+		 i0, f0, RT_CI, CIRate1E, dir);
+  if (iinv && iedist != 0) {
+    IntegrateRates(0, n, e0, e0, m, params, sizeof(float)*size, 
+		   i0, f0, -RT_CI, CIRate1E, inv);
+  }
+  for (t = 0; t < n; t++) {
+    a = dir[t];
+    dir[t] = a/(j1[t] + 1.0);
+    if (iinv) {
+      if (iedist == 0) {
+	a *= exp(e0[t]/ele_dist[0].params[0]);
+	inv[t] = p*pow(ele_dist[0].params[0], -1.5)*a;
+	inv[t] /= (j2[t] + 1.0); 
+      } else {
+	inv[t] /= (j2[t] + 1.0);
+      }
     } else {
-      a = IntegrateRate(0, e0, e0, m, params, i0, f0,
-			-RT_CI, CIRate1E);
-      *inv = a/(j2+1.0);
+      inv[t] = 0.0;
     }
-  } else {
-    *inv = 0.0;
   }
+  free(e0);
   return 0;
 }
 
+int CIRate(double *dir, double *inv, int iinv, 
+	   int j1, int j2, double e,
+	   int m, float *params, int i0, int f0) {
+  return CIRates(1, dir, inv, iinv, &j1, &j2, &e, m, params, 0, &i0, &f0);
+}
+
 double RRRateHydrogenic(double t, double z, int n, double *top) {
   const double a = 5.197E-4;
   const double b = HARTREE_EV/2.0;
@@ -814,25 +969,42 @@ double PIRateKramers(double e, double eth, int np, void *p) {
   return c;
 }
  
-int RRRate(double *dir, double *inv, int iinv, 
-	   int j1, int j2, double e,
-	   int m, double *params, int i0, int f0) {
-  double e0;
-
-  e0 = e*HARTREE_EV;	
-  *dir = IntegrateRate(0, e0, 0.0, m, params, 
-		       i0, f0, RT_RR, RRRate1E);
-  *dir /= (j1 + 1.0);
+int RRRates(int n, double *dir, double *inv, int iinv, 
+	    int *j1, int *j2, double *e, int m, double *params, int size,
+	    int *i0, int *f0) {
+  double *e0, *b;
+  int t;
+
+  e0 = (double *) malloc(sizeof(double)*2*n);
+  b = e0 + n;
+  for (t = 0; t < n; t++) {
+    e0[t] = e[t]*HARTREE_EV;
+    b[t] = 0.0;
+  }
+  IntegrateRates(0, n, e0, b, m, params, sizeof(double)*size, 
+		 i0, f0, RT_RR, RRRate1E, dir);
   if (iinv) {
-    *inv = IntegrateRate(1, e0, e0, m, params, 
-			 i0, f0, -RT_RR, PIRate1E);
-    *inv /= (j2 + 1.0);
-  } else {
-    *inv = 0.0;
+    IntegrateRates(1, n, e0, e0, m, params, sizeof(double)*size, 
+		   i0, f0, -RT_RR, PIRate1E, inv);
   }
+  for (t = 0; t < n; t++) {
+    dir[t] /= (j1[t] + 1.0);
+    if (iinv) {
+      inv[t] /= (j2[t] + 1.0);
+    } else {
+      inv[t] = 0.0;
+    }
+  }
+  free(e0);
   return 0;
 }
 
+int RRRate(double *dir, double *inv, int iinv, 
+	   int j1, int j2, double e,
+	   int m, double *params, int i0, int f0) {
+  return RRRates(1, dir, inv, iinv, &j1, &j2, &e, m, params, 0, &i0, &f0);
+}
+
 int AIRate(double *dir, double *inv, int iinv, 
 	   int j1, int j2, double e, float rate) {
   double a, e0;
@@ -1793,6 +1965,7 @@ int InitRates(void) {
   rate_args.epsabs = EPS8;
   rate_args.epsrel = EPS3;
   rate_args.iprint = 1;
+  SetRateQuadrature(0);
 
   for (i = 0; i < NSEATON; i++) {
     log_xseaton[i] = log(xseaton[i]);
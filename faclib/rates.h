@@ -52,12 +52,20 @@ int SetRateAccuracy(double epsrel, double epsabs);
 double IntegrateRate(int idist, double eth, double bound, 
 		     int np, void *params, int i0, int f0, int type,
 		     double (*Rate1E)(double, double, int, void *));
+int SetRateQuadrature(int n);
+int IntegrateRates(int idist, int n, double *eth, double *bound,
+		   int np, void *params, int size, int *i0, int *f0,
+		   int type, double (*Rate1E)(double, double, int, void *),
+		   double *r);
 double IntegrateRate2(int idist, double e, int np, 
 		      void *params, int i0, int f0, int type,
 		      double (*Rate2E)(double, double, double, int, void *));
 
 double CERate1E(double e, double eth, int np, void *p);
 double DERate1E(double e, double eth, int np, void *p);
+int CERates(int n, double *dir, double *inv, int iinv, 
+	    int *j1, int *j2, double *e, int m, double *params, int size,
+	    int *i0, int *f0);
 int CERate(double *dir, double *inv, int iinv, 
 	   int j1, int j2, double e,
 	   int m, double *params, int i0, int f0);
@@ -66,6 +74,9 @@ int TRRate(double *dir, double *inv, int iinv,
 	   int j1, int j2, double e, float strength);
 
 double CIRate1E(double e, double eth, int np, void *p);
+int CIRates(int n, double *dir, double *inv, int iinv, 
+	    int *j1, int *j2, double *e, int m, float *params, int size,
+	    int *i0, int *f0);
 int CIRate(double *dir, double *inv, int iinv, 
 	   int j1, int j2, double e,
 	   int m, float *params, int i0, int f0);
@@ -73,6 +84,9 @@ double RRRateHydrogenic(double t, double z, int n, double *top);
 double RRRate1E(double e, double eth, int np, void *p);
 double PIRate1E(double e, double eth, int np, void *p);
 double PIRateKramers(double e, double eth, int np, void *p);
+int RRRates(int n, double *dir, double *inv, int iinv, 
+	    int *j1, int *j2, double *e, int m, double *params, int size,
+	    int *i0, int *f0);
 int RRRate(double *dir, double *inv, int iinv, 
 	   int j1, int j2, double e,
 	   int m, double *params, int i0, int f0);
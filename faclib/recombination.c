@@ -2389,7 +2389,6 @@ int FreeRecPk(void) {
 }
 
 int FreeRecQk(void) {
-  if (qk_array->array == NULL) return 0;
   MultiFreeData(qk_array, FreeRecPkData);
   return 0;
 }
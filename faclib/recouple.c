@@ -80,6 +80,7 @@ static void InitInteractDatum(void *p, int n) {
   d = (INTERACT_DATUM *) p;
   for (i = 0; i < n; i++) {
     d[i].n_shells = 0;
+    d[i].ifb = 0;
     d[i].bra = NULL;
   }
 }
@@ -1433,6 +1434,7 @@ int InteractingShells(INTERACT_DATUM **idatum,
       j < cj->n_shells) {
     free(bra);
     bra = NULL;
+    (*idatum)->bra = NULL;
     n_shells = -1;
     goto END;
   }    
@@ -1532,6 +1534,325 @@ void CompactInteractShell(char c[4], INTERACT_SHELL *s, int m) {
   }
 }
 
+/* 
+** FUNCTION:    PublishInteract
+** PURPOSE:     store an INTERACT_DATUM built by one thread into
+**              the shared interact_shells array.
+** INPUT:       {INTERACT_DATUM *d},
+**              the datum in the array.
+**              {INTERACT_DATUM *t},
+**              the datum just built.
+** RETURN:      
+** SIDE EFFECT: t->bra is taken over or freed.
+** NOTE:        n_shells is set last, readers only look at the 
+**              other fields once n_shells is nonzero.
+*/
+static void PublishInteract(INTERACT_DATUM *d, INTERACT_DATUM *t) {
+#pragma omp critical(recouple_interact)
+  {
+    if (d->n_shells == 0) {
+      if (t->n_shells > 0) {
+	d->bra = t->bra;
+	memcpy(d->s, t->s, sizeof(INTERACT_SHELL)*4);
+	d->phase = t->phase;
+      } else {
+	free(t->bra);
+      }
+      d->ifb = t->ifb;
+#pragma omp flush
+      d->n_shells = t->n_shells;
+    } else {
+      free(t->bra);
+    }
+  }
+}
+
+/*
+** the store of the interacting shells. they only depend on the 
+** shells of the two configurations, so they are kept in the angular
+** store of SaveAngZ and LoadAngZ as well, addressed by the content 
+** of the configurations. the store is a section of ints, {nrec, 
+** nidx}, the records, and at nidx the index of nrec {key, offset} 
+** sorted by the key, where nidx and offset count ints from the start
+** of the section. each record has {nd, n_shells, phase, 0}, the nd 
+** ints of the descriptor, and if n_shells > 0, the 4 interacting 
+** shells of 7 ints each and the n_shells shells of the bra of 3 ints
+** each. the descriptor is ifb, and the number of shells and the 
+** (n, kappa, nq) of the shells of each configuration.
+*/
+#define INTERACT_RECHEAD 4
+
+typedef struct _INTERACT_INDEX_ {
+  unsigned int key;
+  int offset;
+} INTERACT_INDEX;
+
+static struct {
+  int *map;
+  int nrec;
+  INTERACT_INDEX *index;
+} interact_store = {NULL, 0, NULL};
+
+typedef struct _INTERACT_WRITER_ {
+  FILE *f;
+  long start;
+  int nrec, mrec;
+  INTERACT_INDEX *index;
+  char *found;
+} INTERACT_WRITER;
+
+/* FNV-1a hash of the descriptor d. */
+static unsigned int InteractHash(int n, int *d) {
+  unsigned int h;
+  int i;
+
+  h = 2166136261U;
+  for (i = 0; i < n; i++) {
+    h ^= (unsigned int) d[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+/*
+** the descriptor of the configurations ci and cj, allocated in d.
+** returns the number of ints.
+*/
+static int InteractDescriptor(CONFIG *ci, CONFIG *cj, int ifb, int **d) {
+  int i, n, *t;
+
+  n = 3 + 3*(ci->n_shells + cj->n_shells);
+  *d = (int *) malloc(sizeof(int)*n);
+  t = *d;
+  t[0] = ifb;
+  t[1] = ci->n_shells;
+  t += 2;
+  for (i = 0; i < ci->n_shells; i++) {
+    t[0] = ci->shells[i].n;
+    t[1] = ci->shells[i].kappa;
+    t[2] = ci->shells[i].nq;
+    t += 3;
+  }
+  t[0] = cj->n_shells;
+  t++;
+  for (i = 0; i < cj->n_shells; i++) {
+    t[0] = cj->shells[i].n;
+    t[1] = cj->shells[i].kappa;
+    t[2] = cj->shells[i].nq;
+    t += 3;
+  }
+  return n;
+}
+
+/* number of ints of the record r. */
+static int InteractRecordSize(int *r) {
+  int n;
+
+  n = INTERACT_RECHEAD + r[0];
+  if (r[1] > 0) n += 28 + 3*r[1];
+  return n;
+}
+
+static int CompareInteractIndex(const void *p1, const void *p2) {
+  unsigned int k1, k2;
+
+  k1 = ((INTERACT_INDEX *) p1)->key;
+  k2 = ((INTERACT_INDEX *) p2)->key;
+  if (k1 < k2) return -1;
+  if (k1 > k2) return 1;
+  return 0;
+}
+
+/* position in the index of the store of the descriptor d, or -1. */
+static int FindInteractRecord(int nd, int *d) {
+  unsigned int h;
+  int i0, i1, i, *r;
+
+  h = InteractHash(nd, d);
+  i0 = 0;
+  i1 = interact_store.nrec;
+  while (i0 < i1) {
+    i = (i0 + i1)/2;
+    if (interact_store.index[i].key < h) i0 = i + 1;
+    else i1 = i;
+  }
+  for (i = i0; i < interact_store.nrec; i++) {
+    if (interact_store.index[i].key != h) break;
+    r = interact_store.map + interact_store.index[i].offset;
+    if (r[0] == nd && memcmp(r+INTERACT_RECHEAD, d, sizeof(int)*nd) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* 
+** FUNCTION:    SetInteractStore
+** PURPOSE:     set the section of the interacting shells of the 
+**              angular store.
+** INPUT:       {int *p},
+**              the start of the section, NULL to clear the store.
+** RETURN:      
+** SIDE EFFECT: 
+** NOTE:        the memory stays owned by the caller.
+*/
+void SetInteractStore(int *p) {
+  if (p == NULL || p[0] <= 0) {
+    interact_store.map = NULL;
+    interact_store.nrec = 0;
+    interact_store.index = NULL;
+    return;
+  }
+  interact_store.map = p;
+  interact_store.nrec = p[0];
+  interact_store.index = (INTERACT_INDEX *) (p + p[1]);
+}
+
+/*
+** the interacting shells of ci and cj in the store are published
+** into d, if they are there.
+*/
+static void LookupInteract(INTERACT_DATUM *d, CONFIG *ci, CONFIG *cj,
+			   int ifb) {
+  INTERACT_DATUM t;
+  int nd, *dd, *r, i;
+
+  if (interact_store.nrec == 0) return;
+  nd = InteractDescriptor(ci, cj, ifb, &dd);
+  i = FindInteractRecord(nd, dd);
+  free(dd);
+  if (i < 0) return;
+  r = interact_store.map + interact_store.index[i].offset;
+  t.n_shells = r[1];
+  t.phase = r[2];
+  t.ifb = ifb;
+  t.bra = NULL;
+  if (t.n_shells > 0) {
+    r += INTERACT_RECHEAD + nd;
+    for (i = 0; i < 4; i++) {
+      t.s[i].index = r[0];
+      t.s[i].n = r[1];
+      t.s[i].j = r[2];
+      t.s[i].kl = r[3];
+      t.s[i].kappa = r[4];
+      t.s[i].nq_bra = r[5];
+      t.s[i].nq_ket = r[6];
+      r += 7;
+    }
+    t.bra = (SHELL *) malloc(sizeof(SHELL)*t.n_shells);
+    for (i = 0; i < t.n_shells; i++) {
+      t.bra[i].n = r[0];
+      t.bra[i].kappa = r[1];
+      t.bra[i].nq = r[2];
+      r += 3;
+    }
+  }
+  PublishInteract(d, &t);
+}
+
+static void AddInteractIndex(INTERACT_WRITER *w, unsigned int key) {
+  if (w->nrec == w->mrec) {
+    w->mrec = 2*w->mrec + 1024;
+    w->index = (INTERACT_INDEX *) realloc(w->index, 
+					  sizeof(INTERACT_INDEX)*w->mrec);
+  }
+  w->index[w->nrec].key = key;
+  w->index[w->nrec].offset = (ftell(w->f) - w->start)/sizeof(int);
+  w->nrec++;
+}
+
+static int WriteInteractElem(int *k, void *p, void *arg) {
+  INTERACT_WRITER *w;
+  INTERACT_DATUM *d;
+  CONFIG *ci, *cj;
+  int nd, *dd, i, iw[7];
+
+  w = (INTERACT_WRITER *) arg;
+  d = (INTERACT_DATUM *) p;
+  if (d->n_shells == 0) return 0;
+  ci = GetConfigFromGroup(k[0], k[2]);
+  cj = GetConfigFromGroup(k[1], k[3]);
+  if (ci == NULL || cj == NULL) return 0;
+  nd = InteractDescriptor(ci, cj, d->ifb, &dd);
+  i = FindInteractRecord(nd, dd);
+  if (i >= 0) w->found[i] = 1;
+  AddInteractIndex(w, InteractHash(nd, dd));
+  iw[0] = nd;
+  iw[1] = d->n_shells;
+  iw[2] = (d->n_shells > 0)? d->phase : 0;
+  iw[3] = 0;
+  fwrite(iw, sizeof(int), INTERACT_RECHEAD, w->f);
+  fwrite(dd, sizeof(int), nd, w->f);
+  free(dd);
+  if (d->n_shells > 0) {
+    for (i = 0; i < 4; i++) {
+      iw[0] = d->s[i].index;
+      iw[1] = d->s[i].n;
+      iw[2] = d->s[i].j;
+      iw[3] = d->s[i].kl;
+      iw[4] = d->s[i].kappa;
+      iw[5] = d->s[i].nq_bra;
+      iw[6] = d->s[i].nq_ket;
+      fwrite(iw, sizeof(int), 7, w->f);
+    }
+    for (i = 0; i < d->n_shells; i++) {
+      iw[0] = d->bra[i].n;
+      iw[1] = d->bra[i].kappa;
+      iw[2] = d->bra[i].nq;
+      fwrite(iw, sizeof(int), 3, w->f);
+    }
+  }
+  return 0;
+}
+
+/* 
+** FUNCTION:    WriteInteractStore
+** PURPOSE:     write the section of the interacting shells of the 
+**              angular store.
+** INPUT:       {FILE *f},
+**              the file, positioned at the start of the section.
+** RETURN:      {int},
+**              number of records written.
+** SIDE EFFECT: 
+** NOTE:        the records of the current store that were not 
+**              computed again are copied over.
+*/
+int WriteInteractStore(FILE *f) {
+  INTERACT_WRITER w;
+  int i, n, *r, hdr[2];
+
+  w.f = f;
+  w.start = ftell(f);
+  w.nrec = 0;
+  w.mrec = 0;
+  w.index = NULL;
+  w.found = (char *) calloc(interact_store.nrec+1, sizeof(char));
+  hdr[0] = 0;
+  hdr[1] = 0;
+  fwrite(hdr, sizeof(int), 2, f);
+  MultiWalk(interact_shells, WriteInteractElem, &w);
+  for (i = 0; i < interact_store.nrec; i++) {
+    if (w.found[i]) continue;
+    r = interact_store.map + interact_store.index[i].offset;
+    n = InteractRecordSize(r);
+    AddInteractIndex(&w, interact_store.index[i].key);
+    fwrite(r, sizeof(int), n, f);
+  }
+  if (w.nrec > 1) {
+    qsort(w.index, w.nrec, sizeof(INTERACT_INDEX), CompareInteractIndex);
+  }
+  hdr[0] = w.nrec;
+  hdr[1] = (ftell(f) - w.start)/sizeof(int);
+  fwrite(w.index, sizeof(INTERACT_INDEX), w.nrec, f);
+  fseek(f, w.start, SEEK_SET);
+  fwrite(hdr, sizeof(int), 2, f);
+  fseek(f, 0, SEEK_END);
+  free(w.found);
+  if (w.index) free(w.index);
+
+  return w.nrec;
+}
+
 /* 
 ** FUNCTION:    GetInteract
 ** PURPOSE:     determing which shells can be interacting.
@@ -1551,6 +1872,7 @@ int GetInteract(INTERACT_DATUM **idatum,
   SHELL_STATE *csf_i, *csf_j, *csf_ip;
   SHELL *bra;
   INTERACT_SHELL *s;
+  INTERACT_DATUM tdatum, *pdatum, **qdatum;
   int n_shells;
   int index[4];
 
@@ -1585,6 +1907,9 @@ int GetInteract(INTERACT_DATUM **idatum,
 					      NULL, InitInteractDatum, 
 					      FreeInteractDatum);
     }
+    if ((*idatum)->n_shells == 0) {
+      LookupInteract(*idatum, ci, cj, ifb);
+    }
     if ((*idatum)->n_shells < 0) return -1;
   } else {
     (*idatum) = malloc(sizeof(INTERACT_DATUM));
@@ -1626,6 +1951,16 @@ int GetInteract(INTERACT_DATUM **idatum,
       (*sbra)[0].Nr = 0;
     }
   } else {
+    /* the cached datum is built in a local copy and published when
+       complete, since other threads may be reading it. */
+    qdatum = idatum;
+    if (csf_i != NULL) {
+      tdatum.n_shells = 0;
+      tdatum.ifb = ifb;
+      tdatum.bra = NULL;
+      pdatum = &tdatum;
+      qdatum = &pdatum;
+    }
     if (ifb) {
       cip.n_shells = ci->n_shells + 1;
       cip.shells = malloc(sizeof(SHELL)*cip.n_shells);
@@ -1646,16 +1981,19 @@ int GetInteract(INTERACT_DATUM **idatum,
 	cip.n_csfs = 0;
 	csf_ip = NULL;
       }
-      n_shells = InteractingShells(idatum, sbra, sket, 
+      n_shells = InteractingShells(qdatum, sbra, sket, 
 				   &cip, cj, csf_ip, csf_j);
       free(cip.shells);
       if (csf_i) {
 	free(cip.csfs);
       }
     } else {
-      n_shells = InteractingShells(idatum, sbra, sket, 
+      n_shells = InteractingShells(qdatum, sbra, sket, 
 				   ci, cj, csf_i, csf_j);
     }
+    if (csf_i != NULL) {
+      PublishInteract(*idatum, &tdatum);
+    }
   }
 
   if (n_shells < 0 && csf_i == NULL) {
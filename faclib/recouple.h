@@ -113,6 +113,8 @@ typedef struct _INTERACT_SHELL_ {
 **              {short phase},
 **              the phase resulting from the decoupling that depends
 **              on the shell structure of the states.
+**              {short ifb},
+**              whether a free electron was added to the bra.
 ** NOTE:        
 */
 typedef struct _INTERACT_DATUM_ {
@@ -120,6 +122,7 @@ typedef struct _INTERACT_DATUM_ {
   INTERACT_SHELL s[4];
   short n_shells;
   short phase;
+  short ifb;
 } INTERACT_DATUM;
 
 #define MAXJ 80
@@ -198,6 +201,8 @@ int GetInteract(INTERACT_DATUM **idatum,
 		int kci, int kcj, 
 		int ki, int kj, int bf);
 void CompactInteractShell(char c[4], INTERACT_SHELL *s, int m);
+void SetInteractStore(int *p);
+int WriteInteractStore(FILE *f);
 
 /* only compile these test routines if the debug flag is on */
 void    TestAngular(void);
@@ -18,6 +18,10 @@
 
 #include "rmatrix.h"
 #include "cf77.h"
+#include <unistd.h>
+#ifdef _POSIX_MAPPED_FILES
+#include <sys/mman.h>
+#endif
 
 static char *rcsid="$Id: rmatrix.c,v 1.8 2004/12/23 21:31:03 mfgu Exp $";
 #if __GNUC__ == 2
@@ -29,6 +33,7 @@ static RBASIS rbasis;
 static int ntg, *tg, nts, *ts;
 static int ncg, *cg, ncs, *cs;
 static DCFG dcfg;
+#pragma omp threadprivate(dcfg)
 static int nbatch;
 static int fmode;
 
@@ -113,7 +118,7 @@ void ReadRMatrixBasis(char *fn, RBASIS *rbs, int fmt) {
   int i, j, k, n, kappa, m, nr;
 
   f = fopen(fn, "r");
-  if (fmt == 0) {
+  if (fmt != 1) {
     nr = fread(&(rbs->ib0), sizeof(int), 1, f);
     nr = fread(&(rbs->rb0), sizeof(double), 1, f);
     nr = fread(&(rbs->ib1), sizeof(int), 1, f);
@@ -206,7 +211,7 @@ void WriteRMatrixBasis(char *fn, int fmt) {
   f = fopen(fn, "w");
   if (f == NULL) return;
 
-  if (fmt == 0) {
+  if (fmt != 1) {
     nr = fwrite(&(rbasis.ib0), sizeof(int), 1, f);
     nr = fwrite(&(rbasis.rb0), sizeof(double), 1, f);
     nr = fwrite(&(rbasis.ib1), sizeof(int), 1, f);
@@ -554,9 +559,40 @@ void RMatrixTargets(int nt, int *kt, int nc, int *kc) {
   memcpy(cg, kc, sizeof(int)*ncg);
 }
 
-void ClearRMatrixSurface(RMATRIX *rmx) {
+/*
+** release the data of the current symmetry. with a mapped surface
+** file, only the R-matrix workspace is allocated.
+*/
+static void ClearSurfaceSymmetry(RMATRIX *rmx) {
   int i;
 
+  if (rmx->ndim > 0 && rmx->map == NULL) free(rmx->ek);
+  if (rmx->nchan0 > 0) {
+    for (i = 0; i < rmx->nchan0; i++) {
+      if (rmx->map == NULL) {
+	free(rmx->w0[rmx->chans[i]]);
+	free(rmx->w1[rmx->chans[i]]);
+      }
+      rmx->w0[rmx->chans[i]] = NULL;
+      rmx->w1[rmx->chans[i]] = NULL;
+    }
+    for (i = 0; i < 3; i++) {
+      free(rmx->rmatrix[i]);
+    }
+    if (rmx->map == NULL) {
+      free(rmx->chans);
+      free(rmx->ilev);
+      free(rmx->kappa);
+      for (i = 0; i < rmx->nlam; i++) {
+	free(rmx->aij[i]);
+      }
+    }
+  }
+  rmx->ndim = 0;
+  rmx->nchan0 = 0;
+}
+
+void ClearRMatrixSurface(RMATRIX *rmx) {
   if (rmx->nts > 0) {
     free(rmx->et);
     free(rmx->ts);
@@ -567,38 +603,52 @@ void ClearRMatrixSurface(RMATRIX *rmx) {
     free(rmx->cs);
     free(rmx->jcs);
   }
-  if (rmx->ndim > 0) free(rmx->ek);
-  if (rmx->nchan0 > 0) {
-    for (i = 0; i < rmx->nchan0; i++) {
-      free(rmx->w0[rmx->chans[i]]);
-      free(rmx->w1[rmx->chans[i]]);
-    }
-    free(rmx->chans);
-    for (i = 0; i < rmx->nlam; i++) {
-      free(rmx->aij[i]);
-    }
-    for (i = 0; i < 3; i++) {
-      free(rmx->rmatrix[i]);
-    }
-  }
+  ClearSurfaceSymmetry(rmx);
   if (rmx->nlam > 0) free(rmx->aij);
+  if (rmx->map) {
+#ifdef _POSIX_MAPPED_FILES
+    if (rmx->mmapped) munmap(rmx->map, rmx->msize);
+    else free(rmx->map);
+#else
+    free(rmx->map);
+#endif
+    free(rmx->moffset);
+    rmx->map = NULL;
+  }
 }  
   
 int ReadRMatrixSurface(FILE *f, RMATRIX *rmx, int m, int fmt) {
   int nkappa, isym, nsym, p, j;
   int n, nchan, mchan, nchan0, ndim, i, k, t, ilam;
-  int k1, k2, k3, k4, ierr;
+  int k1, k2, k3, k4, ierr, hdr[8];
   double a, b, z;
 
-  if (fmt == 0) {
+  if (m == 0) {
+    rmx->map = NULL;
+    rmx->msize = 0;
+    rmx->moffset = NULL;
+    rmx->mmapped = 0;
+  }
+  if (fmt != 1) {
     if (m == 0) {
-      ierr = fread(&nsym, sizeof(int), 1, f);
-      ierr = fread(&mchan, sizeof(int), 1, f);
-      ierr = fread(&nts, sizeof(int), 1, f);
-      ierr = fread(&ncs, sizeof(int), 1, f);
-      ierr = fread(&nkappa, sizeof(int), 1, f);
-      ierr = fread(&z, sizeof(double), 1, f);
-      ierr = fread(&(rmx->nlam), sizeof(int), 1, f);
+      if (fmt == 2) {
+	ierr = fread(hdr, sizeof(int), 8, f);
+	nsym = hdr[0];
+	mchan = hdr[1];
+	nts = hdr[2];
+	ncs = hdr[3];
+	nkappa = hdr[4];
+	rmx->nlam = hdr[5];
+	ierr = fread(&z, sizeof(double), 1, f);
+      } else {
+	ierr = fread(&nsym, sizeof(int), 1, f);
+	ierr = fread(&mchan, sizeof(int), 1, f);
+	ierr = fread(&nts, sizeof(int), 1, f);
+	ierr = fread(&ncs, sizeof(int), 1, f);
+	ierr = fread(&nkappa, sizeof(int), 1, f);
+	ierr = fread(&z, sizeof(double), 1, f);
+	ierr = fread(&(rmx->nlam), sizeof(int), 1, f);
+      }
       rmx->nsym = nsym;
       rmx->mchan = mchan;
       rmx->nts = nts;
@@ -640,30 +690,22 @@ int ReadRMatrixSurface(FILE *f, RMATRIX *rmx, int m, int fmt) {
       return 0;
     }
     
-    if (rmx->ndim > 0) free(rmx->ek);
-    if (rmx->nchan0 > 0) {
-      for (i = 0; i < rmx->nchan0; i++) {
-	free(rmx->w0[rmx->chans[i]]);
-	free(rmx->w1[rmx->chans[i]]);
-	rmx->w0[rmx->chans[i]] = NULL;
-	rmx->w1[rmx->chans[i]] = NULL;
-      }
-      free(rmx->chans);
-      free(rmx->ilev);
-      free(rmx->kappa);
-      for (i = 0; i < 3; i++) {
-	free(rmx->rmatrix[i]);
-      }
-      for (i = 0; i < rmx->nlam; i++) {
-	free(rmx->aij[i]);
-      }
-    }
+    ClearSurfaceSymmetry(rmx);
     
-    ierr = fread(&isym, sizeof(int), 1, f);
-    ierr = fread(&p, sizeof(int), 1, f);
-    ierr = fread(&j, sizeof(int), 1, f);
-    ierr = fread(&ndim, sizeof(int), 1, f);
-    ierr = fread(&nchan0, sizeof(int), 1, f);
+    if (fmt == 2) {
+      ierr = fread(hdr, sizeof(int), 8, f);
+      isym = hdr[0];
+      p = hdr[1];
+      j = hdr[2];
+      ndim = hdr[3];
+      nchan0 = hdr[4];
+    } else {
+      ierr = fread(&isym, sizeof(int), 1, f);
+      ierr = fread(&p, sizeof(int), 1, f);
+      ierr = fread(&j, sizeof(int), 1, f);
+      ierr = fread(&ndim, sizeof(int), 1, f);
+      ierr = fread(&nchan0, sizeof(int), 1, f);
+    }
     rmx->isym = isym;
     rmx->p = p;
     rmx->j = j;
@@ -680,15 +722,34 @@ int ReadRMatrixSurface(FILE *f, RMATRIX *rmx, int m, int fmt) {
       rmx->aij[i] = malloc(sizeof(double)*nchan0*nchan0);
     }
     ierr = fread(rmx->ek, sizeof(double), ndim, f);
-    for (i = 0; i < nchan0; i++) {
-      ierr = fread(&(rmx->chans[i]), sizeof(int), 1, f);
-      ierr = fread(&(rmx->ilev[i]), sizeof(int), 1, f);
-      ierr = fread(&(rmx->kappa[i]), sizeof(int), 1, f);
+    if (fmt == 2) {
+      ierr = fread(rmx->chans, sizeof(int), nchan0, f);
+      ierr = fread(rmx->ilev, sizeof(int), nchan0, f);
+      ierr = fread(rmx->kappa, sizeof(int), nchan0, f);
+      if (nchan0 & 1) ierr = fread(&k, sizeof(int), 1, f);
+    } else {
+      for (i = 0; i < nchan0; i++) {
+	ierr = fread(&(rmx->chans[i]), sizeof(int), 1, f);
+	ierr = fread(&(rmx->ilev[i]), sizeof(int), 1, f);
+	ierr = fread(&(rmx->kappa[i]), sizeof(int), 1, f);
+      }
     }
     for (i = 0; i < nchan0; i++) {
       rmx->w0[rmx->chans[i]] = malloc(sizeof(double)*ndim);
       rmx->w1[rmx->chans[i]] = malloc(sizeof(double)*ndim);
     }
+    if (fmt == 2) {
+      for (ilam = 0; ilam < rmx->nlam; ilam++) {
+	ierr = fread(rmx->aij[ilam], sizeof(double), nchan0*nchan0, f);
+      }
+      for (i = 0; i < nchan0; i++) {
+	ierr = fread(rmx->w0[rmx->chans[i]], sizeof(double), ndim, f);
+      }
+      for (i = 0; i < nchan0; i++) {
+	ierr = fread(rmx->w1[rmx->chans[i]], sizeof(double), ndim, f);
+      }
+      return 0;
+    }
     for (ilam = 0; ilam < rmx->nlam; ilam++) {
       for (i = 0; i < nchan0; i++) {
 	for (t = 0; t <= i; t++) {
@@ -750,24 +811,7 @@ int ReadRMatrixSurface(FILE *f, RMATRIX *rmx, int m, int fmt) {
       return 0;
     }
 
-    if (rmx->ndim > 0) free(rmx->ek);
-    if (rmx->nchan0 > 0) {
-      for (i = 0; i < rmx->nchan0; i++) {
-	free(rmx->w0[rmx->chans[i]]);
-	free(rmx->w1[rmx->chans[i]]);
-	rmx->w0[rmx->chans[i]] = NULL;
-	rmx->w1[rmx->chans[i]] = NULL;
-      }
-      free(rmx->chans);
-      free(rmx->ilev);
-      free(rmx->kappa);
-      for (i = 0; i < 3; i++) {
-	free(rmx->rmatrix[i]);
-      }
-      for (i = 0; i < rmx->nlam; i++) {
-	free(rmx->aij[i]);
-      }
-    }
+    ClearSurfaceSymmetry(rmx);
   
     ierr = fscanf(f, "%d %d %d %d %d\n", &isym, &p, &j, &ndim, &nchan0);
     if (ierr == EOF) {
@@ -827,22 +871,32 @@ int WriteRMatrixSurface(FILE *f, double **wik0, double **wik1, int m,
 			int fmt, RMATRIX *rmx) {
   HAMILTON *h;
   int nchan, t, ic, nchan0, i, k, ilev, ka;
-  int p, j, jc, i1, k1, ilev1, ka1, ilam, nr;
-  double z, a;
+  int p, j, jc, i1, k1, ilev1, ka1, ilam, nr, hdr[8];
+  double z, a, *aij;
   LEVEL *lev;
   
+  for (t = 0; t < 8; t++) hdr[t] = 0;
   if (m == 0) {
     if (rmx == NULL) {
       z = GetAtomicNumber();
       z -= GetNumElectrons(ts[0]);
-      if (fmt == 0) {
-	nr = fwrite(&m, sizeof(int), 1, f);
-	nr = fwrite(&m, sizeof(int), 1, f);
-	nr = fwrite(&nts, sizeof(int), 1, f);
-	nr = fwrite(&ncs, sizeof(int), 1, f);
-	nr = fwrite(&(rbasis.nkappa), sizeof(int), 1, f);
-	nr = fwrite(&z, sizeof(double), 1, f);
-	nr = fwrite(&(dcfg.nmultipoles), sizeof(int), 1, f);
+      if (fmt != 1) {
+	if (fmt == 2) {
+	  hdr[2] = nts;
+	  hdr[3] = ncs;
+	  hdr[4] = rbasis.nkappa;
+	  hdr[5] = dcfg.nmultipoles;
+	  nr = fwrite(hdr, sizeof(int), 8, f);
+	  nr = fwrite(&z, sizeof(double), 1, f);
+	} else {
+	  nr = fwrite(&m, sizeof(int), 1, f);
+	  nr = fwrite(&m, sizeof(int), 1, f);
+	  nr = fwrite(&nts, sizeof(int), 1, f);
+	  nr = fwrite(&ncs, sizeof(int), 1, f);
+	  nr = fwrite(&(rbasis.nkappa), sizeof(int), 1, f);
+	  nr = fwrite(&z, sizeof(double), 1, f);
+	  nr = fwrite(&(dcfg.nmultipoles), sizeof(int), 1, f);
+	}
 	for (t = 0; t < nts; t++) {
 	  ilev = ts[t];
 	  lev = GetLevel(ilev);
@@ -879,14 +933,25 @@ int WriteRMatrixSurface(FILE *f, double **wik0, double **wik1, int m,
       z = rmx->z;
       nts = rmx->nts;
       ncs = rmx->ncs;
-      if (fmt == 0) {
-	nr = fwrite(&(rmx->nsym), sizeof(int), 1, f);
-	nr = fwrite(&(rmx->mchan), sizeof(int), 1, f);
-	nr = fwrite(&nts, sizeof(int), 1, f);
-	nr = fwrite(&ncs, sizeof(int), 1, f);	
-	nr = fwrite(&(rmx->nkappa), sizeof(int), 1, f);
-	nr = fwrite(&z, sizeof(double), 1, f);
-	nr = fwrite(&(rmx->nlam), sizeof(int), 1, f);
+      if (fmt != 1) {
+	if (fmt == 2) {
+	  hdr[0] = rmx->nsym;
+	  hdr[1] = rmx->mchan;
+	  hdr[2] = nts;
+	  hdr[3] = ncs;
+	  hdr[4] = rmx->nkappa;
+	  hdr[5] = rmx->nlam;
+	  nr = fwrite(hdr, sizeof(int), 8, f);
+	  nr = fwrite(&z, sizeof(double), 1, f);
+	} else {
+	  nr = fwrite(&(rmx->nsym), sizeof(int), 1, f);
+	  nr = fwrite(&(rmx->mchan), sizeof(int), 1, f);
+	  nr = fwrite(&nts, sizeof(int), 1, f);
+	  nr = fwrite(&ncs, sizeof(int), 1, f);	
+	  nr = fwrite(&(rmx->nkappa), sizeof(int), 1, f);
+	  nr = fwrite(&z, sizeof(double), 1, f);
+	  nr = fwrite(&(rmx->nlam), sizeof(int), 1, f);
+	}
 	for (t = 0; t < nts; t++) {
 	  nr = fwrite(&(rmx->ts[t]), sizeof(int), 1, f);
 	  nr = fwrite(&(rmx->jts[t]), sizeof(int), 1, f);
@@ -923,7 +988,63 @@ int WriteRMatrixSurface(FILE *f, double **wik0, double **wik1, int m,
     for (ic = 0; ic < nchan; ic++) {
       if (wik1[ic]) nchan0++;
     }
-    if (fmt == 0) {
+    if (fmt == 2) {
+      hdr[0] = h->pj;
+      hdr[1] = p;
+      hdr[2] = j;
+      hdr[3] = h->dim;
+      hdr[4] = nchan0;
+      nr = fwrite(hdr, sizeof(int), 8, f);
+      nr = fwrite(h->mixing, sizeof(double), h->dim, f);
+      for (ic = 0; ic < nchan; ic++) {
+	if (wik1[ic]) nr = fwrite(&ic, sizeof(int), 1, f);
+      }
+      for (ic = 0; ic < nchan; ic++) {
+	if (wik1[ic]) {
+	  i = ic/rbasis.nkappa;
+	  nr = fwrite(&i, sizeof(int), 1, f);
+	}
+      }
+      for (ic = 0; ic < nchan; ic++) {
+	if (wik1[ic]) {
+	  ka = KappaFromIndex(ic%rbasis.nkappa);
+	  nr = fwrite(&ka, sizeof(int), 1, f);
+	}
+      }
+      if (nchan0 & 1) nr = fwrite(&(hdr[5]), sizeof(int), 1, f);
+      aij = malloc(sizeof(double)*nchan0*nchan0);
+      for (ilam = 0; ilam < dcfg.nmultipoles; ilam++) {
+	i = 0;
+	for (ic = 0; ic < nchan; ic++) {
+	  if (wik1[ic] == NULL) continue;
+	  ilev = ts[ic/rbasis.nkappa];
+	  ka = KappaFromIndex(ic%rbasis.nkappa);
+	  t = 0;
+	  for (jc = 0; jc <= ic; jc++) {
+	    if (wik1[jc] == NULL) continue;
+	    ilev1 = ts[jc/rbasis.nkappa];
+	    ka1 = KappaFromIndex(jc%rbasis.nkappa);
+	    a = MultipoleCoeff(h->pj, ilev1, ka1, ilev, ka, ilam+1);
+	    aij[t*nchan0 + i] = a;
+	    aij[i*nchan0 + t] = a;
+	    t++;
+	  }
+	  i++;
+	}
+	nr = fwrite(aij, sizeof(double), nchan0*nchan0, f);
+      }
+      free(aij);
+      for (ic = 0; ic < nchan; ic++) {
+	if (wik1[ic]) nr = fwrite(wik0[ic], sizeof(double), h->dim, f);
+      }
+      for (ic = 0; ic < nchan; ic++) {
+	if (wik1[ic]) nr = fwrite(wik1[ic], sizeof(double), h->dim, f);
+	free(wik0[ic]);
+	free(wik1[ic]);
+	wik0[ic] = NULL;
+	wik1[ic] = NULL;
+      }
+    } else if (fmt == 0) {
       nr = fwrite(&(h->pj), sizeof(int), 1, f);
       nr = fwrite(&p, sizeof(int), 1, f);
       nr = fwrite(&j, sizeof(int), 1, f);
@@ -1021,7 +1142,28 @@ int WriteRMatrixSurface(FILE *f, double **wik0, double **wik1, int m,
   } else {
     nchan = rmx->nkappa * rmx->nts;
     nchan0 = rmx->nchan0;
-    if (fmt == 0) {
+    if (fmt == 2) {
+      hdr[0] = rmx->isym;
+      hdr[1] = rmx->p;
+      hdr[2] = rmx->j;
+      hdr[3] = rmx->ndim;
+      hdr[4] = nchan0;
+      nr = fwrite(hdr, sizeof(int), 8, f);
+      nr = fwrite(rmx->ek, sizeof(double), rmx->ndim, f);
+      nr = fwrite(rmx->chans, sizeof(int), nchan0, f);
+      nr = fwrite(rmx->ilev, sizeof(int), nchan0, f);
+      nr = fwrite(rmx->kappa, sizeof(int), nchan0, f);
+      if (nchan0 & 1) nr = fwrite(&(hdr[5]), sizeof(int), 1, f);
+      for (ilam = 0; ilam < rmx->nlam; ilam++) {
+	nr = fwrite(rmx->aij[ilam], sizeof(double), nchan0*nchan0, f);
+      }
+      for (i = 0; i < nchan0; i++) {
+	nr = fwrite(rmx->w0[rmx->chans[i]], sizeof(double), rmx->ndim, f);
+      }
+      for (i = 0; i < nchan0; i++) {
+	nr = fwrite(rmx->w1[rmx->chans[i]], sizeof(double), rmx->ndim, f);
+      }
+    } else if (fmt == 0) {
       nr = fwrite(&(rmx->isym), sizeof(int), 1, f);
       nr = fwrite(&(rmx->p), sizeof(int), 1, f);
       nr = fwrite(&(rmx->j), sizeof(int), 1, f);
@@ -1189,7 +1331,7 @@ int RMatrixSurface(char *fn) {
   }
   
   fseek(f, 0, SEEK_SET);
-  if (fmode == 0) {
+  if (fmode != 1) {
     fwrite(&nsym, sizeof(int), 1, f);
     fwrite(&nchm, sizeof(int), 1, f);
   } else {
@@ -1202,83 +1344,271 @@ int RMatrixSurface(char *fn) {
   return 0;
 }
 
-int RMatrix(double e, RMATRIX *rmx, RBASIS *rbs, int m) {
-  int i, j, p, q, nb, k;
-  double *si0, *si1, *sj0, *sj1;
-  double de, a00, a11, a01, a10;
-  double *x, *y0, *y1, *y2, b;
+/*
+** the surface file of fmode 2 is laid out to be used in place. the
+** header is 8 ints, nsym, mchan, nts, ncs, nkappa, nlam, and two
+** zeros, followed by z, and the (level, 2j, energy) records of the
+** targets and the bound states. each symmetry starts with the 8 ints
+** isym, p, j, ndim, nchan0 and three zeros, then ek[ndim], the arrays
+** chans, ilev, kappa, padded to an even number of ints, the full
+** nchan0 x nchan0 matrix of each multipole, the w0 of the channels
+** and the w1 of the channels. every block starts at a multiple of 8
+** bytes, so the arrays of RMATRIX may point into the file directly.
+*/
+static long SurfaceRecordSize(int ndim, int nchan0, int nlam) {
+  long n;
+
+  n = sizeof(int)*(8 + 3*nchan0 + (nchan0&1));
+  n += sizeof(double)*(ndim + (long)nlam*nchan0*nchan0 + 2L*nchan0*ndim);
+  return n;
+}
 
-  for (i = 0; i < rmx->nchan0; i++) {
-    si0 = rmx->w0[rmx->chans[i]];
-    si1 = rmx->w1[rmx->chans[i]];
-    for (j = 0; j <= i; j++) {
-      sj0 = rmx->w0[rmx->chans[j]];
-      sj1 = rmx->w1[rmx->chans[j]];
-      p = i*rmx->nchan0 + j;
-      a00 = 0.0;
-      a11 = 0.0;
-      a01 = 0.0;
-      a10 = 0.0;
-      for (k = 0; k < rmx->ndim; k++) {	
-	de = rmx->ek[k] - rmx->et0;
-	de -= e;
-	a11 += si1[k]*sj1[k]/de;
-	if (rbs->ib0 > 0) {
-	  a00 += si0[k]*sj0[k]/de;
-	  a01 += si0[k]*sj1[k]/de;
-	  a10 += si1[k]*sj0[k]/de;
+/* map the surface file fn of fmode 2, and index its symmetries. */
+int MapRMatrixSurface(char *fn, RMATRIX *rmx) {
+  FILE *f;
+  int i, *hdr;
+  long p;
+
+  f = fopen(fn, "r");
+  if (f == NULL) {
+    printf("cannot open file %s\n", fn);
+    return -1;
+  }
+  ReadRMatrixSurface(f, rmx, 0, 2);
+  p = ftell(f);
+  fseek(f, 0, SEEK_END);
+  rmx->msize = ftell(f);
+#ifdef _POSIX_MAPPED_FILES
+  rmx->map = mmap(NULL, rmx->msize, PROT_READ, MAP_SHARED, fileno(f), 0);
+  if (rmx->map == MAP_FAILED) {
+    rmx->map = NULL;
+  } else {
+    rmx->mmapped = 1;
+  }
+#endif
+  if (rmx->map == NULL) {
+    rmx->map = malloc(rmx->msize);
+    fseek(f, 0, SEEK_SET);
+    if ((long) fread(rmx->map, 1, rmx->msize, f) != rmx->msize) {
+      printf("error reading file %s\n", fn);
+      free(rmx->map);
+      rmx->map = NULL;
+      fclose(f);
+      return -1;
+    }
+  }
+  fclose(f);
+
+  rmx->moffset = malloc(sizeof(long)*(rmx->nsym+1));
+  for (i = 0; i < rmx->nsym; i++) {
+    rmx->moffset[i] = p;
+    hdr = (int *) (rmx->map + p);
+    p += SurfaceRecordSize(hdr[3], hdr[4], rmx->nlam);
+    if (p > rmx->msize) {
+      printf("surface file %s truncated at symmetry %d\n", fn, i);
+      ClearRMatrixSurface(rmx);
+      return -1;
+    }
+  }
+  rmx->moffset[i] = p;
+
+  return 0;
+}
+
+/* point the symmetry arrays of rmx to the record isym of the map. */
+int MapRMatrixSymmetry(RMATRIX *rmx, int isym) {
+  char *q;
+  int i, ilam, ndim, nchan0, *hdr;
+
+  if (isym < 0 || isym >= rmx->nsym) return -1;
+  ClearSurfaceSymmetry(rmx);
+  q = rmx->map + rmx->moffset[isym];
+  hdr = (int *) q;
+  ndim = hdr[3];
+  nchan0 = hdr[4];
+  rmx->isym = hdr[0];
+  rmx->p = hdr[1];
+  rmx->j = hdr[2];
+  rmx->ndim = ndim;
+  rmx->nchan0 = nchan0;
+  q += sizeof(int)*8;
+  rmx->ek = (double *) q;
+  q += sizeof(double)*ndim;
+  rmx->chans = (int *) q;
+  rmx->ilev = rmx->chans + nchan0;
+  rmx->kappa = rmx->ilev + nchan0;
+  q += sizeof(int)*(3*nchan0 + (nchan0&1));
+  for (ilam = 0; ilam < rmx->nlam; ilam++) {
+    rmx->aij[ilam] = (double *) q;
+    q += sizeof(double)*nchan0*nchan0;
+  }
+  for (i = 0; i < nchan0; i++) {
+    rmx->w0[rmx->chans[i]] = (double *) q;
+    q += sizeof(double)*ndim;
+  }
+  for (i = 0; i < nchan0; i++) {
+    rmx->w1[rmx->chans[i]] = (double *) q;
+    q += sizeof(double)*ndim;
+  }
+  for (i = 0; i < 3; i++) {
+    rmx->rmatrix[i] = malloc(sizeof(double)*nchan0*nchan0);
+  }
+
+  return 0;
+}
+
+/*
+** the pole sums of the R-matrix for ne energies. with the surface
+** amplitudes of the channels as the columns of W0 and W1, and
+** D = diag(0.5/(E_k - E)), they are W1 D W1^T, W0 D W0^T, and
+** W0 D W1^T, stored in rb at ie*3*nchan0^2 for energy ie. the
+** right factors of all energies are formed together, so that each
+** sum is a single DGEMM over the batch, done in groups of at most
+** RMX_BATCH_WORDS words of workspace.
+*/
+int RMatrixPoles(int ne, double *e, RMATRIX *rmx, RBASIS *rbs, double *rb) {
+  int i, k, ie, je, nb, nc, nc2, nd, nw;
+  double *w0, *w1, *b, *d, *c, *x;
+  char trans[] = "T";
+  char notrans[] = "N";
+  double d_one = 1.0, d_zero = 0.0;
+
+  nc = rmx->nchan0;
+  nc2 = nc*nc;
+  nd = rmx->ndim;
+  nw = 1;
+  if (rbs->ib0 > 0) nw = 2;
+  w1 = malloc(sizeof(double)*nd*nc*nw);
+  w0 = w1 + nd*nc;
+  for (i = 0; i < nc; i++) {
+    memcpy(w1+i*nd, rmx->w1[rmx->chans[i]], sizeof(double)*nd);
+    if (nw > 1) {
+      memcpy(w0+i*nd, rmx->w0[rmx->chans[i]], sizeof(double)*nd);
+    }
+  }
+  nb = RMX_BATCH_WORDS/(nd*nc);
+  if (nb < 1) nb = 1;
+  if (nb > ne) nb = ne;
+  b = malloc(sizeof(double)*(nd*nc*nb + nd*nb + nc2*nb));
+  d = b + nd*nc*nb;
+  c = d + nd*nb;
+  
+  for (ie = 0; ie < ne; ie += nb) {
+    if (ie + nb > ne) nb = ne - ie;
+    for (je = 0; je < nb; je++) {
+      x = d + je*nd;
+      for (k = 0; k < nd; k++) {
+	x[k] = 0.5/(rmx->ek[k] - rmx->et0 - e[ie+je]);
+      }
+    }
+    for (je = 0; je < nb; je++) {
+      for (i = 0; i < nc; i++) {
+	x = b + (je*nc + i)*nd;
+	for (k = 0; k < nd; k++) {
+	  x[k] = w1[i*nd+k]*d[je*nd+k];
 	}
       }
-      a11 *= 0.5;
-      if (rbs->ib0 > 0) {
-	a00 *= 0.5;
-	a01 *= 0.5;
-	a10 *= 0.5;
-      }
-      rmx->rmatrix[0][p] = a11;
-      rmx->rmatrix[1][p] = a00;
-      rmx->rmatrix[2][p] = a01;
-      if (i != j) {	
-	p = j*rmx->nchan0 + i;
-	rmx->rmatrix[0][p] = a11;
-	rmx->rmatrix[1][p] = a00;
-	rmx->rmatrix[2][p] = a10;
-      } else if (m >= 0) {
-	q = rmx->chans[i]/rbs->nkappa;
-	k = rmx->chans[i]%rbs->nkappa;
-	nb = rbs->nbuttle;
-	x = rbs->ebuttle[k];
-	if (m == 0) {
-	  y0 = rbs->cbuttle[0][k];
-	  y1 = rbs->cbuttle[1][k];
-	} else {
-	  y0 = rbs->cbuttle[2][k];
-	  y1 = rbs->cbuttle[3][k];
+    }
+    DGEMM(trans, notrans, nc, nc*nb, nd, d_one, w1, nd, 
+	  b, nd, d_zero, c, nc);
+    for (je = 0; je < nb; je++) {
+      memcpy(rb+(ie+je)*3*nc2, c+je*nc2, sizeof(double)*nc2);
+    }
+    if (nw == 1) {
+      for (je = 0; je < nb; je++) {
+	x = rb+(ie+je)*3*nc2 + nc2;
+	for (k = 0; k < 2*nc2; k++) x[k] = 0.0;
+      }
+      continue;
+    }
+    for (je = 0; je < nb; je++) {
+      for (i = 0; i < nc; i++) {
+	x = b + (je*nc + i)*nd;
+	for (k = 0; k < nd; k++) {
+	  x[k] = w0[i*nd+k]*d[je*nd+k];
 	}
-	de = e - (rmx->et[q] - rmx->et0);
-	if (de <= x[nb-1]) {
-	  y2 = rbs->cbuttle[4][k];
-	  UVIP3P(3, nb, x, y0, 1, &de, &b);
-	  rmx->rmatrix[0][p] += b;	
-	  if (rbs->ib0 > 0) {
-	    UVIP3P(3, nb, x, y1, 1, &de, &b);
-	    rmx->rmatrix[1][p] += b;
-	    UVIP3P(3, nb, x, y2, 1, &de, &b);
-	    rmx->rmatrix[2][p] += b;
-	  }
-	} else {
-	  ExtrapolateButtle(rbs, k, 1, &de, &a00, &a01, &a11);
-	  rmx->rmatrix[0][p] += a01;
-	  if (rbs->ib0 > 0) {
-	    rmx->rmatrix[1][p] += a00;
-	    rmx->rmatrix[2][p] += a11;
-	  }
+      }
+    }
+    DGEMM(trans, notrans, nc, nc*nb, nd, d_one, w0, nd, 
+	  b, nd, d_zero, c, nc);
+    for (je = 0; je < nb; je++) {
+      memcpy(rb+(ie+je)*3*nc2+nc2, c+je*nc2, sizeof(double)*nc2);
+    }
+    /* element (i, j) of W0 D W1^T is at i*nchan0+j, which is the
+       transposed, column major, product W1 (D W0^T) */
+    DGEMM(trans, notrans, nc, nc*nb, nd, d_one, w1, nd, 
+	  b, nd, d_zero, c, nc);
+    for (je = 0; je < nb; je++) {
+      memcpy(rb+(ie+je)*3*nc2+2*nc2, c+je*nc2, sizeof(double)*nc2);
+    }
+  }
+
+  free(w1);
+  free(b);
+  return 0;
+}
+
+/*
+** the R-matrix at energy e from its pole sums rb, computed by
+** RMatrixPoles, with the Buttle corrections for m >= 0.
+*/
+int RMatrixSet(double e, double *rb, RMATRIX *rmx, RBASIS *rbs, int m) {
+  int i, p, q, nb, k, nc2;
+  double de, a00, a11, a01;
+  double *x, *y0, *y1, *y2, b;
+
+  nc2 = rmx->nchan0*rmx->nchan0;
+  for (i = 0; i < 3; i++) {
+    memcpy(rmx->rmatrix[i], rb+i*nc2, sizeof(double)*nc2);
+  }
+  if (m >= 0) {
+    for (i = 0; i < rmx->nchan0; i++) {
+      p = i*rmx->nchan0 + i;
+      q = rmx->chans[i]/rbs->nkappa;
+      k = rmx->chans[i]%rbs->nkappa;
+      nb = rbs->nbuttle;
+      x = rbs->ebuttle[k];
+      if (m == 0) {
+	y0 = rbs->cbuttle[0][k];
+	y1 = rbs->cbuttle[1][k];
+      } else {
+	y0 = rbs->cbuttle[2][k];
+	y1 = rbs->cbuttle[3][k];
+      }
+      de = e - (rmx->et[q] - rmx->et0);
+      if (de <= x[nb-1]) {
+	y2 = rbs->cbuttle[4][k];
+	UVIP3P(3, nb, x, y0, 1, &de, &b);
+	rmx->rmatrix[0][p] += b;	
+	if (rbs->ib0 > 0) {
+	  UVIP3P(3, nb, x, y1, 1, &de, &b);
+	  rmx->rmatrix[1][p] += b;
+	  UVIP3P(3, nb, x, y2, 1, &de, &b);
+	  rmx->rmatrix[2][p] += b;
+	}
+      } else {
+	ExtrapolateButtle(rbs, k, 1, &de, &a00, &a01, &a11);
+	rmx->rmatrix[0][p] += a01;
+	if (rbs->ib0 > 0) {
+	  rmx->rmatrix[1][p] += a00;
+	  rmx->rmatrix[2][p] += a11;
 	}
       }
     }
   }
 
   rmx->energy = e;
+  return 0;
+}
+
+int RMatrix(double e, RMATRIX *rmx, RBASIS *rbs, int m) {
+  double *rb;
+
+  rb = malloc(sizeof(double)*3*rmx->nchan0*rmx->nchan0);
+  RMatrixPoles(1, &e, rmx, rbs, rb);
+  RMatrixSet(e, rb, rmx, rbs, m);
+  free(rb);
+
   return 0;
 }    
 
@@ -1518,6 +1848,8 @@ int IntegrateExternal(RMATRIX *rmx, double r1, double r0) {
     lrw = dcfg.lrw;
     liw = dcfg.liw;
     rs = r0;
+    /* LSODE keeps its state in common blocks */
+#pragma omp critical(ode_lsode)
     while (rs != r1) {
       LSODE(C_FUNCTION(EXTDPQ, extdpq), neq, y, &rs, r1,
 	    itol, rtol, &atol, itask, &istate, iopt, rwork,
@@ -1553,6 +1885,8 @@ int IntegrateExternal(RMATRIX *rmx, double r1, double r0) {
     lrw = dcfg.lrw;
     liw = dcfg.liw;
     rs = r0;
+    /* LSODE keeps its state in common blocks */
+#pragma omp critical(ode_lsode)
     while (rs != r1) {
       LSODE(C_FUNCTION(EXTDPQ, extdpq), neq, y, &rs, r1,
 	    itol, rtol, &atol, itask, &istate, iopt, rwork,
@@ -1740,6 +2074,8 @@ int GailitisExp(RMATRIX *rmx, double r) {
       p[i] = sqrt(fabs(p2[i]));
     }
     ierr = 0;
+    /* DCOUL passes intermediates through common blocks */
+#pragma omp critical(coul_dcoul)
     DCOUL(rmx->z, e[i], rmx->kappa[i], r, &t1, &c1, &t2, &c2, &ierr);
     if (e[i] > 0) {
       dcfg.fs0[i] = t1;
@@ -2068,7 +2404,9 @@ int RMatrixCE(char *fn, int np, char *bfn[], char *rfn[],
   int i, j, k, t, p, q, h, n, i0, ns, *iwork;
   double *e0, *e, et, **s, ***sp, *r0, *r1, x;
   int pp, jj, its0, its1, st0, ka0, ka1, mka0, mka1, npw;
-  int nke, npe;
+  int nke, npe, ng, nk, k0, mc2, mw;
+  double **rb, *rw;
+  RMATRIX *rmxt, *rt;
 
   emin /= HARTREE_EV;
   emax /= HARTREE_EV;
@@ -2088,6 +2426,11 @@ int RMatrixCE(char *fn, int np, char *bfn[], char *rfn[],
   
   for (i = 0; i < np; i++) {
     ReadRMatrixBasis(bfn[i], &(rbs[i]), fmode);
+    if (fmode == 2) {
+      f[i] = NULL;
+      if (MapRMatrixSurface(rfn[i], &(rmx[i])) < 0) return -1;
+      continue;
+    }
     f[i] = fopen(rfn[i], "r");
     if (f[i] == NULL) return -1;
     ReadRMatrixSurface(f[i], &(rmx[i]), 0, fmode);
@@ -2107,6 +2450,19 @@ int RMatrixCE(char *fn, int np, char *bfn[], char *rfn[],
   }
 
   InitDCFG(rmx[0].mchan);
+  mw = 0;
+  for (i = 0; i < np; i++) {
+    if (rmx[i].mchan*rmx[i].mchan > mw) mw = rmx[i].mchan*rmx[i].mchan;
+  }
+  ng = RMX_BATCH_WORDS/(3*mw);
+  if (ng < 1) ng = 1;
+  if (ng > nbatch) ng = nbatch;
+  rb = malloc(sizeof(double *)*np);
+  for (i = 0; i < np; i++) {
+    rb[i] = malloc(sizeof(double)*3*mw*ng);
+  }
+  rmxt = malloc(sizeof(RMATRIX)*np*MaxThreads());
+  rw = malloc(sizeof(double)*3*mw*np*MaxThreads());
 
   e = e0;
   npe = 0;
@@ -2116,7 +2472,8 @@ int RMatrixCE(char *fn, int np, char *bfn[], char *rfn[],
     } else {
       nke = nbatch;
     }
-    for (i = 0; i < np; i++) {
+    /* the mapped surfaces are indexed by symmetry, no rewinding. */
+    for (i = 0; i < np && fmode != 2; i++) {
       ClearRMatrixSurface(&(rmx[i]));      
       fseek(f[i], 0, SEEK_SET);
       ReadRMatrixSurface(f[i], &(rmx[i]), 0, fmode);
@@ -2148,62 +2505,91 @@ int RMatrixCE(char *fn, int np, char *bfn[], char *rfn[],
     fflush(f1);
     for (i = 0; i < rmx[0].nsym;  i++) {
       for (j = 0; j < np; j++) {
-	ReadRMatrixSurface(f[j], &(rmx[j]), 1, fmode);
+	if (fmode == 2) {
+	  MapRMatrixSymmetry(&(rmx[j]), i);
+	} else {
+	  ReadRMatrixSurface(f[j], &(rmx[j]), 1, fmode);
+	}
       }
       DecodePJ(rmx[0].isym, &pp, &jj);
       printf("sym: %d %d %d\n", rmx[0].isym, pp, jj);
       fflush(stdout);
-      for (k = 0; k < nke; k++) {
+      for (k0 = 0; k0 < nke; k0 += ng) {
+	nk = Min(ng, nke-k0);
 	for (j = 0; j < np; j++) {
-	  RMatrix(e[k], &(rmx[j]), &(rbs[j]), mb);
-	}
-	r0 = rmx[0].rmatrix[0];
-	r1 = rmx[0].rmatrix[1];
-	if (dcfg.rgailitis > rbs[np-1].rb1) {
-	  GailitisExp(&(rmx[0]), dcfg.rgailitis);
-	  IntegrateExternal(&(rmx[0]), rbs[np-1].rb1, dcfg.rgailitis);
-	} else {
-	  GailitisExp(&(rmx[0]), rbs[np-1].rb1);
+	  RMatrixPoles(nk, e+k0, &(rmx[j]), &(rbs[j]), rb[j]);
 	}
-	if (dcfg.pdirection >= 0) {
-	  for (j = 1; j < np; j++) {
-	    RMatrixPropogate(r0, r1, &(rmx[j]));
-	  }
-	  RMatrixKMatrix(&(rmx[0]), &(rbs[np-1]), r0);
-	} else {
-	  for (j = np-1; j > 0; j--) {
-	    PropogateExternal(&(rmx[j]), &(rbs[j]));
+	/* each thread works on its own copies of the R-matrices, and
+	   its own dcfg, the energies are independent. */
+#pragma omp parallel default(shared) copyin(dcfg) \
+  private(j, k, t, p, q, h, x, r0, r1, rt, its0, its1, st0, ka0, ka1, mka0, mka1, et, mc2)
+	{
+	  t = MyThread();
+	  if (t > 0) InitDCFG(rmx[0].mchan);
+	  rt = rmxt + t*np;
+	  for (j = 0; j < np; j++) {
+	    rt[j] = rmx[j];
+	    for (p = 0; p < 3; p++) {
+	      rt[j].rmatrix[p] = rw + ((t*np + j)*3 + p)*mw;
+	    }
 	  }
-	  RMatrixKMatrix(&(rmx[0]), &(rbs[0]), r0);
-	}
-	SMatrix(&(rmx[0]));
-	for (p = 0; p < dcfg.nop; p++) {
-	  its1 = rmx[0].ilev[p];
-	  st0 = its1*(its1+1)/2;
-	  ka1 = rmx[0].kappa[p];
-	  mka1 = GetLFromKappa(ka1);
-	  mka1 /= 2;
-	  for (q = 0; q <= p; q++) {
-	    h = q*rmx[0].nchan0 + p;
-	    x = r0[h]*r0[h] + r1[h]*r1[h];
-	    x *= 0.5*(jj+1.0);
-	    its0 = rmx[0].ilev[q];
-	    ka0 = rmx[0].kappa[q];
-	    mka0 = GetLFromKappa(ka0);
-	    mka0 /= 2;
-	    s[st0+its0][k] += x;
-	    if (m & 1) {
-	      sp[st0+its0][k][mka0] += x;
+#pragma omp for ordered schedule(dynamic)
+	  for (k = k0; k < k0+nk; k++) {
+	    for (j = 0; j < np; j++) {
+	      mc2 = rt[j].nchan0*rt[j].nchan0;
+	      RMatrixSet(e[k], rb[j]+(k-k0)*3*mc2, &(rt[j]), &(rbs[j]), mb);
 	    }
-	    if (m & 2) {
-	      et = (e[k]-rmx[0].et[its0]+rmx[0].et0)*HARTREE_EV;
-	      fprintf(f1, 
-		      "%3d %4d %4d %4d %4d %12.5E %12.5E %12.5E %12.5E %12.5E\n",
-		      rmx[0].isym, its0, ka0, its1, ka1, et, 
-		      r0[h], r1[h], 
-		      x, rmx[0].rmatrix[2][h]);
+	    r0 = rt[0].rmatrix[0];
+	    r1 = rt[0].rmatrix[1];
+	    if (dcfg.rgailitis > rbs[np-1].rb1) {
+	      GailitisExp(&(rt[0]), dcfg.rgailitis);
+	      IntegrateExternal(&(rt[0]), rbs[np-1].rb1, dcfg.rgailitis);
+	    } else {
+	      GailitisExp(&(rt[0]), rbs[np-1].rb1);
+	    }
+	    if (dcfg.pdirection >= 0) {
+	      for (j = 1; j < np; j++) {
+		RMatrixPropogate(r0, r1, &(rt[j]));
+	      }
+	      RMatrixKMatrix(&(rt[0]), &(rbs[np-1]), r0);
+	    } else {
+	      for (j = np-1; j > 0; j--) {
+		PropogateExternal(&(rt[j]), &(rbs[j]));
+	      }
+	      RMatrixKMatrix(&(rt[0]), &(rbs[0]), r0);
+	    }
+	    SMatrix(&(rt[0]));
+#pragma omp ordered
+	    for (p = 0; p < dcfg.nop; p++) {
+	      its1 = rt[0].ilev[p];
+	      st0 = its1*(its1+1)/2;
+	      ka1 = rt[0].kappa[p];
+	      mka1 = GetLFromKappa(ka1);
+	      mka1 /= 2;
+	      for (q = 0; q <= p; q++) {
+		h = q*rt[0].nchan0 + p;
+		x = r0[h]*r0[h] + r1[h]*r1[h];
+		x *= 0.5*(jj+1.0);
+		its0 = rt[0].ilev[q];
+		ka0 = rt[0].kappa[q];
+		mka0 = GetLFromKappa(ka0);
+		mka0 /= 2;
+		s[st0+its0][k] += x;
+		if (m & 1) {
+		  sp[st0+its0][k][mka0] += x;
+		}
+		if (m & 2) {
+		  et = (e[k]-rt[0].et[its0]+rt[0].et0)*HARTREE_EV;
+		  fprintf(f1, 
+			  "%3d %4d %4d %4d %4d %12.5E %12.5E %12.5E %12.5E %12.5E\n",
+			  rt[0].isym, its0, ka0, its1, ka1, et, 
+			  r0[h], r1[h], 
+			  x, rt[0].rmatrix[2][h]);
+		}
+	      }
 	    }
 	  }
+	  if (t > 0) ClearDCFG();
 	}
       }
     }
@@ -2257,10 +2643,16 @@ int RMatrixCE(char *fn, int np, char *bfn[], char *rfn[],
   }
       
   for (i = 0; i < np; i++) {
-    fclose(f[i]);
+    if (f[i]) fclose(f[i]);
     ClearRMatrixBasis(&(rbs[i]));
     ClearRMatrixSurface(&(rmx[i]));
   }
+  for (i = 0; i < np; i++) {
+    free(rb[i]);
+  }
+  free(rb);
+  free(rmxt);
+  free(rw);
   free(f);
   free(rbs);
   free(rmx);
@@ -2272,7 +2664,7 @@ int RMatrixCE(char *fn, int np, char *bfn[], char *rfn[],
 }
 
 int RMatrixConvert(char *ifn, char *ofn, int m) {
-  int i;
+  int i, fi, fo;
   FILE *f0, *f1;
   RMATRIX rmx;
 
@@ -2286,30 +2678,21 @@ int RMatrixConvert(char *ifn, char *ofn, int m) {
     WriteRMatrixBasis(ofn, 0);
     ClearRMatrixBasis(&rbasis);
     return 0;
-  } else if (m == 2) {
-    f0 = fopen(ifn, "r");
-    if (!f0) {
-      printf("cannot open file %s\n", ifn);
-      return -1;
-    }
-    f1 = fopen(ofn, "w");
-    if (!f1) {
-      printf("cannot open file %s\n", ofn);
-      fclose(f0);
-      return -1;
-    }
-    ReadRMatrixSurface(f0, &rmx, 0, 0);
-    WriteRMatrixSurface(f1, NULL, NULL, 0, 1, &rmx);
-    for (i = 0; i < rmx.nsym; i++) {
-      printf("sym: %3d\n", i);
-      ReadRMatrixSurface(f0, &rmx, 1, 0);
-      WriteRMatrixSurface(f1, NULL, NULL, 1, 1, &rmx);
+  } else if (m >= 2 && m <= 5) {
+    /* the surface formats of ifn and ofn */
+    if (m == 2) {
+      fi = 0;
+      fo = 1;
+    } else if (m == 3) {
+      fi = 1;
+      fo = 0;
+    } else if (m == 4) {
+      fi = 0;
+      fo = 2;
+    } else {
+      fi = 2;
+      fo = 0;
     }
-    ClearRMatrixSurface(&rmx);
-    fclose(f0);
-    fclose(f1);
-    return 0;
-  } else if (m == 3) {
     f0 = fopen(ifn, "r");
     if (!f0) {
       printf("cannot open file %s\n", ifn);
@@ -2321,18 +2704,20 @@ int RMatrixConvert(char *ifn, char *ofn, int m) {
       fclose(f0);
       return -1;
     }
-    ReadRMatrixSurface(f0, &rmx, 0, 1);
-    WriteRMatrixSurface(f1, NULL, NULL, 0, 0, &rmx);
+    ReadRMatrixSurface(f0, &rmx, 0, fi);
+    WriteRMatrixSurface(f1, NULL, NULL, 0, fo, &rmx);
     for (i = 0; i < rmx.nsym; i++) {
       printf("sym: %3d\n", i);
-      ReadRMatrixSurface(f0, &rmx, 1, 1);
-      WriteRMatrixSurface(f1, NULL, NULL, 1, 0, &rmx);
+      ReadRMatrixSurface(f0, &rmx, 1, fi);
+      WriteRMatrixSurface(f1, NULL, NULL, 1, fo, &rmx);
     }
     ClearRMatrixSurface(&rmx);
     fclose(f0);
     fclose(f1);
     return 0;
   }
+
+  return -1;
 }
 
 void TestRMatrix(double e, int m, char *fn1, char *fn2, char *fn3) {
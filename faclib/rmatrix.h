@@ -26,6 +26,8 @@
 
 #define NBTERMS 5
 #define NBFIT 7
+/* workspace bound, in words, of the batched pole sums */
+#define RMX_BATCH_WORDS 4194304
 typedef struct _RBASIS_ {
   int kmax, nbk, nkappa, nbuttle;
   int ib0, ib1;
@@ -45,6 +47,9 @@ typedef struct _RMATRIX_ {
   double et0, *et, *ec, *ek, **w0, **w1;
   double *rmatrix[3];
   double z, energy;
+  char *map;
+  long msize, *moffset;
+  int mmapped;
 } RMATRIX;
 
 typedef struct _DCFG_ {
@@ -76,6 +81,10 @@ int ReadRMatrixSurface(FILE *f, RMATRIX *rmx, int m, int fmt);
 int WriteRMatrixSurface(FILE *f, double **wik0, double **wik1, int m, 
 			int fmt, RMATRIX *rmx);
 int RMatrixSurface(char *fn);
+int MapRMatrixSurface(char *fn, RMATRIX *rmx);
+int MapRMatrixSymmetry(RMATRIX *rmx, int isym);
+int RMatrixPoles(int ne, double *e, RMATRIX *rmx, RBASIS *rbs, double *rb);
+int RMatrixSet(double e, double *rb, RMATRIX *rmx, RBASIS *rbs, int m);
 int RMatrix(double e, RMATRIX *rmx, RBASIS *rbs, int m);
 int RMatrixPropogate(double *r0, double *r1, RMATRIX *rmx1);
 int RMatrixKMatrix(RMATRIX *rmx0, RBASIS *rbs, double *r0);
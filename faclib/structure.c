@@ -20,6 +20,10 @@
 
 #include "structure.h"
 #include "cf77.h"
+#include <unistd.h>
+#ifdef _POSIX_MAPPED_FILES
+#include <sys/mman.h>
+#endif
 
 static char *rcsid="$Id$";
 #if __GNUC__ == 2
@@ -42,8 +46,10 @@ USE (rcsid);
 static int nhams = 0;
 static SHAMILTON hams[MAX_HAMS];
 
-static HAMILTON _ham = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-			NULL, NULL, NULL, NULL, NULL, NULL};
+static HAMILTON _ham = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+/* each thread works on its own Hamiltonian in SolveStructure */
+#pragma omp threadprivate(_ham)
 
 static ARRAY levels_per_ion[N_ELEMENTS+1];
 static ARRAY *levels;
@@ -62,6 +68,8 @@ static int ncorrections = 0;
 static ARRAY *ecorrections;
 
 static int ci_level = 0;
+static int diag_mode = 0;
+static int diag_nlev = 0;
 static int rydberg_ignored = 0;
 static double angz_cut = ANGZCUT;
 static double mix_cut = MIXCUT;
@@ -214,6 +222,35 @@ int SetCILevel(m) {
   ci_level = m;
 }
 
+/*
+** m = 0, packed storage DSPEV, all eigenpairs.
+** m = 1, full storage DSYEVD.
+** m = 2, full storage DSYEVR.
+** m = 3, sparse storage, Davidson iterations for the lowest nlev.
+** the other solvers are only used for the Hamiltonians 
+** constructed with full storage requested, i.e., in Structure
+** without perturbers. nlev > 0 keeps only the lowest nlev 
+** eigenpairs in that case, DSYEVR and Davidson do not compute 
+** the others.
+*/
+int SetEigenSolver(int m, int nlev) {
+#ifndef SYSTEM_LAPACK
+  if (m == 1 || m == 2) {
+    printf("full storage eigen solvers need the system LAPACK, ");
+    printf("configure with --with-lapack. DSPEV is used\n");
+    m = 0;
+  }
+#endif
+  if (m < 0 || m > 3) m = 0;
+  if (m == 3 && nlev <= 0) {
+    printf("Davidson solver needs the number of levels. DSPEV is used\n");
+    m = 0;
+  }
+  diag_mode = m;
+  diag_nlev = nlev;
+  return 0;
+}
+
 int SetAngZCut(double cut) {
   if (cut >= 0) angz_cut = cut;
   else angz_cut = ANGZCUT;
@@ -352,10 +389,41 @@ int IsClosedShell(int ih, int k) {
   return (hams[ih].closed[i] & (1 << j));
 }
 
+/*
+** register the basis of the Hamiltonian h in hams.
+*/
+static void AddSHamilton(HAMILTON *h) {
+  SHAMILTON *hs;
+  SYMMETRY *sym;
+  STATE *s;
+  int t;
+
+  if (nhams >= MAX_HAMS) {
+    printf("Number of hamiltons exceeded the maximum %d\n", MAX_HAMS);
+    exit(1);
+  }
+  sym = GetSymmetry(h->pj);
+  hs = hams + nhams;
+  nhams++;
+  hs->pj = h->pj;
+  hs->nlevs = h->nlevs;
+  hs->nbasis = h->n_basis;
+  hs->basis = malloc(sizeof(STATE *)*hs->nbasis);
+  for (t = 0; t < h->n_basis; t++) {
+    s = (STATE *) ArrayGet(&(sym->states), h->basis[t]);
+    hs->basis[t] = s;
+  }
+  FlagClosed(hs);
+}
+
+/*
+** m = 0, zeroth order energies of the configurations.
+** m = 1, diagonal elements, the basis is registered in hams.
+** m = 2, diagonal elements, the basis is not registered.
+*/
 int ConstructHamiltonDiagonal(int isym, int k, int *kg, int m) {
   int i, j, t;
   HAMILTON *h;
-  SHAMILTON *hs;
   ARRAY *st;
   STATE *s;
   SYMMETRY *sym;
@@ -389,6 +457,7 @@ int ConstructHamiltonDiagonal(int isym, int k, int *kg, int m) {
   h->dim = j;
   h->n_basis = j;
   h->hsize = j;
+  h->storage = 0;
 
   if (h->basis == NULL) {
     h->n_basis0 = h->n_basis;
@@ -410,6 +479,20 @@ int ConstructHamiltonDiagonal(int isym, int k, int *kg, int m) {
   }
   if (!(h->hamilton)) goto ERROR;
 
+  if (m > 0) {
+    /* DiagnolizeHamilton fills the mixing with the unit vectors */
+    h->msize = h->dim * h->n_basis + h->dim;
+    if (h->mixing == NULL) {
+      h->msize0 = h->msize;
+      h->mixing = (double *) malloc(sizeof(double)*h->msize);
+    } else if (h->msize > h->msize0) {
+      h->msize0 = h->msize;
+      free(h->mixing);
+      h->mixing = (double *) malloc(sizeof(double)*h->msize);
+    }
+    if (!(h->mixing)) goto ERROR;
+  }
+
   j = 0;  
   for (t = 0; t < sym->n_states; t++) {
     s = (STATE *) ArrayGet(st, t);
@@ -429,22 +512,9 @@ int ConstructHamiltonDiagonal(int isym, int k, int *kg, int m) {
     h->hamilton[j] = r;
   }
 
-  if (m > 0) {
-    hs = hams + nhams;
-    nhams++;
-    if (nhams > MAX_HAMS) {
-      printf("Number of hamiltons exceeded the maximum %d\n", MAX_HAMS);
-      exit(1);
-    }
-    hs->pj = h->pj;
-    hs->nlevs = h->dim;
-    hs->nbasis = h->n_basis;
-    hs->basis = malloc(sizeof(STATE *)*hs->nbasis);
-    for (t = 0; t < h->n_basis; t++) {
-      s = (STATE *) ArrayGet(&(sym->states), h->basis[t]);
-      hs->basis[t] = s;
-    }
-    FlagClosed(hs);
+  if (m == 1) {
+    h->nlevs = h->dim;
+    AddSHamilton(h);
   }
 
 #ifdef PERFORM_STATISTICS
@@ -527,9 +597,8 @@ int ConstructHamiltonEB(int n, int *ilev) {
 }
 
 int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md) {
-  int i, j, j0, t, jp, m1, m2, m3;
+  int i, j, j0, t, jp, m0, m1, m2, m3;
   HAMILTON *h;
-  SHAMILTON *hs;
   ARRAY *st;
   STATE *s;
   SYMMETRY *sym;
@@ -550,8 +619,15 @@ int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md
   if (sym_pp >= 0 && i != sym_pp) return -2;
   if (sym_njj > 0 && IBisect(j, sym_njj, sym_jj) < 0) return -3;
 
-  m1 = md/100;
-  t = md%100;
+  /*
+  ** md = 1000*m0 + 100*m1 + 10*m2 + m3, m0 requests the full or 
+  ** sparse storage of the matrix when there are no perturbers and 
+  ** the eigen solver selected needs it.
+  */
+  m0 = md/1000;
+  t = md%1000;
+  m1 = t/100;
+  t = t%100;
   m2 = t/10;
   m3 = t%10;
   sym = GetSymmetry(isym);
@@ -562,7 +638,8 @@ int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md
   if (m1) {
     if (k <= 0) return -1;
     if (ci_level == -1) {
-      return ConstructHamiltonDiagonal(isym, k, kg, 1);
+      if (m3) return ConstructHamiltonDiagonal(isym, k, kg, 1);
+      else return ConstructHamiltonDiagonal(isym, k, kg, 2);
     }
     st = &(sym->states);
     j = 0;
@@ -582,7 +659,13 @@ int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md
       }
     }    
 
-    if (AllocHamMem(j, jp+j) == -1) goto ERROR;
+    if (m0 && jp == 0 && diag_mode > 0) {
+      if (diag_mode == 3) m0 = 2;
+      else m0 = 1;
+    } else {
+      m0 = 0;
+    }
+    if (AllocHamStorage(j, jp+j, m0) == -1) goto ERROR;
     
     j = 0;  
     for (t = 0; t < sym->n_states; t++) {
@@ -602,9 +685,20 @@ int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md
       }
     }
   }
-  if (m2) {
+  if (m2 && h->storage == 2) {
+    if (ConstructHamiltonSparse(isym) < 0) goto ERROR;
+  } else if (m2) {
+    /* 
+    ** the rows are distributed over the threads. each element is 
+    ** computed independently of the others, and the angular and 
+    ** radial caches give the same values regardless of the order 
+    ** they are filled in, so the result does not depend on the 
+    ** number of threads.
+    */
+#pragma omp parallel for private(i, j, t, r) schedule(dynamic)
     for (j = 0; j < h->dim; j++) {
-      t = j*(j+1)/2;
+      if (h->storage) t = j*h->dim;
+      else t = j*(j+1)/2;
       for (i = 0; i <= j; i++) {
 	r = HamiltonElement(isym, h->basis[i], h->basis[j]);
 	h->hamilton[i+t] = r;
@@ -614,37 +708,33 @@ int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md
     if (jp > 0) {
       t = ((h->dim+1)*(h->dim))/2;
       for (i = 0; i < h->dim; i++) {
+#pragma omp parallel for private(j, r) schedule(dynamic)
 	for (j = h->dim; j < h->n_basis; j++) {
 	  r = HamiltonElement(isym, h->basis[i], h->basis[j]);
-	  h->hamilton[t++] = r;
+	  h->hamilton[t+j-h->dim] = r;
+	}
+	t += h->n_basis - h->dim;
+	if (!InParallel()) {
+	  ReinitRecouple(0);
+	  ReinitRadial(1);
 	}
-	ReinitRecouple(0);
-	ReinitRadial(1);
       }
+#pragma omp parallel for private(j, r) schedule(dynamic)
       for (j = h->dim; j < h->n_basis; j++) {
 	r = HamiltonElement(isym, h->basis[j], h->basis[j]);
-	h->hamilton[t++] = r;
+	h->hamilton[t+j-h->dim] = r;
+      }
+      if (!InParallel()) {
+	ReinitRecouple(0);
+	ReinitRadial(1);
       }
-      ReinitRecouple(0);
-      ReinitRadial(1);
     }
   }
   if (m3) {
-    if (nhams >= MAX_HAMS) {
-      printf("Number of hamiltons exceeded the maximum %d\n", MAX_HAMS);
-      exit(1);
-    }
-    hs = hams + nhams;
-    nhams++;
-    hs->pj = h->pj;
-    hs->nlevs = h->dim;
-    hs->nbasis = h->n_basis;
-    hs->basis = malloc(sizeof(STATE *)*hs->nbasis);
-    for (t = 0; t < h->n_basis; t++) {
-      s = (STATE *) ArrayGet(&(sym->states), h->basis[t]);
-      hs->basis[t] = s;
-    }
-    FlagClosed(hs);
+    /* registered before the diagonalization, AddToLevelsHamilton sets
+       the number of levels actually found. */
+    h->nlevs = h->dim;
+    AddSHamilton(h);
   }
 #ifdef PERFORM_STATISTICS
   stop = clock();
@@ -662,6 +752,135 @@ int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md
   return -1;
 }
 
+/*
+** the number of electrons that must be moved to turn configuration
+** c1 into c2. the shells of both are sorted in the same order.
+*/
+static int ConfigDistance(CONFIG *c1, CONFIG *c2) {
+  int i, j, k, d;
+
+  i = 0;
+  j = 0;
+  d = 0;
+  while (i < c1->n_shells || j < c2->n_shells) {
+    if (i == c1->n_shells) k = 1;
+    else if (j == c2->n_shells) k = -1;
+    else k = CompareShellInvert(c1->shells+i, c2->shells+j);
+    if (k == 0) {
+      d += abs(c1->shells[i].nq - c2->shells[j].nq);
+      i++;
+      j++;
+    } else if (k < 0) {
+      d += c1->shells[i++].nq;
+    } else {
+      d += c2->shells[j++].nq;
+    }
+  }
+
+  return d/2;
+}
+
+/*
+** the upper triangle is stored by columns. the row indices of
+** column j are in hidx[hptr[j]...hptr[j+1]-1], in increasing order, 
+** the last one is the diagonal. only the nonzero elements are kept.
+** the states of configurations which differ by more than two 
+** electrons do not interact, and are skipped without evaluating
+** the element.
+*/
+int ConstructHamiltonSparse(int isym) {
+  HAMILTON *h;
+  SYMMETRY *sym;
+  STATE *s;
+  CONFIG **c;
+  char *ia;
+  int i, j, t, n, nc, *cn, **ci, *kc;
+  double r, **cr;
+
+  h = &_ham;
+  n = h->dim;
+  cn = (int *) malloc(sizeof(int)*n);
+  ci = (int **) malloc(sizeof(int *)*n);
+  cr = (double **) malloc(sizeof(double *)*n);
+  if (!cn || !ci || !cr) return -1;
+
+  /* index the distinct configurations of the basis, and tabulate 
+     which pairs of them can interact. */
+  sym = GetSymmetry(isym);
+  c = (CONFIG **) malloc(sizeof(CONFIG *)*n);
+  kc = (int *) malloc(sizeof(int)*n);
+  nc = 0;
+  for (i = 0; i < n; i++) {
+    s = (STATE *) ArrayGet(&(sym->states), h->basis[i]);
+    c[nc] = GetConfig(s);
+    for (t = nc-1; t >= 0; t--) {
+      if (c[t] == c[nc]) break;
+    }
+    if (t < 0) t = nc++;
+    kc[i] = t;
+  }
+  ia = (char *) malloc(sizeof(char)*nc*nc);
+  for (j = 0; j < nc; j++) {
+    for (i = 0; i <= j; i++) {
+      ia[i+j*nc] = (ConfigDistance(c[i], c[j]) <= 2);
+      ia[j+i*nc] = ia[i+j*nc];
+    }
+  }
+
+#pragma omp parallel for private(i, j, t, r) schedule(dynamic)
+  for (j = 0; j < n; j++) {
+    ci[j] = (int *) malloc(sizeof(int)*(j+1));
+    cr[j] = (double *) malloc(sizeof(double)*(j+1));
+    t = 0;
+    for (i = 0; i <= j; i++) {
+      if (i < j && !ia[kc[i]+kc[j]*nc]) continue;
+      r = HamiltonElement(isym, h->basis[i], h->basis[j]);
+      if (i < j && r == 0.0) continue;
+      ci[j][t] = i;
+      cr[j][t] = r;
+      t++;
+    }
+    cn[j] = t;
+    ci[j] = (int *) ReallocNew(ci[j], sizeof(int)*t);
+    cr[j] = (double *) ReallocNew(cr[j], sizeof(double)*t);
+  }
+  free(c);
+  free(kc);
+  free(ia);
+
+  if (h->hptr) free(h->hptr);
+  if (h->hidx) free(h->hidx);
+  h->hptr = (int *) malloc(sizeof(int)*(n+1));
+  h->hptr[0] = 0;
+  for (j = 0; j < n; j++) {
+    h->hptr[j+1] = h->hptr[j] + cn[j];
+  }
+  h->nnz = h->hptr[n];
+  h->hidx = (int *) malloc(sizeof(int)*h->nnz);
+  h->hsize = h->nnz;
+  if (h->hamilton == NULL) {
+    h->hsize0 = h->hsize;
+    h->hamilton = (double *) malloc(sizeof(double)*h->hsize);
+  } else if (h->hsize > h->hsize0) {
+    h->hsize0 = h->hsize;
+    free(h->hamilton);
+    h->hamilton = (double *) malloc(sizeof(double)*h->hsize);
+  }
+  if (!(h->hidx) || !(h->hamilton)) return -1;
+  for (j = 0; j < n; j++) {
+    t = h->hptr[j];
+    memcpy(h->hidx+t, ci[j], sizeof(int)*cn[j]);
+    memcpy(h->hamilton+t, cr[j], sizeof(double)*cn[j]);
+    free(ci[j]);
+    free(cr[j]);
+  }
+  free(cn);
+  free(ci);
+  free(cr);
+
+  return 0;
+}
+
 int ValidBasis(STATE *s, int k, int *kg, int n) {
   int t, m, kb;
   LEVEL *lev;
@@ -1817,6 +2036,11 @@ int DiagnolizeHamilton(void) {
 
   lwork = h->lwork;
   liwork = h->liwork;  
+  h->nlevs = n;
+
+  if (h->storage == 2) {
+    return DiagnolizeHamiltonSparse();
+  }
  
   if (ci_level == -1) {
     mixing = h->mixing+n;
@@ -1838,6 +2062,35 @@ int DiagnolizeHamilton(void) {
   }
   w = mixing;
   z = mixing + n;
+#ifdef SYSTEM_LAPACK
+  if (h->storage == 1 && h->heff == NULL) {
+    char range[] = "A";
+    int nlev;
+
+    ap = h->hamilton;
+    nlev = n;
+    if (diag_nlev > 0 && diag_nlev < n) nlev = diag_nlev;
+    if (diag_mode == 2) {
+      if (nlev < n) range[0] = 'I';
+      d_zero = 0.0;
+      one = 1;
+      DSYEVR(jobz, range, uplo, n, ap, n, d_zero, d_zero, one, nlev,
+	     d_zero, &k, w, z, ldz, h->iwork+liwork-2*n, h->work, lwork,
+	     h->iwork, liwork-2*n, &info);
+      nlev = k;
+    } else {
+      DSYEVD(jobz, uplo, n, ap, n, w, h->work, lwork,
+	     h->iwork, liwork, &info);
+      memcpy(z, ap, sizeof(double)*n*nlev);
+    }
+    if (info) {
+      printf("full storage eigen solver Error: %d\n", info);
+      goto ERROR;
+    }
+    h->nlevs = nlev;
+    return 0;
+  }
+#endif
   if (h->heff == NULL) {
     ap = h->hamilton;
     /* the dspevd sometimes fails. use dspev instead 
@@ -1920,9 +2173,368 @@ int DiagnolizeHamilton(void) {
   return -1;
 }
 
+/*
+** y = H x for the sparse Hamiltonian h. h is passed explicitly 
+** since _ham is threadprivate and this is called by the workers 
+** of the team that multiplies the Davidson block.
+*/
+void MultiplyHamiltonSparse(HAMILTON *h, double *x, double *y) {
+  int i, j, p;
+  double a, b;
+
+  for (j = 0; j < h->dim; j++) {
+    y[j] = 0.0;
+  }
+  for (j = 0; j < h->dim; j++) {
+    b = 0.0;
+    for (p = h->hptr[j]; p < h->hptr[j+1]-1; p++) {
+      i = h->hidx[p];
+      a = h->hamilton[p];
+      b += a*x[i];
+      y[i] += a*x[j];
+    }
+    y[j] += b + h->hamilton[p]*x[j];
+  }
+}
+
+/*
+** block Davidson iterations for the lowest diag_nlev eigenpairs of 
+** the sparse Hamiltonian, with the diagonal as the preconditioner. 
+** the results are stored in h->mixing as DiagnolizeHamilton does. 
+** small matrices are expanded and passed to DSPEV.
+*/
+int DiagnolizeHamiltonSparse(void) {
+  HAMILTON *h;
+  char jobz[] = "V";
+  char uplo[] = "U";
+  char trans[] = "T";
+  char notrans[] = "N";
+  int n, k, m, mmax, nw, nc, na, i, j, p, q, iter, one, info;
+  int *conv;
+  double *v, *w, *g, *gt, *e, *s, *x, *r, *c, *hd, *wk, *t;
+  double a, b, b0, d_one, d_zero, d_mone;
+
+  h = &_ham;
+  n = h->dim;
+  k = diag_nlev;
+  if (k > n) k = n;
+  one = 1;
+  
+  if (n <= DAVIDSON_MINDIM*diag_nlev) {
+    q = n*(n+1)/2;
+    g = (double *) malloc(sizeof(double)*(q + 3*n));
+    wk = g + q;
+    for (i = 0; i < q; i++) g[i] = 0.0;
+    for (j = 0; j < n; j++) {
+      q = j*(j+1)/2;
+      for (p = h->hptr[j]; p < h->hptr[j+1]; p++) {
+	g[q + h->hidx[p]] = h->hamilton[p];
+      }
+    }
+    DSPEV(jobz, uplo, n, g, h->mixing, h->mixing+n, n, wk, &info);
+    free(g);
+    if (info) return -1;
+    h->nlevs = k;
+    return 0;
+  }
+
+  mmax = 3*k;
+  if (mmax < k+16) mmax = k+16;
+  if (mmax > n) mmax = n;
+  q = mmax*(mmax+1)/2;
+  hd = (double *) malloc(sizeof(double)*n);
+  v = (double *) malloc(sizeof(double)*n*mmax);
+  w = (double *) malloc(sizeof(double)*n*mmax);
+  x = (double *) malloc(sizeof(double)*n*k);
+  r = (double *) malloc(sizeof(double)*n*k);
+  g = (double *) malloc(sizeof(double)*q);
+  gt = (double *) malloc(sizeof(double)*q);
+  s = (double *) malloc(sizeof(double)*mmax*mmax);
+  e = (double *) malloc(sizeof(double)*mmax);
+  c = (double *) malloc(sizeof(double)*mmax);
+  wk = (double *) malloc(sizeof(double)*3*mmax);
+  conv = (int *) malloc(sizeof(int)*n);
+  if (!hd || !v || !w || !x || !r || !g || !gt || 
+      !s || !e || !c || !wk || !conv) {
+    printf("Not enough memory for the Davidson solver\n");
+    exit(1);
+  }
+  d_one = 1.0;
+  d_zero = 0.0;
+  d_mone = -1.0;
+
+  /* the unit vectors of the k lowest diagonal elements */
+  for (j = 0; j < n; j++) {
+    hd[j] = h->hamilton[h->hptr[j+1]-1];
+    conv[j] = 0;
+  }
+  for (i = 0; i < k; i++) {
+    q = -1;
+    for (j = 0; j < n; j++) {
+      if (conv[j]) continue;
+      if (q < 0 || hd[j] < hd[q]) q = j;
+    }
+    conv[q] = 1;
+    t = v + i*n;
+    for (j = 0; j < n; j++) t[j] = 0.0;
+    t[q] = 1.0;
+  }
+
+  m = k;
+  nw = 0;
+  nc = 0;
+  for (iter = 0; iter < DAVIDSON_NITER; iter++) {
+#pragma omp parallel for private(j) schedule(dynamic)
+    for (j = nw; j < m; j++) {
+      MultiplyHamiltonSparse(h, v+j*n, w+j*n);
+    }
+    for (j = nw; j < m; j++) {
+      q = j*(j+1)/2;
+      for (i = 0; i <= j; i++) {
+	g[q+i] = DDOT(n, v+i*n, one, w+j*n, one);
+      }
+    }
+    nw = m;
+    memcpy(gt, g, sizeof(double)*m*(m+1)/2);
+    DSPEV(jobz, uplo, m, gt, e, s, m, wk, &info);
+    if (info) goto ERROR;
+    /* ritz vectors and H times them */
+    DGEMM(notrans, notrans, n, k, m, d_one, v, n, s, m, d_zero, x, n);
+    DGEMM(notrans, notrans, n, k, m, d_one, w, n, s, m, d_zero, r, n);
+
+    nc = 0;
+    for (i = 0; i < k; i++) {
+      b = 0.0;
+      for (p = 0; p < n; p++) {
+	a = r[i*n+p] - e[i]*x[i*n+p];
+	b += a*a;
+      }
+      conv[i] = (sqrt(b) < DAVIDSON_TOL);
+      nc += conv[i];
+    }
+    if (nc == k) break;
+
+    if (m + k - nc > mmax) {
+      /* restart with the ritz vectors */
+      memcpy(v, x, sizeof(double)*n*k);
+      memcpy(w, r, sizeof(double)*n*k);
+      for (j = 0; j < k; j++) {
+	q = j*(j+1)/2;
+	for (i = 0; i < j; i++) g[q+i] = 0.0;
+	g[q+j] = e[j];
+      }
+      m = k;
+      nw = k;
+    }
+
+    /* preconditioned residuals as the new directions */
+    na = m;
+    for (i = 0; i < k; i++) {
+      if (conv[i]) continue;
+      t = v + na*n;
+      for (p = 0; p < n; p++) {
+	a = e[i] - hd[p];
+	if (fabs(a) < EPS8) a = EPS8;
+	t[p] = (r[i*n+p] - e[i]*x[i*n+p])/a;
+      }
+      b0 = sqrt(DDOT(n, t, one, t, one));
+      for (j = 0; j < 2; j++) {
+	DGEMV(trans, n, na, d_one, v, n, t, one, d_zero, c, one);
+	DGEMV(notrans, n, na, d_mone, v, n, c, one, d_one, t, one);
+      }
+      b = sqrt(DDOT(n, t, one, t, one));
+      if (b < EPS8*b0) continue;
+      DSCAL(n, 1.0/b, t, one);
+      na++;
+    }
+    if (na == m) break;
+    m = na;
+  }
+  
+  if (nc < k) {
+    printf("Davidson solver converged for %d of %d levels in %d iter\n",
+	   nc, k, iter);
+  }
+  memcpy(h->mixing, e, sizeof(double)*k);
+  memcpy(h->mixing+n, x, sizeof(double)*n*k);
+  h->nlevs = k;
+  info = 0;
+
+ ERROR:
+  free(hd);
+  free(v);
+  free(w);
+  free(x);
+  free(r);
+  free(g);
+  free(gt);
+  free(s);
+  free(e);
+  free(c);
+  free(wk);
+  free(conv);
+  if (info) return -1;
+  return 0;
+}
+
+/*
+** the bundled LAPACK computes the machine constants on the first
+** call and keeps them in SAVE variables. make these calls before 
+** the threads diagonalize concurrently.
+*/
+static void InitLapackConstants(void) {
+  char jobz[] = "V";
+  char uplo[] = "U";
+  double *ap, *w, *z, *work;
+  int *iwork, n, i, j, t, lwork, liwork, info;
+
+  n = 32;
+  lwork = 1 + 6*n + n*n;
+  liwork = 3 + 5*n;
+  t = n*(n+1)/2;
+  ap = (double *) malloc(sizeof(double)*(t + n + n*n + lwork));
+  iwork = (int *) malloc(sizeof(int)*liwork);
+  w = ap + t;
+  z = w + n;
+  work = z + n*n;
+  for (j = 0; j < n; j++) {
+    t = j*(j+1)/2;
+    for (i = 0; i <= j; i++) {
+      ap[t+i] = sin(1.0+i*j+j);
+    }
+  }
+  DSPEVD(jobz, uplo, n, ap, w, z, n, work, lwork, iwork, liwork, &info);
+  for (j = 0; j < 4; j++) {
+    t = j*(j+1)/2;
+    for (i = 0; i <= j; i++) {
+      ap[t+i] = sin(1.0+i*j+j);
+    }
+  }
+  DSPEV(jobz, uplo, 4, ap, w, z, 4, work, &info);
+  free(ap);
+  free(iwork);
+}
+
+/*
+** construct and diagnolize the Hamiltonians of all symmetries, 
+** the levels are added in the order of the symmetries.
+** only one level of parallelism is used. when there are at least
+** as many blocks as threads, and no block has more than a share of
+** one thread of the squared dimensions, the symmetries are 
+** distributed over the threads, each with its own HAMILTON. 
+** otherwise the blocks are solved one after another, and the 
+** threads share the work within each block. this choice is a rough
+** rule, it has not been timed on several cores.
+** the finished blocks are kept in a reorder buffer until all the
+** preceding symmetries have been added, so that the levels and 
+** hams are the same as in a serial run. as in the serial loop, a 
+** block that fails to diagonalize stops the calculation, the
+** levels of the preceding blocks are kept, and -1 is returned.
+*/
+int SolveStructure(int ng0, int ng, int *kg, int ngp, int *kgp) {
+  HAMILTON *h, *rh;
+  SYMMETRY *sym;
+  STATE *s;
+  int *rs, i, k, t, d, ns, nb, next, failed, par;
+  double w, wt, wmax;
+
+  ns = MAX_SYMMETRIES;
+  par = 0;
+  if (MaxThreads() > 1) {
+    nb = 0;
+    wt = 0.0;
+    wmax = 0.0;
+    for (i = 0; i < ns; i++) {
+      sym = GetSymmetry(i);
+      if (sym == NULL) continue;
+      d = 0;
+      for (t = 0; t < sym->n_states; t++) {
+	s = (STATE *) ArrayGet(&(sym->states), t);
+	if (InGroups(s->kgroup, ng, kg) || 
+	    (ngp > 0 && InGroups(s->kgroup, ngp, kgp))) d++;
+      }
+      if (d == 0) continue;
+      w = (double) d*d;
+      nb++;
+      wt += w;
+      if (w > wmax) wmax = w;
+    }
+    par = (nb >= MaxThreads() && wmax*MaxThreads() <= wt);
+  }
+
+  rh = (HAMILTON *) malloc(sizeof(HAMILTON)*ns);
+  rs = (int *) malloc(sizeof(int)*ns);
+  if (!rh || !rs) return -1;
+  for (i = 0; i < ns; i++) {
+    rs[i] = -3;
+  }
+  next = 0;
+  failed = ns;
+  if (MaxThreads() > 1) InitLapackConstants();
+
+#pragma omp parallel for private(i, k, h) schedule(dynamic) if (par)
+  for (i = 0; i < ns; i++) {
+    /* the blocks after a failed one are not needed */
+#pragma omp critical(structure_levels)
+    k = (i > failed);
+    if (k) continue;
+    k = ConstructHamilton(i, ng0, ng, kg, ngp, kgp, 1110);
+    if (k >= 0) {
+      if (DiagnolizeHamilton() < 0) {
+	k = -2;
+      } else {
+	/* hand the basis and mixing over to the reorder buffer */
+	h = &_ham;
+	memcpy(rh+i, h, sizeof(HAMILTON));
+	h->basis = NULL;
+	h->mixing = NULL;
+	h->n_basis0 = 0;
+	h->msize0 = 0;
+	k = 1;
+      }
+    } else {
+      k = 0;
+    }
+#pragma omp critical(structure_levels)
+    {
+      rs[i] = k;
+      if (k == -2 && i < failed) failed = i;
+      while (next < failed && rs[next] != -3) {
+	if (rs[next] == 1) {
+	  h = rh + next;
+	  AddSHamilton(h);
+	  if (ng0 < ng) {
+	    AddToLevelsHamilton(h, ng0, kg);
+	  } else {
+	    AddToLevelsHamilton(h, 0, kg);
+	  }
+	  free(h->basis);
+	  free(h->mixing);
+	}
+	next++;
+      }
+    }
+  }
+
+  /* the finished blocks after a failed one */
+  for (i = next; i < ns; i++) {
+    if (rs[i] == 1) {
+      free(rh[i].basis);
+      free(rh[i].mixing);
+    }
+  }
+  free(rh);
+  free(rs);
+  if (failed < ns) return -1;
+  return 0;
+}
+
 int AddToLevels(int ng, int *kg) {
+  return AddToLevelsHamilton(&_ham, ng, kg);
+}
+
+int AddToLevelsHamilton(HAMILTON *h, int ng, int *kg) {
   int i, d, j, k, t, m;
-  HAMILTON *h;
   LEVEL lev;
   SYMMETRY *sym;
   STATE *s, *s1;
@@ -1969,7 +2581,6 @@ int AddToLevels(int ng, int *kg) {
     return 0;
   }
 
-  h = &_ham;
   if (h->basis == NULL ||
       h->mixing == NULL) return -1;
   d = h->dim;
@@ -2010,9 +2621,14 @@ int AddToLevels(int ng, int *kg) {
     return 0;
   }
 
+  /* the partial spectrum solvers find fewer levels than the dimension
+     of a block registered before its diagonalization. */
+  if (nhams > 0 && hams[nhams-1].pj == h->pj) {
+    hams[nhams-1].nlevs = h->nlevs;
+  }
   j = n_levels;
   sym = GetSymmetry(h->pj);  
-  for (i = 0; i < d; i++) {
+  for (i = 0; i < h->nlevs; i++) {
     k = GetPrincipleBasis(mix, d, NULL);
     s = (STATE *) ArrayGet(&(sym->states), h->basis[k]);
     if (ng > 0) {      
@@ -3022,6 +3638,637 @@ void StructureEB(char *fn, int n, int *ilev) {
   SaveEBLevels(fn, k, -1);
 }
 
+/*
+** store the angular coefficients a and pnz of ns basis pairs into ad,
+** with ns set last, unless another thread has done so meanwhile.
+*/
+static void PublishAngZ(ANGZ_DATUM *ad, int kind, int ns,
+			void **a, int *pnz) {
+  int i;
+
+#pragma omp critical(structure_angz)
+  {
+    if (ad->ns == 0) {
+      ad->kind = kind;
+      ad->angz = a;
+      ad->nz = pnz;
+#pragma omp flush
+      ad->ns = ns;
+    } else {
+      for (i = 0; i < ns; i++) {
+	if (pnz[i] > 0) free(a[i]);
+      }
+      free(a);
+      free(pnz);
+    }
+  }
+}
+
+/*
+** the on-disk store of the angular coefficients. a record is
+** addressed by the kind of coefficients and the content of the two
+** bases, i.e., the configurations and the coupled shell states, not
+** by the indices of this run. the orbitals of the coefficients are
+** kept as (n, kappa) in a table, and resolved again when loaded.
+** a basis made from the levels of another ion (kgroup < 0) has no 
+** such content, its states depend on the mixing of the levels, and
+** its coefficients are not stored.
+** the file starts with 8 ints {magic, version, sizeof(long), norb,
+** nrec, 0, 0, 0} and the offsets of the index, the orbital table,
+** and the interacting shells of recouple.c.
+** each record has 4 ints {kind, ns, nd, ntot}, the nd ints of the
+** descriptor, the ns counts of the basis pairs, the ntot
+** coefficients, and the ranks and orbitals of the coefficients.
+*/
+#define ANGZ_MAGIC   0x5a474e41
+#define ANGZ_VERSION 2
+
+typedef struct _ANGZ_INDEX_ {
+  unsigned int key;
+  int kind;
+  long offset;
+} ANGZ_INDEX;
+
+static struct {
+  char *map;
+  long msize;
+  int mmapped;
+  int norb, nrec;
+  int *orb;
+  ANGZ_INDEX *index;
+} angz_store = {NULL, 0, 0, 0, 0, NULL, NULL};
+
+/* number of ints stored for each coefficient of the kind. */
+static int AngZWidth(int kind) {
+  switch (kind) {
+  case ANGZ_MIX:
+    return 3;
+  case ANGZ_FB:
+    return 1;
+  default:
+    return 5;
+  }
+}
+
+/*
+** number of leading ints of a coefficient that are not orbitals,
+** the rank, and the j of the free electron of ANGULAR_ZxZMIX.k0.
+*/
+static int AngZRaw(int kind) {
+  switch (kind) {
+  case ANGZ_MIX:
+    return 1;
+  case ANGZ_FB:
+    return 0;
+  default:
+    return 2;
+  }
+}
+
+/* offset of the coefficients in a record, in units of int. */
+static int AngZRecordHead(int ns, int nd) {
+  int m;
+
+  m = 4 + nd + ns;
+  return m + (m&1);
+}
+
+/*
+** the descriptor of the basis of hams[ih], stored in d if it is
+** not NULL. returns the number of ints, or -1 if a basis state is
+** not made of a configuration.
+*/
+static int HamDescriptor(int ih, int *d) {
+  int i, j, n, *t;
+  STATE *s;
+  CONFIG *c;
+  SHELL_STATE *csf;
+
+  if (d) {
+    d[0] = hams[ih].pj;
+    d[1] = hams[ih].nbasis;
+    for (i = 0; i < MBCLOSE; i++) d[2+i] = hams[ih].closed[i];
+  }
+  n = 2 + MBCLOSE;
+  for (i = 0; i < hams[ih].nbasis; i++) {
+    s = hams[ih].basis[i];
+    if (s->kgroup < 0) return -1;
+    c = GetConfigFromGroup(s->kgroup, s->kcfg);
+    if (d) {
+      csf = c->csfs + s->kstate;
+      d[n] = c->n_shells;
+      t = d + n + 1;
+      for (j = 0; j < c->n_shells; j++) {
+	t[0] = c->shells[j].n;
+	t[1] = c->shells[j].kappa;
+	t[2] = c->shells[j].nq;
+	t[3] = csf[j].shellJ;
+	t[4] = csf[j].totalJ;
+	t[5] = csf[j].nu;
+	t[6] = csf[j].Nr;
+	t += 7;
+      }
+    }
+    n += 1 + 7*c->n_shells;
+  }
+
+  return n;
+}
+
+/*
+** the descriptor of the coefficients of the kind between hams[ih1]
+** and hams[ih2], allocated in d. returns the number of ints, or -1
+** if they are not to be stored.
+*/
+static int AngZDescriptor(int kind, int ih1, int ih2, int **d) {
+  int n1, n2, n;
+
+  *d = NULL;
+  n1 = HamDescriptor(ih1, NULL);
+  if (n1 < 0) return -1;
+  n2 = HamDescriptor(ih2, NULL);
+  if (n2 < 0) return -1;
+  n = 2 + n1 + n2;
+  *d = (int *) malloc(sizeof(int)*n);
+  (*d)[0] = kind;
+  (*d)[1] = (kind == ANGZ_FB)? GetMaxRank() : 0;
+  HamDescriptor(ih1, *d + 2);
+  HamDescriptor(ih2, *d + 2 + n1);
+
+  return n;
+}
+
+/* FNV-1a hash of the descriptor d. */
+static unsigned int AngZHash(int n, int *d) {
+  unsigned int h;
+  int i;
+
+  h = 2166136261U;
+  for (i = 0; i < n; i++) {
+    h ^= (unsigned int) d[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+static int CompareAngZIndex(const void *p1, const void *p2) {
+  unsigned int k1, k2;
+
+  k1 = ((ANGZ_INDEX *) p1)->key;
+  k2 = ((ANGZ_INDEX *) p2)->key;
+  if (k1 < k2) return -1;
+  if (k1 > k2) return 1;
+  return 0;
+}
+
+/*
+** the position in idx of n entries sorted by the key, of the first
+** entry whose key is not less than h.
+*/
+static int LowerAngZIndex(ANGZ_INDEX *idx, int n, unsigned int h) {
+  int i0, i1, i;
+
+  i0 = 0;
+  i1 = n;
+  while (i0 < i1) {
+    i = (i0 + i1)/2;
+    if (idx[i].key < h) i0 = i + 1;
+    else i1 = i;
+  }
+  return i0;
+}
+
+/* offset of the record of the descriptor d in the store, or -1. */
+static long FindAngZRecord(int nd, int *d) {
+  unsigned int h;
+  int i, *r;
+
+  h = AngZHash(nd, d);
+  i = LowerAngZIndex(angz_store.index, angz_store.nrec, h);
+  for (; i < angz_store.nrec && angz_store.index[i].key == h; i++) {
+    if (angz_store.index[i].kind != d[0]) continue;
+    r = (int *) (angz_store.map + angz_store.index[i].offset);
+    if (r[2] == nd && memcmp(r+4, d, sizeof(int)*nd) == 0) {
+      return angz_store.index[i].offset;
+    }
+  }
+  return -1;
+}
+
+/* the orbital index of the entry i of the table of the store. */
+static int AngZOrbital(int *omap, int i) {
+  int n, kappa;
+
+  if (omap[i] == -2) {
+    n = angz_store.orb[2*i];
+    kappa = angz_store.orb[2*i+1];
+    if (kappa == 0) omap[i] = n;
+    else omap[i] = OrbitalIndex(n, kappa, 0.0);
+  }
+  return omap[i];
+}
+
+/*
+** rebuild the coefficients of the record at offset p of the store,
+** and publish them into ad. returns the number of basis pairs.
+*/
+static int RestoreAngZ(ANGZ_DATUM *ad, long p) {
+  int kind, ns, nd, i, j, *r, *nz, *ik, *omap, *pnz;
+  double *c;
+  void **a;
+  ANGULAR_ZMIX *zm;
+  ANGULAR_ZFB *zf;
+  ANGULAR_ZxZMIX *zx;
+
+  r = (int *) (angz_store.map + p);
+  kind = r[0];
+  ns = r[1];
+  nd = r[2];
+  nz = r + 4 + nd;
+  c = (double *) (r + AngZRecordHead(ns, nd));
+  ik = (int *) (c + r[3]);
+  omap = (int *) malloc(sizeof(int)*angz_store.norb);
+  for (i = 0; i < angz_store.norb; i++) omap[i] = -2;
+  a = (void **) malloc(sizeof(void *)*ns);
+  pnz = (int *) malloc(sizeof(int)*ns);
+  for (i = 0; i < ns; i++) {
+    pnz[i] = nz[i];
+    a[i] = NULL;
+    if (nz[i] <= 0) continue;
+    switch (kind) {
+    case ANGZ_MIX:
+      zm = (ANGULAR_ZMIX *) malloc(sizeof(ANGULAR_ZMIX)*nz[i]);
+      for (j = 0; j < nz[i]; j++) {
+	zm[j].coeff = c[j];
+	zm[j].k = ik[0];
+	zm[j].k0 = AngZOrbital(omap, ik[1]);
+	zm[j].k1 = AngZOrbital(omap, ik[2]);
+	ik += 3;
+      }
+      a[i] = zm;
+      break;
+    case ANGZ_FB:
+      zf = (ANGULAR_ZFB *) malloc(sizeof(ANGULAR_ZFB)*nz[i]);
+      for (j = 0; j < nz[i]; j++) {
+	zf[j].coeff = c[j];
+	zf[j].kb = AngZOrbital(omap, ik[0]);
+	ik++;
+      }
+      a[i] = zf;
+      break;
+    default:
+      zx = (ANGULAR_ZxZMIX *) malloc(sizeof(ANGULAR_ZxZMIX)*nz[i]);
+      for (j = 0; j < nz[i]; j++) {
+	zx[j].coeff = c[j];
+	zx[j].k = ik[0];
+	zx[j].k0 = ik[1];
+	zx[j].k1 = AngZOrbital(omap, ik[2]);
+	zx[j].k2 = AngZOrbital(omap, ik[3]);
+	zx[j].k3 = AngZOrbital(omap, ik[4]);
+	ik += 5;
+      }
+      a[i] = zx;
+      break;
+    }
+    c += nz[i];
+  }
+  free(omap);
+  PublishAngZ(ad, kind, ns, a, pnz);
+
+  return ad->ns;
+}
+
+/*
+** look the coefficients of the kind between hams[ih1] and hams[ih2]
+** up in the store, and publish them into ad if found. returns the
+** number of basis pairs, 0 if they are not in the store.
+*/
+static int LookupAngZ(ANGZ_DATUM *ad, int kind, int ih1, int ih2) {
+  int nd, *d;
+  long p;
+
+  if (angz_store.nrec == 0) return 0;
+  nd = AngZDescriptor(kind, ih1, ih2, &d);
+  if (nd < 0) return 0;
+  p = FindAngZRecord(nd, d);
+  free(d);
+  if (p < 0) return 0;
+  return RestoreAngZ(ad, p);
+}
+
+static void ClearAngZStore(void) {
+  if (angz_store.map) {
+#ifdef _POSIX_MAPPED_FILES
+    if (angz_store.mmapped) munmap(angz_store.map, angz_store.msize);
+    else free(angz_store.map);
+#else
+    free(angz_store.map);
+#endif
+  }
+  angz_store.map = NULL;
+  angz_store.msize = 0;
+  angz_store.mmapped = 0;
+  angz_store.norb = 0;
+  angz_store.nrec = 0;
+  angz_store.orb = NULL;
+  angz_store.index = NULL;
+  SetInteractStore(NULL);
+}
+
+/*
+** map the angular store fn, whose records are then used in place of
+** computing the coefficients. returns the number of records, or -1
+** if the file does not exist or is not a valid store.
+*/
+int LoadAngZ(char *fn) {
+  FILE *f;
+  int hdr[8];
+  long pos[3];
+
+  ClearAngZStore();
+  f = fopen(fn, "r");
+  if (f == NULL) return -1;
+  if (fread(hdr, sizeof(int), 8, f) != 8 ||
+      fread(pos, sizeof(long), 3, f) != 3 ||
+      hdr[0] != ANGZ_MAGIC || hdr[1] != ANGZ_VERSION ||
+      hdr[2] != (int) sizeof(long)) {
+    printf("invalid angular store %s\n", fn);
+    fclose(f);
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  angz_store.msize = ftell(f);
+#ifdef _POSIX_MAPPED_FILES
+  angz_store.map = mmap(NULL, angz_store.msize, PROT_READ, MAP_SHARED,
+			fileno(f), 0);
+  if (angz_store.map == MAP_FAILED) {
+    angz_store.map = NULL;
+  } else {
+    angz_store.mmapped = 1;
+  }
+#endif
+  if (angz_store.map == NULL) {
+    angz_store.map = malloc(angz_store.msize);
+    fseek(f, 0, SEEK_SET);
+    if ((long) fread(angz_store.map, 1, angz_store.msize, f) !=
+	angz_store.msize) {
+      printf("error reading file %s\n", fn);
+      fclose(f);
+      ClearAngZStore();
+      return -1;
+    }
+  }
+  fclose(f);
+  angz_store.norb = hdr[3];
+  angz_store.nrec = hdr[4];
+  angz_store.index = (ANGZ_INDEX *) (angz_store.map + pos[0]);
+  angz_store.orb = (int *) (angz_store.map + pos[1]);
+  if (pos[2] > 0) SetInteractStore((int *) (angz_store.map + pos[2]));
+
+  return angz_store.nrec;
+}
+
+/*
+** the entry of the orbital (n, kappa) in the table tab of ntab
+** entries and room for mtab, appended if not there.
+*/
+static int AngZTableId(int n, int kappa, int *ntab, int *mtab, int **tab) {
+  int i;
+
+  for (i = 0; i < *ntab; i++) {
+    if ((*tab)[2*i] == n && (*tab)[2*i+1] == kappa) return i;
+  }
+  if (*ntab == *mtab) {
+    *mtab = 2*(*mtab) + 64;
+    *tab = (int *) realloc(*tab, sizeof(int)*2*(*mtab));
+  }
+  (*tab)[2*i] = n;
+  (*tab)[2*i+1] = kappa;
+  (*ntab)++;
+  return i;
+}
+
+/* the table entry of the orbital index k, cached in tmap. */
+static int AngZOrbitalId(int k, int *tmap, int *ntab, int *mtab, int **tab) {
+  ORBITAL *orb;
+
+  if (k < 0) return AngZTableId(k, 0, ntab, mtab, tab);
+  if (tmap[k] < 0) {
+    orb = GetOrbital(k);
+    tmap[k] = AngZTableId(orb->n, orb->kappa, ntab, mtab, tab);
+  }
+  return tmap[k];
+}
+
+/*
+** write the coefficients of all basis pairs computed so far, and the
+** records of the loaded store not computed again, to the store fn.
+** the file is written to fn.tmp first and then renamed, so that a
+** mapping of the old file stays valid.
+*/
+int SaveAngZ(char *fn) {
+  FILE *f;
+  char *tfn;
+  int hdr[8], i, j, k, t, ns, nd, ntot, ncur, nrec, ntab, mtab, norb;
+  int iw[5], zero[2], *tab, *tmap, *otab, *cnd, **cd, *r, *ik;
+  long pos[3];
+  ANGZ_INDEX *cur, *idx;
+  ANGZ_DATUM *ad;
+  ANGULAR_ZMIX *zm;
+  ANGULAR_ZFB *zf;
+  ANGULAR_ZxZMIX *zx;
+
+  tfn = (char *) malloc(strlen(fn)+5);
+  sprintf(tfn, "%s.tmp", fn);
+  f = fopen(tfn, "w");
+  if (f == NULL) {
+    printf("cannot open file %s\n", tfn);
+    free(tfn);
+    return -1;
+  }
+
+  ncur = 0;
+  for (i = 0; i < 2*angz_dim2; i++) {
+    ad = (i < angz_dim2)? angz_array+i : angzxz_array+i-angz_dim2;
+    if (ad->ns > 0) ncur++;
+  }
+  cur = (ANGZ_INDEX *) malloc(sizeof(ANGZ_INDEX)*(ncur+1));
+  cd = (int **) malloc(sizeof(int *)*(ncur+1));
+  cnd = (int *) malloc(sizeof(int)*(ncur+1));
+  idx = (ANGZ_INDEX *) malloc(sizeof(ANGZ_INDEX)*(ncur+angz_store.nrec+1));
+  norb = GetNumOrbitals();
+  tmap = (int *) malloc(sizeof(int)*(norb+1));
+  for (i = 0; i < norb; i++) tmap[i] = -1;
+  ntab = 0;
+  mtab = 0;
+  tab = NULL;
+  zero[0] = 0;
+  zero[1] = 0;
+  for (i = 0; i < 8; i++) hdr[i] = 0;
+  pos[0] = 0;
+  pos[1] = 0;
+  pos[2] = 0;
+  fwrite(hdr, sizeof(int), 8, f);
+  fwrite(pos, sizeof(long), 3, f);
+
+  nrec = 0;
+  k = 0;
+  for (i = 0; i < 2*angz_dim2; i++) {
+    if (i < angz_dim2) {
+      ad = angz_array + i;
+      t = i;
+    } else {
+      ad = angzxz_array + i - angz_dim2;
+      t = i - angz_dim2;
+    }
+    if (ad->ns <= 0) continue;
+    ns = ad->ns;
+    nd = AngZDescriptor(ad->kind, t/angz_dim, t%angz_dim, &(cd[k]));
+    if (nd < 0) continue;
+    cnd[k] = nd;
+    cur[k].key = AngZHash(nd, cd[k]);
+    cur[k].kind = ad->kind;
+    cur[k].offset = k;
+    ntot = 0;
+    for (j = 0; j < ns; j++) {
+      if (ad->nz[j] > 0) ntot += ad->nz[j];
+    }
+    idx[nrec].key = cur[k].key;
+    idx[nrec].kind = ad->kind;
+    idx[nrec].offset = ftell(f);
+    nrec++;
+    iw[0] = ad->kind;
+    iw[1] = ns;
+    iw[2] = nd;
+    iw[3] = ntot;
+    fwrite(iw, sizeof(int), 4, f);
+    fwrite(cd[k], sizeof(int), nd, f);
+    for (j = 0; j < ns; j++) {
+      iw[0] = (ad->nz[j] > 0)? ad->nz[j] : 0;
+      fwrite(iw, sizeof(int), 1, f);
+    }
+    fwrite(zero, sizeof(int), AngZRecordHead(ns, nd)-4-nd-ns, f);
+    for (j = 0; j < ns; j++) {
+      for (t = 0; t < ad->nz[j]; t++) {
+	switch (ad->kind) {
+	case ANGZ_MIX:
+	  fwrite(&(((ANGULAR_ZMIX *) ad->angz[j])[t].coeff),
+		 sizeof(double), 1, f);
+	  break;
+	case ANGZ_FB:
+	  fwrite(&(((ANGULAR_ZFB *) ad->angz[j])[t].coeff),
+		 sizeof(double), 1, f);
+	  break;
+	default:
+	  fwrite(&(((ANGULAR_ZxZMIX *) ad->angz[j])[t].coeff),
+		 sizeof(double), 1, f);
+	  break;
+	}
+      }
+    }
+    for (j = 0; j < ns; j++) {
+      for (t = 0; t < ad->nz[j]; t++) {
+	switch (ad->kind) {
+	case ANGZ_MIX:
+	  zm = ((ANGULAR_ZMIX *) ad->angz[j]) + t;
+	  iw[0] = zm->k;
+	  iw[1] = AngZOrbitalId(zm->k0, tmap, &ntab, &mtab, &tab);
+	  iw[2] = AngZOrbitalId(zm->k1, tmap, &ntab, &mtab, &tab);
+	  break;
+	case ANGZ_FB:
+	  zf = ((ANGULAR_ZFB *) ad->angz[j]) + t;
+	  iw[0] = AngZOrbitalId(zf->kb, tmap, &ntab, &mtab, &tab);
+	  break;
+	default:
+	  zx = ((ANGULAR_ZxZMIX *) ad->angz[j]) + t;
+	  iw[0] = zx->k;
+	  iw[1] = zx->k0;
+	  iw[2] = AngZOrbitalId(zx->k1, tmap, &ntab, &mtab, &tab);
+	  iw[3] = AngZOrbitalId(zx->k2, tmap, &ntab, &mtab, &tab);
+	  iw[4] = AngZOrbitalId(zx->k3, tmap, &ntab, &mtab, &tab);
+	  break;
+	}
+	fwrite(iw, sizeof(int), AngZWidth(ad->kind), f);
+      }
+    }
+    fwrite(zero, sizeof(int), (ntot*AngZWidth(ad->kind))&1, f);
+    k++;
+  }
+
+  ncur = k;
+  qsort(cur, ncur, sizeof(ANGZ_INDEX), CompareAngZIndex);
+  otab = (int *) malloc(sizeof(int)*(angz_store.norb+1));
+  for (i = 0; i < angz_store.norb; i++) otab[i] = -1;
+  for (i = 0; i < angz_store.nrec; i++) {
+    r = (int *) (angz_store.map + angz_store.index[i].offset);
+    nd = r[2];
+    j = LowerAngZIndex(cur, ncur, angz_store.index[i].key);
+    for (; j < ncur && cur[j].key == angz_store.index[i].key; j++) {
+      k = cur[j].offset;
+      if (cnd[k] == nd && memcmp(cd[k], r+4, sizeof(int)*nd) == 0) break;
+    }
+    if (j < ncur && cur[j].key == angz_store.index[i].key) continue;
+    ns = r[1];
+    ntot = r[3];
+    idx[nrec].key = angz_store.index[i].key;
+    idx[nrec].kind = r[0];
+    idx[nrec].offset = ftell(f);
+    nrec++;
+    t = AngZRecordHead(ns, nd);
+    fwrite(r, sizeof(int), t, f);
+    fwrite(r+t, sizeof(double), ntot, f);
+    ik = (int *) (((double *) (r+t)) + ntot);
+    for (j = 0; j < ntot; j++) {
+      for (t = 0; t < AngZWidth(r[0]); t++) {
+	iw[t] = ik[t];
+	if (t < AngZRaw(r[0])) continue;
+	if (otab[ik[t]] < 0) {
+	  otab[ik[t]] = AngZTableId(angz_store.orb[2*ik[t]],
+				    angz_store.orb[2*ik[t]+1],
+				    &ntab, &mtab, &tab);
+	}
+	iw[t] = otab[ik[t]];
+      }
+      fwrite(iw, sizeof(int), AngZWidth(r[0]), f);
+      ik += AngZWidth(r[0]);
+    }
+    fwrite(zero, sizeof(int), (ntot*AngZWidth(r[0]))&1, f);
+  }
+
+  qsort(idx, nrec, sizeof(ANGZ_INDEX), CompareAngZIndex);
+  pos[0] = ftell(f);
+  fwrite(idx, sizeof(ANGZ_INDEX), nrec, f);
+  pos[1] = ftell(f);
+  fwrite(tab, sizeof(int), 2*ntab, f);
+  pos[2] = ftell(f);
+  WriteInteractStore(f);
+  hdr[0] = ANGZ_MAGIC;
+  hdr[1] = ANGZ_VERSION;
+  hdr[2] = sizeof(long);
+  hdr[3] = ntab;
+  hdr[4] = nrec;
+  fseek(f, 0, SEEK_SET);
+  fwrite(hdr, sizeof(int), 8, f);
+  fwrite(pos, sizeof(long), 3, f);
+  fclose(f);
+
+  if (rename(tfn, fn) != 0) {
+    printf("cannot rename %s to %s\n", tfn, fn);
+    nrec = -1;
+  }
+  for (k = 0; k < ncur; k++) free(cd[k]);
+  free(cd);
+  free(cnd);
+  free(cur);
+  free(idx);
+  free(tmap);
+  free(otab);
+  if (tab) free(tab);
+  free(tfn);
+
+  return nrec;
+}
+
 int AngularZMixStates(ANGZ_DATUM **ad, int ih1, int ih2) {
   int kg1, kg2, kc1, kc2;
   int ns, n, p, q, nz, iz, iz1, iz2;
@@ -3065,18 +4312,23 @@ int AngularZMixStates(ANGZ_DATUM **ad, int ih1, int ih2) {
 #endif
     return ns;
   }
+  if (LookupAngZ(*ad, ANGZ_MIX, ih1, ih2) > 0) {
+#ifdef PERFORM_STATISTICS
+    stop = clock();
+    timing.angz_states_load += stop-start;
+    timing.n_angz_states_load++;
+#endif
+    return (*ad)->ns;
+  }
 
   ns1 = hams[ih1].nbasis;
   ns2 = hams[ih2].nbasis;
-  (*ad)->ns = ns1*ns2;
-  ns = (*ad)->ns;
-  (*ad)->angz = malloc(sizeof(ANGULAR_ZMIX *)*ns);
-  (*ad)->nz = (int *) malloc(sizeof(int)*ns);
+  ns = ns1*ns2;
+  a = (ANGULAR_ZMIX **) malloc(sizeof(ANGULAR_ZMIX *)*ns);
+  pnz = (int *) malloc(sizeof(int)*ns);
   iz = 0;
   iz1 = 0;
   iz2 = 0;
-  a = (ANGULAR_ZMIX **) (*ad)->angz;
-  pnz = (*ad)->nz;
 
   for (i1 = 0; i1 < ns1; i1++) {
     s1 = hams[ih1].basis[i1];
@@ -3204,6 +4456,7 @@ int AngularZMixStates(ANGZ_DATUM **ad, int ih1, int ih2) {
       }
     }
   }
+  PublishAngZ(*ad, ANGZ_MIX, ns, (void **) a, pnz);
 #ifdef PERFORM_STATISTICS
   stop = clock();
   timing.angz_states += stop - start;
@@ -3272,19 +4525,23 @@ int AngularZFreeBoundStates(ANGZ_DATUM **ad, int ih1, int ih2) {
 #endif
     return ns;
   }
+  if (LookupAngZ(*ad, ANGZ_FB, ih1, ih2) > 0) {
+#ifdef PERFORM_STATISTICS
+    stop = clock();
+    timing.angzfb_states += stop-start;
+#endif
+    return (*ad)->ns;
+  }
 
   ns1 = hams[ih1].nbasis;
   ns2 = hams[ih2].nbasis;
-  (*ad)->ns = ns1 * ns2;
-  ns = (*ad)->ns;
-  (*ad)->angz = malloc(sizeof(ANGULAR_ZMIX *)*ns);
-  (*ad)->nz = (int *) malloc(sizeof(int)*ns);
+  ns = ns1 * ns2;
+  a = (ANGULAR_ZFB **) malloc(sizeof(ANGULAR_ZFB *)*ns);
+  pnz = (int *) malloc(sizeof(int)*ns);
   
   kmax = GetMaxRank();
 
   iz = 0;
-  a = (ANGULAR_ZFB **) (*ad)->angz;
-  pnz = (*ad)->nz;
     
   for (i1 = 0; i1 < ns1; i1++) {
     s1 = hams[ih1].basis[i1];
@@ -3361,6 +4618,7 @@ int AngularZFreeBoundStates(ANGZ_DATUM **ad, int ih1, int ih2) {
       iz++;
     }
   }
+  PublishAngZ(*ad, ANGZ_FB, ns, (void **) a, pnz);
   
 #ifdef PERFORM_STATISTICS
   stop = clock();
@@ -3414,9 +4672,17 @@ int AngularZxZFreeBoundStates(ANGZ_DATUM **ad, int ih1, int ih2) {
 #endif
     return ns;
   }
+  if (LookupAngZ(*ad, ANGZ_ZXZ, ih1, ih2) > 0) {
+#ifdef PERFORM_STATISTICS
+    stop = clock();
+    timing.angzxzfb_states += stop-start;
+#endif
+    return (*ad)->ns;
+  }
   
   ns1 = hams[ih1].nbasis;
   ns2 = hams[ih2].nbasis;
+  (*ad)->kind = ANGZ_ZXZ;
   (*ad)->ns = ns1*ns2;
   ns = (*ad)->ns;
   (*ad)->angz = malloc(sizeof(ANGULAR_ZxZMIX *)*ns);
@@ -4624,6 +5890,18 @@ void ClearRMatrixLevels(int n) {
 }
 
 int AllocHamMem(int hdim, int nbasis) {
+  return AllocHamStorage(hdim, nbasis, 0);
+}
+
+/*
+** storage = 0, packed upper triangle of the matrix.
+** storage = 1, upper triangle in a hdim*hdim column major array.
+** storage = 2, sparse upper triangle, allocated by 
+** ConstructHamiltonSparse. only the lowest diag_nlev eigenvectors
+** are kept, unless the matrix is small enough for DSPEV.
+** storage > 0 requires hdim == nbasis.
+*/
+int AllocHamStorage(int hdim, int nbasis, int storage) {
   int jp, t;
   HAMILTON *h;
 
@@ -4631,8 +5909,11 @@ int AllocHamMem(int hdim, int nbasis) {
   jp = nbasis - hdim;
   h->dim = hdim;
   h->n_basis = nbasis;
+  h->storage = storage;
   t = hdim*(hdim+1)/2;
-  h->hsize = t + hdim*jp + jp;
+  if (storage == 1) h->hsize = hdim*hdim;
+  else if (storage == 2) h->hsize = 0;
+  else h->hsize = t + hdim*jp + jp;
   if (h->basis == NULL) {
     h->n_basis0 = h->n_basis;
     h->basis = (int *) malloc(sizeof(int)*(h->n_basis));
@@ -4643,32 +5924,54 @@ int AllocHamMem(int hdim, int nbasis) {
   }
   if (!(h->basis)) return -1;
   
-  if (h->hamilton == NULL) {
-    h->hsize0 = h->hsize;
-    h->hamilton = (double *) malloc(sizeof(double)*h->hsize);
-  } else if (h->hsize > h->hsize0) {
-    h->hsize0 = h->hsize;
-    free(h->hamilton);
-    h->hamilton = (double *) malloc(sizeof(double)*h->hsize);
-  }
-  if (!(h->hamilton)) return -1;
+  if (storage != 2) {
+    if (h->hamilton == NULL) {
+      h->hsize0 = h->hsize;
+      h->hamilton = (double *) malloc(sizeof(double)*h->hsize);
+    } else if (h->hsize > h->hsize0) {
+      h->hsize0 = h->hsize;
+      free(h->hamilton);
+      h->hamilton = (double *) malloc(sizeof(double)*h->hsize);
+    }
+    if (!(h->hamilton)) return -1;
     
-  t = t*2;
-  h->lwork = 1 + 10*hdim + t;
-  h->liwork = 3 + 10*hdim;
-  if (h->work == NULL) {
-    h->dim0 = h->dim;
-    h->work = (double *) malloc(sizeof(double)*(h->lwork+2*t));
-    h->iwork = (int *) malloc(sizeof(int)*h->liwork);
-  } else if (h->dim > h->dim0) {
-    h->dim0 = h->dim;
-    free(h->work);
-    free(h->iwork);
-    h->work = (double *) malloc(sizeof(double)*(h->lwork+2*t));
-    h->iwork = (int *) malloc(sizeof(int)*h->liwork);
-  }
-
-  h->msize = h->dim * h->n_basis + h->dim;  
+    t = t*2;
+    h->lwork = 1 + 10*hdim + t;
+    h->liwork = 3 + 10*hdim;
+    if (diag_mode == 1) {
+      jp = 1 + 6*hdim + 2*hdim*hdim;
+      if (h->lwork < jp) h->lwork = jp;
+    } else if (diag_mode == 2) {
+      /* room for the blocked reduction, and the isuppz of dsyevr */
+      jp = 70*hdim;
+      if (h->lwork < jp) h->lwork = jp;
+      h->liwork = 3 + 12*hdim;
+    }
+    /* the work space also depends on the solver */
+    if (h->work == NULL) {
+      h->dim0 = h->dim;
+      h->lwork0 = h->lwork;
+      h->liwork0 = h->liwork;
+      h->work = (double *) malloc(sizeof(double)*(h->lwork+2*t));
+      h->iwork = (int *) malloc(sizeof(int)*h->liwork);
+    } else if (h->dim > h->dim0 || h->lwork > h->lwork0 || 
+	       h->liwork > h->liwork0) {
+      h->dim0 = h->dim;
+      h->lwork0 = h->lwork;
+      h->liwork0 = h->liwork;
+      free(h->work);
+      free(h->iwork);
+      h->work = (double *) malloc(sizeof(double)*(h->lwork+2*t));
+      h->iwork = (int *) malloc(sizeof(int)*h->liwork);
+    }
+    t = h->dim;
+  } else {
+    /* the work space of the Davidson solver is allocated there */
+    if (hdim > DAVIDSON_MINDIM*diag_nlev) t = diag_nlev;
+    else t = hdim;
+  }
+
+  h->msize = t * h->n_basis + h->dim;  
   if (h->mixing == NULL) {
     h->msize0 = h->msize;
     h->mixing = (double *) malloc(sizeof(double)*h->msize);
@@ -41,6 +41,13 @@ typedef struct _HAMILTON_ {
   int msize0;
   int lwork;
   int liwork;
+  int lwork0;
+  int liwork0;
+  int storage;
+  int nlevs;
+  int nnz;
+  int *hptr;
+  int *hidx;
   int *basis;
   double *hamilton;
   double *mixing;
@@ -74,8 +81,14 @@ typedef struct _LEVEL_ION_ {
   int imax;
 } LEVEL_ION;
 
+/* the kind of angular coefficients held by an ANGZ_DATUM */
+#define ANGZ_MIX 0
+#define ANGZ_FB  1
+#define ANGZ_ZXZ 2
+
 typedef struct _ANGZ_DATUM_ {
   int ns;
+  int kind;
   int *nz;
   void **angz;
   double **mk;
@@ -145,6 +158,7 @@ int SortUnique(int n, int *a);
 int CompareInt(const void *a1, const void *a2);
 int ConstructHamilton(int isym, int k0, int k, int *kg, int kp, int *kgp, int md);
 int ConstructHamiltonDiagonal(int isym, int k, int *kg, int m);
+int ConstructHamiltonSparse(int isym);
 int ValidBasis(STATE *s, int k, int *kg, int n);
 int ConstructHamiltonFrozen(int isym, int k, int *kg, int n, int nc, int *kc);
 void HamiltonElement1E2E(int isym, int isi, int isj, double *r1, double *r2);
@@ -162,7 +176,11 @@ double Hamilton1E(int n_shells, SHELL_STATE *sbra,
 HAMILTON *GetHamilton(void);
 SHAMILTON *GetSHamilton(int *n);
 int DiagnolizeHamilton(void);
+int DiagnolizeHamiltonSparse(void);
+void MultiplyHamiltonSparse(HAMILTON *h, double *x, double *y);
 int AddToLevels(int ng, int *kg);
+int AddToLevelsHamilton(HAMILTON *h, int ng, int *kg);
+int SolveStructure(int ng0, int ng, int *kg, int ngp, int *kgp);
 int AddECorrection(int kref, int k, double e, int nmin);
 LEVEL *GetLevel(int k);
 LEVEL *GetEBLevel(int k);
@@ -192,6 +210,8 @@ int AngZSwapBraKet(int nz, ANGULAR_ZMIX *ang, int p);
 int AngularZFreeBoundStates(ANGZ_DATUM **ad, int ih1, int ih2);
 int AngularZxZMixStates(ANGZ_DATUM **ad, int ih1, int ih2);
 int AngularZxZFreeBoundStates(ANGZ_DATUM **ad, int ih1, int ih2);
+int LoadAngZ(char *fn);
+int SaveAngZ(char *fn);
 int AddToAngularZxZ(int *n, int *nz, ANGULAR_ZxZMIX **ang, 
 		    int n_shells, int phase, SHELL_STATE *sbra, 
 		    SHELL_STATE *sket, INTERACT_SHELL *s, int m);
@@ -210,6 +230,7 @@ int SaveEBLevels(char *fn, int m, int n);
 int SetAngZOptions(int n, double mc, double c);
 int SetAngZCut(double c);
 int SetCILevel(int m);
+int SetEigenSolver(int m, int nlev);
 int SetMixCut(double c, double c2);
 int FreeAngZArray(void);
 int InitAngZArray(void);
@@ -226,6 +247,7 @@ void CutMixing(int nlev, int *ilev, int n, int *kg, double c);
 void FlagClosed(SHAMILTON *h);
 int IsClosedShell(int ih, int p);
 int AllocHamMem(int hdim, int nbasis);
+int AllocHamStorage(int hdim, int nbasis, int storage);
 void SetFields(double b, double e, double a, int m);
 void GetFields(double *b, double *e, double *a);
 int CodeBasisEB(int s, int m);
@@ -838,6 +838,22 @@ static PyObject *PSetAngZOptions(PyObject *self, PyObject *args) {
   return Py_None;
 }
 
+static PyObject *PSetThreads(PyObject *self, PyObject *args) {
+  int i;
+
+  if (sfac_file) {
+    SFACStatement("SetThreads", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  if (!PyArg_ParseTuple(args, "i", &i))
+    return NULL;
+  if (i > 0) SetMaxThreads(i);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static PyObject *PSetCILevel(PyObject *self, PyObject *args) {
   int i;
 
@@ -854,6 +870,23 @@ static PyObject *PSetCILevel(PyObject *self, PyObject *args) {
   return Py_None;
 }
 
+static PyObject *PSetEigenSolver(PyObject *self, PyObject *args) {
+  int m, nlev;
+
+  if (sfac_file) {
+    SFACStatement("SetEigenSolver", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  nlev = 0;
+  if (!PyArg_ParseTuple(args, "i|i", &m, &nlev))
+    return NULL;
+  SetEigenSolver(m, nlev);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static PyObject *PSetAngZCut(PyObject *self, PyObject *args) {
   double c;
 
@@ -1146,7 +1179,7 @@ static PyObject *PSolveBound(PyObject *self, PyObject *args) {
 }
 
 static PyObject *PStructure(PyObject *self, PyObject *args) {
-  int i, k, ng0, ng, ns;
+  int i, ng0, ng;
   int nlevels, ip;
   int ngp;
   int *kg, *kgp;
@@ -1211,19 +1244,9 @@ static PyObject *PStructure(PyObject *self, PyObject *args) {
   if (IsUTA()) {
     AddToLevels(ng0, kg);
   } else {
-    ns = MAX_SYMMETRIES;
-    for (i = 0; i < ns; i++) {
-      k = ConstructHamilton(i, ng0, ng, kg, ngp, kgp, 111);
-      if (k < 0) continue;
-      if (DiagnolizeHamilton() < 0) {
-	onError("Diagnolizing Hamiltonian Error");
-	return NULL;
-      }
-      if (ng0 < ng) {
-	AddToLevels(ng0, kg);
-      } else {
-	AddToLevels(0, kg);
-      }
+    if (SolveStructure(ng0, ng, kg, ngp, kgp) < 0) {
+      onError("Diagnolizing Hamiltonian Error");
+      return NULL;
     }
   }
 
@@ -2880,7 +2903,7 @@ static PyObject *PTestMyArray(PyObject *self, PyObject *args) {
     }
   }
   printf("set\n"); 
-  MultiFreeData(&ma, NULL);
+  MultiFree(&ma, NULL);
   printf("freed\n");
   Py_INCREF(Py_None);
   return Py_None;
@@ -3591,6 +3614,36 @@ static PyObject *PPrintTable(PyObject *self, PyObject *args) {
   return Py_None;
 }
 
+static PyObject *PLoadAngZ(PyObject *self, PyObject *args) {
+  char *s;
+
+  if (sfac_file) {
+    SFACStatement("LoadAngZ", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  if (!PyArg_ParseTuple(args, "s", &s)) return NULL;
+  LoadAngZ(s);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *PSaveAngZ(PyObject *self, PyObject *args) {
+  char *s;
+
+  if (sfac_file) {
+    SFACStatement("SaveAngZ", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  if (!PyArg_ParseTuple(args, "s", &s)) return NULL;
+  if (SaveAngZ(s) < 0) return NULL;
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static PyObject *PMemENTable(PyObject *self, PyObject *args) { 
   char *fn;
   
@@ -4843,6 +4896,35 @@ static PyObject *PJoinTable(PyObject *self, PyObject *args) {
   return Py_None;
 }
 
+static PyObject *PMergeTable(PyObject *self, PyObject *args) {
+  PyObject *q;
+  char **fn;
+  int i, n;
+  
+  if (sfac_file) {
+    SFACStatement("MergeTable", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  n = PyTuple_Size(args);
+  if (n < 2) return NULL;
+  fn = (char **) malloc(sizeof(char *)*n);
+  for (i = 0; i < n; i++) {
+    q = PyTuple_GetItem(args, i);
+    if (!PyString_Check(q)) {
+      free(fn);
+      return NULL;
+    }
+    fn[i] = PyString_AsString(q);
+  }
+  i = MergeTable(fn[0], n-1, fn+1);
+  free(fn);
+  if (i < 0) return NULL;
+  
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static PyObject *PModifyTable(PyObject *self, PyObject *args) {
   char *fn, *fn1, *fn2, *fnm; 
   
@@ -4876,6 +4958,82 @@ static PyObject *PLimitArray(PyObject *self, PyObject *args) {
   return Py_None;
 }
 
+static PyObject *PLimitArrayMemory(PyObject *self, PyObject *args) {
+  int m;
+  double mb;
+  
+  if (sfac_file) {
+    SFACStatement("LimitArrayMemory", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  if (!PyArg_ParseTuple(args, "id", &m, &mb)) return NULL;
+  if (m < 10) LimitArrayRadialMemory(m, mb);
+  
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *PPrintAngularStats(PyObject *self, PyObject *args) {
+  
+  if (sfac_file) {
+    SFACStatement("PrintAngularStats", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  PrintAngularStats();
+  
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *PPrintArrayStats(PyObject *self, PyObject *args) {
+  
+  if (sfac_file) {
+    SFACStatement("PrintArrayStats", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  PrintArrayRadialStats();
+  
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *PSaveRadialCheckpoint(PyObject *self, PyObject *args) {
+  char *fn;
+
+  if (sfac_file) {
+    SFACStatement("SaveRadialCheckpoint", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  if (!PyArg_ParseTuple(args, "s", &fn)) return NULL;
+  if (SaveRadialCheckpoint(fn) < 0) return NULL;
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject *PSetRadialCheckpoint(PyObject *self, PyObject *args) {
+  char *fn;
+  double dt;
+
+  if (sfac_file) {
+    SFACStatement("SetRadialCheckpoint", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  dt = 0.0;
+  if (!PyArg_ParseTuple(args, "s|d", &fn, &dt)) return NULL;
+  SetRadialCheckpoint(fn, dt);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static PyObject *PWignerDMatrix(PyObject *self, PyObject *args) {
   int j2, m2, n2;
   double a;
@@ -4987,8 +5145,10 @@ static struct PyMethodDef fac_methods[] = {
   {"SetCEPWFile", PSetCEPWFile, METH_VARARGS}, 
   {"AppendTable", PAppendTable, METH_VARARGS}, 
   {"JoinTable", PJoinTable, METH_VARARGS}, 
+  {"MergeTable", PMergeTable, METH_VARARGS},
   {"ModifyTable", PModifyTable, METH_VARARGS},
   {"LimitArray", PLimitArray, METH_VARARGS},
+  {"LimitArrayMemory", PLimitArrayMemory, METH_VARARGS},
   {"RMatrixExpansion", PRMatrixExpansion, METH_VARARGS}, 
   {"RMatrixNBatch", PRMatrixNBatch, METH_VARARGS}, 
   {"RMatrixFMode", PRMatrixFMode, METH_VARARGS}, 
@@ -5052,13 +5212,19 @@ static struct PyMethodDef fac_methods[] = {
   {"Info", PInfo, METH_VARARGS},
   {"StructureMBPT", PStructureMBPT, METH_VARARGS},
   {"TransitionMBPT", PTransitionMBPT, METH_VARARGS},
+  {"LoadAngZ", PLoadAngZ, METH_VARARGS},
   {"MemENTable", PMemENTable, METH_VARARGS},
+  {"SaveAngZ", PSaveAngZ, METH_VARARGS},
   {"LevelInfor", PLevelInfor, METH_VARARGS},
   {"LevelInfo", PLevelInfor, METH_VARARGS},
   {"OptimizeRadial", POptimizeRadial, METH_VARARGS},
   {"PrepAngular", PPrepAngular, METH_VARARGS},
   {"RadialOverlaps", PRadialOverlaps, METH_VARARGS},
   {"RefineRadial", PRefineRadial, METH_VARARGS},
+  {"PrintAngularStats", PPrintAngularStats, METH_VARARGS},
+  {"PrintArrayStats", PPrintArrayStats, METH_VARARGS},
+  {"SaveRadialCheckpoint", PSaveRadialCheckpoint, METH_VARARGS},
+  {"SetRadialCheckpoint", PSetRadialCheckpoint, METH_VARARGS},
   {"PrintTable", PPrintTable, METH_VARARGS},
   {"RecStates", PRecStates, METH_VARARGS},
   {"ReinitConfig", PReinitConfig, METH_VARARGS},
@@ -5077,6 +5243,8 @@ static struct PyMethodDef fac_methods[] = {
   {"SetAngZOptions", PSetAngZOptions, METH_VARARGS},
   {"SetAngZCut", PSetAngZCut, METH_VARARGS},
   {"SetCILevel", PSetCILevel, METH_VARARGS},
+  {"SetThreads", PSetThreads, METH_VARARGS},
+  {"SetEigenSolver", PSetEigenSolver, METH_VARARGS},
   {"SetMixCut", PSetMixCut, METH_VARARGS},
   {"SetAtom", PSetAtom, METH_VARARGS},
   {"SetAvgConfig", PSetAvgConfig, METH_VARARGS},
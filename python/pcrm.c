@@ -391,6 +391,22 @@ static PyObject *PSetRateAccuracy(PyObject *self, PyObject *args) {
   return Py_None;
 }  
     
+static PyObject *PSetRateQuadrature(PyObject *self, PyObject *args) {
+  int n;
+
+  if (scrm_file) {
+    SCRMStatement("SetRateQuadrature", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+  
+  if (!PyArg_ParseTuple(args, "i", &n)) return NULL;
+  SetRateQuadrature(n);
+  
+  Py_INCREF(Py_None);
+  return Py_None;
+}  
+    
 static PyObject *PSetCascade(PyObject *self, PyObject *args) {
   int c;
   double a;
@@ -427,6 +443,23 @@ static PyObject *PSetIteration(PyObject *self, PyObject *args) {
   return Py_None;
 } 
 
+static PyObject *PSetSparseSolver(PyObject *self, PyObject *args) {
+  int m;
+  double tol;
+  
+  if (scrm_file) {
+    SCRMStatement("SetSparseSolver", args, NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  tol = -1.0;
+  if (!PyArg_ParseTuple(args, "i|d", &m, &tol)) return NULL;
+  SetSparseSolver(m, tol);
+  Py_INCREF(Py_None);
+  return Py_None;
+} 
+
 static PyObject *PSetBlocks(PyObject *self, PyObject *args) {
   char *ifn;
   double n;
@@ -1308,7 +1341,9 @@ static struct PyMethodDef crm_methods[] = {
   {"SetPhoDensity", PSetPhoDensity, METH_VARARGS},
   {"SetCascade", PSetCascade, METH_VARARGS},
   {"SetIteration", PSetIteration, METH_VARARGS},
+  {"SetSparseSolver", PSetSparseSolver, METH_VARARGS},
   {"SetRateAccuracy", PSetRateAccuracy, METH_VARARGS},
+  {"SetRateQuadrature", PSetRateQuadrature, METH_VARARGS},
   {"SetBlocks", PSetBlocks, METH_VARARGS},
   {"RateTable", PRateTable, METH_VARARGS},
   {"AddIon", PAddIon, METH_VARARGS},
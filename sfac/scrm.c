@@ -225,6 +225,18 @@ static int PSetRateAccuracy(int argc, char *argv[], int argt[],
   return 0;
 }
 
+static int PSetRateQuadrature(int argc, char *argv[], int argt[], 
+			      ARRAY *variables) {
+  int n;
+
+  if (argc != 1) return -1;
+  n = atoi(argv[0]);
+
+  SetRateQuadrature(n);
+  
+  return 0;
+}
+
 static int PSetCascade(int argc, char *argv[], int argt[], 
 		       ARRAY *variables) {
   int c;
@@ -262,6 +274,21 @@ static int PSetIteration(int argc, char *argv[], int argt[],
   return 0;
 } 
 
+static int PSetSparseSolver(int argc, char *argv[], int argt[], 
+			    ARRAY *variables) {
+  int m;
+  double tol;
+
+  if (argc < 1 || argc > 2) return -1;
+
+  m = atoi(argv[0]);
+  tol = -1.0;
+  if (argc > 1) tol = atof(argv[1]);
+
+  SetSparseSolver(m, tol);
+  return 0;
+} 
+
 static int PSetBlocks(int argc, char *argv[], int argt[], 
 		      ARRAY *variables) {
   char *ifn;
@@ -701,7 +728,9 @@ static METHOD methods[] = {
   {"SetPhoDensity", PSetPhoDensity, METH_VARARGS},
   {"SetCascade", PSetCascade, METH_VARARGS},
   {"SetIteration", PSetIteration, METH_VARARGS},
+  {"SetSparseSolver", PSetSparseSolver, METH_VARARGS},
   {"SetRateAccuracy", PSetRateAccuracy, METH_VARARGS},
+  {"SetRateQuadrature", PSetRateQuadrature, METH_VARARGS},
   {"SetBlocks", PSetBlocks, METH_VARARGS},
   {"RateTable", PRateTable, METH_VARARGS},
   {"AddIon", PAddIon, METH_VARARGS},
@@ -932,6 +932,28 @@ static int PInfo(int argc, char *argv[], int argt[], ARRAY *variables) {
   return 0;
 }
 
+static int PLoadAngZ(int argc, char *argv[], int argt[], 
+		     ARRAY *variables) {
+
+  if (argc != 1) return -1;
+  if (argt[0] != STRING) return -1;
+
+  LoadAngZ(argv[0]);
+
+  return 0;
+}
+
+static int PSaveAngZ(int argc, char *argv[], int argt[], 
+		     ARRAY *variables) {
+
+  if (argc != 1) return -1;
+  if (argt[0] != STRING) return -1;
+
+  if (SaveAngZ(argv[0]) < 0) return -1;
+
+  return 0;
+}
+
 static int PMemENTable(int argc, char *argv[], int argt[], 
 		       ARRAY *variables) {
 
@@ -1374,6 +1396,17 @@ static int PSetAngZOptions(int argc, char *argv[], int argt[],
   return 0;
 }
 
+static int PSetThreads(int argc, char *argv[], int argt[],
+		       ARRAY *variables) {
+  int i;
+  
+  if (argc != 1 || argt[0] != NUMBER) return -1;
+  i = atoi(argv[0]);
+  if (i > 0) SetMaxThreads(i);
+
+  return 0;
+}
+
 static int PSetCILevel(int argc, char *argv[], int argt[],
 		       ARRAY *variables) {
   int i;
@@ -1385,6 +1418,23 @@ static int PSetCILevel(int argc, char *argv[], int argt[],
   return 0;
 }
 
+static int PSetEigenSolver(int argc, char *argv[], int argt[],
+			   ARRAY *variables) {
+  int m, nlev;
+  
+  if (argc < 1 || argc > 2) return -1;
+  if (argt[0] != NUMBER) return -1;
+  m = atoi(argv[0]);
+  nlev = 0;
+  if (argc > 1) {
+    if (argt[1] != NUMBER) return -1;
+    nlev = atoi(argv[1]);
+  }
+  SetEigenSolver(m, nlev);
+
+  return 0;
+}
+
 static int PSetAngZCut(int argc, char *argv[], int argt[],
 		       ARRAY *variables) {
   double c;
@@ -2771,7 +2821,7 @@ static int PCutMixing(int argc, char *argv[], int argt[],
 }
 static int PStructure(int argc, char *argv[], int argt[], 
 		      ARRAY *variables) {
-  int i, k, ng0, ng, ngp, ns;
+  int i, ng0, ng, ngp;
   int ip, nlevels;
   int *kg, *kgp;
   int n;
@@ -2827,17 +2877,7 @@ static int PStructure(int argc, char *argv[], int argt[],
   if (IsUTA()) {
     AddToLevels(ng0, kg);
   } else {
-    ns = MAX_SYMMETRIES;  
-    for (i = 0; i < ns; i++) {
-      k = ConstructHamilton(i, ng0, ng, kg, ngp, kgp, 111);
-      if (k < 0) continue;
-      if (DiagnolizeHamilton() < 0) return -1;
-      if (ng0 < ng) {
-	AddToLevels(ng0, kg);
-      } else {
-	AddToLevels(0, kg);
-      }
-    }
+    if (SolveStructure(ng0, ng, kg, ngp, kgp) < 0) return -1;
   }
 
   SortLevels(nlevels, -1, 0);
@@ -3546,6 +3586,15 @@ static int PJoinTable(int argc, char *argv[], int argt[],
   return 0;
 }
 
+static int PMergeTable(int argc, char *argv[], int argt[], 
+		       ARRAY *variables) {
+  if (argc < 2) return -1;
+  
+  if (MergeTable(argv[0], argc-1, argv+1) < 0) return -1;
+  
+  return 0;
+}
+
 static int PModifyTable(int argc, char *argv[], int argt[], 
 			ARRAY *variables) {
   
@@ -3576,6 +3625,54 @@ static int PLimitArray(int argc, char *argv[], int argt[],
   return 0;
 }
 
+static int PLimitArrayMemory(int argc, char *argv[], int argt[], 
+			     ARRAY *variables) {
+  int m;
+  double mb;
+
+  if (argc != 2) return -1;
+  m = atoi(argv[0]);
+  mb = atof(argv[1]);
+
+  if (m < 10) {
+    LimitArrayRadialMemory(m, mb);
+  }
+  
+  return 0;
+}
+
+static int PPrintAngularStats(int argc, char *argv[], int argt[], 
+			      ARRAY *variables) {
+  if (argc != 0) return -1;
+  PrintAngularStats();
+  return 0;
+}
+
+static int PPrintArrayStats(int argc, char *argv[], int argt[], 
+			    ARRAY *variables) {
+  if (argc != 0) return -1;
+  PrintArrayRadialStats();
+  return 0;
+}
+
+static int PSetRadialCheckpoint(int argc, char *argv[], int argt[], 
+				ARRAY *variables) {
+  double dt;
+
+  if (argc < 1 || argc > 2 || argt[0] != STRING) return -1;
+  dt = 0.0;
+  if (argc > 1) dt = atof(argv[1]);
+  SetRadialCheckpoint(argv[0], dt);
+  return 0;
+}
+
+static int PSaveRadialCheckpoint(int argc, char *argv[], int argt[], 
+				 ARRAY *variables) {
+  if (argc != 1 || argt[0] != STRING) return -1;
+  if (SaveRadialCheckpoint(argv[0]) < 0) return -1;
+  return 0;
+}
+
 static int PSetFields(int argc, char *argv[], int argt[], 
 		      ARRAY *variables) {
   int m;
@@ -3775,10 +3872,12 @@ static METHOD methods[] = {
   {"SetCEPWFile", PSetCEPWFile, METH_VARARGS}, 
   {"AppendTable", PAppendTable, METH_VARARGS}, 
   {"JoinTable", PJoinTable, METH_VARARGS}, 
+  {"MergeTable", PMergeTable, METH_VARARGS}, 
   {"ModifyTable", PModifyTable, METH_VARARGS},
   {"LimitArray", PLimitArray, METH_VARARGS},
+  {"LimitArrayMemory", PLimitArrayMemory, METH_VARARGS},
   {"RMatrixExpansion", PRMatrixExpansion, METH_VARARGS}, 
-  {"RMatrixNBatch", PRMatrixNMultipoles, METH_VARARGS}, 
+  {"RMatrixNBatch", PRMatrixNBatch, METH_VARARGS}, 
   {"RMatrixFMode", PRMatrixFMode, METH_VARARGS}, 
   {"RMatrixConvert", PRMatrixConvert, METH_VARARGS}, 
   {"RMatrixNMultipoles", PRMatrixNMultipoles, METH_VARARGS}, 
@@ -3823,7 +3922,9 @@ static METHOD methods[] = {
   {"FreeRecQk", PFreeRecQk, METH_VARARGS},
   {"GetPotential", PGetPotential, METH_VARARGS},
   {"Info", PInfo, METH_VARARGS},
+  {"LoadAngZ", PLoadAngZ, METH_VARARGS},
   {"MemENTable", PMemENTable, METH_VARARGS},
+  {"SaveAngZ", PSaveAngZ, METH_VARARGS},
   {"StructureMBPT", PStructureMBPT, METH_VARARGS},
   {"TransitionMBPT", PTransitionMBPT, METH_VARARGS},
   {"OptimizeRadial", POptimizeRadial, METH_VARARGS},
@@ -3831,6 +3932,10 @@ static METHOD methods[] = {
   {"Pause", PPause, METH_VARARGS},
   {"RadialOverlaps", PRadialOverlaps, METH_VARARGS},
   {"RefineRadial", PRefineRadial, METH_VARARGS},
+  {"PrintAngularStats", PPrintAngularStats, METH_VARARGS},
+  {"PrintArrayStats", PPrintArrayStats, METH_VARARGS},
+  {"SaveRadialCheckpoint", PSaveRadialCheckpoint, METH_VARARGS},
+  {"SetRadialCheckpoint", PSetRadialCheckpoint, METH_VARARGS},
   {"PrintMemInfo", PPrintMemInfo, METH_VARARGS},
   {"PrintTable", PPrintTable, METH_VARARGS},
   {"RecStates", PRecStates, METH_VARARGS},
@@ -3849,6 +3954,8 @@ static METHOD methods[] = {
   {"SetAngZOptions", PSetAngZOptions, METH_VARARGS},
   {"SetAngZCut", PSetAngZCut, METH_VARARGS},
   {"SetCILevel", PSetCILevel, METH_VARARGS},
+  {"SetThreads", PSetThreads, METH_VARARGS},
+  {"SetEigenSolver", PSetEigenSolver, METH_VARARGS},
   {"SetBoundary", PSetBoundary, METH_VARARGS},
   {"SetMixCut", PSetMixCut, METH_VARARGS},
   {"SetAtom", PSetAtom, METH_VARARGS},